@@ -35,8 +35,14 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <exception>
+#include <iterator>
 #include <string>
+#include <utility>
 
 #include "libreallive/compression.h"
 
@@ -47,16 +53,30 @@ namespace fs = boost::filesystem;
 namespace libreallive {
 
 Archive::Archive(const std::string& filename)
-    : name_(filename), info_(filename, Read), second_level_xor_key_(NULL) {
+    : scenario_budget_(0),
+      resident_size_(0),
+      access_counter_(0),
+      name_(filename),
+      info_(filename, Read),
+      second_level_xor_key_(NULL),
+      preload_in_flight_(-1),
+      preload_hits_(0),
+      preload_stopping_(false) {
   ReadTOC();
   ReadOverrides();
 }
 
 Archive::Archive(const std::string& filename, const std::string& regname)
-    : name_(filename),
+    : scenario_budget_(0),
+      resident_size_(0),
+      access_counter_(0),
+      name_(filename),
       info_(filename, Read),
       second_level_xor_key_(NULL),
-      regname_(regname) {
+      regname_(regname),
+      preload_in_flight_(-1),
+      preload_hits_(0),
+      preload_stopping_(false) {
   ReadTOC();
   ReadOverrides();
 
@@ -92,20 +112,208 @@ Archive::Archive(const std::string& filename, const std::string& regname)
   }
 }
 
-Archive::~Archive() {}
+Archive::~Archive() {
+  if (preload_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(preload_mutex_);
+      preload_stopping_ = true;
+    }
+    preload_thread_.join();
+  }
+}
 
 Scenario* Archive::GetScenario(int index) {
-  accessed_t::const_iterator at = accessed_.find(index);
-  if (at != accessed_.end())
-    return at->second.get();
-  scenarios_t::const_iterator st = scenarios_.find(index);
-  if (st != scenarios_.end()) {
-    Scenario* scene =
-        new Scenario(st->second, index, regname_, second_level_xor_key_);
-    accessed_[index].reset(scene);
-    return scene;
+  accessed_t::iterator at = accessed_.find(index);
+  if (at != accessed_.end()) {
+    at->second.last_access = ++access_counter_;
+    return at->second.scenario.get();
+  }
+  if (scenarios_.find(index) == scenarios_.end())
+    return NULL;
+
+  {
+    std::unique_lock<std::mutex> lock(preload_mutex_);
+    // Waiting on a parse that's already under way beats starting over.
+    preload_finished_.wait(lock,
+                           [&] { return preload_in_flight_ != index; });
+
+    auto it = preloaded_.find(index);
+    if (it != preloaded_.end()) {
+      std::unique_ptr<Scenario> scene = std::move(it->second);
+      preloaded_.erase(it);
+      preload_hits_++;
+      // AddToCache() charges it again.
+      resident_size_ -= scene->resident_size();
+      lock.unlock();
+      return AddToCache(index, std::move(scene));
+    }
+
+    claimed_.insert(index);
+  }
+
+  return AddToCache(index, ParseScenario(index));
+}
+
+void Archive::TrimScenarioCache() {
+  EvictUntilWithinBudget(-1);
+}
+
+void Archive::StartPreload() {
+  if (!preload_thread_.joinable())
+    preload_thread_ = std::thread(&Archive::RunPreload, this, scenario_budget_);
+}
+
+int Archive::preload_hits() const {
+  std::lock_guard<std::mutex> lock(preload_mutex_);
+  return preload_hits_;
+}
+
+std::vector<Archive::ScenarioReport> Archive::ValidateScenarios() const {
+  std::vector<ScenarioReport> reports(scenarios_.size());
+  std::vector<int> indexes;
+  for (const auto& entry : scenarios_)
+    indexes.push_back(entry.first);
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < indexes.size(); i = next++) {
+      ScenarioReport& report = reports[i];
+      report.index = indexes[i];
+      report.elements = 0;
+      report.bytecode_length = 0;
+
+      auto start = std::chrono::steady_clock::now();
+      try {
+        std::unique_ptr<Scenario> scene = ParseScenario(indexes[i]);
+        report.elements = scene->size();
+        report.bytecode_length = scene->bytecode_length();
+      }
+      catch (std::exception& e) {
+        report.error = e.what();
+      }
+      report.parse_time =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start).count();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  size_t thread_count = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), indexes.size());
+  for (size_t i = 1; i < thread_count; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+
+  return reports;
+}
+
+std::map<int, size_t> Archive::GetResidentScenarioSizes() const {
+  std::map<int, size_t> sizes;
+  for (const auto& entry : accessed_)
+    sizes[entry.first] = entry.second.size;
+
+  std::lock_guard<std::mutex> lock(preload_mutex_);
+  for (const auto& entry : preloaded_)
+    sizes[entry.first] = entry.second->resident_size();
+  return sizes;
+}
+
+void Archive::EvictUntilWithinBudget(int keep) {
+  if (!scenario_budget_)
+    return;
+
+  {
+    // Nobody has asked for these yet, so they go first, furthest ahead first.
+    std::lock_guard<std::mutex> lock(preload_mutex_);
+    while (resident_size_ > scenario_budget_ && !preloaded_.empty()) {
+      auto victim = std::prev(preloaded_.end());
+      resident_size_ -= victim->second->resident_size();
+      preloaded_.erase(victim);
+    }
+  }
+
+  while (resident_size_ > scenario_budget_) {
+    accessed_t::iterator victim = accessed_.end();
+    for (accessed_t::iterator it = accessed_.begin(); it != accessed_.end();
+         ++it) {
+      if (it->first == keep ||
+          (scenario_in_use_ && scenario_in_use_(it->first)))
+        continue;
+      if (victim == accessed_.end() ||
+          it->second.last_access < victim->second.last_access)
+        victim = it;
+    }
+
+    if (victim == accessed_.end())
+      return;
+
+    resident_size_ -= victim->second.size;
+    accessed_.erase(victim);
+  }
+}
+
+std::unique_ptr<Scenario> Archive::ParseScenario(int index) const {
+  return std::unique_ptr<Scenario>(new Scenario(
+      scenarios_.at(index), index, regname_, second_level_xor_key_));
+}
+
+Scenario* Archive::AddToCache(int index, std::unique_ptr<Scenario> scene) {
+  CachedScenario& cached = accessed_[index];
+  cached.scenario = std::move(scene);
+  cached.size = cached.scenario->resident_size();
+  cached.last_access = ++access_counter_;
+  resident_size_ += cached.size;
+
+  Scenario* result = cached.scenario.get();
+  if (scenario_loaded_)
+    scenario_loaded_(result);
+
+  // Our caller is about to use |result|, so it's never a candidate.
+  EvictUntilWithinBudget(index);
+  return result;
+}
+
+void Archive::RunPreload(size_t budget) {
+  // |scenarios_| doesn't change after construction, so it's safe to walk
+  // without the lock.
+  for (const auto& entry : scenarios_) {
+    int index = entry.first;
+    {
+      std::lock_guard<std::mutex> lock(preload_mutex_);
+      if (preload_stopping_)
+        return;
+      if (!claimed_.insert(index).second)
+        continue;
+      preload_in_flight_ = index;
+    }
+
+    std::unique_ptr<Scenario> scene;
+    try {
+      scene = ParseScenario(index);
+    }
+    catch (std::exception& e) {
+      // Leave it to GetScenario() to parse it again and report the error.
+    }
+
+    bool over_budget = false;
+    {
+      std::lock_guard<std::mutex> lock(preload_mutex_);
+      preload_in_flight_ = -1;
+      if (scene) {
+        resident_size_ += scene->resident_size();
+        preloaded_[index] = std::move(scene);
+      } else {
+        claimed_.erase(index);
+      }
+      over_budget = budget && resident_size_ >= budget;
+    }
+    preload_finished_.notify_all();
+
+    if (over_budget)
+      return;
   }
-  return NULL;
 }
 
 int Archive::GetProbableEncodingType() const {
@@ -34,9 +34,15 @@
 #ifndef SRC_LIBREALLIVE_ARCHIVE_H_
 #define SRC_LIBREALLIVE_ARCHIVE_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "libreallive/defs.h"
@@ -52,6 +58,22 @@ struct XorKey;
 // Interface to a loaded SEEN.TXT file.
 class Archive {
  public:
+  // The result of parsing one scenario in ValidateScenarios().
+  struct ScenarioReport {
+    int index;
+
+    // Number of bytecode elements, and the length of the decompressed
+    // bytecode they were read from.
+    size_t elements;
+    size_t bytecode_length;
+
+    // Wall clock time spent decompressing and parsing, in microseconds.
+    long parse_time;
+
+    // The error that parsing threw, if any.
+    std::string error;
+  };
+
   // Read an archive, assuming no per-game xor key. (Used in unit testing).
   explicit Archive(const string& filename);
 
@@ -65,15 +87,86 @@ class Archive {
   const_iterator end() { return scenarios_.cend(); }
 
   // Returns a specific scenario by |index| number or NULL if none exist.
+  //
+  // Parsed scenarios are cached. When a scenario budget is set, parsing a new
+  // scenario may evict others, which invalidates pointers to them; see
+  // set_scenario_in_use_callback().
   Scenario* GetScenario(int index);
 
+  // Limits the approximate number of bytes of parsed scenarios we keep
+  // resident. Zero, the default, never evicts anything.
+  void set_scenario_budget(size_t bytes) { scenario_budget_ = bytes; }
+  size_t scenario_budget() const { return scenario_budget_; }
+
+  // Sets the predicate that says whether a scenario number is still
+  // referenced by someone (i.e., a StackFrame). Those are never evicted.
+  void set_scenario_in_use_callback(std::function<bool(int)> in_use) {
+    scenario_in_use_ = in_use;
+  }
+
+  // Sets a function that's run on each newly parsed scenario before
+  // GetScenario() returns it.
+  void set_scenario_loaded_callback(std::function<void(Scenario*)> loaded) {
+    scenario_loaded_ = loaded;
+  }
+
+  // Evicts least recently used scenarios until we're within budget or only
+  // scenarios that are in use remain.
+  void TrimScenarioCache();
+
+  // Starts parsing scenarios that haven't been asked for yet on a background
+  // thread, in scenario number order. GetScenario() picks up the finished
+  // ones instead of parsing them again. Preloaded scenarios count against the
+  // scenario budget like any other and are the first to be evicted; the
+  // thread stops once the budget is full or it runs out of scenarios.
+  void StartPreload();
+
+  // Number of scenarios that GetScenario() got from the preload thread.
+  int preload_hits() const;
+
+  // Decompresses and parses every scenario in the archive across all cores,
+  // outside of the scenario cache, and reports how each one went. Errors are
+  // caught and recorded instead of thrown.
+  std::vector<ScenarioReport> ValidateScenarios() const;
+
+  // Returns the approximate resident size of each parsed scenario, including
+  // ones the preload thread has parsed, keyed by scenario number.
+  std::map<int, size_t> GetResidentScenarioSizes() const;
+
+  // Total approximate size of all parsed scenarios, including preloaded ones.
+  size_t resident_size() const { return resident_size_; }
+
   // Does a quick pass through all scenarios in the archive, looking for any
   // with non-default encoding. This short circuits when it finds one.
   int GetProbableEncodingType() const;
 
  private:
+  struct CachedScenario {
+    std::unique_ptr<Scenario> scenario;
+    size_t size;
+
+    // Value of |access_counter_| when this was last returned.
+    unsigned long last_access;
+  };
+
   typedef std::map<int, FilePos> scenarios_t;
-  typedef std::map<int, std::unique_ptr<Scenario>> accessed_t;
+  typedef std::map<int, CachedScenario> accessed_t;
+
+  // Drops preloaded scenarios nobody has asked for yet, and then least
+  // recently used scenarios other than |keep| and those that are in use,
+  // until |resident_size_| is within |scenario_budget_|.
+  void EvictUntilWithinBudget(int keep);
+
+  // Parses scenario |index|, which must exist, without touching the cache.
+  // Safe to call from any thread.
+  std::unique_ptr<Scenario> ParseScenario(int index) const;
+
+  // Hands |scene| to the cache and returns it.
+  Scenario* AddToCache(int index, std::unique_ptr<Scenario> scene);
+
+  // Body of |preload_thread_|. Stops once |resident_size_| reaches |budget|,
+  // unless |budget| is zero.
+  void RunPreload(size_t budget);
 
   void ReadTOC();
 
@@ -81,6 +174,15 @@ class Archive {
 
   scenarios_t scenarios_;
   accessed_t accessed_;
+
+  size_t scenario_budget_;
+
+  // Covers both |accessed_| and |preloaded_|, so the preload thread adds to
+  // it too.
+  std::atomic<size_t> resident_size_;
+  unsigned long access_counter_;
+  std::function<bool(int)> scenario_in_use_;
+  std::function<void(Scenario*)> scenario_loaded_;
   string name_;
   Mapping info_;
 
@@ -94,6 +196,28 @@ class Archive {
   // The #REGNAME key from the Gameexe.ini file. Passed down to Scenario for
   // prettier error messages.
   std::string regname_;
+
+  // Guards the preload state below.
+  mutable std::mutex preload_mutex_;
+
+  // Signalled whenever the preload thread finishes a scenario.
+  std::condition_variable preload_finished_;
+
+  // Scenario numbers that have been parsed, or are being parsed, by either
+  // thread. The preload thread skips these.
+  std::set<int> claimed_;
+
+  // Scenarios the preload thread has parsed that GetScenario() hasn't taken.
+  std::map<int, std::unique_ptr<Scenario>> preloaded_;
+
+  // The scenario the preload thread is parsing, or -1.
+  int preload_in_flight_;
+
+  int preload_hits_;
+
+  bool preload_stopping_;
+
+  std::thread preload_thread_;
 };
 
 }  // namespace libreallive
@@ -33,6 +33,7 @@
 
 #include "libreallive/bytecode.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <exception>
@@ -51,86 +52,12 @@ namespace libreallive {
 
 namespace {
 
-inline BytecodeElement* ReadFunction(const char* stream,
-                                     ConstructionData& cdata) {
-  // opcode: 0xttmmoooo (Type, Module, Opcode: e.g. 0x01030101 = 1:03:00257
-  const unsigned long opcode =
-      (stream[1] << 24) | (stream[2] << 16) | (stream[4] << 8) | stream[3];
-  switch (opcode) {
-    case 0x00010000:
-    case 0x00010005:
-    case 0x00050001:
-    case 0x00050005:
-    case 0x00060001:
-    case 0x00060005:
-      return new GotoElement(stream, cdata);
-    case 0x00010001:
-    case 0x00010002:
-    case 0x00010006:
-    case 0x00010007:
-    case 0x00050002:
-    case 0x00050006:
-    case 0x00050007:
-    case 0x00060000:
-    case 0x00060002:
-    case 0x00060006:
-    case 0x00060007:
-      return new GotoIfElement(stream, cdata);
-    case 0x00010003:
-    case 0x00010008:
-    case 0x00050003:
-    case 0x00050008:
-    case 0x00060003:
-    case 0x00060008:
-      return new GotoOnElement(stream, cdata);
-    case 0x00010004:
-    case 0x00010009:
-    case 0x00050004:
-    case 0x00050009:
-    case 0x00060004:
-    case 0x00060009:
-      return new GotoCaseElement(stream, cdata);
-    case 0x00010010:
-    case 0x00060010:
-      return new GosubWithElement(stream, cdata);
+const size_t kCommandSize = 8;
 
-    // Select elements.
-    case 0x00020000:
-    case 0x00020001:
-    case 0x00020002:
-    case 0x00020003:
-    case 0x00020010:
-      return new SelectElement(stream);
-  }
-
-  return BuildFunctionElement(stream);
-}
+char entrypoint_marker = '@';
 
 }  // namespace
 
-char BytecodeElement::entrypoint_marker = '@';
-
-CommandElement* BuildFunctionElement(const char* stream) {
-  const char* ptr = stream;
-  ptr += 8;
-  std::vector<std::string> params;
-  if (*ptr == '(') {
-    const char* end = ptr + 1;
-    while (*end != ')') {
-      const size_t len = NextData(end);
-      params.emplace_back(end, len);
-      end += len;
-    }
-  }
-
-  if (params.size() == 0)
-    return new VoidFunctionElement(stream);
-  else if (params.size() == 1)
-    return new SingleArgFunctionElement(stream, params.front());
-  else
-    return new FunctionElement(stream, params);
-}
-
 void PrintParameterString(std::ostream& oss,
                           const std::vector<std::string>& parameters) {
   bool first = true;
@@ -159,175 +86,23 @@ void PrintParameterString(std::ostream& oss,
 // ConstructionData
 // -----------------------------------------------------------------------
 
-ConstructionData::ConstructionData(size_t kt, pointer_t pt)
-    : kidoku_table(kt), null(pt) {}
+ConstructionData::ConstructionData(size_t kt) : kidoku_table(kt) {}
 
 // -----------------------------------------------------------------------
 
 ConstructionData::~ConstructionData() {}
 
-// -----------------------------------------------------------------------
-// Pointers
-// -----------------------------------------------------------------------
-
-Pointers::Pointers() {}
-
-Pointers::~Pointers() {}
-
-void Pointers::SetPointers(ConstructionData& cdata) {
-  assert(target_ids.size() != 0);
-  targets.reserve(target_ids.size());
-  for (unsigned int i = 0; i < target_ids.size(); ++i) {
-    ConstructionData::offsets_t::const_iterator it =
-        cdata.offsets.find(target_ids[i]);
-    assert(it != cdata.offsets.end());
-    targets.push_back(it->second);
-  }
-  target_ids.clear();
-}
-
-// -----------------------------------------------------------------------
-// BytecodeElement
-// -----------------------------------------------------------------------
-
-BytecodeElement::BytecodeElement() {}
-
-BytecodeElement::~BytecodeElement() {}
-
-void BytecodeElement::PrintSourceRepresentation(RLMachine* machine,
-                                                std::ostream& oss) const {
-  oss << "<unspecified bytecode>" << std::endl;
-}
-
-void BytecodeElement::SetPointers(ConstructionData& cdata) {}
-
-const int BytecodeElement::GetEntrypoint() const { return kInvalidEntrypoint; }
-
-string BytecodeElement::GetSerializedCommand(RLMachine& machine) const {
-  throw Error(
-      "Can't call GetSerializedCommand() on things other than "
-      "FunctionElements");
-}
-
-void BytecodeElement::RunOnMachine(RLMachine& machine) const {
-  machine.AdvanceInstructionPointer();
-}
-
-// static
-BytecodeElement* BytecodeElement::Read(const char* stream,
-                                       const char* end,
-                                       ConstructionData& cdata) {
-  const char c = *stream;
-  if (c == '!')
-    entrypoint_marker = '!';
-  switch (c) {
-    case 0:
-    case ',':
-      return new CommaElement;
-    case '\n':
-      return new MetaElement(0, stream);
-    case '@':  // fall through
-    case '!':
-      return new MetaElement(&cdata, stream);
-    case '$':
-      return new ExpressionElement(stream);
-    case '#':
-      return ReadFunction(stream, cdata);
-    default:
-      return new TextoutElement(stream, end);
-  }
-}
-
-BytecodeElement::BytecodeElement(const BytecodeElement& c) {}
-
-// -----------------------------------------------------------------------
-// CommaElement
-// -----------------------------------------------------------------------
-
-CommaElement::CommaElement() {}
-CommaElement::~CommaElement() {}
-
-void CommaElement::PrintSourceRepresentation(RLMachine* machine,
-                                             std::ostream& oss) const {
-  oss << "<CommaElement>" << std::endl;
-}
-
-const size_t CommaElement::GetBytecodeLength() const { return 1; }
-
-// -----------------------------------------------------------------------
-// MetaElement
-// -----------------------------------------------------------------------
-
-MetaElement::MetaElement(const ConstructionData* cv, const char* src) {
-  value_ = read_i16(src + 1);
-  if (!cv) {
-    type_ = Line_;
-  } else if (cv->kidoku_table.at(value_) >= 1000000) {
-    type_ = Entrypoint_;
-    entrypoint_index_ = cv->kidoku_table[value_] - 1000000;
-  } else {
-    type_ = Kidoku_;
-  }
-}
-
-MetaElement::~MetaElement() {}
-
-void MetaElement::PrintSourceRepresentation(RLMachine* machine,
-                                            std::ostream& oss) const {
-  if (type_ == Line_)
-    oss << "#line " << value_ << std::endl;
-  else if (type_ == Entrypoint_)
-    oss << "#entrypoint " << value_ << std::endl;
-  else
-    oss << "{- Kidoku " << value_ << " -}" << std::endl;
-}
-
-const size_t MetaElement::GetBytecodeLength() const { return 3; }
-
-const int MetaElement::GetEntrypoint() const {
-  return type_ == Entrypoint_ ? entrypoint_index_ : kInvalidEntrypoint;
-}
-
-void MetaElement::RunOnMachine(RLMachine& machine) const {
-  if (type_ == Line_)
-    machine.SetLineNumber(value_);
-  else if (type_ == Kidoku_)
-    machine.SetKidokuMarker(value_);
-
-  machine.AdvanceInstructionPointer();
-}
-
 // -----------------------------------------------------------------------
 // TextoutElement
 // -----------------------------------------------------------------------
 
-TextoutElement::TextoutElement(const char* src, const char* file_end) {
-  const char* end = src;
-  bool quoted = false;
-  while (true && end < file_end) {
-    if (quoted) {
-      quoted = *end != '"';
-      if (*end == '\\' && end[1] == '"')
-        ++end;
-    } else {
-      if (*end == ',')
-        ++end;
-      quoted = *end == '"';
-      if (!*end || *end == '#' || *end == '$' || *end == '\n' || *end == '@' ||
-          *end == entrypoint_marker)
-        break;
-    }
-    if ((*end >= 0x81 && *end <= 0x9f) || (*end >= 0xe0 && *end <= 0xef))
-      end += 2;
-    else
-      ++end;
-  }
-  repr.assign(src, end);
+TextoutElement::TextoutElement(const BytecodeList& list, pointer_t index)
+    : list_(list), record_(list[index]) {
+  assert(record_.type == TEXTOUT_ELEMENT);
 }
 
-TextoutElement::~TextoutElement() {}
-
 const string TextoutElement::GetText() const {
+  const string repr = list_.GetString(record_.first_string);
   string rv;
   bool quoted = false;
   string::const_iterator it = repr.cbegin();
@@ -352,94 +127,97 @@ const string TextoutElement::GetText() const {
   return rv;
 }
 
-void TextoutElement::PrintSourceRepresentation(RLMachine* machine,
-                                               std::ostream& oss) const {
-  oss << "\"" << GetText() << "\"" << std::endl;
-}
-
-const size_t TextoutElement::GetBytecodeLength() const { return repr.size(); }
-
-void TextoutElement::RunOnMachine(RLMachine& machine) const {
-  machine.PerformTextout(*this);
-  machine.AdvanceInstructionPointer();
-}
-
 // -----------------------------------------------------------------------
 // ExpressionElement
 // -----------------------------------------------------------------------
 
-ExpressionElement::ExpressionElement(const char* src)
-    : parsed_expression_(invalid_expression_piece_t()) {
-  const char* end = src;
-  parsed_expression_ = GetAssignment(end);
-  length_ = std::distance(src, end);
-}
-
-ExpressionElement::ExpressionElement(const long val)
-    : length_(0),
-      parsed_expression_(ExpressionPiece::IntConstant(val)) {
+ExpressionElement::ExpressionElement(const BytecodeList& list,
+                                     pointer_t index)
+    : list_(list), record_(list[index]) {
+  assert(record_.type == EXPRESSION_ELEMENT);
 }
 
-ExpressionElement::ExpressionElement(const ExpressionElement& rhs)
-    : length_(0),
-      parsed_expression_(rhs.parsed_expression_) {
-}
-
-ExpressionElement::~ExpressionElement() {}
-
 const ExpressionPiece& ExpressionElement::ParsedExpression() const {
-  return parsed_expression_;
-}
-
-void ExpressionElement::PrintSourceRepresentation(RLMachine* machine,
-                                                  std::ostream& oss) const {
-  oss << ParsedExpression().GetDebugString() << std::endl;
-}
-
-const size_t ExpressionElement::GetBytecodeLength() const {
-  return length_;
-}
-
-void ExpressionElement::RunOnMachine(RLMachine& machine) const {
-  machine.ExecuteExpression(*this);
+  return list_.expressions_[record_.value];
 }
 
 // -----------------------------------------------------------------------
 // CommandElement
 // -----------------------------------------------------------------------
 
-CommandElement::CommandElement(const char* src) { memcpy(command, src, 8); }
-
-CommandElement::~CommandElement() {}
+CommandElement::CommandElement(const BytecodeList& list, pointer_t index)
+    : list_(list), record_(list[index]) {
+  assert(record_.is_command());
+}
 
 std::vector<std::string> CommandElement::GetUnparsedParameters() const {
   std::vector<std::string> parameters;
   size_t param_count = GetParamCount();
+  parameters.reserve(param_count);
   for (size_t i = 0; i < param_count; ++i)
     parameters.push_back(GetParam(i));
   return parameters;
 }
 
 bool CommandElement::AreParametersParsed() const {
-  return GetParamCount() == parsed_parameters_.size();
+  return GetParamCount() == GetParsedParameters().size();
 }
 
 void CommandElement::SetParsedParameters(
     ExpressionPiecesVector parsedParameters) const {
-  parsed_parameters_ = std::move(parsedParameters);
+  ExpressionPiecesVector& parsed = list_.parsed_parameters_[record_.value];
+  parsed = std::move(parsedParameters);
+  for (ExpressionPiece& piece : parsed)
+    piece.Compile();
 }
 
 const ExpressionPiecesVector& CommandElement::GetParsedParameters() const {
-  return parsed_parameters_;
+  return list_.parsed_parameters_[record_.value];
+}
+
+string CommandElement::GetParam(int index) const {
+  if (index < 0 || index >= record_.param_count)
+    return string();
+  return list_.GetString(record_.first_string + index);
+}
+
+pointer_t CommandElement::GetPointer(int i) const {
+  assert(i >= 0 && i < static_cast<int>(record_.target_count));
+  return list_.targets_[record_.first_target + i];
 }
 
-const size_t CommandElement::GetPointersCount() const { return 0; }
+const size_t CommandElement::GetCaseCount() const {
+  if (record_.type != GOTO_CASE_ELEMENT)
+    return 0;
+  return record_.string_count - record_.param_count;
+}
 
-pointer_t CommandElement::GetPointer(int i) const { return pointer_t(); }
+const string CommandElement::GetCase(int i) const {
+  if (i < 0 || i >= static_cast<int>(GetCaseCount()))
+    return "";
+  return list_.GetString(record_.first_string + record_.param_count + i);
+}
 
-const size_t CommandElement::GetCaseCount() const { return 0; }
+string CommandElement::GetSerializedCommand(RLMachine& machine) const {
+  if (record_.type != FUNCTION_ELEMENT) {
+    throw Error(
+        "Can't call GetSerializedCommand() on things other than "
+        "FunctionElements");
+  }
 
-const string CommandElement::GetCase(int i) const { return ""; }
+  string rv(reinterpret_cast<const char*>(record_.command), kCommandSize);
+  if (record_.string_count > 0) {
+    rv.push_back('(');
+    for (uint32_t i = 0; i < record_.string_count; ++i) {
+      string param = list_.GetString(record_.first_string + i);
+      const char* data = param.c_str();
+      ExpressionPiece expression(GetData(data));
+      rv.append(expression.GetSerializedExpression(machine));
+    }
+    rv.push_back(')');
+  }
+  return rv;
+}
 
 void CommandElement::PrintSourceRepresentation(RLMachine* machine,
                                                std::ostream& oss) const {
@@ -459,22 +237,334 @@ void CommandElement::PrintSourceRepresentation(RLMachine* machine,
   oss << std::endl;
 }
 
-void CommandElement::RunOnMachine(RLMachine& machine) const {
-  machine.ExecuteCommand(*this);
+// -----------------------------------------------------------------------
+// SelectElement
+// -----------------------------------------------------------------------
+
+SelectElement::SelectElement(const CommandElement& command)
+    : CommandElement(command) {
+  if (type() != SELECT_ELEMENT)
+    throw Error("SelectElement(): not a select command");
+}
+
+ExpressionPiece SelectElement::GetWindowExpression() const {
+  const string& window = list_.selects_[record_.first_target].window;
+  if (!window.empty()) {
+    const char* location = window.c_str() + 1;
+    return GetExpression(location);
+  }
+  return ExpressionPiece::IntConstant(-1);
+}
+
+const SelectElement::params_t& SelectElement::raw_params() const {
+  return list_.selects_[record_.first_target].params;
 }
 
 // -----------------------------------------------------------------------
-// SelectElement
+// BytecodeList
 // -----------------------------------------------------------------------
 
-SelectElement::SelectElement(const char* src)
-    : CommandElement(src), uselessjunk(0) {
-  repr.assign(src, 8);
+BytecodeList::BytecodeList() : string_offsets_(1, 0) {}
+
+BytecodeList::~BytecodeList() {}
+
+pointer_t BytecodeList::Read(const char* stream,
+                             const char* end,
+                             ConstructionData& cdata) {
+  const char c = *stream;
+  if (c == '!')
+    entrypoint_marker = '!';
+  switch (c) {
+    case 0:
+    case ',':
+      AddRecord(COMMA_ELEMENT, 1);
+      break;
+    case '\n':
+      AddRecord(LINE_ELEMENT, 3).value = read_i16(stream + 1);
+      break;
+    case '@':  // fall through
+    case '!': {
+      const int value = read_i16(stream + 1);
+      const bool entrypoint = cdata.kidoku_table.at(value) >= 1000000;
+      AddRecord(entrypoint ? ENTRYPOINT_ELEMENT : KIDOKU_ELEMENT, 3).value =
+          value;
+      break;
+    }
+    case '$': {
+      const char* src = stream;
+      ExpressionPiece expression = GetAssignment(src);
+      expression.Compile();
+      BytecodeRecord& record =
+          AddRecord(EXPRESSION_ELEMENT, std::distance(stream, src));
+      record.value = expressions_.size();
+      expressions_.push_back(std::move(expression));
+      break;
+    }
+    case '#':
+      ReadFunction(stream);
+      break;
+    default:
+      ReadTextout(stream, end);
+      break;
+  }
+  return records_.size() - 1;
+}
+
+pointer_t BytecodeList::AppendFunction(const char* stream) {
+  BytecodeRecord& record = AddCommand(FUNCTION_ELEMENT, stream);
+  record.length = kCommandSize;
+
+  const char* ptr = stream + kCommandSize;
+  if (*ptr == '(') {
+    const char* end = ptr + 1;
+    while (*end != ')') {
+      const size_t len = NextData(end);
+      AddString(record, end, len);
+      end += len;
+    }
+    if (record.string_count > 0)
+      record.length = kCommandSize + 2 + (end - (ptr + 1));
+  }
+
+  // Because line number metaelements can be placed inside parameters (!?!?!),
+  // it's possible that our last parameter consists only of the data for a
+  // source line MetaElement. We can't detect this during parsing (because just
+  // dropping the parameter will put the stream cursor in the wrong place), so
+  // hack this here.
+  record.param_count = record.string_count;
+  if (record.string_count > 1) {
+    const uint32_t last = record.first_string + record.string_count - 1;
+    if (string_offsets_[last + 1] - string_offsets_[last] == 3 &&
+        string_data_[string_offsets_[last]] == '\n')
+      record.param_count--;
+  }
+
+  return records_.size() - 1;
+}
+
+void BytecodeList::SetPointers(const ConstructionData& cdata) {
+  for (pointer_t& target : targets_) {
+    std::vector<unsigned long>::const_iterator it =
+        std::lower_bound(cdata.offsets.begin(), cdata.offsets.end(),
+                         static_cast<unsigned long>(target));
+    assert(it != cdata.offsets.end() &&
+           *it == static_cast<unsigned long>(target));
+    target = it - cdata.offsets.begin();
+  }
+}
+
+void BytecodeList::shrink_to_fit() {
+  records_.shrink_to_fit();
+  string_data_.shrink_to_fit();
+  string_offsets_.shrink_to_fit();
+  expressions_.shrink_to_fit();
+  targets_.shrink_to_fit();
+  selects_.shrink_to_fit();
+  parsed_parameters_.shrink_to_fit();
+}
+
+size_t BytecodeList::resident_size() const {
+  size_t size = records_.capacity() * sizeof(BytecodeRecord) +
+                string_data_.capacity() +
+                string_offsets_.capacity() * sizeof(uint32_t) +
+                expressions_.capacity() * sizeof(ExpressionPiece) +
+                targets_.capacity() * sizeof(pointer_t) +
+                selects_.capacity() * sizeof(Select) +
+                parsed_parameters_.capacity() * sizeof(ExpressionPiecesVector);
+  for (const Select& select : selects_) {
+    size += select.window.capacity() + select.params.capacity() * sizeof(
+        SelectElement::Param);
+  }
+  return size;
+}
+
+void BytecodeList::RunOnMachine(pointer_t i, RLMachine& machine) const {
+  const BytecodeRecord& record = records_[i];
+  switch (record.type) {
+    case COMMA_ELEMENT:
+    case ENTRYPOINT_ELEMENT:
+      machine.AdvanceInstructionPointer();
+      break;
+    case LINE_ELEMENT:
+      machine.SetLineNumber(record.value);
+      machine.AdvanceInstructionPointer();
+      break;
+    case KIDOKU_ELEMENT:
+      machine.SetKidokuMarker(record.value);
+      machine.AdvanceInstructionPointer();
+      break;
+    case TEXTOUT_ELEMENT:
+      machine.PerformTextout(TextoutElement(*this, i));
+      machine.AdvanceInstructionPointer();
+      break;
+    case EXPRESSION_ELEMENT:
+      machine.ExecuteExpression(ExpressionElement(*this, i));
+      break;
+    default:
+      machine.ExecuteCommand(CommandElement(*this, i));
+      break;
+  }
+}
+
+void BytecodeList::PrintSourceRepresentation(pointer_t i,
+                                             RLMachine* machine,
+                                             std::ostream& oss) const {
+  const BytecodeRecord& record = records_[i];
+  switch (record.type) {
+    case COMMA_ELEMENT:
+      oss << "<CommaElement>" << std::endl;
+      break;
+    case LINE_ELEMENT:
+      oss << "#line " << record.value << std::endl;
+      break;
+    case ENTRYPOINT_ELEMENT:
+      oss << "#entrypoint " << record.value << std::endl;
+      break;
+    case KIDOKU_ELEMENT:
+      oss << "{- Kidoku " << record.value << " -}" << std::endl;
+      break;
+    case TEXTOUT_ELEMENT:
+      oss << "\"" << textout(i).GetText() << "\"" << std::endl;
+      break;
+    case EXPRESSION_ELEMENT:
+      oss << expression(i).ParsedExpression().GetDebugString() << std::endl;
+      break;
+    default:
+      command(i).PrintSourceRepresentation(machine, oss);
+      break;
+  }
+}
+
+BytecodeRecord& BytecodeList::AddRecord(ElementType type, uint32_t length) {
+  records_.push_back(BytecodeRecord());
+  BytecodeRecord& record = records_.back();
+  record.type = type;
+  record.length = length;
+  record.first_string = string_offsets_.size() - 1;
+  record.first_target = targets_.size();
+  return record;
+}
+
+BytecodeRecord& BytecodeList::AddCommand(ElementType type, const char* src) {
+  BytecodeRecord& record = AddRecord(type, 0);
+  memcpy(record.command, src, kCommandSize);
+  record.value = parsed_parameters_.size();
+  parsed_parameters_.emplace_back();
+  return record;
+}
+
+void BytecodeList::AddString(BytecodeRecord& record,
+                             const char* src,
+                             size_t len) {
+  string_data_.append(src, len);
+  string_offsets_.push_back(string_data_.size());
+  record.string_count++;
+}
+
+void BytecodeList::AddTarget(BytecodeRecord& record, const char* src) {
+  targets_.push_back(read_i32(src));
+  record.target_count++;
+}
+
+void BytecodeList::ReadFunction(const char* stream) {
+  // opcode: 0xttmmoooo (Type, Module, Opcode: e.g. 0x01030101 = 1:03:00257
+  const unsigned long opcode =
+      (stream[1] << 24) | (stream[2] << 16) | (stream[4] << 8) | stream[3];
+  switch (opcode) {
+    case 0x00010000:
+    case 0x00010005:
+    case 0x00050001:
+    case 0x00050005:
+    case 0x00060001:
+    case 0x00060005:
+      ReadGoto(stream);
+      break;
+    case 0x00010001:
+    case 0x00010002:
+    case 0x00010006:
+    case 0x00010007:
+    case 0x00050002:
+    case 0x00050006:
+    case 0x00050007:
+    case 0x00060000:
+    case 0x00060002:
+    case 0x00060006:
+    case 0x00060007:
+      ReadGotoIf(stream);
+      break;
+    case 0x00010003:
+    case 0x00010008:
+    case 0x00050003:
+    case 0x00050008:
+    case 0x00060003:
+    case 0x00060008:
+      ReadGotoOn(stream);
+      break;
+    case 0x00010004:
+    case 0x00010009:
+    case 0x00050004:
+    case 0x00050009:
+    case 0x00060004:
+    case 0x00060009:
+      ReadGotoCase(stream);
+      break;
+    case 0x00010010:
+    case 0x00060010:
+      ReadGosubWith(stream);
+      break;
+
+    // Select elements.
+    case 0x00020000:
+    case 0x00020001:
+    case 0x00020002:
+    case 0x00020003:
+    case 0x00020010:
+      ReadSelect(stream);
+      break;
+
+    default:
+      AppendFunction(stream);
+      break;
+  }
+}
 
-  src += 8;
+void BytecodeList::ReadTextout(const char* src, const char* file_end) {
+  const char* end = src;
+  bool quoted = false;
+  while (true && end < file_end) {
+    if (quoted) {
+      quoted = *end != '"';
+      if (*end == '\\' && end[1] == '"')
+        ++end;
+    } else {
+      if (*end == ',')
+        ++end;
+      quoted = *end == '"';
+      if (!*end || *end == '#' || *end == '$' || *end == '\n' || *end == '@' ||
+          *end == entrypoint_marker)
+        break;
+    }
+    if ((*end >= 0x81 && *end <= 0x9f) || (*end >= 0xe0 && *end <= 0xef))
+      end += 2;
+    else
+      ++end;
+  }
+
+  BytecodeRecord& record = AddRecord(TEXTOUT_ELEMENT, end - src);
+  AddString(record, src, end - src);
+}
+
+void BytecodeList::ReadSelect(const char* src) {
+  BytecodeRecord& record = AddCommand(SELECT_ELEMENT, src);
+  record.first_target = selects_.size();
+  selects_.emplace_back();
+  Select& select = selects_.back();
+  const int argc = record.command[5] | (record.command[6] << 8);
+
+  src += kCommandSize;
   if (*src == '(') {
     const int elen = NextExpression(src);
-    repr.append(src, elen);
+    select.window.assign(src, elen);
     src += elen;
   }
 
@@ -482,23 +572,21 @@ SelectElement::SelectElement(const char* src)
     throw Error("SelectElement(): expected `{'");
 
   if (*src == '\n') {
-    firstline = read_i16(src + 1);
     src += 3;
-  } else {
-    firstline = 0;
   }
 
-  for (int i = 0; i < argc(); ++i) {
+  size_t length = kCommandSize + select.window.size() + 5;
+  for (int i = 0; i < argc; ++i) {
     // Skip preliminary metadata.
     while (*src == ',')
       ++src;
     // Read condition, if present.
     const char* cond = src;
-    std::vector<Condition> cond_parsed;
+    std::vector<SelectElement::Condition> cond_parsed;
     if (*src == '(') {
       ++src;
       while (*src != ')') {
-        Condition c;
+        SelectElement::Condition c;
         if (*src == '(') {
           int len = NextExpression(src);
           c.condition = string(src, len);
@@ -527,8 +615,12 @@ SelectElement::SelectElement(const char* src)
       throw Error("SelectElement(): expected `\\n'");
     int lnum = read_i16(src + 1);
     src += 3;
-    params.emplace_back(cond_parsed, cond, clen, text, tlen, lnum);
+    select.params.emplace_back(cond_parsed, cond, clen, text, tlen, lnum);
+    // The parameter the RLOperation sees is the condition and text together.
+    AddString(record, cond, clen + tlen);
+    length += clen + tlen + 3;
   }
+  record.param_count = record.string_count;
 
   // HACK?: In Kotomi's path in CLANNAD, there's a select with empty options
   // outside the count specified by argc().
@@ -540,399 +632,118 @@ SelectElement::SelectElement(const char* src)
   while (*src == '\n') {
     // The only thing allowed other than a 16 bit integer.
     src += 3;
-    uselessjunk++;
+    length += 3;
   }
 
   if (*src++ != '}')
     throw Error("SelectElement(): expected `}'");
-}
-
-SelectElement::~SelectElement() {}
 
-ExpressionPiece SelectElement::GetWindowExpression() const {
-  if (repr[8] == '(') {
-    const char* location = repr.c_str() + 9;
-    return GetExpression(location);
-  }
-  return ExpressionPiece::IntConstant(-1);
-}
-
-const size_t SelectElement::GetParamCount() const { return params.size(); }
-
-string SelectElement::GetParam(int i) const {
-  string rv(params[i].cond_text);
-  rv.append(params[i].text);
-  return rv;
-}
-
-const size_t SelectElement::GetBytecodeLength() const {
-  size_t rv = repr.size() + 5;
-  for (Param const& param : params)
-    rv += param.cond_text.size() + param.text.size() + 3;
-  rv += (uselessjunk * 3);
-  return rv;
-}
-
-// -----------------------------------------------------------------------
-// FunctionElement
-// -----------------------------------------------------------------------
-
-FunctionElement::FunctionElement(const char* src,
-                                 const std::vector<string>& params)
-    : CommandElement(src), params(params) {}
-
-FunctionElement::~FunctionElement() {}
-
-const size_t FunctionElement::GetParamCount() const {
-  // Because line number metaelements can be placed inside parameters (!?!?!),
-  // it's possible that our last parameter consists only of the data for a
-  // source line MetaElement. We can't detect this during parsing (because just
-  // dropping the parameter will put the stream cursor in the wrong place), so
-  // hack this here.
-  if (!params.empty()) {
-    string final = params.back();
-    if (final.size() == 3 && final[0] == '\n')
-      return params.size() - 1;
-  }
-  return params.size();
+  record.length = length;
 }
 
-string FunctionElement::GetParam(int i) const { return params[i]; }
-
-const size_t FunctionElement::GetBytecodeLength() const {
-  if (params.size() > 0) {
-    size_t rv(COMMAND_SIZE + 2);
-    for (std::string const& param : params)
-      rv += param.size();
-    return rv;
-  } else {
-    return COMMAND_SIZE;
-  }
-}
-
-std::string FunctionElement::GetSerializedCommand(RLMachine& machine) const {
-  string rv;
-  for (int i = 0; i < COMMAND_SIZE; ++i)
-    rv.push_back(command[i]);
-  if (params.size() > 0) {
-    rv.push_back('(');
-    for (string const& param : params) {
-      const char* data = param.c_str();
-      ExpressionPiece expression(GetData(data));
-      rv.append(expression.GetSerializedExpression(machine));
-    }
-    rv.push_back(')');
-  }
-  return rv;
-}
-
-// -----------------------------------------------------------------------
-// VoidFunctionElement
-// -----------------------------------------------------------------------
-
-VoidFunctionElement::VoidFunctionElement(const char* src)
-    : CommandElement(src) {}
-
-VoidFunctionElement::~VoidFunctionElement() {}
-
-const size_t VoidFunctionElement::GetParamCount() const { return 0; }
-
-string VoidFunctionElement::GetParam(int i) const { return std::string(); }
-
-const size_t VoidFunctionElement::GetBytecodeLength() const {
-  return COMMAND_SIZE;
-}
-
-std::string VoidFunctionElement::GetSerializedCommand(RLMachine& machine)
-    const {
-  string rv;
-  for (int i = 0; i < COMMAND_SIZE; ++i)
-    rv.push_back(command[i]);
-  return rv;
-}
-
-// -----------------------------------------------------------------------
-// SingleArgFunctionElement
-// -----------------------------------------------------------------------
-
-SingleArgFunctionElement::SingleArgFunctionElement(const char* src,
-                                                   const std::string& arg)
-    : CommandElement(src), arg_(arg) {}
-
-SingleArgFunctionElement::~SingleArgFunctionElement() {}
-
-const size_t SingleArgFunctionElement::GetParamCount() const { return 1; }
-
-string SingleArgFunctionElement::GetParam(int i) const {
-  return i == 0 ? arg_ : std::string();
-}
-
-const size_t SingleArgFunctionElement::GetBytecodeLength() const {
-  return COMMAND_SIZE + 2 + arg_.size();
-}
-
-std::string SingleArgFunctionElement::GetSerializedCommand(RLMachine& machine)
-    const {
-  string rv;
-  for (int i = 0; i < COMMAND_SIZE; ++i)
-    rv.push_back(command[i]);
-  rv.push_back('(');
-  const char* data = arg_.c_str();
-  ExpressionPiece expression(GetData(data));
-  rv.append(expression.GetSerializedExpression(machine));
-  rv.push_back(')');
-  return rv;
-}
-
-// -----------------------------------------------------------------------
-// PointerElement
-// -----------------------------------------------------------------------
-
-PointerElement::PointerElement(const char* src) : CommandElement(src) {}
-
-PointerElement::~PointerElement() {}
-
-const size_t PointerElement::GetPointersCount() const { return targets.size(); }
-
-pointer_t PointerElement::GetPointer(int i) const { return targets[i]; }
-
-void PointerElement::SetPointers(ConstructionData& cdata) {
-  targets.SetPointers(cdata);
-}
-
-// -----------------------------------------------------------------------
-// GotoElement
-// -----------------------------------------------------------------------
-
-GotoElement::GotoElement(const char* src, ConstructionData& cdata)
-    : CommandElement(src) {
-  src += 8;
-
-  id_ = read_i32(src);
-}
-
-GotoElement::~GotoElement() {}
-
-const size_t GotoElement::GetParamCount() const {
+void BytecodeList::ReadGoto(const char* src) {
+  BytecodeRecord& record = AddCommand(GOTO_ELEMENT, src);
   // The pointer is not counted as a parameter.
-  return 0;
-}
-
-string GotoElement::GetParam(int i) const { return std::string(); }
-
-const size_t GotoElement::GetPointersCount() const { return 1; }
-
-pointer_t GotoElement::GetPointer(int i) const {
-  assert(i == 0);
-  return pointer_;
-}
-
-const size_t GotoElement::GetBytecodeLength() const { return 12; }
-
-void GotoElement::SetPointers(ConstructionData& cdata) {
-  ConstructionData::offsets_t::const_iterator it = cdata.offsets.find(id_);
-  assert(it != cdata.offsets.end());
-  pointer_ = it->second;
+  AddTarget(record, src + kCommandSize);
+  record.length = kCommandSize + 4;
 }
 
-// -----------------------------------------------------------------------
-// GotoIfElement
-// -----------------------------------------------------------------------
-
-GotoIfElement::GotoIfElement(const char* src, ConstructionData& cdata)
-    : CommandElement(src) {
-  repr.assign(src, 8);
-  src += 8;
+void BytecodeList::ReadGotoIf(const char* src) {
+  BytecodeRecord& record = AddCommand(GOTO_IF_ELEMENT, src);
+  const char* start = src;
+  src += kCommandSize;
 
   if (*src++ != '(')
     throw Error("GotoIfElement(): expected `('");
   int expr = NextExpression(src);
-  repr.push_back('(');
-  repr.append(src, expr);
-  repr.push_back(')');
+  AddString(record, src, expr);
   src += expr;
   if (*src++ != ')')
     throw Error("GotoIfElement(): expected `)'");
 
-  id_ = read_i32(src);
-}
-
-GotoIfElement::~GotoIfElement() {}
-
-const size_t GotoIfElement::GetParamCount() const {
   // The pointer is not counted as a parameter.
-  return repr.size() == 8 ? 0 : 1;
-}
-
-string GotoIfElement::GetParam(int i) const {
-  return i == 0
-             ? (repr.size() == 8 ? string() : repr.substr(9, repr.size() - 10))
-             : string();
-}
-
-const size_t GotoIfElement::GetPointersCount() const { return 1; }
-
-pointer_t GotoIfElement::GetPointer(int i) const {
-  assert(i == 0);
-  return pointer_;
-}
-
-const size_t GotoIfElement::GetBytecodeLength() const {
-  return repr.size() + 4;
+  record.param_count = 1;
+  AddTarget(record, src);
+  record.length = src - start + 4;
 }
 
-void GotoIfElement::SetPointers(ConstructionData& cdata) {
-  ConstructionData::offsets_t::const_iterator it = cdata.offsets.find(id_);
-  assert(it != cdata.offsets.end());
-  pointer_ = it->second;
-}
-
-// -----------------------------------------------------------------------
-// GotoCaseElement
-// -----------------------------------------------------------------------
-
-GotoCaseElement::GotoCaseElement(const char* src, ConstructionData& cdata)
-    : PointerElement(src) {
-  repr.assign(src, 8);
-  src += 8;
+void BytecodeList::ReadGotoCase(const char* src) {
+  BytecodeRecord& record = AddCommand(GOTO_CASE_ELEMENT, src);
+  const int argc = record.command[5] | (record.command[6] << 8);
+  const char* start = src;
+  src += kCommandSize;
   // Condition
   const int expr = NextExpression(src);
-  repr.append(src, expr);
+  AddString(record, src, expr);
   src += expr;
+  // The cases are not counted as parameters.
+  record.param_count = 1;
   // Cases
   if (*src++ != '{')
     throw Error("GotoCaseElement(): expected `{'");
-  int i = argc();
-  cases.reserve(i);
-  targets.reserve(i);
+  int i = argc;
   while (i--) {
     if (src[0] != '(')
       throw Error("GotoCaseElement(): expected `('");
     if (src[1] == ')') {
-      cases.push_back("()");
+      AddString(record, src, 2);
       src += 2;
     } else {
       int cexpr = NextExpression(src + 1);
-      cases.emplace_back(src, cexpr + 2);
+      AddString(record, src, cexpr + 2);
       src += cexpr + 1;
       if (*src++ != ')')
         throw Error("GotoCaseElement(): expected `)'");
     }
-    targets.push_id(read_i32(src));
+    AddTarget(record, src);
     src += 4;
   }
   if (*src != '}')
     throw Error("GotoCaseElement(): expected `}'");
+  record.length = src - start + 1;
 }
 
-GotoCaseElement::~GotoCaseElement() {}
-
-const size_t GotoCaseElement::GetParamCount() const {
-  // The cases are not counted as parameters.
-  return 1;
-}
-
-string GotoCaseElement::GetParam(int i) const {
-  return i == 0 ? repr.substr(8, repr.size() - 8) : string();
-}
-
-const size_t GotoCaseElement::GetCaseCount() const { return cases.size(); }
-
-const string GotoCaseElement::GetCase(int i) const { return cases[i]; }
-
-const size_t GotoCaseElement::GetBytecodeLength() const {
-  size_t rv = repr.size() + 2;
-  for (unsigned int i = 0; i < cases.size(); ++i)
-    rv += cases[i].size() + 4;
-  return rv;
-}
-
-// -----------------------------------------------------------------------
-// GotoOnElement
-// -----------------------------------------------------------------------
-
-GotoOnElement::GotoOnElement(const char* src, ConstructionData& cdata)
-    : PointerElement(src) {
-  repr.assign(src, 8);
-  src += 8;
+void BytecodeList::ReadGotoOn(const char* src) {
+  BytecodeRecord& record = AddCommand(GOTO_ON_ELEMENT, src);
+  const int argc = record.command[5] | (record.command[6] << 8);
+  const char* start = src;
+  src += kCommandSize;
   // Condition
   const int expr = NextExpression(src);
-  repr.append(src, expr);
+  AddString(record, src, expr);
   src += expr;
+  record.param_count = 1;
   // Pointers
   if (*src++ != '{')
     throw Error("GotoOnElement(): expected `{'");
-  int i = argc();
-  targets.reserve(i);
+  int i = argc;
   while (i--) {
-    targets.push_id(read_i32(src));
+    AddTarget(record, src);
     src += 4;
   }
   if (*src != '}')
     throw Error("GotoOnElement(): expected `}'");
+  record.length = src - start + 1;
 }
 
-GotoOnElement::~GotoOnElement() {}
-
-const size_t GotoOnElement::GetParamCount() const { return 1; }
-
-string GotoOnElement::GetParam(int i) const {
-  return i == 0 ? repr.substr(8, repr.size() - 8) : string();
-}
-
-const size_t GotoOnElement::GetBytecodeLength() const {
-  return repr.size() + argc() * 4 + 2;
-}
-
-// -----------------------------------------------------------------------
-// GosubWithElement
-// -----------------------------------------------------------------------
-
-GosubWithElement::GosubWithElement(const char* src, ConstructionData& cdata)
-    : CommandElement(src), repr_size(8) {
-  src += 8;
+void BytecodeList::ReadGosubWith(const char* src) {
+  BytecodeRecord& record = AddCommand(GOSUB_WITH_ELEMENT, src);
+  const char* start = src;
+  src += kCommandSize;
   if (*src == '(') {
     src++;
-    repr_size++;
-
     while (*src != ')') {
       int expr = NextData(src);
-      repr_size += expr;
-      params.emplace_back(src, expr);
+      AddString(record, src, expr);
       src += expr;
     }
     src++;
-
-    repr_size++;
   }
 
-  id_ = read_i32(src);
-}
-
-GosubWithElement::~GosubWithElement() {}
-
-const size_t GosubWithElement::GetParamCount() const {
   // The pointer is not counted as a parameter.
-  return params.size();
-}
-
-string GosubWithElement::GetParam(int i) const { return params[i]; }
-
-const size_t GosubWithElement::GetPointersCount() const { return 1; }
-
-pointer_t GosubWithElement::GetPointer(int i) const {
-  assert(i == 0);
-  return pointer_;
-}
-
-const size_t GosubWithElement::GetBytecodeLength() const {
-  return repr_size + 4;
-}
-
-void GosubWithElement::SetPointers(ConstructionData& cdata) {
-  ConstructionData::offsets_t::const_iterator it = cdata.offsets.find(id_);
-  assert(it != cdata.offsets.end());
-  pointer_ = it->second;
+  record.param_count = record.string_count;
+  AddTarget(record, src);
+  record.length = src - start + 4;
 }
 
 }  // namespace libreallive
@@ -35,7 +35,6 @@
 #define SRC_LIBREALLIVE_BYTECODE_H_
 
 #include <cstdint>
-#include <map>
 #include <string>
 #include <vector>
 
@@ -44,188 +43,130 @@
 #include "libreallive/expression.h"
 
 class RLMachine;
+class RLOperation;
 
 namespace libreallive {
 
-class CommandElement;
-
-// Returns a representation of the non-special cased function.
-CommandElement* BuildFunctionElement(const char* stream);
-
 void PrintParameterString(std::ostream& oss,
                           const std::vector<std::string>& paramseters);
 
 struct ConstructionData {
-  ConstructionData(size_t kt, pointer_t pt);
+  explicit ConstructionData(size_t kt);
   ~ConstructionData();
 
   std::vector<unsigned long> kidoku_table;
-  pointer_t null;
-  typedef std::map<unsigned long, pointer_t> offsets_t;
-  offsets_t offsets;
-};
-
-class Pointers {
- public:
-  Pointers();
-  ~Pointers();
-
-  typedef std::vector<pointer_t>::iterator iterator;
-  iterator begin() { return targets.begin(); }
-  iterator end() { return targets.end(); }
 
-  void reserve(size_t i) { target_ids.reserve(i); }
-  void push_id(unsigned long id) { target_ids.push_back(id); }
-  pointer_t& operator[] (long idx) { return targets.at(idx); }
-  const pointer_t& operator[] (long idx) const { return targets.at(idx); }
-  const size_t size() const { return targets.size(); }
-  const size_t idSize() const { return target_ids.size(); }
-
-  void SetPointers(ConstructionData& cdata);
-
- private:
-  std::vector<unsigned long> target_ids;
-  std::vector<pointer_t> targets;
+  // The offset in the bytecode of each element read so far, in order. Used
+  // to turn the byte offsets jumps are written as into element indexes.
+  std::vector<unsigned long> offsets;
 };
 
-// Base classes for bytecode elements.
-
-class BytecodeElement {
- public:
-  static const int kInvalidEntrypoint = -999;
-
-  BytecodeElement();
-  virtual ~BytecodeElement();
+// What kind of element a BytecodeRecord is.
+enum ElementType : uint8_t {
+  // Metadata elements: commas, source line, kidoku, and entrypoint markers.
+  COMMA_ELEMENT,
+  LINE_ELEMENT,
+  KIDOKU_ELEMENT,
+  ENTRYPOINT_ELEMENT,
+
+  // Display-text elements.
+  TEXTOUT_ELEMENT,
+
+  // Expression elements.
+  EXPRESSION_ELEMENT,
+
+  // Command elements. Every type from here on is a command.
+  FUNCTION_ELEMENT,
+  SELECT_ELEMENT,
+  GOTO_ELEMENT,
+  GOTO_IF_ELEMENT,
+  GOTO_CASE_ELEMENT,
+  GOTO_ON_ELEMENT,
+  GOSUB_WITH_ELEMENT
+};
 
-  // Prints a human readable version of this bytecode element to |oss|. This
-  // tries to match Haeleth's kepago language as much as is feasible.
-  virtual void PrintSourceRepresentation(RLMachine* machine,
-                                         std::ostream& oss) const;
+// One bytecode element. Every element is the same size; whatever doesn't fit
+// is kept in the side tables of the BytecodeList the record belongs to and is
+// referred to by index.
+struct BytecodeRecord {
+  bool is_command() const { return type >= FUNCTION_ELEMENT; }
 
-  // Returns the length of this element in bytes in the source file.
-  virtual const size_t GetBytecodeLength() const = 0;
+  ElementType type;
 
-  // Used to connect pointers in the bytecode after we've created all
-  // BytecodeElements in a Scenario.
-  virtual void SetPointers(ConstructionData& cdata);
+  // Commands only: the raw command header.
+  unsigned char command[8];
 
-  // Needed for MetaElement during reading the script
-  virtual const int GetEntrypoint() const;
+  // Commands only: the number of parameters passed to the RLOperation.
+  uint16_t param_count;
 
-  // Fat interface: takes a FunctionElement and returns all data serialized for
-  // writing to disk so the exact command can be replayed later. Throws in all
-  // other cases.
-  virtual string GetSerializedCommand(RLMachine& machine) const;
+  // The length of this element in bytes in the source file.
+  uint32_t length;
 
-  // Execute this bytecode instruction on this virtual machine
-  virtual void RunOnMachine(RLMachine& machine) const;
+  // Line, kidoku and entrypoint markers: the marker's number. Expressions:
+  // index into the expression table. Commands: index into the parsed
+  // parameter table.
+  int32_t value;
 
-  // Read the next element from a stream.
-  static BytecodeElement* Read(const char* stream,
-                               const char* end,
-                               ConstructionData& cdata);
+  // Range in the string table. Textouts: the text as it appears in the
+  // bytecode. Commands: the unparsed parameters, followed by the cases of a
+  // goto_case or a trailing source line marker that isn't counted in
+  // |param_count|. Selects: each option's condition and text.
+  uint32_t first_string;
+  uint32_t string_count;
 
- protected:
-  static char entrypoint_marker;
-  BytecodeElement(const BytecodeElement& c);
+  // Jumps: range in the target table. Selects: index into the select table.
+  uint32_t first_target;
+  uint32_t target_count;
 
- private:
-  friend class Script;
-};
-
-class CommaElement : public BytecodeElement {
- public:
-  CommaElement();
-  virtual ~CommaElement();
-
-  // Overridden from BytecodeElement:
-  virtual void PrintSourceRepresentation(RLMachine* machine,
-                                         std::ostream& oss) const final;
-  virtual const size_t GetBytecodeLength() const final;
-};
-
-// Metadata elements: source line, kidoku, and entrypoint markers.
-class MetaElement : public BytecodeElement {
- public:
-  MetaElement(const ConstructionData* cv, const char* src);
-  virtual ~MetaElement();
-
-  const int value() const { return value_; }
-  void set_value(const int value) { value_ = value; }
-
-  // Overridden from BytecodeElement:
-  virtual void PrintSourceRepresentation(RLMachine* machine,
-                                         std::ostream& oss) const final;
-  virtual const size_t GetBytecodeLength() const final;
-  virtual const int GetEntrypoint() const final;
-  virtual void RunOnMachine(RLMachine& machine) const final;
-
- private:
-  enum MetaElementType { Line_ = '\n', Kidoku_ = '@', Entrypoint_ };
-  MetaElementType type_;
-  int value_;
-  int entrypoint_index_;
+  // Cached result of the RLMachine's opcode lookup; see CommandElement.
+  mutable int operation_owner;
+  mutable RLOperation* operation;
 };
 
 // Display-text elements.
-class TextoutElement : public BytecodeElement {
+class TextoutElement {
  public:
-  TextoutElement(const char* src, const char* file_end);
-  virtual ~TextoutElement();
+  TextoutElement(const BytecodeList& list, pointer_t index);
 
   const string GetText() const;
 
-  // Overridden from BytecodeElement::
-  virtual void PrintSourceRepresentation(RLMachine* machine,
-                                         std::ostream& oss) const final;
-  virtual const size_t GetBytecodeLength() const final;
-  virtual void RunOnMachine(RLMachine& machine) const final;
-
  private:
-  string repr;
+  const BytecodeList& list_;
+  const BytecodeRecord& record_;
 };
 
-// Expression elements.
-// Construct from long to build a representation of an integer constant.
-
-// A BytecodeElement that represents an expression
-class ExpressionElement : public BytecodeElement {
+// An expression evaluated for its side effects, usually an assignment.
+class ExpressionElement {
  public:
-  explicit ExpressionElement(const long val);
-  explicit ExpressionElement(const char* src);
-  ExpressionElement(const ExpressionElement& rhs);
-  virtual ~ExpressionElement();
+  ExpressionElement(const BytecodeList& list, pointer_t index);
 
   // Returns an ExpressionPiece representing this expression.
   const ExpressionPiece& ParsedExpression() const;
 
-  // Overridden from BytecodeElement:
-  virtual void PrintSourceRepresentation(RLMachine* machine,
-                                         std::ostream& oss) const final;
-  virtual const size_t GetBytecodeLength() const final;
-  virtual void RunOnMachine(RLMachine& machine) const final;
-
  private:
-  int length_;
-
-  // Storage for the parsed expression so we only have to calculate
-  // it once (and so we can return it by const reference)
-  ExpressionPiece parsed_expression_;
+  const BytecodeList& list_;
+  const BytecodeRecord& record_;
 };
 
-// Command elements.
-
-class CommandElement : public BytecodeElement {
+// Command elements. This is a view onto a command record and the parts of
+// its BytecodeList's side tables that belong to it; it's cheap to make one
+// whenever it's needed.
+class CommandElement {
  public:
-  explicit CommandElement(const char* src);
-  virtual ~CommandElement();
+  CommandElement(const BytecodeList& list, pointer_t index);
+
+  ElementType type() const { return record_.type; }
 
   // Identity information.
-  const int modtype()  const { return command[1]; }
-  const int module()   const { return command[2]; }
-  const int opcode()   const { return command[3] | (command[4] << 8); }
-  const int argc()     const { return command[5] | (command[6] << 8); }
-  const int overload() const { return command[7]; }
+  const int modtype()  const { return record_.command[1]; }
+  const int module()   const { return record_.command[2]; }
+  const int opcode()   const {
+    return record_.command[3] | (record_.command[4] << 8);
+  }
+  const int argc()     const {
+    return record_.command[5] | (record_.command[6] << 8);
+  }
+  const int overload() const { return record_.command[7]; }
 
   // Returns the raw byte strings of this command elements parameters.
   std::vector<string> GetUnparsedParameters() const;
@@ -237,28 +178,40 @@ class CommandElement : public BytecodeElement {
   void SetParsedParameters(ExpressionPiecesVector p) const;
   const ExpressionPiecesVector& GetParsedParameters() const;
 
+  // The RLOperation that implements this command, as looked up by the
+  // RLMachine whose operation cache id is |owner|, or NULL if that machine
+  // hasn't looked it up yet.
+  RLOperation* GetCachedOperation(int owner) const {
+    return record_.operation_owner == owner ? record_.operation : NULL;
+  }
+  void SetCachedOperation(int owner, RLOperation* operation) const {
+    record_.operation_owner = owner;
+    record_.operation = operation;
+  }
+
   // Returns the number of parameters.
-  virtual const size_t GetParamCount() const = 0;
-  virtual string GetParam(int index) const = 0;
+  const size_t GetParamCount() const { return record_.param_count; }
+  string GetParam(int index) const;
 
-  // Methods that deal with pointers.
-  virtual const size_t GetPointersCount() const;
-  virtual pointer_t GetPointer(int i) const;
+  // Methods that deal with pointers. Pointers are indexes into the
+  // BytecodeList this command is in.
+  const size_t GetPointersCount() const { return record_.target_count; }
+  pointer_t GetPointer(int i) const;
 
   // Fat interface stuff for GotoCase. Prevents casting, etc.
-  virtual const size_t GetCaseCount() const;
-  virtual const string GetCase(int i) const;
+  const size_t GetCaseCount() const;
+  const string GetCase(int i) const;
 
-  // Overridden from BytecodeElement:
-  virtual void PrintSourceRepresentation(RLMachine* machine,
-                                         std::ostream& oss) const final;
-  virtual void RunOnMachine(RLMachine& machine) const final;
+  // Returns all data serialized for writing to disk so the exact command can
+  // be replayed later. Throws for anything other than a plain function call.
+  string GetSerializedCommand(RLMachine& machine) const;
 
- protected:
-  static const int COMMAND_SIZE = 8;
-  unsigned char command[COMMAND_SIZE];
+  // Prints a human readable version of this command to |oss|.
+  void PrintSourceRepresentation(RLMachine* machine, std::ostream& oss) const;
 
-  mutable std::vector<ExpressionPiece> parsed_parameters_;
+ protected:
+  const BytecodeList& list_;
+  const BytecodeRecord& record_;
 };
 
 class SelectElement : public CommandElement {
@@ -291,190 +244,117 @@ class SelectElement : public CommandElement {
   };
   typedef std::vector<Param> params_t;
 
-  explicit SelectElement(const char* src);
-  virtual ~SelectElement();
+  // Throws if |command| isn't a SELECT_ELEMENT.
+  explicit SelectElement(const CommandElement& command);
 
   // Returns the expression in the source code which refers to which window to
   // display.
   ExpressionPiece GetWindowExpression() const;
 
-  const params_t& raw_params() const { return params; }
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-
- private:
-  string repr;
-  params_t params;
-  int firstline;
-  int uselessjunk;
-};
-
-class FunctionElement : public CommandElement {
- public:
-  FunctionElement(const char* src, const std::vector<string>& params);
-  virtual ~FunctionElement();
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-  virtual string GetSerializedCommand(RLMachine& machine) const final;
-
- private:
-  std::vector<string> params;
-};
-
-class VoidFunctionElement : public CommandElement {
- public:
-  explicit VoidFunctionElement(const char* src);
-  virtual ~VoidFunctionElement();
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-  virtual string GetSerializedCommand(RLMachine& machine) const final;
-};
-
-class SingleArgFunctionElement : public CommandElement {
- public:
-  SingleArgFunctionElement(const char* src,
-                           const std::string& arg);
-  virtual ~SingleArgFunctionElement();
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-  virtual string GetSerializedCommand(RLMachine& machine) const final;
-
- private:
-  std::string arg_;
+  const params_t& raw_params() const;
 };
 
-class PointerElement : public CommandElement {
+// The elements of a scenario. Each element is a BytecodeRecord; text, unparsed
+// parameters, parsed expressions, jump targets and select options live in
+// side tables shared by the whole list, so reading a scenario makes a handful
+// of allocations instead of one or more per element.
+class BytecodeList {
  public:
-  explicit PointerElement(const char* src);
-  virtual ~PointerElement();
+  BytecodeList();
+  ~BytecodeList();
 
-  // Overridden from CommandElement:
-  virtual const size_t GetPointersCount() const final;
-  virtual pointer_t GetPointer(int i) const final;
+  size_t size() const { return records_.size(); }
+  const BytecodeRecord& operator[](pointer_t i) const { return records_[i]; }
 
-  // Overridden from BytecodeElement:
-  virtual void SetPointers(ConstructionData& cdata) final;
+  // Views onto element |i|, which must be of the matching type.
+  TextoutElement textout(pointer_t i) const { return TextoutElement(*this, i); }
+  ExpressionElement expression(pointer_t i) const {
+    return ExpressionElement(*this, i);
+  }
+  CommandElement command(pointer_t i) const { return CommandElement(*this, i); }
 
- protected:
-  Pointers targets;
-};
+  // Reads the element at |stream| and appends it, returning its index. Jump
+  // targets aren't usable until SetPointers() is called.
+  pointer_t Read(const char* stream, const char* end, ConstructionData& cdata);
 
-class GotoElement : public CommandElement {
- public:
-  GotoElement(const char* src, ConstructionData& cdata);
-  virtual ~GotoElement();
+  // Appends the non-special cased function at |stream|, returning its index.
+  pointer_t AppendFunction(const char* stream);
 
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-  virtual const size_t GetPointersCount() const final;
-  virtual pointer_t GetPointer(int i) const final;
+  // Used to connect pointers in the bytecode after we've read all the
+  // elements in a Scenario.
+  void SetPointers(const ConstructionData& cdata);
 
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-  virtual void SetPointers(ConstructionData& cdata) final;
+  // Frees the slack left over from reading.
+  void shrink_to_fit();
 
- private:
-  unsigned long id_;
-  pointer_t pointer_;
-};
-
-class GotoIfElement : public CommandElement {
- public:
-  GotoIfElement(const char* src, ConstructionData& cdata);
-  virtual ~GotoIfElement();
+  // Approximate number of bytes of heap the records and side tables use.
+  size_t resident_size() const;
 
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-  virtual const size_t GetPointersCount() const final;
-  virtual pointer_t GetPointer(int i) const final;
+  // Execute element |i| on this virtual machine.
+  void RunOnMachine(pointer_t i, RLMachine& machine) const;
 
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-  virtual void SetPointers(ConstructionData& cdata) final;
+  // Prints a human readable version of element |i| to |oss|. This tries to
+  // match Haeleth's kepago language as much as is feasible.
+  void PrintSourceRepresentation(pointer_t i,
+                                 RLMachine* machine,
+                                 std::ostream& oss) const;
 
  private:
-  unsigned long id_;
-  pointer_t pointer_;
-  string repr;
-};
-
-class GotoCaseElement : public PointerElement {
- public:
-  GotoCaseElement(const char* src, ConstructionData& cdata);
-  virtual ~GotoCaseElement();
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-  virtual const size_t GetCaseCount() const final;
-  virtual const string GetCase(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-
- private:
-  string repr;
-  std::vector<string> cases;
-};
-
-class GotoOnElement : public PointerElement {
- public:
-  GotoOnElement(const char* src, ConstructionData& cdata);
-  virtual ~GotoOnElement();
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-
- private:
-  string repr;
-};
-
-class GosubWithElement : public CommandElement {
- public:
-  GosubWithElement(const char* src, ConstructionData& cdata);
-  virtual ~GosubWithElement();
-
-  // Overridden from CommandElement:
-  virtual const size_t GetParamCount() const final;
-  virtual string GetParam(int i) const final;
-  virtual const size_t GetPointersCount() const final;
-  virtual pointer_t GetPointer(int i) const final;
-
-  // Overridden from BytecodeElement:
-  virtual const size_t GetBytecodeLength() const final;
-  virtual void SetPointers(ConstructionData& cdata) final;
+  friend class TextoutElement;
+  friend class ExpressionElement;
+  friend class CommandElement;
+  friend class SelectElement;
+
+  struct Select {
+    // The bytecode of the window expression, or empty.
+    string window;
+    SelectElement::params_t params;
+  };
 
- private:
-  unsigned long id_;
-  pointer_t pointer_;
-  int repr_size;
-  std::vector<string> params;
+  // Appends a record of |type|, returning it.
+  BytecodeRecord& AddRecord(ElementType type, uint32_t length);
+  BytecodeRecord& AddCommand(ElementType type, const char* src);
+
+  // Appends |len| bytes at |src| to the string table as the next string of
+  // |record|, which must be the last record.
+  void AddString(BytecodeRecord& record, const char* src, size_t len);
+
+  // Appends the byte offset at |src| to the target table as the next target
+  // of |record|, which must be the last record.
+  void AddTarget(BytecodeRecord& record, const char* src);
+  string GetString(uint32_t i) const {
+    return string_data_.substr(string_offsets_[i],
+                               string_offsets_[i + 1] - string_offsets_[i]);
+  }
+
+  void ReadFunction(const char* stream);
+  void ReadTextout(const char* src, const char* file_end);
+  void ReadSelect(const char* src);
+  void ReadGoto(const char* src);
+  void ReadGotoIf(const char* src);
+  void ReadGotoCase(const char* src);
+  void ReadGotoOn(const char* src);
+  void ReadGosubWith(const char* src);
+
+  std::vector<BytecodeRecord> records_;
+
+  // The string table: every string, back to back. String i is the bytes from
+  // string_offsets_[i] to string_offsets_[i + 1].
+  string string_data_;
+  std::vector<uint32_t> string_offsets_;
+
+  std::vector<ExpressionPiece> expressions_;
+
+  // Element indexes jumps can go to. Until SetPointers() is called, these are
+  // the byte offsets the bytecode refers to them by.
+  std::vector<pointer_t> targets_;
+
+  std::vector<Select> selects_;
+
+  // Filled in by the RLOperation the first time each command is run (or all
+  // at once by RLMachine::PreparseParameters()). There's one entry per
+  // command so that different commands can be parsed on different threads.
+  mutable std::vector<ExpressionPiecesVector> parsed_parameters_;
 };
 
 }  // namespace libreallive
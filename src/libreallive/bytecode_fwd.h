@@ -29,32 +29,25 @@
 #ifndef SRC_LIBREALLIVE_BYTECODE_FWD_H_
 #define SRC_LIBREALLIVE_BYTECODE_FWD_H_
 
-#include <forward_list>
-#include <memory>
-
 namespace libreallive {
 
 // List definitions.
 class ExpressionPiece;
-class BytecodeElement;
-typedef std::forward_list<std::unique_ptr<BytecodeElement>> BytecodeList;
-typedef BytecodeList::iterator pointer_t;
+struct BytecodeRecord;
+// A scenario's elements, stored as one array of fixed size records in file
+// order with their strings and parameters in side tables.
+class BytecodeList;
+// The index of an element in a BytecodeList. Jump targets and instruction
+// pointers are these, so advancing is an increment and the offset of an
+// element from the start of the scenario is the value itself.
+typedef int pointer_t;
 
 struct ConstructionData;
-class Pointers;
 
-class DataElement;
-class MetaElement;
 class TextoutElement;
 class ExpressionElement;
 class CommandElement;
 class SelectElement;
-class FunctionElement;
-class PointerElement;
-class GotoElement;
-class GotoCaseElement;
-class GotoOnElement;
-class GosubWithElement;
 
 }  // namespace libreallive
 
@@ -43,6 +43,7 @@
 #include <string>
 
 #include "libreallive/defs.h"
+#include "libreallive/expression_program.h"
 #include "libreallive/intmemref.h"
 #include "machine/reference.h"
 #include "machine/rlmachine.h"
@@ -69,7 +70,7 @@ namespace libreallive {
 // Expression Tokenization
 //
 // Functions that tokenize expression data while parsing the bytecode
-// to create the BytecodeElements. These functions simply tokenize and
+// to build a BytecodeList. These functions simply tokenize and
 // mark boundaries; they do not perform any parsing.
 
 size_t NextToken(const char* src) {
@@ -656,7 +657,7 @@ ExpressionPiece::ExpressionPiece(invalid_expression_piece_t)
 }
 
 ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
-    : piece_type(rhs.piece_type) {
+    : piece_type(rhs.piece_type), compiled_program(rhs.compiled_program) {
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -707,7 +708,8 @@ ExpressionPiece::ExpressionPiece(const ExpressionPiece& rhs)
 }
 
 ExpressionPiece::ExpressionPiece(ExpressionPiece&& rhs)
-    : piece_type(rhs.piece_type) {
+    : piece_type(rhs.piece_type),
+      compiled_program(std::move(rhs.compiled_program)) {
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -767,6 +769,7 @@ ExpressionPiece& ExpressionPiece::operator=(const ExpressionPiece& rhs) {
   Invalidate();
 
   piece_type = rhs.piece_type;
+  compiled_program = rhs.compiled_program;
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -822,6 +825,7 @@ ExpressionPiece& ExpressionPiece::operator=(ExpressionPiece&& rhs) {
   Invalidate();
 
   piece_type = rhs.piece_type;
+  compiled_program = std::move(rhs.compiled_program);
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       break;
@@ -933,6 +937,13 @@ void ExpressionPiece::SetIntegerValue(RLMachine& machine, int rvalue) {
 }
 
 int ExpressionPiece::GetIntegerValue(RLMachine& machine) const {
+  if (compiled_program)
+    return compiled_program->Evaluate(machine);
+
+  return InterpretIntegerValue(machine);
+}
+
+int ExpressionPiece::InterpretIntegerValue(RLMachine& machine) const {
   switch (piece_type) {
     case TYPE_STORE_REGISTER:
       return machine.store_register();
@@ -941,32 +952,33 @@ int ExpressionPiece::GetIntegerValue(RLMachine& machine) const {
     case TYPE_MEMORY_REFERENCE:
       return machine.GetIntValue(IntMemRef(
           mem_reference.type,
-          mem_reference.location->GetIntegerValue(machine)));
+          mem_reference.location->InterpretIntegerValue(machine)));
     case TYPE_SIMPLE_MEMORY_REFERENCE:
       return machine.GetIntValue(IntMemRef(
           simple_mem_reference.type,
           simple_mem_reference.location));
     case TYPE_UNIARY_EXPRESSION:
       return PerformUniaryOperationOn(
-          uniary_expression.operand->GetIntegerValue(machine));
+          uniary_expression.operand->InterpretIntegerValue(machine));
     case TYPE_BINARY_EXPRESSION:
       if (binary_expression.operation >= 20 &&
           binary_expression.operation < 30) {
         int value = PerformBinaryOperationOn(
             binary_expression.operation,
-            binary_expression.left_operand->GetIntegerValue(machine),
-            binary_expression.right_operand->GetIntegerValue(machine));
+            binary_expression.left_operand->InterpretIntegerValue(machine),
+            binary_expression.right_operand->InterpretIntegerValue(machine));
         binary_expression.left_operand->SetIntegerValue(machine, value);
         return value;
       } else if (binary_expression.operation == 30) {
-        int value = binary_expression.right_operand->GetIntegerValue(machine);
+        int value =
+            binary_expression.right_operand->InterpretIntegerValue(machine);
         binary_expression.left_operand->SetIntegerValue(machine, value);
         return value;
       } else {
         return PerformBinaryOperationOn(
             binary_expression.operation,
-            binary_expression.left_operand->GetIntegerValue(machine),
-            binary_expression.right_operand->GetIntegerValue(machine));
+            binary_expression.left_operand->InterpretIntegerValue(machine),
+            binary_expression.right_operand->InterpretIntegerValue(machine));
       }
     case TYPE_SIMPLE_ASSIGNMENT:
       machine.SetIntValue(
@@ -983,6 +995,31 @@ int ExpressionPiece::GetIntegerValue(RLMachine& machine) const {
   }
 }
 
+void ExpressionPiece::Compile() {
+  switch (piece_type) {
+    case TYPE_MEMORY_REFERENCE:
+    case TYPE_SIMPLE_MEMORY_REFERENCE:
+      if (GetExpressionValueType() == ValueTypeString)
+        break;
+      // Fall through.
+    case TYPE_UNIARY_EXPRESSION:
+    case TYPE_BINARY_EXPRESSION:
+    case TYPE_SIMPLE_ASSIGNMENT:
+      compiled_program = ExpressionProgram::Compile(*this);
+      break;
+    case TYPE_COMPLEX_EXPRESSION:
+      for (ExpressionPiece& piece : complex_expression)
+        piece.Compile();
+      break;
+    case TYPE_SPECIAL_EXPRESSION:
+      for (ExpressionPiece& piece : special_expression.pieces)
+        piece.Compile();
+      break;
+    default:
+      break;
+  }
+}
+
 void ExpressionPiece::SetStringValue(RLMachine& machine,
                                      const std::string& rvalue) {
   switch (piece_type) {
@@ -1196,6 +1233,8 @@ void ExpressionPiece::Invalidate() {
     case TYPE_INVALID:
       break;
   }
+
+  compiled_program.reset();
 }
 
 // -----------------------------------------------------------------------------
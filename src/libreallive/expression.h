@@ -53,6 +53,7 @@ size_t NextData(const char* src);
 
 // Parse expression functions
 class ExpressionPiece;
+class ExpressionProgram;
 ExpressionPiece GetExpressionToken(const char*& src);
 ExpressionPiece GetExpressionTerm(const char*& src);
 ExpressionPiece GetExpressionArithmatic(const char*& src);
@@ -143,9 +144,23 @@ class ExpressionPiece {
   void SetIntegerValue(RLMachine& machine, int rvalue);
 
   // Returns the integer value of this expression; this can either be
-  // a memory access or a calculation based on some subexpressions.
+  // a memory access or a calculation based on some subexpressions. Runs the
+  // compiled program if Compile() produced one.
   int GetIntegerValue(RLMachine& machine) const;
 
+  // Evaluates the expression by walking the tree, ignoring any compiled
+  // program. This is the reference implementation that ExpressionProgram is
+  // tested against.
+  int InterpretIntegerValue(RLMachine& machine) const;
+
+  // Lowers integer expressions into an ExpressionProgram that
+  // GetIntegerValue() uses from then on. Complex and special parameters
+  // compile their contained pieces. Constants, the store register and
+  // anything the program can't represent are left as they are.
+  void Compile();
+
+  bool is_compiled() const { return compiled_program != nullptr; }
+
   void SetStringValue(RLMachine& machine, const std::string& rvalue);
   const std::string& GetStringValue(RLMachine& machine) const;
 
@@ -173,6 +188,8 @@ class ExpressionPiece {
   int GetOverloadTag() const;
 
  private:
+  friend class ExpressionProgram;
+
   ExpressionPiece();
 
   // Frees all possible memory and sets |piece_type| to TYPE_INVALID.
@@ -245,6 +262,10 @@ class ExpressionPiece {
       std::vector<ExpressionPiece> pieces;
     } special_expression;
   };
+
+  // Flat version of this expression built by Compile(). Programs are
+  // immutable, so copies of this piece share it.
+  std::shared_ptr<const ExpressionProgram> compiled_program;
 };
 
 typedef std::vector<libreallive::ExpressionPiece> ExpressionPiecesVector;
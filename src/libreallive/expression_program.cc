@@ -0,0 +1,566 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of libreallive, a dependency of RLVM.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (c) 2016 Elliot Glaysher
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// -----------------------------------------------------------------------
+
+#include "libreallive/expression_program.h"
+
+#include "libreallive/expression.h"
+#include "libreallive/intmemref.h"
+#include "machine/memory.h"
+#include "machine/rlmachine.h"
+
+namespace libreallive {
+
+namespace {
+
+// Reads |location| out of |bank| with access |type|, the same way
+// Memory::GetIntValue() does. Returns false if |location| is out of range.
+inline bool ReadBank(const int* bank, int type, int location, int* out) {
+  if (type == 0) {
+    if (static_cast<unsigned int>(location) >= 2000u)
+      return false;
+    *out = bank[location];
+  } else {
+    int factor = 1 << (type - 1);
+    int eltsize = 32 / factor;
+    if (static_cast<unsigned int>(location) >= (64000u / factor))
+      return false;
+    *out = (bank[location / eltsize] >> ((location % eltsize) * factor)) &
+           ((1 << factor) - 1);
+  }
+  return true;
+}
+
+// Writes |value| into the 32-bit |word| of bank number |bank|. Everything but
+// intL goes through Memory so that savepoint bookkeeping still happens.
+inline void StoreWord(Memory& memory, int* const* banks, int bank, int word,
+                      int value) {
+  if (bank == INTL_LOCATION)
+    banks[bank][word] = value;
+  else
+    memory.SetIntBankWord(bank, word, value);
+}
+
+inline void StoreBits(Memory& memory, int* const* banks, int bank, int word,
+                      int shift, int mask, int value) {
+  int current = banks[bank][word];
+  StoreWord(memory, banks, bank, word,
+            (current & ~(mask << shift)) | (value & mask) << shift);
+}
+
+// Writes |location| into |bank| with access |type|, the same way
+// Memory::SetIntValue() does. Returns false if |location| is out of range.
+inline bool WriteBank(Memory& memory, int* const* banks, int bank, int type,
+                      int location, int value) {
+  if (type == 0) {
+    if (static_cast<unsigned int>(location) >= 2000u)
+      return false;
+    StoreWord(memory, banks, bank, location, value);
+  } else {
+    int factor = 1 << (type - 1);
+    int eltsize = 32 / factor;
+    if (static_cast<unsigned int>(location) >= (64000u / factor))
+      return false;
+    StoreBits(memory, banks, bank, location / eltsize,
+              (location % eltsize) * factor, (1 << factor) - 1, value);
+  }
+  return true;
+}
+
+}  // namespace
+
+ExpressionProgram::ExpressionProgram()
+    : uses_local_bank_(false), stack_depth_(0), max_stack_depth_(0) {}
+
+ExpressionProgram::~ExpressionProgram() {}
+
+// static
+std::unique_ptr<ExpressionProgram> ExpressionProgram::Compile(
+    const ExpressionPiece& piece) {
+  std::unique_ptr<ExpressionProgram> program(new ExpressionProgram);
+  if (!program->CompileValue(piece) ||
+      program->max_stack_depth_ > kMaxStackDepth)
+    return nullptr;
+
+  program->code_.shrink_to_fit();
+  return program;
+}
+
+int ExpressionProgram::Evaluate(RLMachine& machine) const {
+  Memory& memory = machine.memory();
+  int* banks[NUMBER_OF_INT_LOCATIONS + 1];
+  for (int i = 0; i < NUMBER_OF_INT_LOCATIONS; ++i)
+    banks[i] = memory.int_bank(i);
+  banks[INTL_LOCATION] = uses_local_bank_ ? machine.CurrentIntLBank() : NULL;
+
+  int stack[kMaxStackDepth];
+  int* sp = stack;
+
+  for (const Instruction& ins : code_) {
+    switch (ins.op) {
+      case OP_CONSTANT:
+        *sp++ = ins.arg;
+        break;
+      case OP_LOAD_STORE_REGISTER:
+        *sp++ = machine.store_register();
+        break;
+      case OP_STORE_STORE_REGISTER:
+        machine.set_store_register(sp[-1]);
+        break;
+      case OP_LOAD:
+        *sp++ = banks[ins.bank][ins.arg];
+        break;
+      case OP_LOAD_BITS:
+        *sp++ = (banks[ins.bank][ins.arg] >> ins.shift) & ins.mask;
+        break;
+      case OP_STORE:
+        StoreWord(memory, banks, ins.bank, ins.arg, sp[-1]);
+        break;
+      case OP_STORE_BITS:
+        StoreBits(memory, banks, ins.bank, ins.arg, ins.shift, ins.mask,
+                  sp[-1]);
+        break;
+      case OP_LOAD_INDIRECT:
+        if (!ReadBank(banks[ins.bank], ins.type, sp[-1], &sp[-1])) {
+          // Let Memory report the bad access.
+          sp[-1] = machine.GetIntValue(IntMemRef(ins.rep, sp[-1]));
+        }
+        break;
+      case OP_STORE_INDIRECT:
+        if (!WriteBank(memory, banks, ins.bank, ins.type, sp[-2], sp[-1]))
+          machine.SetIntValue(IntMemRef(ins.rep, sp[-2]), sp[-1]);
+        sp[-2] = sp[-1];
+        --sp;
+        break;
+      case OP_LOAD_REF:
+        *sp++ = machine.GetIntValue(IntMemRef(ins.rep, ins.arg));
+        break;
+      case OP_LOAD_REF_INDIRECT:
+        sp[-1] = machine.GetIntValue(IntMemRef(ins.rep, sp[-1]));
+        break;
+      case OP_STORE_REF:
+        machine.SetIntValue(IntMemRef(ins.rep, ins.arg), sp[-1]);
+        break;
+      case OP_STORE_REF_INDIRECT:
+        machine.SetIntValue(IntMemRef(ins.rep, sp[-2]), sp[-1]);
+        sp[-2] = sp[-1];
+        --sp;
+        break;
+      case OP_DUP:
+        sp[0] = sp[-1];
+        ++sp;
+        break;
+      case OP_NEGATE:
+        sp[-1] = -sp[-1];
+        break;
+      case OP_ADD:
+        --sp;
+        sp[-1] = sp[-1] + sp[0];
+        break;
+      case OP_SUB:
+        --sp;
+        sp[-1] = sp[-1] - sp[0];
+        break;
+      case OP_MUL:
+        --sp;
+        sp[-1] = sp[-1] * sp[0];
+        break;
+      case OP_DIV:
+        --sp;
+        if (sp[0] != 0)
+          sp[-1] = sp[-1] / sp[0];
+        break;
+      case OP_MOD:
+        --sp;
+        if (sp[0] != 0)
+          sp[-1] = sp[-1] % sp[0];
+        break;
+      case OP_BIT_AND:
+        --sp;
+        sp[-1] = sp[-1] & sp[0];
+        break;
+      case OP_BIT_OR:
+        --sp;
+        sp[-1] = sp[-1] | sp[0];
+        break;
+      case OP_BIT_XOR:
+        --sp;
+        sp[-1] = sp[-1] ^ sp[0];
+        break;
+      case OP_SHL:
+        --sp;
+        sp[-1] = sp[-1] << sp[0];
+        break;
+      case OP_SHR:
+        --sp;
+        sp[-1] = sp[-1] >> sp[0];
+        break;
+      case OP_EQ:
+        --sp;
+        sp[-1] = sp[-1] == sp[0];
+        break;
+      case OP_NE:
+        --sp;
+        sp[-1] = sp[-1] != sp[0];
+        break;
+      case OP_LE:
+        --sp;
+        sp[-1] = sp[-1] <= sp[0];
+        break;
+      case OP_LT:
+        --sp;
+        sp[-1] = sp[-1] < sp[0];
+        break;
+      case OP_GE:
+        --sp;
+        sp[-1] = sp[-1] >= sp[0];
+        break;
+      case OP_GT:
+        --sp;
+        sp[-1] = sp[-1] > sp[0];
+        break;
+      case OP_LOGICAL_AND:
+        --sp;
+        sp[-1] = sp[-1] && sp[0];
+        break;
+      case OP_LOGICAL_OR:
+        --sp;
+        sp[-1] = sp[-1] || sp[0];
+        break;
+    }
+  }
+
+  return sp[-1];
+}
+
+bool ExpressionProgram::IsConstant() const {
+  return code_.size() == 1 && code_[0].op == OP_CONSTANT;
+}
+
+bool ExpressionProgram::CompileValue(const ExpressionPiece& piece) {
+  switch (piece.piece_type) {
+    case TYPE_STORE_REGISTER:
+      Emit(OP_LOAD_STORE_REGISTER, 1);
+      return true;
+    case TYPE_INT_CONSTANT:
+      Emit(OP_CONSTANT, 1, piece.int_constant);
+      return true;
+    case TYPE_MEMORY_REFERENCE:
+    case TYPE_SIMPLE_MEMORY_REFERENCE: {
+      Instruction load, store;
+      bool indirect;
+      if (!CompileReference(piece, &load, &store, &indirect))
+        return false;
+      Emit(load, indirect ? 0 : 1);
+      return true;
+    }
+    case TYPE_UNIARY_EXPRESSION: {
+      size_t start = code_.size();
+      if (!CompileValue(*piece.uniary_expression.operand))
+        return false;
+      // Every operation other than negation is the identity.
+      if (piece.uniary_expression.operation == 0x01) {
+        if (code_.size() == start + 1 && code_.back().op == OP_CONSTANT)
+          code_.back().arg = -code_.back().arg;
+        else
+          Emit(OP_NEGATE, 0);
+      }
+      return true;
+    }
+    case TYPE_BINARY_EXPRESSION: {
+      char operation = piece.binary_expression.operation;
+      if (operation >= 20 && operation <= 30) {
+        return CompileAssignment(operation,
+                                 *piece.binary_expression.left_operand,
+                                 *piece.binary_expression.right_operand);
+      }
+
+      size_t lhs_start = code_.size();
+      if (!CompileValue(*piece.binary_expression.left_operand))
+        return false;
+      size_t rhs_start = code_.size();
+      if (!CompileValue(*piece.binary_expression.right_operand))
+        return false;
+      return EmitBinaryOperation(operation, lhs_start, rhs_start);
+    }
+    case TYPE_SIMPLE_ASSIGNMENT: {
+      Instruction load, store;
+      ResolveConstantReference(piece.simple_assignment.type,
+                               piece.simple_assignment.location,
+                               &load, &store);
+      Emit(OP_CONSTANT, 1, piece.simple_assignment.value);
+      Emit(store, 0);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool ExpressionProgram::CompileReference(const ExpressionPiece& piece,
+                                         Instruction* load,
+                                         Instruction* store,
+                                         bool* indirect) {
+  *indirect = false;
+  switch (piece.piece_type) {
+    case TYPE_STORE_REGISTER:
+      *load = Instruction();
+      load->op = OP_LOAD_STORE_REGISTER;
+      *store = Instruction();
+      store->op = OP_STORE_STORE_REGISTER;
+      return true;
+    case TYPE_SIMPLE_MEMORY_REFERENCE:
+      ResolveConstantReference(piece.simple_mem_reference.type,
+                               piece.simple_mem_reference.location,
+                               load, store);
+      return true;
+    case TYPE_MEMORY_REFERENCE: {
+      int rep = piece.mem_reference.type;
+      size_t start = code_.size();
+      if (!CompileValue(*piece.mem_reference.location))
+        return false;
+
+      if (code_.size() == start + 1 && code_.back().op == OP_CONSTANT) {
+        // The location folded down to a constant.
+        int location = code_.back().arg;
+        code_.pop_back();
+        --stack_depth_;
+        ResolveConstantReference(rep, location, load, store);
+        return true;
+      }
+
+      *indirect = true;
+      *load = Instruction();
+      if (ResolveBank(rep, load)) {
+        load->op = OP_LOAD_INDIRECT;
+        *store = *load;
+        store->op = OP_STORE_INDIRECT;
+      } else {
+        load->op = OP_LOAD_REF_INDIRECT;
+        load->rep = rep;
+        *store = *load;
+        store->op = OP_STORE_REF_INDIRECT;
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool ExpressionProgram::CompileAssignment(char operation,
+                                          const ExpressionPiece& lhs,
+                                          const ExpressionPiece& rhs) {
+  Instruction load, store;
+  bool indirect;
+  if (!CompileReference(lhs, &load, &store, &indirect))
+    return false;
+
+  if (operation == 30) {
+    if (!CompileValue(rhs))
+      return false;
+  } else {
+    if (indirect)
+      Emit(OP_DUP, 1);
+    size_t lhs_start = code_.size();
+    Emit(load, indirect ? 0 : 1);
+    size_t rhs_start = code_.size();
+    if (!CompileValue(rhs) ||
+        !EmitBinaryOperation(operation - 20, lhs_start, rhs_start))
+      return false;
+  }
+
+  Emit(store, indirect ? -1 : 0);
+  return true;
+}
+
+void ExpressionProgram::ResolveConstantReference(int rep,
+                                                 int location,
+                                                 Instruction* load,
+                                                 Instruction* store) {
+  *load = Instruction();
+  if (ResolveLocation(rep, location, load)) {
+    *store = *load;
+    store->op = load->op == OP_LOAD ? OP_STORE : OP_STORE_BITS;
+  } else {
+    load->op = OP_LOAD_REF;
+    load->rep = rep;
+    load->arg = location;
+    *store = *load;
+    store->op = OP_STORE_REF;
+  }
+}
+
+bool ExpressionProgram::ResolveLocation(int rep,
+                                        int location,
+                                        Instruction* instruction) {
+  if (!ResolveBank(rep, instruction))
+    return false;
+
+  int type = instruction->type;
+  if (type == 0) {
+    if (static_cast<unsigned int>(location) >= 2000u)
+      return false;
+    instruction->op = OP_LOAD;
+    instruction->arg = location;
+  } else {
+    int factor = 1 << (type - 1);
+    int eltsize = 32 / factor;
+    if (static_cast<unsigned int>(location) >= (64000u / factor))
+      return false;
+    instruction->op = OP_LOAD_BITS;
+    instruction->arg = location / eltsize;
+    instruction->shift = (location % eltsize) * factor;
+    instruction->mask = (1 << factor) - 1;
+  }
+
+  return true;
+}
+
+bool ExpressionProgram::ResolveBank(int rep, Instruction* instruction) {
+  // Mirrors the IntMemRef(int, int) constructor.
+  int bank = rep % 26;
+  int type = rep / 26;
+  if (bank == INTZ_LOCATION_IN_BYTECODE)
+    bank = INTZ_LOCATION;
+  else if (bank == INTL_LOCATION_IN_BYTECODE)
+    bank = INTL_LOCATION;
+  else if (bank < INTA_LOCATION || bank > INTG_LOCATION)
+    return false;
+
+  // Only the documented access types (none, b, 2b, 4b and 8b); anything else
+  // goes through Memory.
+  if (type < 0 || type > 4)
+    return false;
+
+  if (bank == INTL_LOCATION)
+    uses_local_bank_ = true;
+
+  instruction->bank = bank;
+  instruction->type = type;
+  instruction->rep = rep;
+  return true;
+}
+
+void ExpressionProgram::Emit(Opcode op, int stack_delta, int arg) {
+  Instruction instruction = Instruction();
+  instruction.op = op;
+  instruction.arg = arg;
+  Emit(instruction, stack_delta);
+}
+
+void ExpressionProgram::Emit(const Instruction& instruction, int stack_delta) {
+  code_.push_back(instruction);
+  stack_depth_ += stack_delta;
+  if (stack_depth_ > max_stack_depth_)
+    max_stack_depth_ = stack_depth_;
+}
+
+bool ExpressionProgram::EmitBinaryOperation(char operation,
+                                            size_t lhs_start,
+                                            size_t rhs_start) {
+  Opcode op;
+  switch (operation) {
+    case 0:
+      op = OP_ADD;
+      break;
+    case 1:
+      op = OP_SUB;
+      break;
+    case 2:
+      op = OP_MUL;
+      break;
+    case 3:
+      op = OP_DIV;
+      break;
+    case 4:
+      op = OP_MOD;
+      break;
+    case 5:
+      op = OP_BIT_AND;
+      break;
+    case 6:
+      op = OP_BIT_OR;
+      break;
+    case 7:
+      op = OP_BIT_XOR;
+      break;
+    case 8:
+      op = OP_SHL;
+      break;
+    case 9:
+      op = OP_SHR;
+      break;
+    case 40:
+      op = OP_EQ;
+      break;
+    case 41:
+      op = OP_NE;
+      break;
+    case 42:
+      op = OP_LE;
+      break;
+    case 43:
+      op = OP_LT;
+      break;
+    case 44:
+      op = OP_GE;
+      break;
+    case 45:
+      op = OP_GT;
+      break;
+    case 60:
+      op = OP_LOGICAL_AND;
+      break;
+    case 61:
+      op = OP_LOGICAL_OR;
+      break;
+    default:
+      return false;
+  }
+
+  if (rhs_start == lhs_start + 1 && code_.size() == rhs_start + 1 &&
+      code_[lhs_start].op == OP_CONSTANT &&
+      code_[rhs_start].op == OP_CONSTANT) {
+    int value = ExpressionPiece::PerformBinaryOperationOn(
+        operation, code_[lhs_start].arg, code_[rhs_start].arg);
+    code_.pop_back();
+    --stack_depth_;
+    code_.back().arg = value;
+    return true;
+  }
+
+  Emit(op, -1);
+  return true;
+}
+
+}  // namespace libreallive
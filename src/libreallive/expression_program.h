@@ -0,0 +1,198 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of libreallive, a dependency of RLVM.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (c) 2016 Elliot Glaysher
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// -----------------------------------------------------------------------
+
+#ifndef SRC_LIBREALLIVE_EXPRESSION_PROGRAM_H_
+#define SRC_LIBREALLIVE_EXPRESSION_PROGRAM_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class RLMachine;
+
+namespace libreallive {
+
+class ExpressionPiece;
+
+// A flat, stack based program lowered from an integer valued
+// ExpressionPiece. Walking the ExpressionPiece tree chases a heap pointer per
+// node and sends every memory read through the full bank dispatch in
+// Memory::GetIntValue(); hot conditions and counters in game scripts pay for
+// that on every execution.
+//
+// Compiling folds constant subexpressions and decodes constant memory
+// references (bank, access type, word and bit offset, bounds check) ahead of
+// time, so that Evaluate() is a single dispatch loop over a small vector.
+// Bank pointers themselves are fetched from the machine's Memory when the
+// program is evaluated, since a scenario's expressions outlive any one
+// Memory instance.
+//
+// ExpressionPiece::InterpretIntegerValue() remains the reference
+// implementation; a program must always produce the same value and the same
+// side effects as walking the tree does.
+class ExpressionProgram {
+ public:
+  ~ExpressionProgram();
+
+  // Lowers |piece| into a program. Returns nullptr if |piece| uses something
+  // a program can't represent (string values, unknown operators, assignment
+  // to something that isn't an lvalue), in which case callers should keep
+  // walking the tree.
+  static std::unique_ptr<ExpressionProgram> Compile(
+      const ExpressionPiece& piece);
+
+  // Runs the program and returns the value of the expression. Operands are
+  // evaluated left to right.
+  int Evaluate(RLMachine& machine) const;
+
+  // Whether the whole expression folded down to a single constant.
+  bool IsConstant() const;
+
+  // The number of instructions in the program.
+  size_t size() const { return code_.size(); }
+
+ private:
+  enum Opcode : uint8_t {
+    OP_CONSTANT,
+
+    // The store register.
+    OP_LOAD_STORE_REGISTER,
+    OP_STORE_STORE_REGISTER,
+
+    // Pre-resolved accesses to a constant location. |bank| is the internal
+    // bank number and |arg| the index of the 32-bit word; the *_BITS forms
+    // also use |shift| and |mask|.
+    OP_LOAD,
+    OP_LOAD_BITS,
+    OP_STORE,
+    OP_STORE_BITS,
+
+    // Pre-resolved bank with the location taken from the stack.
+    OP_LOAD_INDIRECT,
+    OP_STORE_INDIRECT,
+
+    // Fallbacks that go through RLMachine::{Get,Set}IntValue() with the
+    // bytecode's bank byte |rep|, for references we can't decode ahead of
+    // time. The *_INDIRECT forms take the location from the stack.
+    OP_LOAD_REF,
+    OP_LOAD_REF_INDIRECT,
+    OP_STORE_REF,
+    OP_STORE_REF_INDIRECT,
+
+    OP_DUP,
+    OP_NEGATE,
+
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_BIT_AND,
+    OP_BIT_OR,
+    OP_BIT_XOR,
+    OP_SHL,
+    OP_SHR,
+    OP_EQ,
+    OP_NE,
+    OP_LE,
+    OP_LT,
+    OP_GE,
+    OP_GT,
+    OP_LOGICAL_AND,
+    OP_LOGICAL_OR
+  };
+
+  struct Instruction {
+    Opcode op;
+    uint8_t bank;
+    uint8_t type;
+    uint8_t rep;
+    int32_t arg;
+    int32_t shift;
+    int32_t mask;
+  };
+
+  // Programs never need more stack than this in practice; anything deeper is
+  // left to the tree walker.
+  static const int kMaxStackDepth = 32;
+
+  ExpressionProgram();
+
+  // Recursive lowering functions. Return false if |piece| can't be compiled.
+  bool CompileValue(const ExpressionPiece& piece);
+  bool CompileAssignment(char operation,
+                         const ExpressionPiece& lhs,
+                         const ExpressionPiece& rhs);
+
+  // Emits the code for the location of the lvalue |piece| (unless it is a
+  // constant) and fills in the instructions that load from and store to it.
+  // |indirect| is set when the location is left on the stack.
+  bool CompileReference(const ExpressionPiece& piece,
+                        Instruction* load,
+                        Instruction* store,
+                        bool* indirect);
+
+  // Fills in |load| and |store| for the reference |rep|[|location|],
+  // pre-resolving it when possible.
+  void ResolveConstantReference(int rep,
+                                int location,
+                                Instruction* load,
+                                Instruction* store);
+
+  // Decodes the memory reference |rep|[|location|] into a pre-resolved
+  // OP_LOAD or OP_LOAD_BITS. Returns false if it isn't a standard integer
+  // bank or |location| is out of range.
+  bool ResolveLocation(int rep, int location, Instruction* instruction);
+  bool ResolveBank(int rep, Instruction* instruction);
+
+  // Appends an instruction, tracking how deep the stack gets.
+  void Emit(Opcode op, int stack_delta, int arg = 0);
+  void Emit(const Instruction& instruction, int stack_delta);
+
+  // Appends the operator |operation| for the operands starting at
+  // |lhs_start| and |rhs_start|, folding it when both are constants.
+  bool EmitBinaryOperation(char operation, size_t lhs_start, size_t rhs_start);
+
+  std::vector<Instruction> code_;
+
+  // Whether the program touches intL[], which lives in the current stack
+  // frame and is looked up per evaluation.
+  bool uses_local_bank_;
+
+  int stack_depth_;
+  int max_stack_depth_;
+};
+
+}  // namespace libreallive
+
+#endif  // SRC_LIBREALLIVE_EXPRESSION_PROGRAM_H_
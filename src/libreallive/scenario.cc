@@ -37,6 +37,8 @@
 #include <cassert>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "libreallive/compression.h"
 #include "utilities/exception.h"
@@ -45,6 +47,14 @@
 
 namespace libreallive {
 
+namespace {
+
+// Per entry cost of a std::map node.
+const size_t kMapNodeOverhead = sizeof(void*) * 4 + sizeof(pointer_t) +
+                                sizeof(int);
+
+}  // namespace
+
 Metadata::Metadata() : encoding_(0) {}
 
 void Metadata::Assign(const char* input) {
@@ -113,16 +123,18 @@ Script::Script(const Header& hdr,
                const size_t length,
                const std::string& regname,
                bool use_xor_2,
-               const compression::XorKey* second_level_xor_key) {
+               const compression::XorKey* second_level_xor_key)
+    : resident_size_(0), bytecode_length_(0) {
   // Kidoku/entrypoint table
   const int kidoku_offs = read_i32(data + 0x08);
   const size_t kidoku_length = read_i32(data + 0x0c);
-  ConstructionData cdat(kidoku_length, elts_.end());
+  ConstructionData cdat(kidoku_length);
   for (size_t i = 0; i < kidoku_length; ++i)
     cdat.kidoku_table[i] = read_i32(data + kidoku_offs + i * 4);
 
   // Decompress data
   const size_t dlen = read_i32(data + 0x24);
+  bytecode_length_ = dlen;
 
   const compression::XorKey* key = NULL;
   if (use_xor_2) {
@@ -150,29 +162,32 @@ Script::Script(const Header& hdr,
   const char* stream = uncompressed;
   const char* end = uncompressed + dlen;
   size_t pos = 0;
-  pointer_t it = elts_.before_begin();
   while (pos < dlen) {
     // Read element
-    it = elts_.emplace_after(it, BytecodeElement::Read(stream, end, cdat));
-    cdat.offsets[pos] = it;
+    cdat.offsets.push_back(pos);
+    pointer_t index = elts_.Read(stream, end, cdat);
+    const BytecodeRecord& record = elts_[index];
 
     // Keep track of the entrypoints
-    int entrypoint = (*it)->GetEntrypoint();
-    if (entrypoint != BytecodeElement::kInvalidEntrypoint)
-      entrypoint_associations_.emplace(entrypoint, it);
+    if (record.type == ENTRYPOINT_ELEMENT) {
+      entrypoint_associations_.emplace(
+          cdat.kidoku_table[record.value] - 1000000, index);
+    }
 
     // Advance
-    size_t l = (*it)->GetBytecodeLength();
+    size_t l = record.length;
     if (l <= 0)
       l = 1;  // Failsafe: always advance at least one byte.
     stream += l;
     pos += l;
   }
+  elts_.shrink_to_fit();
+
+  resident_size_ = elts_.resident_size() +
+                   entrypoint_associations_.size() * kMapNodeOverhead;
 
   // Resolve pointers
-  for (auto& element : elts_) {
-    element->SetPointers(cdat);
-  }
+  elts_.SetPointers(cdat);
 
   delete[] uncompressed;
 }
@@ -207,7 +222,14 @@ Scenario::Scenario(const FilePos& fp, int sn,
 
 Scenario::~Scenario() {}
 
-Scenario::const_iterator Scenario::FindEntrypoint(int entrypoint) const {
+size_t Scenario::resident_size() const {
+  size_t size = sizeof(Scenario) + script.resident_size();
+  for (const string& name : header.dramatis_personae_)
+    size += sizeof(string) + name.capacity();
+  return size + header.rldev_metadata_.to_string().capacity();
+}
+
+pointer_t Scenario::FindEntrypoint(int entrypoint) const {
   return script.GetEntrypoint(entrypoint);
 }
 
@@ -70,14 +70,20 @@ class Scenario {
   int savepoint_seentop() const { return header.savepoint_seentop_; }
 
   // Access to script
-  typedef BytecodeList::const_iterator const_iterator;
-  typedef BytecodeList::iterator iterator;
+  const BytecodeList& bytecode() const { return script.elts_; }
 
-  const_iterator begin() const  { return script.elts_.cbegin(); }
-  const_iterator end() const    { return script.elts_.cend();   }
+  // Number of elements in the script; one past the last instruction.
+  pointer_t size() const { return script.elts_.size(); }
 
   // Locate the entrypoint
-  const_iterator FindEntrypoint(int entrypoint) const;
+  pointer_t FindEntrypoint(int entrypoint) const;
+
+  // Approximate number of bytes of memory this parsed scenario holds onto.
+  // Used to keep the Archive's scenario cache within budget.
+  size_t resident_size() const;
+
+  // Length of this scenario's bytecode once decompressed.
+  size_t bytecode_length() const { return script.bytecode_length(); }
 
  private:
   Header header;
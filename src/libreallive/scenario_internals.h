@@ -78,6 +78,12 @@ class Script {
  public:
   const pointer_t GetEntrypoint(int entrypoint) const;
 
+  // Approximate number of bytes of heap this script's bytecode uses.
+  size_t resident_size() const { return resident_size_; }
+
+  // Length of the decompressed bytecode.
+  size_t bytecode_length() const { return bytecode_length_; }
+
  private:
   friend class Scenario;
 
@@ -91,6 +97,9 @@ class Script {
   // Entrypoint handeling
   typedef std::map<int, pointer_t> pointernumber;
   pointernumber entrypoint_associations_;
+
+  size_t resident_size_;
+  size_t bytecode_length_;
 };
 
 #endif  // SRC_LIBREALLIVE_SCENARIO_INTERNALS_H_
@@ -32,6 +32,7 @@
 #include "machine/rlmachine.h"
 #include "systems/base/event_system.h"
 #include "systems/base/graphics_system.h"
+#include "systems/base/image_prefetcher.h"
 #include "systems/base/sound_system.h"
 #include "systems/base/system.h"
 #include "systems/base/text_page.h"
@@ -55,7 +56,12 @@ PauseLongOperation::PauseLongOperation(RLMachine& machine)
   time_at_last_pass_ = event.GetTicks();
   total_time_ = 0;
 
-  machine_.system().graphics().MarkScreenAsDirty(GUT_TEXTSYS);
+  GraphicsSystem& graphics = machine_.system().graphics();
+  graphics.MarkScreenAsDirty(GUT_TEXTSYS);
+
+  // The player is reading; a good time to decode the next scene's images.
+  if (graphics.image_prefetcher())
+    graphics.image_prefetcher()->Prefetch(machine_);
 
   // We undo this in the destructor
   text.set_in_pause_state(true);
@@ -26,10 +26,17 @@
 
 #include "machine/dump_scenario.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <thread>
+#include <vector>
 
+#include "libreallive/archive.h"
 #include "libreallive/bytecode.h"
 #include "libreallive/scenario.h"
+#include "machine/rlmachine.h"
 
 void DumpScenario(RLMachine* machine, libreallive::Scenario* scenario) {
   if (!scenario) {
@@ -37,6 +44,78 @@ void DumpScenario(RLMachine* machine, libreallive::Scenario* scenario) {
     return;
   }
 
-  for (auto const& instruction : *scenario)
-    instruction->PrintSourceRepresentation(machine, std::cout);
+  const libreallive::BytecodeList& bytecode = scenario->bytecode();
+  for (libreallive::pointer_t i = 0; i < scenario->size(); ++i)
+    bytecode.PrintSourceRepresentation(i, machine, std::cout);
+}
+
+void TimeArchiveParse(RLMachine* machine, libreallive::Archive* archive) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::duration load_time = Clock::duration::zero();
+  Clock::duration parse_time = Clock::duration::zero();
+  int scenarios = 0;
+  size_t elements = 0;
+  int commands = 0;
+
+  for (auto it = archive->begin(); it != archive->end(); ++it) {
+    Clock::time_point start = Clock::now();
+    libreallive::Scenario* scenario = archive->GetScenario(it->first);
+    Clock::time_point loaded = Clock::now();
+    if (!scenario)
+      continue;
+    commands += machine->PreparseParameters(*scenario);
+    parse_time += Clock::now() - loaded;
+    load_time += loaded - start;
+
+    ++scenarios;
+    elements += scenario->size();
+  }
+
+  auto ms = [](Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+  };
+  std::cout << "Loaded " << scenarios << " scenarios (" << elements
+            << " elements) in " << ms(load_time) << "ms" << std::endl;
+  std::cout << "Parsed parameters of " << commands << " commands in "
+            << ms(parse_time) << "ms on up to "
+            << std::max(1u, std::thread::hardware_concurrency())
+            << " threads" << std::endl;
+}
+
+int ValidateArchive(libreallive::Archive* archive) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  std::vector<libreallive::Archive::ScenarioReport> reports =
+      archive->ValidateScenarios();
+  Clock::duration wall_time = Clock::now() - start;
+
+  int failures = 0;
+  size_t elements = 0;
+  size_t bytecode_length = 0;
+  long parse_time = 0;
+  for (const auto& report : reports) {
+    std::cout << "SEEN" << std::setw(4) << std::setfill('0') << report.index
+              << std::setfill(' ') << ": ";
+    if (report.error.empty()) {
+      std::cout << report.elements << " elements, " << report.bytecode_length
+                << " bytes, " << report.parse_time << "us" << std::endl;
+    } else {
+      std::cout << "error: " << report.error << std::endl;
+      failures++;
+    }
+
+    elements += report.elements;
+    bytecode_length += report.bytecode_length;
+    parse_time += report.parse_time;
+  }
+
+  std::cout << "Parsed " << reports.size() << " scenarios (" << elements
+            << " elements, " << bytecode_length << " bytes) in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   wall_time).count()
+            << "ms; " << parse_time / 1000 << "ms of parsing across threads"
+            << std::endl;
+  if (failures)
+    std::cout << failures << " scenarios failed to parse" << std::endl;
+  return failures;
 }
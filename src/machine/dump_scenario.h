@@ -28,6 +28,7 @@
 #define SRC_MACHINE_DUMP_SCENARIO_H_
 
 namespace libreallive {
+class Archive;
 class Scenario;
 }
 
@@ -36,4 +37,13 @@ class RLMachine;
 // A really cheap disassembler now that kprl can't be compiled anymore.
 void DumpScenario(RLMachine* machine, libreallive::Scenario* scenario);
 
+// Loads every scenario in |archive| and parses all of their command parameters
+// with |machine|'s modules, printing how long each step took.
+void TimeArchiveParse(RLMachine* machine, libreallive::Archive* archive);
+
+// Parses every scenario in |archive| in parallel and prints the element count,
+// bytecode size, parse time or error for each. Returns the number of
+// scenarios that failed to parse.
+int ValidateArchive(libreallive::Archive* archive);
+
 #endif  // SRC_MACHINE_DUMP_SCENARIO_H_
@@ -0,0 +1,166 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "machine/frame_scheduler.h"
+
+#include <algorithm>
+
+namespace {
+
+// Fast forwarding runs this many frames of bytecode between redraws.
+const int kFastForwardFrames = 4;
+
+// Idle passes are this many frames apart, cutting idle wake ups to a third.
+// Input doesn't wait for the next idle pass: EventSystem::Wait() returns
+// early when there are events to handle.
+const int kIdleFrames = 3;
+
+// How long a CPU usage sample is.
+const unsigned int kCpuWindow = 1000;
+
+std::vector<unsigned int> FrameTimeLimits() {
+  return {5, 10, 17, 20, 34, 50, 100};
+}
+
+std::vector<unsigned int> CpuUsageLimits() {
+  return {10, 20, 30, 40, 50, 60, 70, 80, 90, 100};
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// Histogram
+// -----------------------------------------------------------------------
+
+Histogram::Histogram(const std::vector<unsigned int>& limits)
+    : limits_(limits), counts_(limits.size() + 1, 0), total_(0) {}
+
+Histogram::~Histogram() {}
+
+void Histogram::Add(unsigned int value) {
+  size_t bucket =
+      std::upper_bound(limits_.begin(), limits_.end(), value) - limits_.begin();
+  counts_[bucket]++;
+  total_++;
+}
+
+unsigned int Histogram::lower_bound(size_t bucket) const {
+  return bucket == 0 ? 0 : limits_[bucket - 1];
+}
+
+// -----------------------------------------------------------------------
+// FrameScheduler
+// -----------------------------------------------------------------------
+
+FrameScheduler::FrameScheduler(int target_fps)
+    : target_fps_(std::max(target_fps, 1)),
+      epoch_(0),
+      frame_(0),
+      started_(false),
+      pass_start_(0),
+      window_start_(0),
+      window_busy_(0),
+      frame_times_(FrameTimeLimits()),
+      cpu_usage_(CpuUsageLimits()) {}
+
+FrameScheduler::~FrameScheduler() {}
+
+void FrameScheduler::BeginPass(unsigned int now) {
+  if (!started_) {
+    started_ = true;
+    epoch_ = now;
+    frame_ = 0;
+    window_start_ = now;
+  } else {
+    frame_times_.Add(now - pass_start_);
+  }
+
+  unsigned int window = now - window_start_;
+  if (window >= kCpuWindow) {
+    cpu_usage_.Add(std::min(window_busy_ * 100 / window, 100u));
+    window_start_ = now;
+    window_busy_ = 0;
+  }
+
+  pass_start_ = now;
+}
+
+unsigned int FrameScheduler::GetSliceLength(bool fast_forward) const {
+  unsigned int period = Deadline(1) - Deadline(0);
+  if (fast_forward)
+    return period * kFastForwardFrames;
+
+  // Leave the rest of the frame for drawing it.
+  return std::max(period / 2, 1u);
+}
+
+unsigned int FrameScheduler::EndPass(unsigned int now,
+                                     bool fast_forward,
+                                     bool screen_dirty,
+                                     bool idle) {
+  window_busy_ += now - pass_start_;
+
+  if (fast_forward) {
+    // Frame pacing starts over once we're back to normal speed.
+    epoch_ = now;
+    frame_ = 0;
+    return 0;
+  }
+
+  // The event system cuts sleeps short when there's input, so this pass may
+  // have started before the deadline we slept towards. Pick the grid back up
+  // from the frame we're actually in, so that the next pass is at most a frame
+  // away.
+  while (frame_ > 0 && now - epoch_ < Deadline(frame_) - epoch_)
+    frame_--;
+
+  // Move on to the first deadline that's still ahead of us. If we've fallen
+  // more than a frame behind, drop the missed frames instead of hurrying to
+  // catch up with them.
+  unsigned int next = Deadline(frame_ + 1);
+  if (now - epoch_ >= next - epoch_) {
+    frame_++;
+    next = Deadline(frame_ + 1);
+    if (now - epoch_ >= next - epoch_) {
+      epoch_ = now;
+      frame_ = 0;
+      return screen_dirty ? 0 : 1;
+    }
+  }
+
+  if (idle) {
+    frame_ += kIdleFrames - 1;
+    next = Deadline(frame_ + 1);
+  }
+
+  return next - now;
+}
+
+unsigned int FrameScheduler::Deadline(unsigned int frame) const {
+  return epoch_ + static_cast<unsigned int>(
+                      static_cast<unsigned long long>(frame) * 1000 /
+                      target_fps_);
+}
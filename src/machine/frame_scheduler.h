@@ -0,0 +1,120 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_MACHINE_FRAME_SCHEDULER_H_
+#define SRC_MACHINE_FRAME_SCHEDULER_H_
+
+#include <cstddef>
+#include <vector>
+
+// Counts samples into fixed ranges. Bucket i holds values in
+// [limits[i - 1], limits[i]); the last bucket holds everything from the last
+// limit up.
+class Histogram {
+ public:
+  explicit Histogram(const std::vector<unsigned int>& limits);
+  ~Histogram();
+
+  void Add(unsigned int value);
+
+  size_t bucket_count() const { return counts_.size(); }
+  int count(size_t bucket) const { return counts_[bucket]; }
+
+  // The smallest value counted in |bucket|.
+  unsigned int lower_bound(size_t bucket) const;
+
+  int total() const { return total_; }
+
+ private:
+  std::vector<unsigned int> limits_;
+  std::vector<int> counts_;
+  int total_;
+};  // class Histogram
+
+// Decides how long each pass of the main loop runs bytecode and how long it
+// then sleeps.
+//
+// Passes are aligned to frame deadlines at |target_fps|: after a pass we
+// sleep until the next deadline, so the following pass redraws (if anything
+// is dirty), runs long operations and polls input on schedule instead of
+// waking every 10ms. If the screen is dirty and we're already late, we don't
+// sleep at all. If the pass was idle, we sleep through a few frames instead of
+// one. While fast forwarding we never sleep and run several frames' worth of
+// bytecode between redraws.
+//
+// All times are in milliseconds from EventSystem::GetTicks().
+class FrameScheduler {
+ public:
+  explicit FrameScheduler(int target_fps);
+  ~FrameScheduler();
+
+  int target_fps() const { return target_fps_; }
+
+  // Marks the start of a pass of the main loop.
+  void BeginPass(unsigned int now);
+
+  // How long the pass may run bytecode for.
+  unsigned int GetSliceLength(bool fast_forward) const;
+
+  // Marks the end of the pass's work and returns how long to sleep before the
+  // next one. |screen_dirty| is whether the graphics system has something to
+  // draw. |idle| is whether there's nothing to draw, no long operation
+  // running and the bytecode gave up its slice early, i.e. it's only polling
+  // for input.
+  unsigned int EndPass(unsigned int now,
+                       bool fast_forward,
+                       bool screen_dirty,
+                       bool idle);
+
+  // Time between the starts of consecutive passes, sleep included.
+  const Histogram& frame_times() const { return frame_times_; }
+
+  // Percentage of each second spent working instead of sleeping.
+  const Histogram& cpu_usage() const { return cpu_usage_; }
+
+ private:
+  // The |frame|th deadline after |epoch_|.
+  unsigned int Deadline(unsigned int frame) const;
+
+  int target_fps_;
+
+  // Deadlines are computed from a fixed epoch so that rounding 1000 /
+  // |target_fps_| doesn't drift.
+  unsigned int epoch_;
+  unsigned int frame_;
+
+  bool started_;
+  unsigned int pass_start_;
+
+  // The current one second window for |cpu_usage_|.
+  unsigned int window_start_;
+  unsigned int window_busy_;
+
+  Histogram frame_times_;
+  Histogram cpu_usage_;
+};  // class FrameScheduler
+
+#endif  // SRC_MACHINE_FRAME_SCHEDULER_H_
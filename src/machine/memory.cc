@@ -117,6 +117,11 @@ void Memory::ConnectIntVarPointers() {
   original_int_var[5] = &local_.original_intF;
   original_int_var[6] = NULL;
   original_int_var[7] = NULL;
+
+  for (int i = 0; i < 6; ++i)
+    dirty_int_var[i] = NULL;
+  dirty_int_var[6] = &global_->changes.intG;
+  dirty_int_var[7] = &global_->changes.intZ;
 }
 
 const std::string& Memory::GetStringValue(int type, int location) {
@@ -151,15 +156,11 @@ void Memory::SetStringValue(int type, int number, const std::string& value) {
       break;
     case libreallive::STRM_LOCATION:
       global_->strM[number] = value;
+      global_->changes.strM.set(number);
       break;
     case libreallive::STRS_LOCATION: {
       // Possibly record the original value for a piece of local memory.
-      std::map<int, std::string>::iterator it =
-          local_.original_strS.find(number);
-      if (it == local_.original_strS.end()) {
-        local_.original_strS.insert(
-            std::make_pair(number, local_.strS[number]));
-      }
+      local_.original_strS.Record(number, local_.strS[number]);
       local_.strS[number] = value;
       break;
     }
@@ -179,6 +180,7 @@ void Memory::CheckNameIndex(int index, const std::string& name) const {
 void Memory::SetName(int index, const std::string& name) {
   CheckNameIndex(index, "Memory::set_name");
   global_->global_names[index] = name;
+  global_->changes.global_names.set(index);
 }
 
 const std::string& Memory::GetName(int index) const {
@@ -212,17 +214,20 @@ void Memory::RecordKidoku(int scenario, int kidoku) {
   if (bitset.size() <= static_cast<size_t>(kidoku))
     bitset.resize(kidoku + 1, false);
 
-  bitset[kidoku] = true;
+  if (!bitset[kidoku]) {
+    bitset[kidoku] = true;
+    global_->changes.kidoku.push_back(std::make_pair(scenario, kidoku));
+  }
 }
 
 void Memory::TakeSavepointSnapshot() {
-  local_.original_intA.clear();
-  local_.original_intB.clear();
-  local_.original_intC.clear();
-  local_.original_intD.clear();
-  local_.original_intE.clear();
-  local_.original_intF.clear();
-  local_.original_strS.clear();
+  local_.original_intA.Clear();
+  local_.original_intB.Clear();
+  local_.original_intC.Clear();
+  local_.original_intD.Clear();
+  local_.original_intE.Clear();
+  local_.original_intF.Clear();
+  local_.original_strS.Clear();
 }
 
 // static
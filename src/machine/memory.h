@@ -33,6 +33,7 @@
 #include <boost/serialization/version.hpp>
 
 #include <algorithm>
+#include <bitset>
 #include <map>
 #include <memory>
 #include <string>
@@ -53,6 +54,33 @@ extern const IntegerBank_t GLOBAL_INTEGER_BANKS;
 class RLMachine;
 class Gameexe;
 
+// The locations in global memory that have been written to since they were
+// last appended to the global memory journal. See
+// Serialization::flushGlobalMemoryJournal().
+struct GlobalChangeLog {
+  bool empty() const {
+    return intG.none() && intZ.none() && strM.none() &&
+           global_names.none() && kidoku.empty();
+  }
+
+  void Clear() {
+    intG.reset();
+    intZ.reset();
+    strM.reset();
+    global_names.reset();
+    kidoku.clear();
+  }
+
+  std::bitset<SIZE_OF_MEM_BANK> intG;
+  std::bitset<SIZE_OF_MEM_BANK> intZ;
+  std::bitset<SIZE_OF_MEM_BANK> strM;
+  std::bitset<SIZE_OF_NAME_BANK> global_names;
+
+  // (scenario, kidoku) pairs for bits that went from unread to read. Kidoku
+  // bits are only ever set, so this is all a replay needs.
+  std::vector<std::pair<int, int>> kidoku;
+};
+
 // Struct that represents Global Memory. In any one rlvm process, there
 // should only be one GlobalMemory struct existing, as it will be
 // shared over all the Memory objects in the process.
@@ -70,6 +98,9 @@ struct GlobalMemory {
   // represents a specific kidoku bit.
   std::map<int, boost::dynamic_bitset<>> kidoku_data;
 
+  // Writes that haven't reached the journal yet. Not serialized.
+  GlobalChangeLog changes;
+
   // boost::serialization
   template <class Archive>
   void serialize(Archive& ar, unsigned int version) {
@@ -87,6 +118,29 @@ BOOST_CLASS_VERSION(GlobalMemory, 1)
 
 struct dont_initialize {};
 
+// The values that locations in one memory bank had at the last savepoint, for
+// the locations that have been written to since. A fixed bitset and a flat
+// array, so recording a write is a bit test, and forgetting everything at a
+// savepoint doesn't touch |original|.
+template <typename T>
+struct BankChangeLog {
+  // Remembers |value| as what |location| held at the last savepoint, unless
+  // |location| has already been written to since.
+  void Record(int location, const T& value) {
+    if (!changed[location]) {
+      changed[location] = true;
+      original[location] = value;
+    }
+  }
+
+  void Clear() { changed.reset(); }
+
+  std::bitset<SIZE_OF_MEM_BANK> changed;
+
+  // Only meaningful where |changed| is set.
+  T original[SIZE_OF_MEM_BANK];
+};
+
 // Struct that represents Local Memory. In any one rlvm process, lots
 // of these things will be created, because there are commands
 struct LocalMemory {
@@ -114,13 +168,13 @@ struct LocalMemory {
   // Savepoint(). Instead of doing some sort of copying entire memory banks
   // whenever we hit a Savepoint() call, only reconstruct the original memory
   // when we save.
-  std::map<int, int> original_intA;
-  std::map<int, int> original_intB;
-  std::map<int, int> original_intC;
-  std::map<int, int> original_intD;
-  std::map<int, int> original_intE;
-  std::map<int, int> original_intF;
-  std::map<int, std::string> original_strS;
+  BankChangeLog<int> original_intA;
+  BankChangeLog<int> original_intB;
+  BankChangeLog<int> original_intC;
+  BankChangeLog<int> original_intD;
+  BankChangeLog<int> original_intE;
+  BankChangeLog<int> original_intF;
+  BankChangeLog<std::string> original_strS;
 
   std::string local_names[SIZE_OF_NAME_BANK];
 
@@ -129,12 +183,10 @@ struct LocalMemory {
   template <class Archive, typename T>
   void saveArrayRevertingChanges(Archive& ar,
                                  const T (&a)[SIZE_OF_MEM_BANK],
-                                 const std::map<int, T>& original) const {
+                                 const BankChangeLog<T>& original) const {
     T merged[SIZE_OF_MEM_BANK];
-    std::copy(a, a + SIZE_OF_MEM_BANK, merged);
-    for (auto it = original.cbegin(); it != original.cend(); ++it) {
-      merged[it->first] = it->second;
-    }
+    for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
+      merged[i] = original.changed[i] ? original.original[i] : a[i];
     ar& merged;
   }
 
@@ -212,6 +264,14 @@ class Memory {
   // Sets the value of a certain memory location
   void SetIntValue(const libreallive::IntMemRef& ref, int value);
 
+  // Direct access to the integer banks for libreallive::ExpressionProgram,
+  // which decodes and bounds checks its memory references ahead of time.
+  // |bank| is INTA_LOCATION through INTZ_LOCATION; intL[] lives in the stack
+  // frame. SetIntBankWord() writes the 32-bit |word| of |bank| and keeps the
+  // savepoint records up to date.
+  int* int_bank(int bank) const { return int_var[bank]; }
+  void SetIntBankWord(int bank, int word, int value);
+
   // Returns the string value of a string memory bank
   const std::string& GetStringValue(int type, int location);
 
@@ -283,7 +343,10 @@ class Memory {
   int* int_var[NUMBER_OF_INT_LOCATIONS];
 
   // Change records for original.
-  std::map<int, int>* original_int_var[NUMBER_OF_INT_LOCATIONS];
+  BankChangeLog<int>* original_int_var[NUMBER_OF_INT_LOCATIONS];
+
+  // Journal dirty bits for the global banks; NULL for the local ones.
+  std::bitset<SIZE_OF_MEM_BANK>* dirty_int_var[NUMBER_OF_INT_LOCATIONS];
 };  // end of class Memory
 
 // Implementation of getting an integer out of an array. Global because we need
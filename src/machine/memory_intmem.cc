@@ -61,14 +61,15 @@ void throwIllegalIndex(const IntMemRef& ref, const std::string& function) {
 }
 
 void saveOriginalValue(int* bank,
-                       std::map<int, int>* original_bank,
+                       BankChangeLog<int>* original_bank,
                        int location) {
-  if (bank && original_bank) {
-    std::map<int, int>::iterator it = original_bank->find(location);
-    if (it == original_bank->end()) {
-      original_bank->emplace(location, bank[location]);
-    }
-  }
+  if (bank && original_bank)
+    original_bank->Record(location, bank[location]);
+}
+
+void markDirty(std::bitset<SIZE_OF_MEM_BANK>* dirty_bank, int location) {
+  if (dirty_bank)
+    dirty_bank->set(location);
 }
 
 }  // namespace
@@ -111,7 +112,8 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
   int location = ref.location();
 
   int* bank = NULL;
-  std::map<int, int>* original_bank = NULL;
+  BankChangeLog<int>* original_bank = NULL;
+  std::bitset<SIZE_OF_MEM_BANK>* dirty_bank = NULL;
   if (index == 8) {
     bank = machine_.CurrentIntLBank();
   } else if (index < 0 || index > NUMBER_OF_INT_LOCATIONS) {
@@ -119,6 +121,7 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
   } else {
     bank = int_var[index];
     original_bank = original_int_var[index];
+    dirty_bank = dirty_int_var[index];
   }
 
   if (type == 0) {
@@ -126,6 +129,7 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
     if ((unsigned int)(location) >= 2000)
       throwIllegalIndex(ref, "RLMachine::SetIntValue()");
     saveOriginalValue(bank, original_bank, location);
+    markDirty(dirty_bank, location);
     bank[location] = value;
   } else {
     // Ab[]..G4b[], Z8b[] などを書く
@@ -137,8 +141,15 @@ void Memory::SetIntValue(const IntMemRef& ref, int value) {
       throwIllegalIndex(ref, "RLMachine::SetIntValue()");
 
     saveOriginalValue(bank, original_bank, location / eltsize);
+    markDirty(dirty_bank, location / eltsize);
     bank[location / eltsize] =
         (bank[location / eltsize] & ~(eltmask << shift)) | (value & eltmask)
                                                                << shift;
   }
 }
+
+void Memory::SetIntBankWord(int bank, int word, int value) {
+  saveOriginalValue(int_var[bank], original_int_var[bank], word);
+  markDirty(dirty_int_var[bank], word);
+  int_var[bank][word] = value;
+}
@@ -35,11 +35,15 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <iomanip>
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <iterator>
+#include <thread>
 #include <vector>
 
 #include "libreallive/archive.h"
@@ -59,10 +63,12 @@
 #include "machine/serialization.h"
 #include "machine/stack_frame.h"
 #include "systems/base/graphics_system.h"
+#include "systems/base/sound_system.h"
 #include "systems/base/system.h"
 #include "systems/base/system_error.h"
 #include "systems/base/text_page.h"
 #include "systems/base/text_system.h"
+#include "systems/base/voice_prefetcher.h"
 #include "utilities/date_util.h"
 #include "utilities/exception.h"
 #include "utilities/string_utilities.h"
@@ -90,10 +96,15 @@ const char seen_end[] = {130, 114,  // S
 
 const std::string SeenEnd(seen_end, 14);
 
-bool IsNotLongOp(StackFrame& frame) {
+bool IsNotLongOp(const StackFrame& frame) {
   return frame.frame_type != StackFrame::TYPE_LONGOP;
 }
 
+// Source of RLMachine::operation_cache_id_. Ids are never reused, so a
+// CommandElement never returns an RLOperation owned by a machine that has
+// since been destroyed.
+int next_operation_cache_id = 1;
+
 }  // namespace
 
 // -----------------------------------------------------------------------
@@ -102,8 +113,12 @@ bool IsNotLongOp(StackFrame& frame) {
 
 RLMachine::RLMachine(System& in_system, libreallive::Archive& in_archive)
     : memory_(new Memory(*this, in_system.gameexe())),
+      operation_cache_id_(next_operation_cache_id++),
       archive_(in_archive),
       system_(in_system) {
+  archive_.set_scenario_in_use_callback(
+      std::bind(&RLMachine::IsScenarioInUse, this, std::placeholders::_1));
+
   // Search in the Gameexe for #SEEN_START and place us there
   Gameexe& gameexe = in_system.gameexe();
   libreallive::Scenario* scenario = NULL;
@@ -123,7 +138,7 @@ RLMachine::RLMachine(System& in_system, libreallive::Archive& in_archive)
   if (scenario == 0)
     throw rlvm::Exception("Invalid scenario file");
   PushStackFrame(
-      StackFrame(scenario, scenario->begin(), StackFrame::TYPE_ROOT));
+      StackFrame(scenario, 0, StackFrame::TYPE_ROOT));
 
   // Initial value of the savepoint
   MarkSavepoint();
@@ -146,6 +161,9 @@ RLMachine::RLMachine(System& in_system, libreallive::Archive& in_archive)
 }
 
 RLMachine::~RLMachine() {
+  archive_.set_scenario_in_use_callback(nullptr);
+  archive_.set_scenario_loaded_callback(nullptr);
+
   if (undefined_log_)
     cerr << *undefined_log_;
 }
@@ -261,7 +279,8 @@ void RLMachine::ExecuteNextInstruction() {
         }
         delayed_modifications_.clear();
       } else {
-        (*(call_stack_.back().ip))->RunOnMachine(*this);
+        const StackFrame& frame = call_stack_.back();
+        frame.scenario->bytecode().RunOnMachine(frame.ip, *this);
       }
     }
     catch (rlvm::UnimplementedOpcode& e) {
@@ -323,7 +342,7 @@ void RLMachine::AdvanceInstructionPointer() {
 
     if (it != call_stack_.rend()) {
       it->ip++;
-      if (it->ip == it->scenario->end())
+      if (it->ip == it->scenario->size())
         halted_ = true;
     }
   }
@@ -339,12 +358,100 @@ std::string RLMachine::GetCommandName(const libreallive::CommandElement& f) {
 }
 
 void RLMachine::ExecuteCommand(const libreallive::CommandElement& f) {
+  RLOperation* op = f.GetCachedOperation(operation_cache_id_);
+  if (!op) {
+    op = GetOperation(f);
+    if (!op)
+      throw rlvm::UnimplementedOpcode(*this, f);
+    f.SetCachedOperation(operation_cache_id_, op);
+  }
+
+  try {
+    if (tracing_)
+      TraceCommand(*op, f);
+    op->DispatchFunction(*this, f);
+  }
+  catch (rlvm::Exception& e) {
+    e.setOperation(op);
+    throw;
+  }
+}
+
+void RLMachine::TraceCommand(const RLOperation& op,
+                             const libreallive::CommandElement& f) {
+  std::cerr << "(SEEN" << std::setw(4) << std::setfill('0') << SceneNumber()
+            << ")(Line " << std::setw(4) << std::setfill('0') << line_number()
+            << "): " << op.name();
+  libreallive::PrintParameterString(std::cerr, f.GetUnparsedParameters());
+  std::cerr << std::endl;
+}
+
+RLOperation* RLMachine::GetOperation(const libreallive::CommandElement& f) {
   ModuleMap::iterator it =
       modules_.find(PackModuleNumber(f.modtype(), f.module()));
-  if (it != modules_.end()) {
-    it->second->DispatchFunction(*this, f);
+  if (it != modules_.end())
+    return it->second->GetOperation(f);
+  return NULL;
+}
+
+int RLMachine::PreparseParameters(const libreallive::Scenario& scenario) {
+  // Look up every operation here, on our thread; the workers only touch the
+  // elements themselves.
+  const libreallive::BytecodeList& bytecode = scenario.bytecode();
+  typedef std::pair<libreallive::pointer_t, RLOperation*> Job;
+  std::vector<Job> jobs;
+  for (libreallive::pointer_t i = 0; i < scenario.size(); ++i) {
+    if (!bytecode[i].is_command())
+      continue;
+    libreallive::CommandElement command = bytecode.command(i);
+    if (command.AreParametersParsed())
+      continue;
+
+    RLOperation* op = GetOperation(command);
+    if (op)
+      jobs.emplace_back(i, op);
+  }
+
+  std::atomic<size_t> next_job(0);
+  std::atomic<int> parsed(0);
+  auto worker = [&]() {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+      try {
+        jobs[i].second->ParseCommandParameters(
+            bytecode.command(jobs[i].first));
+        ++parsed;
+      }
+      catch (std::exception& e) {
+        // Left unparsed; the same error is thrown when the command runs.
+      }
+    }
+  };
+
+  // Small scenarios aren't worth starting threads for.
+  const size_t kJobsPerThread = 256;
+  size_t thread_count = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()),
+      (jobs.size() + kJobsPerThread - 1) / kJobsPerThread);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+
+  return parsed;
+}
+
+void RLMachine::SetEagerParameterParsing(bool eager) {
+  eager_parameter_parsing_ = eager;
+  if (eager) {
+    archive_.set_scenario_loaded_callback([this](libreallive::Scenario* s) {
+      PreparseParameters(*s);
+    });
+    if (!call_stack_.empty())
+      PreparseParameters(*CurrentBytecodeFrame().scenario);
   } else {
-    throw rlvm::UnimplementedOpcode(*this, f);
+    archive_.set_scenario_loaded_callback(nullptr);
   }
 }
 
@@ -375,6 +482,8 @@ void RLMachine::Jump(int scenario_num, int entrypoint) {
     call_stack_.back().scenario = scenario;
     call_stack_.back().ip = scenario->FindEntrypoint(entrypoint);
   }
+
+  PrefetchUpcomingVoices();
 }
 
 void RLMachine::Farcall(int scenario_num, int entrypoint) {
@@ -386,13 +495,13 @@ void RLMachine::Farcall(int scenario_num, int entrypoint) {
     throw rlvm::Exception(oss.str());
   }
 
-  libreallive::Scenario::const_iterator it =
-      scenario->FindEntrypoint(entrypoint);
+  libreallive::pointer_t ip = scenario->FindEntrypoint(entrypoint);
 
   if (entrypoint == 0 && ShouldSetSeentopSavepoint())
     MarkSavepoint();
 
-  PushStackFrame(StackFrame(scenario, it, StackFrame::TYPE_FARCALL));
+  PushStackFrame(StackFrame(scenario, ip, StackFrame::TYPE_FARCALL));
+  PrefetchUpcomingVoices();
 }
 
 void RLMachine::ReturnFromFarcall() {
@@ -404,12 +513,12 @@ void RLMachine::ReturnFromFarcall() {
   PopStackFrame();
 }
 
-void RLMachine::GotoLocation(libreallive::BytecodeList::iterator new_location) {
+void RLMachine::GotoLocation(libreallive::pointer_t new_location) {
   // Modify the current frame of the call stack so that it's
   call_stack_.back().ip = new_location;
 }
 
-void RLMachine::Gosub(libreallive::BytecodeList::iterator new_location) {
+void RLMachine::Gosub(libreallive::pointer_t new_location) {
   PushStackFrame(StackFrame(
       call_stack_.back().scenario, new_location, StackFrame::TYPE_GOSUB));
 }
@@ -545,6 +654,39 @@ const libreallive::Scenario& RLMachine::Scenario() const {
   return *call_stack_.back().scenario;
 }
 
+bool RLMachine::IsScenarioInUse(int scene_number) const {
+  // Delayed stack modifications may hold frames we can't see into.
+  if (loading_call_stack_ || !delayed_modifications_.empty())
+    return true;
+
+  auto in_scene = [scene_number](const StackFrame& frame) {
+    return frame.scenario && frame.scenario->scene_number() == scene_number;
+  };
+  return std::any_of(call_stack_.begin(), call_stack_.end(), in_scene) ||
+         std::any_of(savepoint_call_stack_.begin(),
+                     savepoint_call_stack_.end(), in_scene);
+}
+
+const StackFrame& RLMachine::CurrentBytecodeFrame() const {
+  std::vector<StackFrame>::const_reverse_iterator it =
+      find_if(call_stack_.rbegin(), call_stack_.rend(), IsNotLongOp);
+  if (it == call_stack_.rend())
+    throw rlvm::Exception("No bytecode frame on the call stack");
+  return *it;
+}
+
+void RLMachine::PrefetchUpcomingVoices() {
+  SoundSystem& sound = system_.sound();
+  VoicePrefetcher* prefetcher = sound.voice_prefetcher();
+  if (!prefetcher || !sound.is_koe_enabled() || system_.ShouldFastForward() ||
+      call_stack_.empty())
+    return;
+
+  const StackFrame& frame = CurrentBytecodeFrame();
+  prefetcher->Prefetch(VoicePrefetcher::ScanForVoices(
+      frame.scenario->bytecode(), frame.ip, prefetcher->lookahead()));
+}
+
 void RLMachine::ExecuteExpression(const libreallive::ExpressionElement& e) {
   e.ParsedExpression().GetIntegerValue(*this);
   AdvanceInstructionPointer();
@@ -709,7 +851,19 @@ void RLMachine::load(Archive& ar, unsigned int version) {
   // Just thaw the call_stack_; all preprocessing was done at freeze
   // time.
   // assert(call_stack_.size() == 0);
-  ar& call_stack_;
+  loading_call_stack_ = true;
+  try {
+    ar& call_stack_;
+  } catch (...) {
+    loading_call_stack_ = false;
+    throw;
+  }
+  loading_call_stack_ = false;
+
+  // Scenarios only the old stack used can go now.
+  archive_.TrimScenarioCache();
+
+  PrefetchUpcomingVoices();
 }
 
 // -----------------------------------------------------------------------
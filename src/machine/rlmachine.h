@@ -50,6 +50,7 @@ class LongOperation;
 class Memory;
 class OpcodeLog;
 class RLModule;
+class RLOperation;
 class RealLiveDLL;
 class System;
 struct StackFrame;
@@ -98,6 +99,13 @@ class RLMachine {
   void set_tracing_on() { tracing_ = true; }
   bool is_tracing_on() const { return tracing_; }
 
+  // When on, the parameters of every command in a scenario are parsed as soon
+  // as the scenario is loaded (see PreparseParameters()) instead of the first
+  // time each command runs. Turning this on also preparses the scenario we're
+  // currently in. Off by default.
+  void SetEagerParameterParsing(bool eager);
+  bool eager_parameter_parsing() const { return eager_parameter_parsing_; }
+
   // Registers a given module with this RLMachine instance. A module is a set
   // of different functions registered as one unit. Takes ownership of
   // |module|.
@@ -174,13 +182,13 @@ class RLMachine {
   void ReturnFromFarcall();
 
   // Permanently moves the instruction pointer to the passed in
-  // iterator in the current stack frame.
-  void GotoLocation(libreallive::BytecodeList::iterator new_location);
+  // element in the current stack frame.
+  void GotoLocation(libreallive::pointer_t new_location);
 
   // Pushes a new stack frame onto the call stack, saving the current
   // location. The new frame contains the current SEEN with
   // new_location as the instruction pointer.
-  void Gosub(libreallive::BytecodeList::iterator new_location);
+  void Gosub(libreallive::pointer_t new_location);
 
   // Returns from the most recent gosub call. Throws if there's a mismatch
   // between farcall()/rtl() gosub()/ret() pairs.
@@ -210,9 +218,25 @@ class RLMachine {
   // Returns the actual Scenario on the top top of the call stack.
   const libreallive::Scenario& Scenario() const;
 
+  // Whether any frame of the call stack (or the savepoint copy of it) is
+  // executing scenario |scene_number|. The Archive asks this before evicting
+  // a parsed scenario.
+  bool IsScenarioInUse(int scene_number) const;
+
+  // Returns the innermost stack frame that runs bytecode, skipping over any
+  // LongOperations. While a command is executing, its |ip| points to that
+  // command.
+  const StackFrame& CurrentBytecodeFrame() const;
+
+  // Hands the voices played by the next few koePlay commands after the
+  // current instruction to the sound system's VoicePrefetcher, if it has one.
+  // Called after each koePlay and whenever we enter a scenario, so the first
+  // line after a jump is ready too.
+  void PrefetchUpcomingVoices();
+
   // ------------------------------------------------ [ Execution interface ]
-  // Normally, execute_next_instruction will call RunOnMachine() on
-  // whatever BytecodeElement is currently pointed to by the
+  // Normally, execute_next_instruction will have the current scenario's
+  // BytecodeList run whatever element is currently pointed to by the
   // instruction pointer.
 
   // Sets the current line number. This may trigger a line action.
@@ -235,7 +259,20 @@ class RLMachine {
   // that hasn't been patched at the time this method is called.)
   int GetProbableEncodingType() const;
 
+  // Runs the RLOperation that implements |f|. The lookup through our modules
+  // is only done the first time; the result is cached on |f|.
   void ExecuteCommand(const libreallive::CommandElement& f);
+
+  // Returns the RLOperation in our attached modules that implements |f|, or
+  // NULL if there isn't one.
+  RLOperation* GetOperation(const libreallive::CommandElement& f);
+
+  // Parses and caches the parameters of every command in |scenario| that
+  // hasn't been run yet. Each element parses independently, so the work is
+  // spread over all cores; this returns once everything is parsed. Commands
+  // whose parameters fail to parse are left alone so the error is reported
+  // when they run. Returns the number of commands that were parsed.
+  int PreparseParameters(const libreallive::Scenario& scenario);
   void ExecuteExpression(const libreallive::ExpressionElement& e);
   void PerformTextout(const libreallive::TextoutElement& e);
   void PerformTextout(const std::string& cp932str);
@@ -362,6 +399,9 @@ class RLMachine {
   // Mapping between the module_type:module pair and the module implementation
   ModuleMap modules_;
 
+  // Identifies this machine's lookups in CommandElement's operation cache.
+  int operation_cache_id_;
+
   // States whether the RLMachine is in the halted state (and thus won't
   // execute more instructions)
   bool halted_ = false;
@@ -412,6 +452,13 @@ class RLMachine {
   // The actions that were delayed when |delay_stack_modifications_| is on.
   std::vector<std::function<void(void)>> delayed_modifications_;
 
+  // Whether scenarios have their command parameters parsed when loaded.
+  bool eager_parameter_parsing_ = false;
+
+  // Whether we're in the middle of deserializing |call_stack_|, during which
+  // the frames we've already read aren't reachable from it.
+  bool loading_call_stack_ = false;
+
   // An optional set of game specific hacks that run at certain SEEN/line
   // pairs. These run during setLineNumer().
   typedef std::map<std::pair<int, int>, std::function<void(void)>> ActionMap;
@@ -421,6 +468,10 @@ class RLMachine {
   // Currently loaded "DLLs".
   DLLMap loaded_dlls_;
 
+  // Prints the command |op| is about to run to stderr. Used when tracing.
+  void TraceCommand(const RLOperation& op,
+                    const libreallive::CommandElement& f);
+
   // boost::serialization support
   friend class boost::serialization::access;
 
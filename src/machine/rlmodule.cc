@@ -27,7 +27,6 @@
 
 #include "machine/rlmodule.h"
 
-#include <iomanip>
 #include <iostream>
 #include <utility>
 #include <sstream>
@@ -137,30 +136,10 @@ std::string RLModule::GetCommandName(RLMachine& machine,
   return name;
 }
 
-void RLModule::DispatchFunction(RLMachine& machine,
-                                const libreallive::CommandElement& f) {
+RLOperation* RLModule::GetOperation(const libreallive::CommandElement& f) {
   OpcodeMap::iterator it =
       stored_operations_.find(PackOpcodeNumber(f.opcode(), f.overload()));
-  if (it != stored_operations_.end()) {
-    try {
-      if (machine.is_tracing_on()) {
-        std::cerr << "(SEEN" << std::setw(4) << std::setfill('0')
-                  << machine.SceneNumber()
-                  << ")(Line " << std::setw(4) << std::setfill('0')
-                  << machine.line_number() << "): " << it->second->name();
-        libreallive::PrintParameterString(std::cerr,
-                                          f.GetUnparsedParameters());
-        std::cerr << std::endl;
-      }
-      it->second->DispatchFunction(machine, f);
-    }
-    catch (rlvm::Exception& e) {
-      e.setOperation(it->second.get());
-      throw;
-    }
-  } else {
-    throw rlvm::UnimplementedOpcode(machine, f);
-  }
+  return it != stored_operations_.end() ? it->second.get() : NULL;
 }
 
 std::ostream& operator<<(std::ostream& os, const RLModule& module) {
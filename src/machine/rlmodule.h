@@ -124,11 +124,9 @@ class RLModule {
   void SetProperty(int property, int value);
   bool GetProperty(int property, int& value) const;
 
-  // Using the bytecode element CommandElement f, try to find an
-  // RLOperation implementation of the instruction in this module, and
-  // execute it.
-  void DispatchFunction(RLMachine& machine,
-                        const libreallive::CommandElement& f);
+  // Returns the RLOperation that implements |f|, or NULL if this module
+  // doesn't define it.
+  RLOperation* GetOperation(const libreallive::CommandElement& f);
 
   std::string GetCommandName(RLMachine& machine,
                              const libreallive::CommandElement& f);
@@ -90,12 +90,7 @@ bool RLOperation::AdvanceInstructionPointer() { return true; }
 
 void RLOperation::DispatchFunction(RLMachine& machine,
                                    const libreallive::CommandElement& ff) {
-  if (!ff.AreParametersParsed()) {
-    std::vector<std::string> unparsed = ff.GetUnparsedParameters();
-    libreallive::ExpressionPiecesVector output;
-    ParseParameters(unparsed, output);
-    ff.SetParsedParameters(std::move(output));
-  }
+  ParseCommandParameters(ff);
 
   const libreallive::ExpressionPiecesVector& parameter_pieces =
       ff.GetParsedParameters();
@@ -110,6 +105,16 @@ void RLOperation::DispatchFunction(RLMachine& machine,
     machine.AdvanceInstructionPointer();
 }
 
+void RLOperation::ParseCommandParameters(
+    const libreallive::CommandElement& ff) {
+  if (!ff.AreParametersParsed()) {
+    std::vector<std::string> unparsed = ff.GetUnparsedParameters();
+    libreallive::ExpressionPiecesVector output;
+    ParseParameters(unparsed, output);
+    ff.SetParsedParameters(std::move(output));
+  }
+}
+
 // Implementation for IntConstant_T
 IntConstant_T::type IntConstant_T::getData(
     RLMachine& machine,
@@ -266,12 +271,7 @@ void RLOp_SpecialCase::ParseParameters(
 void RLOp_SpecialCase::DispatchFunction(RLMachine& machine,
                                         const libreallive::CommandElement& ff) {
   // First try to run the default parse_parameters if we can.
-  if (!ff.AreParametersParsed()) {
-    std::vector<std::string> unparsed = ff.GetUnparsedParameters();
-    libreallive::ExpressionPiecesVector output;
-    ParseParameters(unparsed, output);
-    ff.SetParsedParameters(std::move(output));
-  }
+  ParseCommandParameters(ff);
 
   // Pass this on to the implementation of this functor.
   operator()(machine, ff);
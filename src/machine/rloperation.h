@@ -127,6 +127,11 @@ class RLOperation {
   virtual void DispatchFunction(RLMachine& machine,
                                 const libreallive::CommandElement& f);
 
+  // Runs ParseParameters() on |f|'s unparsed parameters and caches the result
+  // on |f|, unless that's already been done. Only touches |f|, so different
+  // elements may be parsed on different threads.
+  void ParseCommandParameters(const libreallive::CommandElement& f);
+
  private:
   friend class RLModule;
   friend class MappedRLModule;
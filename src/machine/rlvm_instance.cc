@@ -26,12 +26,15 @@
 
 #include "machine/rlvm_instance.h"
 
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <string>
 
 #include "libreallive/gameexe.h"
 #include "libreallive/reallive.h"
 #include "machine/dump_scenario.h"
+#include "machine/frame_scheduler.h"
 #include "machine/game_hacks.h"
 #include "machine/memory.h"
 #include "machine/rlmachine.h"
@@ -41,9 +44,15 @@
 // Temporarily disable guichan for the SDL2 porting.
 #include "platforms/gcn/gcn_platform.h"
 #include "systems/base/event_system.h"
+#include "systems/base/glyph_cache.h"
 #include "systems/base/graphics_system.h"
+#include "systems/base/image_prefetcher.h"
+#include "systems/base/sound_system.h"
+#include "systems/base/surface_cache.h"
 #include "systems/base/system_error.h"
+#include "systems/base/voice_prefetcher.h"
 #include "systems/sdl/sdl_system.h"
+#include "systems/sdl/sdl_text_system.h"
 #include "utf8cpp/utf8.h"
 #include "utilities/exception.h"
 #include "utilities/file.h"
@@ -53,6 +62,10 @@
 
 namespace fs = boost::filesystem;
 
+// How often, in milliseconds, changes to global memory are appended to the
+// journal while a game is running.
+const unsigned int kGlobalMemoryJournalInterval = 5000;
+
 // AVG32 file checks. We can't run AVG32 games.
 const char* avg32_exes[] = {"avg3216m.exe", "avg3217m.exe", NULL};
 
@@ -68,13 +81,27 @@ RLVMInstance::RLVMInstance()
       count_undefined_copcodes_(false),
       tracing_(false),
       load_save_(-1),
-      dump_seen_(-1) {
+      dump_seen_(-1),
+      scenario_budget_(0),
+      report_scenario_memory_(false),
+      eager_parameter_parsing_(false),
+      time_parse_(false),
+      validate_seen_(false),
+      preload_seen_(false),
+      report_image_prefetch_(false),
+      surface_cache_mb_(-1),
+      texture_cache_mb_(-1),
+      report_surface_cache_(false),
+      report_glyph_cache_(false),
+      report_voice_prefetch_(false),
+      target_fps_(60),
+      report_scheduler_(false) {
   srand(time(NULL));
 }
 
 RLVMInstance::~RLVMInstance() {}
 
-void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
+int RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
   try {
     fs::path gameexePath = FindGameFile(gamerootPath, "Gameexe.ini");
     fs::path seenPath = FindGameFile(gamerootPath, "Seen.txt");
@@ -104,7 +131,21 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
       gameexe("__GAMEFONT") = custom_font_;
     }
 
+    if (surface_cache_mb_ != -1)
+      gameexe("__SURFACE_CACHE_MB") = surface_cache_mb_;
+
+    if (texture_cache_mb_ != -1)
+      gameexe("__TEXTURE_CACHE_MB") = texture_cache_mb_;
+
     libreallive::Archive arc(seenPath.string(), gameexe("REGNAME"));
+    arc.set_scenario_budget(scenario_budget_);
+
+    if (validate_seen_)
+      return ValidateArchive(&arc) ? 1 : 0;
+
+    if (preload_seen_)
+      arc.StartPreload();
+
     SDLSystem sdlSystem(gameexe);
     RLMachine rlmachine(sdlSystem, arc);
     AddAllModules(rlmachine);
@@ -113,9 +154,17 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
     if (dump_seen_ != -1) {
       libreallive::Scenario* scenario = arc.GetScenario(dump_seen_);
       DumpScenario(&rlmachine, scenario);
-      return;
+      return 0;
+    }
+
+    if (time_parse_) {
+      TimeArchiveParse(&rlmachine, &arc);
+      return 0;
     }
 
+    if (eager_parameter_parsing_)
+      rlmachine.SetEagerParameterParsing(true);
+
     // Validate our font file
     // TODO(erg): Remove this when we switch to native font selection dialogs.
     fs::path fontFile = FindFontFile(sdlSystem);
@@ -163,14 +212,20 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
     if (load_save_ != -1)
       Sys_load()(rlmachine, load_save_);
 
+    FrameScheduler scheduler(target_fps_);
+    unsigned int last_journal_flush = sdlSystem.event().GetTicks();
     while (!rlmachine.halted()) {
+      scheduler.BeginPass(sdlSystem.event().GetTicks());
+
       // Give SDL a chance to respond to events, redraw the screen,
       // etc.
       sdlSystem.Run(rlmachine);
 
-      // Run the rlmachine through as many instructions as we can in a 10ms time
-      // slice. Bail out if we switch to long operation mode, or if the screen
-      // is marked as dirty.
+      // Run the rlmachine through as many instructions as we can in this
+      // pass's time slice. Bail out if we switch to long operation mode, or
+      // if the bytecode is waiting on us.
+      bool fast_forward = sdlSystem.ShouldFastForward();
+      unsigned int slice = scheduler.GetSliceLength(fast_forward);
       unsigned int start_ticks = sdlSystem.event().GetTicks();
       unsigned int end_ticks = start_ticks;
       do {
@@ -178,21 +233,58 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
         end_ticks = sdlSystem.event().GetTicks();
       } while (!rlmachine.CurrentLongOperation() &&
                !sdlSystem.force_wait() &&
-               (end_ticks - start_ticks < 10));
-
-      // Sleep to be nice to the processor and to give the GPU a chance to
-      // catch up.
-      if (!sdlSystem.ShouldFastForward()) {
-        int real_sleep_time = 10 - (end_ticks - start_ticks);
-        if (real_sleep_time < 1)
-          real_sleep_time = 1;
-        sdlSystem.event().Wait(real_sleep_time);
+               (end_ticks - start_ticks < slice));
+
+      // Keep read text and global flags from being lost to a crash. This is
+      // only insurance: if it fails, the changes stay pending for the next
+      // try and saveGlobalMemory() at exit still writes them.
+      if (end_ticks - last_journal_flush >= kGlobalMemoryJournalInterval) {
+        try {
+          Serialization::flushGlobalMemoryJournal(rlmachine);
+        }
+        catch (std::exception& e) {
+          std::cerr << "WARNING: Couldn't write the global memory journal: "
+                    << e.what() << std::endl;
+        }
+        last_journal_flush = end_ticks;
       }
 
+      // Sleep until the next frame is due to be nice to the processor and to
+      // give the GPU a chance to catch up. If the bytecode yielded without
+      // anything to draw or animate, it's just polling for input and we can
+      // sleep longer.
+      GraphicsSystem& graphics = sdlSystem.graphics();
+      bool screen_dirty =
+          graphics.screen_needs_refresh() || graphics.object_state_dirty();
+      bool idle = !screen_dirty && !rlmachine.CurrentLongOperation() &&
+                  sdlSystem.force_wait();
+      unsigned int sleep_time =
+          scheduler.EndPass(end_ticks, fast_forward, screen_dirty, idle);
+      if (sleep_time)
+        sdlSystem.event().Wait(sleep_time);
+
       sdlSystem.set_force_wait(false);
     }
 
     Serialization::saveGlobalMemory(rlmachine);
+
+    if (report_scenario_memory_)
+      PrintScenarioMemory(arc);
+
+    if (report_image_prefetch_)
+      PrintImagePrefetchStats(sdlSystem.graphics());
+
+    if (report_surface_cache_)
+      PrintSurfaceCacheStats(sdlSystem.graphics());
+
+    if (report_glyph_cache_)
+      PrintGlyphCacheStats(sdlSystem.text().glyph_cache());
+
+    if (report_voice_prefetch_)
+      PrintVoicePrefetchStats(sdlSystem.sound());
+
+    if (report_scheduler_)
+      PrintSchedulerStats(scheduler);
   }
   catch (rlvm::UserPresentableError& e) {
     ReportFatalError(e.message_text(), e.informative_text());
@@ -212,6 +304,8 @@ void RLVMInstance::Run(const boost::filesystem::path& gamerootPath) {
   catch (const char* e) {
     ReportFatalError(_("Uncaught exception"), e);
   }
+
+  return 0;
 }
 
 boost::filesystem::path RLVMInstance::SelectGameDirectory() {
@@ -223,6 +317,74 @@ void RLVMInstance::ReportFatalError(const std::string& message_text,
   std::cerr << message_text << ": " << informative_text << std::endl;
 }
 
+void RLVMInstance::PrintScenarioMemory(const libreallive::Archive& archive) {
+  std::map<int, size_t> sizes = archive.GetResidentScenarioSizes();
+  std::cerr << "Resident scenarios (" << sizes.size() << ", "
+            << archive.resident_size() / 1024 << " KiB total):" << std::endl;
+  for (const auto& entry : sizes) {
+    std::cerr << "  SEEN" << std::setw(4) << std::setfill('0') << entry.first
+              << ": " << entry.second / 1024 << " KiB" << std::endl;
+  }
+}
+
+void RLVMInstance::PrintImagePrefetchStats(GraphicsSystem& graphics) {
+  ImagePrefetcher* prefetcher = graphics.image_prefetcher();
+  if (!prefetcher) {
+    std::cerr << "Images aren't prefetched on this platform." << std::endl;
+    return;
+  }
+
+  int loads = prefetcher->hits() + prefetcher->late() + prefetcher->misses();
+  std::cerr << "Image prefetch: " << prefetcher->hits() << " ready, "
+            << prefetcher->late() << " still decoding, "
+            << prefetcher->misses() << " not prefetched";
+  if (loads)
+    std::cerr << " (" << prefetcher->hits() * 100 / loads << "% hit rate)";
+  std::cerr << "; " << prefetcher->wasted() << " wasted decodes" << std::endl;
+}
+
+void RLVMInstance::PrintSurfaceCacheStats(GraphicsSystem& graphics) {
+  SurfaceCache& cache = graphics.surface_cache();
+  int fetches = cache.hits() + cache.misses();
+  std::cerr << "Image cache: " << cache.hits() << " hits, " << cache.misses()
+            << " misses";
+  if (fetches)
+    std::cerr << " (" << cache.hits() * 100 / fetches << "% hit rate)";
+  std::cerr << "; " << cache.evictions() << " evicted, "
+            << cache.texture_releases() << " textures released" << std::endl;
+  std::cerr << "  " << cache.size() << " images, "
+            << cache.pixel_memory() / 1024 << " of "
+            << cache.pixel_budget() / 1024 << " KiB pixels, "
+            << cache.GetTextureMemory() / 1024 << " of "
+            << cache.texture_budget() / 1024 << " KiB textures" << std::endl;
+}
+
+void RLVMInstance::PrintGlyphCacheStats(const GlyphCache& cache) {
+  int fetches = cache.hits() + cache.misses();
+  std::cerr << "Glyph cache: " << cache.hits() << " hits, " << cache.misses()
+            << " misses";
+  if (fetches)
+    std::cerr << " (" << cache.hits() * 100 / fetches << "% hit rate)";
+  std::cerr << "; " << cache.evictions() << " evicted" << std::endl;
+  std::cerr << "  " << cache.size() << " glyphs, " << cache.memory() / 1024
+            << " of " << cache.budget() / 1024 << " KiB" << std::endl;
+}
+
+void RLVMInstance::PrintVoicePrefetchStats(SoundSystem& sound) {
+  VoicePrefetcher* prefetcher = sound.voice_prefetcher();
+  if (!prefetcher) {
+    std::cerr << "Voices aren't prefetched on this platform." << std::endl;
+    return;
+  }
+
+  int plays = prefetcher->hits() + prefetcher->misses();
+  std::cerr << "Voice prefetch: " << prefetcher->hits() << " ready, "
+            << prefetcher->misses() << " opened on demand";
+  if (plays)
+    std::cerr << " (" << prefetcher->hits() * 100 / plays << "% hit rate)";
+  std::cerr << std::endl;
+}
+
 void RLVMInstance::DoUserNameCheck(RLMachine& machine) {
   try {
     int encoding = machine.GetProbableEncodingType();
@@ -279,3 +441,34 @@ void RLVMInstance::CheckBadEngine(const boost::filesystem::path& gamerootPath,
     }
   }
 }
+
+// Prints one line for each non-empty bucket of |histogram|.
+static void PrintHistogram(const Histogram& histogram,
+                           const std::string& unit) {
+  for (size_t i = 0; i < histogram.bucket_count(); ++i) {
+    if (!histogram.count(i))
+      continue;
+
+    std::cerr << "  " << std::setw(4) << std::setfill(' ')
+              << histogram.lower_bound(i);
+    if (i + 1 < histogram.bucket_count())
+      std::cerr << " - " << std::setw(3) << histogram.lower_bound(i + 1) - 1;
+    else
+      std::cerr << " +    ";
+    std::cerr << unit << ": " << histogram.count(i);
+    if (histogram.total())
+      std::cerr << " (" << histogram.count(i) * 100 / histogram.total() << "%)";
+    std::cerr << std::endl;
+  }
+}
+
+void RLVMInstance::PrintSchedulerStats(const FrameScheduler& scheduler) {
+  const Histogram& frames = scheduler.frame_times();
+  std::cerr << "Frame times (" << frames.total() << " passes at "
+            << scheduler.target_fps() << " fps target):" << std::endl;
+  PrintHistogram(frames, "ms");
+
+  const Histogram& cpu = scheduler.cpu_usage();
+  std::cerr << "CPU usage (" << cpu.total() << " seconds):" << std::endl;
+  PrintHistogram(cpu, "%");
+}
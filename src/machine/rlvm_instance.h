@@ -28,12 +28,21 @@
 #define SRC_MACHINE_RLVM_INSTANCE_H_
 
 #include <boost/filesystem/operations.hpp>
+#include <cstddef>
 #include <string>
 
+class FrameScheduler;
+class GlyphCache;
+class GraphicsSystem;
 class Platform;
 class RLMachine;
+class SoundSystem;
 class System;
 
+namespace libreallive {
+class Archive;
+}  // namespace libreallive
+
 // The main, cross platform emulator class. Has template methods for
 // implementing platform specific GUI.
 class RLVMInstance {
@@ -41,8 +50,9 @@ class RLVMInstance {
   RLVMInstance();
   virtual ~RLVMInstance();
 
-  // Runs the main emulation loop.
-  void Run(const boost::filesystem::path& gamepath);
+  // Runs the main emulation loop. Returns the process exit status, which is
+  // nonzero when --validate-seen finds scenarios that don't parse.
+  int Run(const boost::filesystem::path& gamepath);
 
   void set_seen_start(int in) { seen_start_ = in; }
   void set_memory() { memory_ = true; }
@@ -54,6 +64,26 @@ class RLVMInstance {
 
   void set_dump_seen(int in) { dump_seen_ = in; }
 
+  void set_scenario_budget(size_t bytes) { scenario_budget_ = bytes; }
+  void set_report_scenario_memory() { report_scenario_memory_ = true; }
+
+  void set_eager_parameter_parsing() { eager_parameter_parsing_ = true; }
+  void set_time_parse() { time_parse_ = true; }
+
+  void set_validate_seen() { validate_seen_ = true; }
+  void set_preload_seen() { preload_seen_ = true; }
+
+  void set_report_image_prefetch() { report_image_prefetch_ = true; }
+
+  void set_surface_cache_mb(int mb) { surface_cache_mb_ = mb; }
+  void set_texture_cache_mb(int mb) { texture_cache_mb_ = mb; }
+  void set_report_surface_cache() { report_surface_cache_ = true; }
+  void set_report_glyph_cache() { report_glyph_cache_ = true; }
+  void set_report_voice_prefetch() { report_voice_prefetch_ = true; }
+
+  void set_target_fps(int fps) { target_fps_ = fps; }
+  void set_report_scheduler() { report_scheduler_ = true; }
+
   // Optionally brings up a file selection dialog to get the game directory. In
   // case this isn't implemented or the user clicks cancel, returns an empty
   // path.
@@ -76,6 +106,24 @@ class RLVMInstance {
       const boost::filesystem::path& gamerootPath,
       const std::string& filename);
 
+  // Prints the approximate size of each parsed scenario still in memory.
+  void PrintScenarioMemory(const libreallive::Archive& archive);
+
+  // Prints how often prefetched images were ready in time.
+  void PrintImagePrefetchStats(GraphicsSystem& graphics);
+
+  // Prints image cache hits, misses and evictions.
+  void PrintSurfaceCacheStats(GraphicsSystem& graphics);
+
+  // Prints how often rendered glyphs were reused.
+  void PrintGlyphCacheStats(const GlyphCache& cache);
+
+  // Prints how often prefetched voices were ready in time.
+  void PrintVoicePrefetchStats(SoundSystem& sound);
+
+  // Prints the main loop's frame time and CPU usage histograms.
+  void PrintSchedulerStats(const FrameScheduler& scheduler);
+
   // Checks to see if the user ran the Japanese version and than installed a
   // fan patch. In this case, we need to warn and let the user reset global
   // data.
@@ -110,6 +158,49 @@ class RLVMInstance {
 
   // Dumps pseudo-kepago of the current seen to stdout and exit if not -1.
   int dump_seen_;
+
+  // How many bytes of parsed scenarios to keep in memory (0 for unlimited).
+  size_t scenario_budget_;
+
+  // Whether we should print how much memory each resident scenario uses on
+  // exit.
+  bool report_scenario_memory_;
+
+  // Whether command parameters are parsed when a scenario is loaded instead of
+  // on first use.
+  bool eager_parameter_parsing_;
+
+  // Parses the whole archive, prints how long that took and exits.
+  bool time_parse_;
+
+  // Parses every SEEN file in parallel, prints a report and exits.
+  bool validate_seen_;
+
+  // Whether to fill the scenario cache on a background thread at startup.
+  bool preload_seen_;
+
+  // Whether we should print image prefetch statistics on exit.
+  bool report_image_prefetch_;
+
+  // Megabytes of decoded images and of their textures to keep cached (-1 for
+  // the default).
+  int surface_cache_mb_;
+  int texture_cache_mb_;
+
+  // Whether we should print image cache statistics on exit.
+  bool report_surface_cache_;
+
+  // Whether we should print glyph cache statistics on exit.
+  bool report_glyph_cache_;
+
+  // Whether we should print voice prefetch statistics on exit.
+  bool report_voice_prefetch_;
+
+  // How many times a second the main loop wakes up to draw and poll input.
+  int target_fps_;
+
+  // Whether we should print frame time and CPU usage histograms on exit.
+  bool report_scheduler_;
 };
 
 #endif  // SRC_MACHINE_RLVM_INSTANCE_H_
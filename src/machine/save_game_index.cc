@@ -0,0 +1,214 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "machine/save_game_index.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/date_time/posix_time/time_serialize.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/serialization/map.hpp>
+
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "machine/serialization.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const char kIndexFilename[] = "saves.idx";
+
+const char kSavePrefix[] = "save";
+const char kSaveSuffix[] = ".sav.gz";
+
+const int CURRENT_INDEX_VERSION = 1;
+
+// Returns the slot |filename| is the save file for, or -1.
+int GetSlotForFilename(const std::string& filename) {
+  const size_t prefix = sizeof(kSavePrefix) - 1;
+  const size_t suffix = sizeof(kSaveSuffix) - 1;
+  if (filename.size() <= prefix + suffix ||
+      !boost::starts_with(filename, kSavePrefix) ||
+      !boost::ends_with(filename, kSaveSuffix))
+    return -1;
+
+  std::string digits =
+      filename.substr(prefix, filename.size() - prefix - suffix);
+  if (digits.find_first_not_of("0123456789") != std::string::npos)
+    return -1;
+
+  return std::stoi(digits);
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// SaveGameIndex
+// -----------------------------------------------------------------------
+
+SaveGameIndex::SaveGameIndex(const fs::path& save_dir)
+    : save_dir_(save_dir), loaded_(false) {}
+
+SaveGameIndex::~SaveGameIndex() {}
+
+// static
+std::string SaveGameIndex::GetSaveFilename(int slot) {
+  std::ostringstream oss;
+  oss << kSavePrefix << std::setw(3) << std::setfill('0') << slot
+      << kSaveSuffix;
+  return oss.str();
+}
+
+bool SaveGameIndex::Exists(int slot) { return GetHeader(slot) != NULL; }
+
+const SaveGameHeader* SaveGameIndex::GetHeader(int slot) {
+  EnsureLoaded();
+
+  Entries::const_iterator it = entries_.find(slot);
+  return it != entries_.end() ? &it->second.header : NULL;
+}
+
+int SaveGameIndex::GetLatestSlot() {
+  EnsureLoaded();
+
+  int latest_slot = -1;
+  std::time_t latest_time = 0;
+  for (Entries::const_iterator it = entries_.begin(); it != entries_.end();
+       ++it) {
+    if (latest_slot == -1 || it->second.mtime > latest_time) {
+      latest_slot = it->first;
+      latest_time = it->second.mtime;
+    }
+  }
+
+  return latest_slot;
+}
+
+void SaveGameIndex::Record(int slot, const SaveGameHeader& header) {
+  EnsureLoaded();
+
+  Entry& entry = entries_[slot];
+  entry.header = header;
+  entry.mtime = fs::last_write_time(save_dir_ / GetSaveFilename(slot));
+
+  WriteIndexFile();
+}
+
+void SaveGameIndex::EnsureLoaded() {
+  if (loaded_)
+    return;
+  loaded_ = true;
+
+  Entries stored = ReadIndexFile();
+  bool changed = false;
+
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(save_dir_, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    int slot = GetSlotForFilename(it->path().filename().string());
+    if (slot == -1)
+      continue;
+
+    std::time_t mtime = fs::last_write_time(it->path());
+    Entries::const_iterator stored_it = stored.find(slot);
+    if (stored_it != stored.end() && stored_it->second.mtime == mtime) {
+      entries_[slot] = stored_it->second;
+      continue;
+    }
+
+    // Saves written while the index was missing, or by something that
+    // doesn't keep it up to date.
+    changed = true;
+    try {
+      fs::ifstream file(it->path(), std::ios::binary);
+      Entry& entry = entries_[slot];
+      entry.header = Serialization::loadHeaderFrom(file);
+      entry.mtime = mtime;
+    }
+    catch (std::exception& e) {
+      std::cerr << "WARNING: Couldn't read the header of " << it->path()
+                << ": " << e.what() << std::endl;
+      entries_.erase(slot);
+    }
+  }
+
+  if (changed || entries_.size() != stored.size())
+    WriteIndexFile();
+}
+
+SaveGameIndex::Entries SaveGameIndex::ReadIndexFile() {
+  Entries entries;
+  fs::ifstream file(save_dir_ / kIndexFilename);
+  if (!file)
+    return entries;
+
+  try {
+    boost::archive::text_iarchive ia(file);
+    int version;
+    ia >> version;
+    if (version == CURRENT_INDEX_VERSION)
+      ia >> entries;
+  }
+  catch (std::exception& e) {
+    // Rebuilt from the save files.
+    entries.clear();
+  }
+
+  return entries;
+}
+
+void SaveGameIndex::WriteIndexFile() {
+  fs::path path = save_dir_ / kIndexFilename;
+  fs::path temporary = save_dir_ / (std::string(kIndexFilename) + ".tmp");
+
+  // The saves themselves are fine if this fails; the index is rebuilt from
+  // them next time.
+  try {
+    fs::ofstream file(temporary);
+    {
+      boost::archive::text_oarchive oa(file);
+      oa << CURRENT_INDEX_VERSION << const_cast<const Entries&>(entries_);
+    }
+    file.close();
+    if (!file) {
+      std::cerr << "WARNING: Couldn't write " << temporary << std::endl;
+      return;
+    }
+
+    fs::rename(temporary, path);
+  }
+  catch (std::exception& e) {
+    std::cerr << "WARNING: Couldn't write " << path << ": " << e.what()
+              << std::endl;
+  }
+}
@@ -0,0 +1,99 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_MACHINE_SAVE_GAME_INDEX_H_
+#define SRC_MACHINE_SAVE_GAME_INDEX_H_
+
+#include <boost/filesystem/path.hpp>
+
+#include <ctime>
+#include <map>
+#include <string>
+
+#include "machine/save_game_header.h"
+
+// The headers of the save games in a save directory, kept in a small index
+// file beside them so that save and load menus don't have to open and
+// decompress every save file to show its title and date.
+//
+// The index file is replaced atomically (written to a temporary file which
+// is renamed over it) every time a save is recorded. The first time it's
+// needed, the index is checked against the save files actually in the
+// directory: saves it doesn't list, or which were modified after it was
+// written, have their headers read from the save file. A missing or
+// unreadable index file is rebuilt this way.
+class SaveGameIndex {
+ public:
+  explicit SaveGameIndex(const boost::filesystem::path& save_dir);
+  ~SaveGameIndex();
+
+  // Returns the name of the save file for |slot|, relative to the save
+  // directory.
+  static std::string GetSaveFilename(int slot);
+
+  // Whether |slot| holds a save game.
+  bool Exists(int slot);
+
+  // Returns the header of the save game in |slot|, or NULL if it's empty.
+  const SaveGameHeader* GetHeader(int slot);
+
+  // Returns the slot most recently saved to, or -1 if there are no saves.
+  int GetLatestSlot();
+
+  // Records that a save game with |header| was just written to |slot|.
+  void Record(int slot, const SaveGameHeader& header);
+
+ private:
+  struct Entry {
+    SaveGameHeader header;
+
+    // When the save file was last written, as of reading |header|.
+    std::time_t mtime;
+
+    template <class Archive>
+    void serialize(Archive& ar, unsigned int version) {
+      ar& header& mtime;
+    }
+  };
+  typedef std::map<int, Entry> Entries;
+
+  // Reads the index file and reconciles it with the save files, the first
+  // time it's called.
+  void EnsureLoaded();
+
+  // Returns the entries in the index file, or nothing if it can't be read.
+  Entries ReadIndexFile();
+
+  void WriteIndexFile();
+
+  boost::filesystem::path save_dir_;
+
+  bool loaded_;
+
+  Entries entries_;
+};  // class SaveGameIndex
+
+#endif  // SRC_MACHINE_SAVE_GAME_INDEX_H_
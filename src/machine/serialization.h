@@ -49,14 +49,48 @@ extern RLMachine* g_current_machine;
 void saveGlobalMemory(RLMachine& machine);
 void saveGlobalMemoryTo(std::ostream& oss, RLMachine& machine);
 
+// Also replays the global memory journal, if there is one, and compacts it
+// into a new snapshot.
 void loadGlobalMemory(RLMachine& machine);
 void loadGlobalMemoryFrom(std::istream& iss, RLMachine& machine);
 
+// Appends the parts of global memory written since the last flush to a
+// journal beside the global memory file, so that read text and global flags
+// survive a crash. Does no I/O when nothing has changed. saveGlobalMemory()
+// compacts the journal into the snapshot.
+void flushGlobalMemoryJournal(RLMachine& machine);
+void flushGlobalMemoryJournalTo(std::ostream& oss, RLMachine& machine);
+
+// Applies each intact record of a journal to |machine|'s global memory, in
+// order, and returns how many there were. Stops at the first torn record.
+int replayGlobalMemoryJournalFrom(std::istream& iss, RLMachine& machine);
+
 boost::filesystem::path buildSaveGameFilename(RLMachine& machine, int slot);
 
+// The formats a save game can be written in. The loading functions detect
+// which one they've been handed, so old saves keep working.
+enum SaveFormat {
+  // A deflated boost text archive. What rlvm has always written.
+  SAVE_FORMAT_TEXT,
+
+  // A versioned header, then a deflated text archive of everything but the
+  // local integer banks, followed by those banks as planes of little endian
+  // bytes instead of as decimal text.
+  SAVE_FORMAT_BINARY
+};
+
+// Also records the save in System::save_game_index().
 void saveGameForSlot(RLMachine& machine, int slot);
-void saveGameTo(std::ostream& oss, RLMachine& machine);
+void saveGameTo(std::ostream& oss,
+                RLMachine& machine,
+                SaveFormat format = SAVE_FORMAT_BINARY);
+void saveGameTo(std::ostream& oss,
+                RLMachine& machine,
+                const SaveGameHeader& header,
+                SaveFormat format);
 
+// Answered from System::save_game_index() when it has the slot, without
+// opening the save file.
 SaveGameHeader loadHeaderForSlot(RLMachine& machine, int slot);
 SaveGameHeader loadHeaderFrom(std::istream& iss);
 
@@ -34,15 +34,25 @@
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
+#include <stdint.h>
+#include <zlib.h>
+#include <algorithm>
+#include <bitset>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "libreallive/alldefs.h"
 #include "libreallive/intmemref.h"
 #include "machine/memory.h"
 #include "machine/rlmachine.h"
@@ -57,6 +67,235 @@
 
 namespace fs = boost::filesystem;
 
+namespace {
+
+// The global memory journal is a sequence of records, one per flush. Each
+// record is a little endian 32-bit payload length, a CRC-32 of the payload,
+// and the payload itself: a JournalRecord written out field by field by
+// WriteJournalRecord(), with every integer little endian. A crash part way
+// through an append leaves a short or mismatched last record, which is where
+// replay stops.
+struct JournalRecord {
+  // A run of consecutive changed words in intG[] or intZ[].
+  struct IntRun {
+    int bank;
+    int start;
+    std::vector<int> values;
+  };
+
+  std::vector<IntRun> ints;
+  std::vector<std::pair<int, std::string>> strings;
+  std::vector<std::pair<int, std::string>> names;
+  std::vector<std::pair<int, int>> kidoku;
+};
+
+// Leads every payload, so that records in some other format are rejected
+// instead of misread.
+const int kJournalRecordMagic = 0x314a4c52;  // "RLJ1"
+
+// Larger than any record global memory can produce; a length beyond this is
+// garbage from a torn write.
+const uint32_t kMaxJournalRecordSize = 64 * 1024 * 1024;
+
+void AppendString(std::string& dest, const std::string& value) {
+  libreallive::append_i32(dest, value.size());
+  dest += value;
+}
+
+void AppendStrings(std::string& dest,
+                   const std::vector<std::pair<int, std::string>>& values) {
+  libreallive::append_i32(dest, values.size());
+  for (const std::pair<int, std::string>& value : values) {
+    libreallive::append_i32(dest, value.first);
+    AppendString(dest, value.second);
+  }
+}
+
+std::string WriteJournalRecord(const JournalRecord& record) {
+  std::string payload;
+  libreallive::append_i32(payload, kJournalRecordMagic);
+
+  libreallive::append_i32(payload, record.ints.size());
+  for (const JournalRecord::IntRun& run : record.ints) {
+    libreallive::append_i32(payload, run.bank);
+    libreallive::append_i32(payload, run.start);
+    libreallive::append_i32(payload, run.values.size());
+    for (int value : run.values)
+      libreallive::append_i32(payload, value);
+  }
+
+  AppendStrings(payload, record.strings);
+  AppendStrings(payload, record.names);
+
+  libreallive::append_i32(payload, record.kidoku.size());
+  for (const std::pair<int, int>& kidoku : record.kidoku) {
+    libreallive::append_i32(payload, kidoku.first);
+    libreallive::append_i32(payload, kidoku.second);
+  }
+
+  return payload;
+}
+
+// Reads back what WriteJournalRecord() wrote. Every read checks that there's
+// enough payload left, so a corrupt record fails to parse instead of reading
+// out of bounds.
+class JournalRecordReader {
+ public:
+  explicit JournalRecordReader(const std::string& payload)
+      : payload_(payload), pos_(0) {}
+
+  bool ReadInt(int* value) {
+    if (payload_.size() - pos_ < 4)
+      return false;
+    *value = libreallive::read_i32(payload_, pos_);
+    pos_ += 4;
+    return true;
+  }
+
+  // Reads a count of items that each take at least |item_size| bytes.
+  bool ReadCount(size_t item_size, size_t* count) {
+    int value;
+    if (!ReadInt(&value) || value < 0 ||
+        static_cast<size_t>(value) > (payload_.size() - pos_) / item_size)
+      return false;
+    *count = value;
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    size_t size;
+    if (!ReadCount(1, &size))
+      return false;
+    value->assign(payload_, pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool ReadStrings(std::vector<std::pair<int, std::string>>* values) {
+    size_t count;
+    if (!ReadCount(8, &count))
+      return false;
+    values->resize(count);
+    for (std::pair<int, std::string>& value : *values) {
+      if (!ReadInt(&value.first) || !ReadString(&value.second))
+        return false;
+    }
+    return true;
+  }
+
+  bool at_end() const { return pos_ == payload_.size(); }
+
+ private:
+  const std::string& payload_;
+  size_t pos_;
+};
+
+bool ReadJournalRecord(const std::string& payload, JournalRecord* record) {
+  JournalRecordReader reader(payload);
+  int magic;
+  if (!reader.ReadInt(&magic) || magic != kJournalRecordMagic)
+    return false;
+
+  size_t count;
+  if (!reader.ReadCount(12, &count))
+    return false;
+  record->ints.resize(count);
+  for (JournalRecord::IntRun& run : record->ints) {
+    if (!reader.ReadInt(&run.bank) || !reader.ReadInt(&run.start) ||
+        !reader.ReadCount(4, &count))
+      return false;
+    // ReadCount() has made sure there's room for all of these.
+    run.values.resize(count);
+    for (int& value : run.values)
+      reader.ReadInt(&value);
+  }
+
+  if (!reader.ReadStrings(&record->strings) ||
+      !reader.ReadStrings(&record->names) || !reader.ReadCount(8, &count))
+    return false;
+  record->kidoku.resize(count);
+  for (std::pair<int, int>& kidoku : record->kidoku) {
+    reader.ReadInt(&kidoku.first);
+    reader.ReadInt(&kidoku.second);
+  }
+
+  return reader.at_end();
+}
+
+void AddIntRuns(int bank,
+                const int* values,
+                const std::bitset<SIZE_OF_MEM_BANK>& dirty,
+                std::vector<JournalRecord::IntRun>* runs) {
+  int i = 0;
+  while (i < SIZE_OF_MEM_BANK) {
+    if (!dirty[i]) {
+      ++i;
+      continue;
+    }
+
+    JournalRecord::IntRun run;
+    run.bank = bank;
+    run.start = i;
+    while (i < SIZE_OF_MEM_BANK && dirty[i])
+      run.values.push_back(values[i++]);
+    runs->push_back(run);
+  }
+}
+
+template <size_t N>
+void AddStrings(const std::string* values,
+                const std::bitset<N>& dirty,
+                std::vector<std::pair<int, std::string>>* out) {
+  for (size_t i = 0; i < N; ++i) {
+    if (dirty[i])
+      out->push_back(std::make_pair(static_cast<int>(i), values[i]));
+  }
+}
+
+// Returns false, having applied nothing, if |record| refers to locations
+// that don't exist.
+bool ApplyJournalRecord(const JournalRecord& record, GlobalMemory& global) {
+  for (const JournalRecord::IntRun& run : record.ints) {
+    if ((run.bank != libreallive::INTG_LOCATION &&
+         run.bank != libreallive::INTZ_LOCATION) ||
+        run.start < 0 ||
+        run.values.size() > static_cast<size_t>(SIZE_OF_MEM_BANK - run.start))
+      return false;
+  }
+  for (const std::pair<int, std::string>& str : record.strings) {
+    if (str.first < 0 || str.first >= SIZE_OF_MEM_BANK)
+      return false;
+  }
+  for (const std::pair<int, std::string>& name : record.names) {
+    if (name.first < 0 || name.first >= SIZE_OF_NAME_BANK)
+      return false;
+  }
+  for (const std::pair<int, int>& kidoku : record.kidoku) {
+    if (kidoku.second < 0)
+      return false;
+  }
+
+  for (const JournalRecord::IntRun& run : record.ints) {
+    int* bank =
+        run.bank == libreallive::INTG_LOCATION ? global.intG : global.intZ;
+    std::copy(run.values.begin(), run.values.end(), bank + run.start);
+  }
+  for (const std::pair<int, std::string>& str : record.strings)
+    global.strM[str.first] = str.second;
+  for (const std::pair<int, std::string>& name : record.names)
+    global.global_names[name.first] = name.second;
+  for (const std::pair<int, int>& kidoku : record.kidoku) {
+    boost::dynamic_bitset<>& bitset = global.kidoku_data[kidoku.first];
+    if (bitset.size() <= static_cast<size_t>(kidoku.second))
+      bitset.resize(kidoku.second + 1, false);
+    bitset[kidoku.second] = true;
+  }
+
+  return true;
+}
+
+}  // namespace
+
 namespace Serialization {
 
 // - Was at 2 was most of rlvm's lifetime.
@@ -70,14 +309,29 @@ fs::path buildGlobalMemoryFilename(RLMachine& machine) {
   return machine.system().GameSaveDirectory() / "global.sav.gz";
 }
 
+fs::path buildGlobalMemoryJournalFilename(RLMachine& machine) {
+  return machine.system().GameSaveDirectory() / "global.journal";
+}
+
 void saveGlobalMemory(RLMachine& machine) {
+  // Flush first, so that the journal never holds a value older than the
+  // snapshot it might be replayed over if we die between replacing the
+  // snapshot and removing the journal.
+  flushGlobalMemoryJournal(machine);
+
   fs::path home = buildGlobalMemoryFilename(machine);
-  fs::ofstream file(home, std::ios::binary);
-  if (!file) {
-    throw rlvm::Exception(_("Could not open global memory file."));
+  fs::path temp = home.string() + ".tmp";
+  {
+    fs::ofstream file(temp, std::ios::binary);
+    if (!file) {
+      throw rlvm::Exception(_("Could not open global memory file."));
+    }
+
+    saveGlobalMemoryTo(file, machine);
   }
 
-  saveGlobalMemoryTo(file, machine);
+  fs::rename(temp, home);
+  fs::remove(buildGlobalMemoryJournalFilename(machine));
 }
 
 void saveGlobalMemoryTo(std::ostream& oss, RLMachine& machine) {
@@ -126,6 +380,17 @@ void loadGlobalMemory(RLMachine& machine) {
                 << save_dir << " to " << dest_save_dir << std::endl;
     }
   }
+
+  // Recover whatever was flushed after the snapshot was written, then fold
+  // it into a new snapshot. That also drops a torn last record, which would
+  // otherwise hide everything appended after it.
+  fs::ifstream journal(buildGlobalMemoryJournalFilename(machine),
+                       std::ios::binary);
+  if (journal) {
+    replayGlobalMemoryJournalFrom(journal, machine);
+    journal.close();
+    saveGlobalMemory(machine);
+  }
 }
 
 void loadGlobalMemoryFrom(std::istream& iss, RLMachine& machine) {
@@ -138,8 +403,9 @@ void loadGlobalMemoryFrom(std::istream& iss, RLMachine& machine) {
   int version;
   ia >> version;
 
-  // Load global memory.
+  // Load global memory. It now matches what's on disk.
   ia >> machine.memory().global();
+  machine.memory().global().changes.Clear();
 
   // When Karmic Koala came out, support for all boost earlier than 1.36 was
   // dropped. For years, I had used boost 1.35 on Ubuntu. It turns out that
@@ -163,4 +429,80 @@ void loadGlobalMemoryFrom(std::istream& iss, RLMachine& machine) {
   }
 }
 
+void flushGlobalMemoryJournal(RLMachine& machine) {
+  if (machine.memory().global().changes.empty())
+    return;
+
+  fs::ofstream file(buildGlobalMemoryJournalFilename(machine),
+                    std::ios::binary | std::ios::app);
+  if (!file) {
+    throw rlvm::Exception(_("Could not open global memory journal."));
+  }
+
+  flushGlobalMemoryJournalTo(file, machine);
+}
+
+void flushGlobalMemoryJournalTo(std::ostream& oss, RLMachine& machine) {
+  GlobalMemory& global = machine.memory().global();
+  GlobalChangeLog& changes = global.changes;
+  if (changes.empty())
+    return;
+
+  JournalRecord record;
+  AddIntRuns(libreallive::INTG_LOCATION, global.intG, changes.intG,
+             &record.ints);
+  AddIntRuns(libreallive::INTZ_LOCATION, global.intZ, changes.intZ,
+             &record.ints);
+  AddStrings(global.strM, changes.strM, &record.strings);
+  AddStrings(global.global_names, changes.global_names, &record.names);
+  record.kidoku = changes.kidoku;
+
+  std::string payload = WriteJournalRecord(record);
+
+  // Written as one block, so a crash tears at most this record.
+  std::string block;
+  libreallive::append_i32(block, payload.size());
+  libreallive::append_i32(
+      block,
+      crc32(0L, reinterpret_cast<const Bytef*>(payload.data()),
+            payload.size()));
+  block += payload;
+  oss.write(block.data(), block.size());
+  oss.flush();
+  if (!oss)
+    throw rlvm::Exception(_("Could not write global memory journal."));
+
+  changes.Clear();
+}
+
+int replayGlobalMemoryJournalFrom(std::istream& iss, RLMachine& machine) {
+  GlobalMemory& global = machine.memory().global();
+  int records = 0;
+  while (true) {
+    std::string header(8, '\0');
+    if (!iss.read(&header[0], header.size()))
+      break;
+    uint32_t size = libreallive::read_i32(header, 0);
+    uint32_t crc = libreallive::read_i32(header, 4);
+    if (size > kMaxJournalRecordSize)
+      break;
+
+    std::string payload(size, '\0');
+    if (!iss.read(&payload[0], payload.size()) ||
+        crc32(0L, reinterpret_cast<const Bytef*>(payload.data()),
+              payload.size()) != crc)
+      break;
+
+    JournalRecord record;
+    if (!ReadJournalRecord(payload, &record))
+      break;
+
+    if (!ApplyJournalRecord(record, global))
+      break;
+    ++records;
+  }
+
+  return records;
+}
+
 }  // namespace Serialization
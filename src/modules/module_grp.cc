@@ -30,6 +30,8 @@
 #include <boost/algorithm/string.hpp>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -189,6 +191,20 @@ void performHideAllTextWindows(RLMachine& machine) {
   }
 }
 
+// Implemented by graphics commands that leave a DC in a state that depends
+// only on their own parameters, so that replaying the graphics stack can skip
+// them when a later command replaces the same DC before anything reads it.
+class DescribesStackEffect {
+ public:
+  virtual ~DescribesStackEffect() {}
+
+  // Fills in the effect of the command that has just run with |parameters|.
+  virtual void DescribeStackEffect(
+      RLMachine& machine,
+      const libreallive::ExpressionPiecesVector& parameters,
+      GraphicsStackCommand& command) const = 0;
+};
+
 // Common code to all the openBg commands.
 void OpenBgPrelude(RLMachine& machine, const std::string& filename) {
   if (!boost::starts_with(filename, "?")) {
@@ -206,10 +222,19 @@ void OpenBgPrelude(RLMachine& machine, const std::string& filename) {
 // allocated thus, although DC 1 is never given a size smaller than the screen
 // resolution. Any previous contents of dc are erased.
 struct allocDC
-    : public RLOpcode<IntConstant_T, IntConstant_T, IntConstant_T> {
+    : public RLOpcode<IntConstant_T, IntConstant_T, IntConstant_T>,
+      public DescribesStackEffect {
   void operator()(RLMachine& machine, int dc, int width, int height) {
     machine.system().graphics().AllocateDC(dc, Size(width, height));
   }
+
+  virtual void DescribeStackEffect(
+      RLMachine& machine,
+      const libreallive::ExpressionPiecesVector& parameters,
+      GraphicsStackCommand& command) const override {
+    command.effect = GraphicsStackCommand::EFFECT_REPLACES_DC;
+    command.dc = parameters[0].GetIntegerValue(machine);
+  }
 };
 
 // Implements op<1:Grp:00031, 0>, fun wipe('DC', 'r', 'g', 'b')
@@ -218,10 +243,19 @@ struct allocDC
 struct wipe : public RLOpcode<IntConstant_T,
                              IntConstant_T,
                              IntConstant_T,
-                             IntConstant_T> {
+                             IntConstant_T>,
+              public DescribesStackEffect {
   void operator()(RLMachine& machine, int dc, int r, int g, int b) {
     machine.system().graphics().GetDC(dc)->Fill(RGBAColour(r, g, b));
   }
+
+  virtual void DescribeStackEffect(
+      RLMachine& machine,
+      const libreallive::ExpressionPiecesVector& parameters,
+      GraphicsStackCommand& command) const override {
+    command.effect = GraphicsStackCommand::EFFECT_FILLS_DC;
+    command.dc = parameters[0].GetIntegerValue(machine);
+  }
 };
 
 struct shake : public RLOpcode<IntConstant_T> {
@@ -250,10 +284,24 @@ struct shake : public RLOpcode<IntConstant_T> {
 // to worry about the difference between grp/rec coordinate space), we write
 // one function for both versions.
 struct load_1
-    : public RLOpcode<StrConstant_T, IntConstant_T, DefaultIntValue_T<255>> {
+    : public RLOpcode<StrConstant_T, IntConstant_T, DefaultIntValue_T<255>>,
+      public DescribesStackEffect {
   bool use_alpha_;
   explicit load_1(bool in) : use_alpha_(in) {}
 
+  // Loading into DC 0 or 1 composites onto what's already there, but any
+  // other DC is reallocated first.
+  virtual void DescribeStackEffect(
+      RLMachine& machine,
+      const libreallive::ExpressionPiecesVector& parameters,
+      GraphicsStackCommand& command) const override {
+    int dc = parameters[1].GetIntegerValue(machine);
+    if (dc != 0 && dc != 1) {
+      command.effect = GraphicsStackCommand::EFFECT_REPLACES_DC;
+      command.dc = dc;
+    }
+  }
+
   void operator()(RLMachine& machine, string filename, int dc, int opacity) {
     GraphicsSystem& graphics = machine.system().graphics();
 
@@ -1180,18 +1228,27 @@ struct multi_dc_0
 // stack"
 class GrpStackAdapter : public RLOp_SpecialCase {
  public:
-  explicit GrpStackAdapter(RLOperation* in) : operation(in) {}
+  explicit GrpStackAdapter(RLOperation* in)
+      : operation(in),
+        describer(dynamic_cast<DescribesStackEffect*>(in)) {}
 
   void operator()(RLMachine& machine, const libreallive::CommandElement& ff) {
     operation->DispatchFunction(machine, ff);
 
     // Record this command's reallive bytecode form onto the graphics stack.
-    machine.system().graphics().AddGraphicsStackCommand(
-        ff.GetSerializedCommand(machine));
+    GraphicsStackCommand command(ff.GetSerializedCommand(machine));
+    if (describer)
+      describer->DescribeStackEffect(machine, ff.GetParsedParameters(),
+                                     command);
+    machine.system().graphics().AddGraphicsStackCommand(command);
   }
 
  private:
   std::unique_ptr<RLOperation> operation;
+
+  // |operation|, if it can say what it does to the DCs. Looked up once here
+  // instead of on every command.
+  const DescribesStackEffect* describer;
 };
 
 }  // namespace
@@ -1439,22 +1496,57 @@ GrpModule::GrpModule() : MappedRLModule(GraphicsStackMappingFun, "Grp", 1, 33) {
 
 // -----------------------------------------------------------------------
 
-void ReplayGraphicsStackCommand(RLMachine& machine,
-                                const std::deque<std::string>& stack) {
+std::vector<bool> FindOverwrittenGraphicsStackCommands(
+    const std::deque<GraphicsStackCommand>& stack) {
+  std::vector<bool> overwritten(stack.size(), false);
+
+  // Walking backwards, the DCs that a later command reallocates before
+  // anything could read them.
+  std::set<int> replaced_later;
+  for (size_t i = stack.size(); i-- > 0;) {
+    const GraphicsStackCommand& command = stack[i];
+    switch (command.effect) {
+      case GraphicsStackCommand::EFFECT_REPLACES_DC:
+        overwritten[i] = replaced_later.count(command.dc) > 0;
+        replaced_later.insert(command.dc);
+        break;
+      case GraphicsStackCommand::EFFECT_FILLS_DC:
+        overwritten[i] = replaced_later.count(command.dc) > 0;
+        break;
+      case GraphicsStackCommand::EFFECT_OTHER:
+        // stackNop() doesn't do anything.
+        if (!command.bytecode.empty())
+          replaced_later.clear();
+        break;
+    }
+  }
+
+  return overwritten;
+}
+
+// -----------------------------------------------------------------------
+
+void ReplayGraphicsStackCommand(
+    RLMachine& machine,
+    const std::deque<GraphicsStackCommand>& stack) {
+  GraphicsSystem& graphics = machine.system().graphics();
+  std::vector<bool> overwritten = FindOverwrittenGraphicsStackCommands(stack);
+
   try {
-    for (auto const& command : stack) {
-      if (command != "") {
-        // Parse the string as a chunk of Reallive bytecode.
-        libreallive::ConstructionData cdata(0, libreallive::pointer_t());
-        libreallive::BytecodeElement* element =
-            libreallive::BytecodeElement::Read(
-                command.c_str(), command.c_str() + command.size(), cdata);
-        libreallive::CommandElement* command =
-            dynamic_cast<libreallive::CommandElement*>(element);
-        if (command) {
-          machine.ExecuteCommand(*command);
-        }
+    for (size_t i = 0; i < stack.size(); ++i) {
+      const GraphicsStackCommand& command = stack[i];
+      if (command.bytecode.empty() || overwritten[i]) {
+        // Running a command puts it back on the stack; keep the ones we don't
+        // run too, so stackSize() and stackTrunc() agree with before the save.
+        graphics.AddGraphicsStackCommand(command);
+        continue;
       }
+
+      // Everything on the stack was recorded from a function call with
+      // constant parameters.
+      libreallive::BytecodeList bytecode;
+      machine.ExecuteCommand(
+          bytecode.command(bytecode.AppendFunction(command.bytecode.c_str())));
     }
   }
   catch (std::exception& e) {
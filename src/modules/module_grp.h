@@ -36,6 +36,7 @@
 #include "machine/rloperation.h"
 
 class GraphicsStackFrame;
+struct GraphicsStackCommand;
 
 // Contains functions for mod<1:33>, Grp.
 class GrpModule : public MappedRLModule {
@@ -49,9 +50,16 @@ RLOperation* GraphicsStackMappingFun(RLOperation* op);
 
 // -----------------------------------------------------------------------
 
-// Replays the new Graphics stack, string representations of reallive bytecode.
-void ReplayGraphicsStackCommand(RLMachine& machine,
-                                const std::deque<std::string>& stack);
+// Returns, for each command on |stack|, whether a later command on it
+// reallocates the DC it draws into before anything could read it.
+std::vector<bool> FindOverwrittenGraphicsStackCommands(
+    const std::deque<GraphicsStackCommand>& stack);
+
+// Replays the new Graphics stack, skipping the commands that
+// FindOverwrittenGraphicsStackCommands() says a later one undoes.
+void ReplayGraphicsStackCommand(
+    RLMachine& machine,
+    const std::deque<GraphicsStackCommand>& stack);
 
 // Replays the serialized graphics stack; this should put the graphics
 // DCs in the same state as they were before the game was saved.
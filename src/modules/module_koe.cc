@@ -68,6 +68,7 @@ void addKoeWait(RLMachine& machine) {
 struct koePlay_0 : public RLOpcode<IntConstant_T> {
   void operator()(RLMachine& machine, int koe) {
     machine.system().sound().KoePlay(koe);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
   }
 };
@@ -75,6 +76,7 @@ struct koePlay_0 : public RLOpcode<IntConstant_T> {
 struct koePlay_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
   void operator()(RLMachine& machine, int koe, int character) {
     machine.system().sound().KoePlay(koe, character);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
   }
 };
@@ -82,6 +84,7 @@ struct koePlay_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
 struct koePlayEx_0 : public RLOpcode<IntConstant_T> {
   void operator()(RLMachine& machine, int koe) {
     machine.system().sound().KoePlay(koe);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
     addKoeWait(machine);
   }
@@ -90,6 +93,7 @@ struct koePlayEx_0 : public RLOpcode<IntConstant_T> {
 struct koePlayEx_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
   void operator()(RLMachine& machine, int koe, int character) {
     machine.system().sound().KoePlay(koe, character);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
     addKoeWait(machine);
   }
@@ -98,6 +102,7 @@ struct koePlayEx_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
 struct koeDoPlayEx_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
   void operator()(RLMachine& machine, int koe, int character) {
     machine.system().sound().KoePlay(koe);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
     addKoeWait(machine);
   }
@@ -106,6 +111,7 @@ struct koeDoPlayEx_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
 struct koePlayExC_0 : public RLOpcode<IntConstant_T> {
   void operator()(RLMachine& machine, int koe) {
     machine.system().sound().KoePlay(koe);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
     addKoeWaitC(machine);
   }
@@ -114,6 +120,7 @@ struct koePlayExC_0 : public RLOpcode<IntConstant_T> {
 struct koePlayExC_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
   void operator()(RLMachine& machine, int koe, int character) {
     machine.system().sound().KoePlay(koe, character);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
     addKoeWait(machine);
   }
@@ -122,6 +129,7 @@ struct koePlayExC_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
 struct koeDoPlayExC_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
   void operator()(RLMachine& machine, int koe, int character) {
     machine.system().sound().KoePlay(koe);
+    machine.PrefetchUpcomingVoices();
     addKoeIcon(machine, koe);
     addKoeWaitC(machine);
   }
@@ -139,6 +147,7 @@ struct koeWaitC : public RLOpcode<> {
 struct koeDoPlay_1 : public RLOpcode<IntConstant_T, IntConstant_T> {
   void operator()(RLMachine& machine, int koe, int character) {
     machine.system().sound().KoePlay(koe);
+    machine.PrefetchUpcomingVoices();
   }
 };
 
@@ -42,7 +42,7 @@ struct stackNop : public RLOpcode<IntConstant_T> {
     GraphicsSystem& sys = machine.system().graphics();
 
     for (int i = 0; i < numberOfNops; ++i) {
-      sys.AddGraphicsStackCommand("");
+      sys.AddGraphicsStackCommand(GraphicsStackCommand());
     }
   }
 };
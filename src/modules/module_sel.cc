@@ -60,7 +60,7 @@ struct Sel_select : public RLOp_SpecialCase {
     if (machine.ShouldSetSelcomSavepoint())
       machine.MarkSavepoint();
 
-    const SelectElement& element = dynamic_cast<const SelectElement&>(ce);
+    const SelectElement element(ce);
     machine.PushLongOperation(new NormalSelectLongOperation(machine, element));
     machine.AdvanceInstructionPointer();
   }
@@ -77,7 +77,7 @@ struct Sel_select_s : public RLOp_SpecialCase {
     if (machine.ShouldSetSelcomSavepoint())
       machine.MarkSavepoint();
 
-    const SelectElement& element = dynamic_cast<const SelectElement&>(ce);
+    const SelectElement element(ce);
     machine.PushLongOperation(
         new ButtonSelectLongOperation(machine, element, 0));
     machine.AdvanceInstructionPointer();
@@ -106,7 +106,7 @@ struct Sel_select_w : public RLOp_SpecialCase {
     if (machine.ShouldSetSelcomSavepoint())
       machine.MarkSavepoint();
 
-    const SelectElement& element = dynamic_cast<const SelectElement&>(ce);
+    const SelectElement element(ce);
 
     // Sometimes the RL bytecode will override DEFAULT_SEL_WINDOW.
     int window = machine.system().gameexe()("DEFAULT_SEL_WINDOW").ToInt(-1);
@@ -27,13 +27,7 @@
 
 #include "modules/module_sys_save.h"
 
-#include <boost/algorithm/string/predicate.hpp>
-#include <boost/filesystem/fstream.hpp>
-#include <boost/filesystem/operations.hpp>
-#include <boost/filesystem/path.hpp>
-
 #include <algorithm>
-#include <limits>
 #include <string>
 
 #include "long_operations/load_game_long_operation.h"
@@ -49,6 +43,7 @@
 #include "machine/rloperation/references.h"
 #include "machine/rloperation/special_t.h"
 #include "machine/save_game_header.h"
+#include "machine/save_game_index.h"
 #include "machine/serialization.h"
 #include "systems/base/colour.h"
 #include "systems/base/surface.h"
@@ -56,9 +51,6 @@
 #include "libreallive/intmemref.h"
 #include "utf8cpp/utf8.h"
 
-using boost::starts_with;
-using boost::ends_with;
-namespace fs = boost::filesystem;
 using std::get;
 
 // -----------------------------------------------------------------------
@@ -67,8 +59,7 @@ namespace {
 
 struct SaveExists : public RLStoreOpcode<IntConstant_T> {
   int operator()(RLMachine& machine, int slot) {
-    fs::path saveFile = Serialization::buildSaveGameFilename(machine, slot);
-    return fs::exists(saveFile) ? 1 : 0;
+    return machine.system().save_game_index().Exists(slot) ? 1 : 0;
   }
 };
 
@@ -267,26 +258,7 @@ struct GetSaveFlag : public RLStoreOpcode<IntConstant_T, GetSaveFlagList> {
 // been saved.
 struct LatestSave : public RLStoreOpcode<> {
   int operator()(RLMachine& machine) {
-    fs::path saveDir = machine.system().GameSaveDirectory();
-    int latestSlot = -1;
-    time_t latestTime = std::numeric_limits<time_t>::min();
-
-    if (fs::exists(saveDir)) {
-      fs::directory_iterator end;
-      for (fs::directory_iterator it(saveDir); it != end; ++it) {
-        string filename = it->path().filename().string();
-        if (starts_with(filename, "save") && ends_with(filename, ".sav.gz")) {
-          time_t mtime = fs::last_write_time(*it);
-
-          if (mtime > latestTime) {
-            latestTime = mtime;
-            latestSlot = std::stoi(filename.substr(4, 3));
-          }
-        }
-      }
-    }
-
-    return latestSlot;
+    return machine.system().save_game_index().GetLatestSlot();
   }
 };
 
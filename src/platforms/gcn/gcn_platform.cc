@@ -46,6 +46,7 @@
 #include "systems/base/system.h"
 #include "systems/base/text_system.h"
 #include "systems/sdl/sdl_event_system.h"
+#include "systems/sdl/sprite_batch.h"
 #include "utilities/exception.h"
 #include "utilities/find_font_file.h"
 #include "libreallive/gameexe.h"
@@ -234,6 +235,10 @@ void GCNPlatform::Run(RLMachine& machine) { guichan_gui_->logic(); }
 // -----------------------------------------------------------------------
 
 void GCNPlatform::render() {
+  // Guichan draws with its own GL state; put the game's pending quads on
+  // screen underneath it first.
+  SpriteBatch::Flush();
+
   try {
     guichan_gui_->draw();
   }
@@ -27,25 +27,22 @@
 #include "platforms/gcn/gcn_save_load_window.h"
 
 #include <boost/date_time/posix_time/time_formatters_limited.hpp>
-#include <boost/filesystem.hpp>
 
 #include <algorithm>
 #include <iomanip>
-#include <limits>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "machine/rlmachine.h"
-#include "machine/serialization.h"
+#include "machine/save_game_index.h"
 #include "platforms/gcn/gcn_button.h"
 #include "platforms/gcn/gcn_platform.h"
 #include "platforms/gcn/gcn_scroll_area.h"
+#include "systems/base/system.h"
 #include "utilities/string_utilities.h"
 
-namespace fs = boost::filesystem;
-
 const int PADDING = 5;
 
 const std::string EVENT_SAVE = "SAVE";
@@ -77,35 +74,25 @@ class SaveGameListModel : public gcn::ListModel {
 
 SaveGameListModel::SaveGameListModel(const std::string& no_data,
                                      RLMachine& machine) {
-  int latestSlot = -1;
-  time_t latestTime = std::numeric_limits<time_t>::min();
+  SaveGameIndex& index = machine.system().save_game_index();
 
   for (int slot = 0; slot < 100; ++slot) {
-    fs::path saveFile = Serialization::buildSaveGameFilename(machine, slot);
-
     std::ostringstream oss;
     oss << "[" << std::setw(3) << std::setfill('0') << slot << "] ";
 
-    bool file_exists = fs::exists(saveFile);
-    if (file_exists) {
-      SaveGameHeader header = Serialization::loadHeaderForSlot(machine, slot);
-      oss << to_simple_string(header.save_time) << " - "
-          << cp932toUTF8(header.title, machine.GetTextEncoding());
-
-      time_t mtime = fs::last_write_time(saveFile);
-
-      if (mtime > latestTime) {
-        latestTime = mtime;
-        latestSlot = slot;
-      }
+    const SaveGameHeader* header = index.GetHeader(slot);
+    if (header) {
+      oss << to_simple_string(header->save_time) << " - "
+          << cp932toUTF8(header->title, machine.GetTextEncoding());
     } else {
       oss << no_data;
     }
 
-    titles_.emplace_back(oss.str(), file_exists);
+    titles_.emplace_back(oss.str(), header != NULL);
   }
 
-  if (latestSlot != -1) {
+  int latestSlot = index.GetLatestSlot();
+  if (latestSlot >= 0 && latestSlot < static_cast<int>(titles_.size())) {
     titles_[latestSlot].first = "[NEW] " + titles_[latestSlot].first;
   }
 }
@@ -366,10 +366,10 @@ BOOL setIncomingFilename(NSString* filename)
     if (gamerootPath.empty())
       exit(-1);
 
-    instance.Run(gamerootPath);
+    int status = instance.Run(gamerootPath);
 
     /* We're done, thank you for playing */
-    exit(0);
+    exit(status);
 }
 @end
 
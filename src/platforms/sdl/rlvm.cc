@@ -98,7 +98,39 @@ int main(int argc, char* argv[]) {
       "undefined-opcodes", "Display a message on undefined opcodes")(
       "count-undefined",
       "On exit, present a summary table about how many times each undefined "
-      "opcode was called")("trace", "Prints opcodes as they are run)");
+      "opcode was called")("trace", "Prints opcodes as they are run)")(
+      "scenario-cache-mb", po::value<int>(),
+      "Limits how many megabytes of parsed SEEN files are kept in memory")(
+      "scenario-memory",
+      "On exit, print how much memory each parsed SEEN file uses")(
+      "eager-parse",
+      "Parse command parameters when a SEEN file is loaded instead of when "
+      "each command first runs")(
+      "time-parse",
+      "Parse every SEEN file and its command parameters, print timings and "
+      "exit")(
+      "validate-seen",
+      "Parse every SEEN file in parallel, report sizes, timings and errors "
+      "and exit")(
+      "preload-seen",
+      "Parse SEEN files on a background thread at startup, up to the "
+      "scenario cache limit")(
+      "image-prefetch-stats",
+      "On exit, print how often prefetched images were ready in time")(
+      "surface-cache-mb", po::value<int>(),
+      "Limits how many megabytes of decoded images are kept in memory")(
+      "texture-cache-mb", po::value<int>(),
+      "Limits how many megabytes of textures cached images keep uploaded")(
+      "surface-cache-stats",
+      "On exit, print image cache hits, misses and evictions")(
+      "glyph-cache-stats",
+      "On exit, print how often rendered glyphs were reused")(
+      "voice-prefetch-stats",
+      "On exit, print how often prefetched voices were ready in time")(
+      "target-fps", po::value<int>(),
+      "How many times a second to redraw and poll input (default 60)")(
+      "scheduler-stats",
+      "On exit, print frame time and CPU usage histograms");
 
   // Declare the final option to be game-root
   po::options_description hidden("Hidden");
@@ -210,13 +242,54 @@ int main(int argc, char* argv[]) {
   if (vm.count("trace"))
     instance.set_tracing();
 
+  if (vm.count("scenario-cache-mb"))
+    instance.set_scenario_budget(
+        static_cast<size_t>(vm["scenario-cache-mb"].as<int>()) * 1024 * 1024);
+
+  if (vm.count("scenario-memory"))
+    instance.set_report_scenario_memory();
+
+  if (vm.count("eager-parse"))
+    instance.set_eager_parameter_parsing();
+
+  if (vm.count("time-parse"))
+    instance.set_time_parse();
+
+  if (vm.count("validate-seen"))
+    instance.set_validate_seen();
+
+  if (vm.count("preload-seen"))
+    instance.set_preload_seen();
+
+  if (vm.count("image-prefetch-stats"))
+    instance.set_report_image_prefetch();
+
+  if (vm.count("surface-cache-mb"))
+    instance.set_surface_cache_mb(vm["surface-cache-mb"].as<int>());
+
+  if (vm.count("texture-cache-mb"))
+    instance.set_texture_cache_mb(vm["texture-cache-mb"].as<int>());
+
+  if (vm.count("surface-cache-stats"))
+    instance.set_report_surface_cache();
+
+  if (vm.count("glyph-cache-stats"))
+    instance.set_report_glyph_cache();
+
+  if (vm.count("voice-prefetch-stats"))
+    instance.set_report_voice_prefetch();
+
+  if (vm.count("target-fps"))
+    instance.set_target_fps(vm["target-fps"].as<int>());
+
+  if (vm.count("scheduler-stats"))
+    instance.set_report_scheduler();
+
   if (vm.count("load-save"))
     instance.set_load_save(vm["load-save"].as<int>());
 
   if (vm.count("font"))
     instance.set_custom_font(vm["font"].as<string>());
 
-  instance.Run(gamerootPath);
-
-  return 0;
+  return instance.Run(gamerootPath);
 }
\ No newline at end of file
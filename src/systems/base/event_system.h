@@ -126,7 +126,8 @@ class EventSystem {
   // started. Used for timing things.
   virtual unsigned int GetTicks() const = 0;
 
-  // Idles the program for a certain amount of time in milliseconds.
+  // Idles the program for a certain amount of time in milliseconds. May
+  // return early if there's input waiting to be handled.
   virtual void Wait(unsigned int milliseconds) const = 0;
 
   // Keyboard and Mouse Input (Reallive style)
@@ -0,0 +1,286 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/g00_decoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "xclannad/file.h"
+
+namespace {
+
+inline int ReadShort(const unsigned char* p) { return p[0] | (p[1] << 8); }
+
+inline uint32_t ReadInt(const unsigned char* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Copies |length| items that start |distance| items back from |out|. When
+// the two ranges overlap, the copy repeats the last |distance| items, so
+// only those go item by item.
+template <typename T>
+inline void CopyBackReference(T* out, size_t distance, size_t length) {
+  const T* from = out - distance;
+  if (distance >= length) {
+    memcpy(out, from, length * sizeof(T));
+  } else {
+    for (size_t i = 0; i < length; ++i)
+      out[i] = from[i];
+  }
+}
+
+// Decodes the LZ variant used by type 1 and type 2 images into at most
+// |dest_size| bytes. Each flag byte describes the next eight items, least
+// significant bit first: a set bit is a literal byte and a clear bit is a
+// back reference of (distance << 4 | (length - 2)). Stops when either side
+// runs out; returns false if the stream refers to data before its start.
+bool DecompressBytes(const unsigned char* src,
+                     const unsigned char* src_end,
+                     unsigned char* dest,
+                     size_t dest_size,
+                     size_t* decoded) {
+  unsigned char* out = dest;
+  unsigned char* out_end = dest + dest_size;
+  while (src < src_end && out < out_end) {
+    int flags = *src++;
+    for (int bit = 0; bit < 8 && src < src_end && out < out_end;
+         ++bit, flags >>= 1) {
+      if (flags & 1) {
+        *out++ = *src++;
+      } else {
+        if (src_end - src < 2)
+          break;
+        int code = ReadShort(src);
+        src += 2;
+
+        size_t distance = code >> 4;
+        size_t length =
+            std::min<size_t>((code & 0x0f) + 2, out_end - out);
+        if (distance > static_cast<size_t>(out - dest))
+          return false;
+        CopyBackReference(out, distance, length);
+        out += length;
+      }
+    }
+  }
+
+  *decoded = out - dest;
+  return true;
+}
+
+// Type 0: the same LZ scheme, but counted in 24-bit pixels, which we write
+// out as opaque 32-bit ones as we go.
+bool DecodeType0(const GRPCONV& conv, uint32_t* pixels) {
+  if (conv.datalen < 13)
+    return false;
+
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(conv.data);
+  const unsigned char* src = data + 13;
+  const unsigned char* src_end = data + conv.datalen;
+  uint32_t* out = pixels;
+  uint32_t* out_end = pixels + static_cast<size_t>(conv.width) * conv.height;
+  while (src < src_end && out < out_end) {
+    int flags = *src++;
+    for (int bit = 0; bit < 8 && src < src_end && out < out_end;
+         ++bit, flags >>= 1) {
+      if (flags & 1) {
+        if (src_end - src < 3)
+          return false;
+        *out++ = src[0] | (src[1] << 8) | (src[2] << 16) | 0xff000000;
+        src += 3;
+      } else {
+        if (src_end - src < 2)
+          return false;
+        int code = ReadShort(src);
+        src += 2;
+
+        size_t distance = code >> 4;
+        size_t length =
+            std::min<size_t>((code & 0x0f) + 1, out_end - out);
+        if (distance > static_cast<size_t>(out - pixels))
+          return false;
+        CopyBackReference(out, distance, length);
+        out += length;
+      }
+    }
+  }
+
+  // A short stream leaves the rest of the image black.
+  std::fill(out, out_end, 0xff000000);
+  return true;
+}
+
+// Type 1: a palette followed by a byte per pixel, all LZ compressed.
+bool DecodeType1(const GRPCONV& conv, uint32_t* pixels) {
+  if (conv.datalen < 13)
+    return false;
+
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(conv.data);
+  size_t count = static_cast<size_t>(conv.width) * conv.height;
+
+  // The header undercounts by one. Don't trust it with more than a full
+  // palette and a byte per pixel.
+  size_t size = std::min<size_t>(static_cast<size_t>(ReadInt(data + 9)) + 1,
+                                 2 + 4 * 0xffff + count);
+  std::unique_ptr<unsigned char[]> buffer(new unsigned char[size]);
+  size_t decoded;
+  if (!DecompressBytes(
+          data + 13, data + conv.datalen, buffer.get(), size, &decoded) ||
+      decoded < 2)
+    return false;
+
+  int palette_length = ReadShort(buffer.get());
+  size_t offset = 2 + static_cast<size_t>(palette_length) * 4;
+  if (offset > decoded)
+    return false;
+
+  uint32_t palette[256] = {0};
+  for (int i = 0; i < std::min(palette_length, 256); ++i)
+    palette[i] = ReadInt(buffer.get() + 2 + i * 4);
+
+  size_t available = std::min(count, decoded - offset);
+  const unsigned char* index = buffer.get() + offset;
+  for (size_t i = 0; i < available; ++i)
+    pixels[i] = palette[index[i]];
+  std::fill(pixels + available, pixels + count, 0);
+  return true;
+}
+
+// Type 2: rectangles of 32-bit pixels, grouped by region, on a transparent
+// canvas.
+bool DecodeType2(const GRPCONV& conv, uint32_t* pixels, bool* has_alpha) {
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(conv.data);
+  const int width = conv.width;
+  const size_t count = static_cast<size_t>(width) * conv.height;
+  std::fill(pixels, pixels + count, 0);
+
+  if (conv.datalen < 17)
+    return false;
+  int region_count = static_cast<int>(ReadInt(data + 5));
+  if (region_count < 0 || region_count > (conv.datalen - 17) / 24)
+    return false;
+
+  // LZ can't expand by more than a factor of eight or so.
+  const unsigned char* head = data + 9 + region_count * 24;
+  size_t size = std::min<size_t>(ReadInt(head + 4),
+                                 static_cast<size_t>(conv.datalen) * 9);
+  std::unique_ptr<unsigned char[]> buffer(new unsigned char[size]);
+  size_t decoded;
+  if (!DecompressBytes(
+          head + 8, data + conv.datalen, buffer.get(), size, &decoded) ||
+      decoded < 4)
+    return false;
+
+  int regions = std::min<int>(region_count, ReadInt(buffer.get()));
+  regions = std::min<int>(regions, conv.region_table.size());
+
+  // The AND of every pixel we copy. If that's opaque, the only translucent
+  // pixels can be ones no block covered.
+  uint32_t opaque = 0xff000000;
+  const unsigned char* buffer_end = buffer.get() + decoded;
+  for (int i = 0; i < regions; ++i) {
+    if (12 + static_cast<size_t>(i) * 8 > decoded)
+      return false;
+    size_t offset = ReadInt(buffer.get() + 4 + i * 8);
+    size_t length = ReadInt(buffer.get() + 8 + i * 8);
+    if (offset > decoded || length > decoded - offset)
+      return false;
+
+    const GRPCONV::REGION& region = conv.region_table[i];
+    const unsigned char* src = buffer.get() + offset + 0x74;
+    const unsigned char* src_end = buffer.get() + offset + length;
+    while (src < src_end) {
+      if (buffer_end - src < 0x5c)
+        return false;
+      size_t x = ReadShort(src) + region.x1;
+      size_t y = ReadShort(src + 2) + region.y1;
+      int block_width = ReadShort(src + 6);
+      int block_height = ReadShort(src + 8);
+      src += 0x5c;
+
+      size_t block_bytes = static_cast<size_t>(block_width) * block_height * 4;
+      if (static_cast<size_t>(buffer_end - src) < block_bytes)
+        return false;
+
+      // Rows that run off the right edge carry on into the next row, as they
+      // do in G00CONV, so only make sure the block ends inside the image.
+      size_t start = y * width + x;
+      if (block_height &&
+          start + (block_height - 1) * static_cast<size_t>(width) +
+                  block_width > count)
+        return false;
+
+      uint32_t* dest = pixels + start;
+      const unsigned char* row = src;
+      for (int j = 0; j < block_height; ++j) {
+        for (int k = 0; k < block_width; ++k) {
+          uint32_t pixel = ReadInt(row + k * 4);
+          opaque &= pixel;
+          dest[k] = pixel;
+        }
+        row += block_width * 4;
+        dest += width;
+      }
+      src += block_bytes;
+    }
+  }
+
+  if ((opaque & 0xff000000) != 0xff000000) {
+    // Strictly, a later block could have covered every translucent pixel
+    // with an opaque one. Reporting alpha then is harmless.
+    *has_alpha = true;
+  } else {
+    *has_alpha = std::find(pixels, pixels + count, 0) != pixels + count;
+  }
+  return true;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+
+bool IsG00(const GRPCONV& conv) {
+  return conv.data && conv.datalen > 0 &&
+         (conv.data[0] == 0 || conv.data[0] == 1 || conv.data[0] == 2);
+}
+
+// -----------------------------------------------------------------------
+
+bool DecodeG00(const GRPCONV& conv, uint32_t* pixels, bool* has_alpha) {
+  *has_alpha = false;
+  switch (conv.data[0]) {
+    case 0:
+      return DecodeType0(conv, pixels);
+    case 1:
+      return DecodeType1(conv, pixels);
+    case 2:
+      return DecodeType2(conv, pixels, has_alpha);
+    default:
+      return false;
+  }
+}
@@ -0,0 +1,60 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_G00_DECODER_H_
+#define SRC_SYSTEMS_BASE_G00_DECODER_H_
+
+#include <cstdint>
+
+class GRPCONV;
+
+// Decodes RealLive's G00 images without the intermediate buffers that
+// xclannad's G00CONV::Read() goes through.
+//
+// GRPCONV::AssignConverter() still parses the header (including the fix ups
+// it makes to type-2 region tables); this replaces only the reading of the
+// pixels. The output is bit for bit what GRPCONV::Read() produces for
+// well formed files: width * height pixels laid out as 0xAARRGGBB.
+//
+// - Type 0 (24-bit) images are LZ decoded straight into the 32-bit output,
+//   instead of into a packed RGB buffer which is then expanded.
+// - Type 1 (paletted) images are LZ decoded into a byte per pixel and
+//   expanded through the palette.
+// - Type 2 (masked, split into rectangles) images are LZ decoded into a
+//   scratch buffer, since their back references can reach into block
+//   headers, and each block is copied out a row at a time. Whether any
+//   pixel is translucent is worked out during that copy.
+
+// Whether |conv| parsed a G00 file.
+bool IsG00(const GRPCONV& conv);
+
+// Decodes the G00 file that |conv| parsed into |pixels|, which must have
+// room for conv.width * conv.height pixels. Sets |has_alpha| to whether any
+// pixel isn't fully opaque; only type 2 images have an alpha channel. Returns
+// false if the file is truncated or otherwise malformed.
+bool DecodeG00(const GRPCONV& conv, uint32_t* pixels, bool* has_alpha);
+
+#endif  // SRC_SYSTEMS_BASE_G00_DECODER_H_
@@ -0,0 +1,79 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/glyph_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "systems/base/pixel_kernels.h"
+#include "systems/base/rect.h"
+
+GlyphCache::GlyphCache(size_t budget) : masks_(budget) {}
+
+GlyphCache::~GlyphCache() {}
+
+std::shared_ptr<const GlyphMask> GlyphCache::Fetch(const std::string& glyph,
+                                                   int size,
+                                                   bool italic) {
+  return masks_.Fetch(Key(glyph, size, italic));
+}
+
+void GlyphCache::Insert(const std::string& glyph,
+                        int size,
+                        bool italic,
+                        std::shared_ptr<const GlyphMask> mask) {
+  masks_.Insert(Key(glyph, size, italic), std::move(mask));
+}
+
+void GlyphCache::Clear() {
+  masks_.Clear();
+}
+
+// -----------------------------------------------------------------------
+
+void CompositeGlyph(const GlyphMask& mask,
+                    uint32_t colour,
+                    const Point& at,
+                    uint8_t* pixels,
+                    int pitch,
+                    const Size& size) {
+  int left = std::max(0, -at.x());
+  int top = std::max(0, -at.y());
+  int right = std::min(mask.width, size.width() - at.x());
+  int bottom = std::min(mask.height, size.height() - at.y());
+  if (left >= right)
+    return;
+
+  for (int y = top; y < bottom; ++y) {
+    uint32_t* row =
+        reinterpret_cast<uint32_t*>(pixels + (at.y() + y) * pitch) + at.x();
+    BlendCoverage(row + left,
+                  mask.coverage.data() + y * mask.width + left,
+                  right - left,
+                  colour);
+  }
+}
@@ -0,0 +1,118 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_GLYPH_CACHE_H_
+#define SRC_SYSTEMS_BASE_GLYPH_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "weighted_lru_cache.hpp"
+
+class Point;
+class Size;
+
+// A rasterized glyph (or string) reduced to how much of each pixel it covers,
+// so that it can be drawn in any colour.
+struct GlyphMask {
+  int width;
+  int height;
+
+  // |width| * |height| coverage values from 0 to 255, row by row.
+  std::vector<uint8_t> coverage;
+};
+
+// Keeps the coverage masks of recently rendered glyphs, so that text made of
+// the same few hundred characters doesn't go through FreeType every time one
+// of them is printed. Masks are keyed by font size and style but not colour;
+// the colour (and the shadow, which is the same mask in another colour) is
+// applied when the mask is composited onto a surface.
+//
+// Entries are weighed by the size of their masks, and the least recently used
+// are dropped once |budget| bytes are exceeded. A budget of zero means
+// unlimited.
+class GlyphCache {
+ public:
+  explicit GlyphCache(size_t budget);
+  ~GlyphCache();
+
+  // Returns the mask of |glyph| at |size| in the given style and marks it as
+  // the most recently used, or NULL if it isn't cached.
+  std::shared_ptr<const GlyphMask> Fetch(const std::string& glyph,
+                                         int size,
+                                         bool italic);
+
+  // Caches |mask| as the most recently used entry and then evicts entries
+  // until we're within budget. The mask just inserted is never evicted.
+  void Insert(const std::string& glyph,
+              int size,
+              bool italic,
+              std::shared_ptr<const GlyphMask> mask);
+
+  void Clear();
+
+  size_t budget() const { return masks_.budget(); }
+  void set_budget(size_t budget) { masks_.set_budget(budget); }
+
+  size_t size() const { return masks_.size(); }
+
+  // Bytes of coverage data held by the cached masks.
+  size_t memory() const { return masks_.weight(); }
+
+  // Calls to Fetch() which found a mask.
+  int hits() const { return masks_.hits(); }
+  // Calls to Fetch() which didn't.
+  int misses() const { return masks_.misses(); }
+  // Masks dropped to stay within the budget.
+  int evictions() const { return masks_.evictions(); }
+
+ private:
+  typedef std::tuple<std::string, int, bool> Key;
+
+  // Weighs masks by the size of their coverage data.
+  struct CoverageSize {
+    size_t operator()(const std::shared_ptr<const GlyphMask>& mask) const {
+      return mask ? mask->coverage.size() : 0;
+    }
+  };
+
+  WeightedLRUCache<Key, std::shared_ptr<const GlyphMask>, CoverageSize> masks_;
+};  // class GlyphCache
+
+// Composites |mask| in |colour| (0xRRGGBB) with its top left corner at |at|
+// onto a 32-bit 0xAARRGGBB image of |size|, whose rows are |pitch| bytes
+// apart. Parts of the mask that fall outside the image are clipped.
+void CompositeGlyph(const GlyphMask& mask,
+                    uint32_t colour,
+                    const Point& at,
+                    uint8_t* pixels,
+                    int pitch,
+                    const Size& size);
+
+#endif  // SRC_SYSTEMS_BASE_GLYPH_CACHE_H_
@@ -89,6 +89,8 @@ const Rect EMPTY_CLIP = Rect(Point(0, 0), Size(-1, -1));
 const boost::shared_ptr<GraphicsObject::Impl> GraphicsObject::s_empty_impl(
     new GraphicsObject::Impl);
 
+unsigned int GraphicsObject::s_render_order_generation = 0;
+
 // -----------------------------------------------------------------------
 // GraphicsObject::TextProperties
 // -----------------------------------------------------------------------
@@ -137,9 +139,13 @@ GraphicsObject::Impl::ButtonProperties::ButtonProperties()
 // -----------------------------------------------------------------------
 // GraphicsObject
 // -----------------------------------------------------------------------
-GraphicsObject::GraphicsObject() : impl_(s_empty_impl) {}
+GraphicsObject::GraphicsObject() : impl_(s_empty_impl) {
+  s_render_order_generation++;
+}
 
 GraphicsObject::GraphicsObject(const GraphicsObject& rhs) : impl_(rhs.impl_) {
+  s_render_order_generation++;
+
   if (rhs.object_data_) {
     object_data_.reset(rhs.object_data_->Clone());
     object_data_->set_owned_by(*this);
@@ -151,11 +157,14 @@ GraphicsObject::GraphicsObject(const GraphicsObject& rhs) : impl_(rhs.impl_) {
     object_mutators_.emplace_back(mutator->Clone());
 }
 
-GraphicsObject::~GraphicsObject() { DeleteObjectMutators(); }
+GraphicsObject::~GraphicsObject() {
+  DeleteObjectMutators();
+  s_render_order_generation++;
+}
 
 GraphicsObject& GraphicsObject::operator=(const GraphicsObject& obj) {
   DeleteObjectMutators();
-  impl_ = obj.impl_;
+  ReplaceImpl(obj.impl_);
 
   if (obj.object_data_) {
     object_data_.reset(obj.object_data_->Clone());
@@ -370,16 +379,22 @@ void GraphicsObject::SetScrollRateY(const int y) {
 }
 
 void GraphicsObject::SetZOrder(const int in) {
+  if (in != impl_->z_order_)
+    s_render_order_generation++;
   MakeImplUnique();
   impl_->z_order_ = in;
 }
 
 void GraphicsObject::SetZLayer(const int in) {
+  if (in != impl_->z_layer_)
+    s_render_order_generation++;
   MakeImplUnique();
   impl_->z_layer_ = in;
 }
 
 void GraphicsObject::SetZDepth(const int in) {
+  if (in != impl_->z_depth_)
+    s_render_order_generation++;
   MakeImplUnique();
   impl_->z_depth_ = in;
 }
@@ -858,6 +873,14 @@ void GraphicsObject::MakeImplUnique() {
   }
 }
 
+void GraphicsObject::ReplaceImpl(const boost::shared_ptr<Impl>& impl) {
+  if (impl->z_order_ != impl_->z_order_ || impl->z_layer_ != impl_->z_layer_ ||
+      impl->z_depth_ != impl_->z_depth_) {
+    s_render_order_generation++;
+  }
+  impl_ = impl;
+}
+
 void GraphicsObject::DeleteObjectMutators() {
   object_mutators_.clear();
 }
@@ -880,13 +903,13 @@ void GraphicsObject::FreeObjectData() {
 }
 
 void GraphicsObject::InitializeParams() {
-  impl_ = s_empty_impl;
+  ReplaceImpl(s_empty_impl);
   DeleteObjectMutators();
 }
 
 void GraphicsObject::FreeDataAndInitializeParams() {
   object_data_.reset();
-  impl_ = s_empty_impl;
+  ReplaceImpl(s_empty_impl);
   DeleteObjectMutators();
 }
 
@@ -910,6 +933,7 @@ void GraphicsObject::Execute(RLMachine& machine) {
 template <class Archive>
 void GraphicsObject::serialize(Archive& ar, unsigned int version) {
   ar& impl_& object_data_;
+  s_render_order_generation++;
 }
 
 // -----------------------------------------------------------------------
@@ -166,6 +166,12 @@ class GraphicsObject {
   int z_depth() const { return impl_->z_depth_; }
   void SetZDepth(const int in);
 
+  // Changes whenever any object is created or destroyed or has its zorder
+  // changed, so that a cached render order can tell when it's stale.
+  static unsigned int render_order_generation() {
+    return s_render_order_generation;
+  }
+
   int GetComputedAlpha() const;
   int raw_alpha() const { return impl_->alpha_; }
   void SetAlpha(const int alpha);
@@ -512,6 +518,11 @@ class GraphicsObject {
   // is cloned on write.
   static const boost::shared_ptr<GraphicsObject::Impl> s_empty_impl;
 
+  static unsigned int s_render_order_generation;
+
+  // Points impl_ at |impl|, noting whether that changed the zorder.
+  void ReplaceImpl(const boost::shared_ptr<Impl>& impl);
+
   // Our actual implementation data
   boost::shared_ptr<GraphicsObject::Impl> impl_;
 
@@ -34,7 +34,9 @@
 #include <boost/serialization/vector.hpp>
 
 #include <algorithm>
+#include <chrono>
 #include <deque>
+#include <exception>
 #include <iostream>
 #include <iterator>
 #include <list>
@@ -83,6 +85,54 @@ using std::vector;
 
 namespace fs = boost::filesystem;
 
+namespace {
+
+// Default budgets for the image cache, in megabytes. Enough for about thirty
+// full screen CGs at 800x600.
+const int kDefaultSurfaceCacheMB = 64;
+const int kDefaultTextureCacheMB = 64;
+
+// Reads a budget given in megabytes out of the Gameexe.
+size_t GetBudgetInBytes(Gameexe& gameexe, const std::string& key, int mb) {
+  return static_cast<size_t>(std::max(0, gameexe(key).ToInt(mb))) << 20;
+}
+
+// Stores |item| in |slot| of a preload array, moving the slot from its old
+// name to the new one in |index|.
+template <typename Item, typename Index>
+void SetPreloadedSlot(LazyArray<Item>& array,
+                      Index& index,
+                      int slot,
+                      const Item& item) {
+  bool existed = slot >= 0 && slot < array.size() && array.exists(slot);
+  Item& entry = array[slot];
+  if (existed) {
+    typename Index::iterator it = index.find(entry.first);
+    if (it != index.end()) {
+      it->second.erase(slot);
+      if (it->second.empty())
+        index.erase(it);
+    }
+  }
+
+  entry = item;
+  index[entry.first].insert(slot);
+}
+
+// Returns the lowest slot of a preload array holding |name|, or NULL.
+template <typename Item, typename Index>
+Item* FindPreloaded(LazyArray<Item>& array,
+                    const Index& index,
+                    const std::string& name) {
+  typename Index::const_iterator it = index.find(name);
+  if (it == index.end())
+    return NULL;
+
+  return &array[*it->second.begin()];
+}
+
+}  // namespace
+
 // -----------------------------------------------------------------------
 // GraphicsSystem::GraphicsObjectSettings
 // -----------------------------------------------------------------------
@@ -196,12 +246,11 @@ struct GraphicsSystem::GraphicsObjectImpl {
   // replaying the new graphics stack format.
   bool use_old_graphics_stack;
 
-  // List of commands in RealLive bytecode to rebuild the graphics stack at the
-  // current moment.
-  std::deque<std::string> graphics_stack;
+  // List of commands to rebuild the graphics stack at the current moment.
+  std::deque<GraphicsStackCommand> graphics_stack;
 
   // Commands to rebuild the graphics stack (at the time of the last savepoint)
-  std::deque<std::string> saved_graphics_stack;
+  std::deque<GraphicsStackCommand> saved_graphics_stack;
 
   // Old style graphics stack implementation.
   std::vector<GraphicsStackFrame> old_graphics_stack;
@@ -238,7 +287,14 @@ GraphicsSystem::GraphicsSystem(System& system, Gameexe& gameexe)
       system_(system),
       preloaded_hik_scripts_(32),
       preloaded_g00_(256),
-      image_cache_(10) {}
+      image_cache_(
+          GetBudgetInBytes(gameexe, "__SURFACE_CACHE_MB",
+                           kDefaultSurfaceCacheMB),
+          GetBudgetInBytes(gameexe, "__TEXTURE_CACHE_MB",
+                           kDefaultTextureCacheMB)),
+      render_order_valid_(false),
+      render_order_generation_(0),
+      render_order_visibility_(0) {}
 
 // -----------------------------------------------------------------------
 
@@ -355,7 +411,8 @@ void GraphicsSystem::SetCursor(int cursor) {
 
 // -----------------------------------------------------------------------
 
-void GraphicsSystem::AddGraphicsStackCommand(const std::string& command) {
+void GraphicsSystem::AddGraphicsStackCommand(
+    const GraphicsStackCommand& command) {
   graphics_object_impl_->graphics_stack.push_back(command);
 
   // RealLive only allows 127 commands to be on the stack so game programmers
@@ -366,6 +423,13 @@ void GraphicsSystem::AddGraphicsStackCommand(const std::string& command) {
 
 // -----------------------------------------------------------------------
 
+const std::deque<GraphicsStackCommand>& GraphicsSystem::graphics_stack()
+    const {
+  return graphics_object_impl_->graphics_stack;
+}
+
+// -----------------------------------------------------------------------
+
 int GraphicsSystem::StackSize() const {
   // I don't think this will ever be accurate in the face of multi()
   // commands. I'm not sure if this matters because the only use of StackSize()
@@ -404,7 +468,7 @@ void GraphicsSystem::ReplayGraphicsStack(RLMachine& machine) {
     ReplayDepricatedGraphicsStackVector(machine, stack_to_replay);
     graphics_object_impl_->use_old_graphics_stack = false;
   } else {
-    std::deque<std::string> stack_to_replay;
+    std::deque<GraphicsStackCommand> stack_to_replay;
     stack_to_replay.swap(graphics_object_impl_->graphics_stack);
 
     machine.set_replaying_graphics_stack(true);
@@ -550,8 +614,8 @@ void GraphicsSystem::Reset() {
 
   ClearAllDCs();
 
-  preloaded_hik_scripts_.Clear();
-  preloaded_g00_.Clear();
+  ClearAllPreloadedHIKScripts();
+  ClearAllPreloadedG00();
   hik_renderer_.reset();
   background_type_ = BACKGROUND_DC0;
 
@@ -590,55 +654,69 @@ void GraphicsSystem::PreloadHIKScript(
   HIKScript* script = new HIKScript(system, file_path);
   script->EnsureUploaded();
 
-  preloaded_hik_scripts_[slot] =
-      std::make_pair(name, std::shared_ptr<HIKScript>(script));
+  SetPreloadedSlot(preloaded_hik_scripts_,
+                   preloaded_hik_index_,
+                   slot,
+                   HIKArrayItem(name, std::shared_ptr<HIKScript>(script)));
 }
 
 void GraphicsSystem::ClearPreloadedHIKScript(int slot) {
-  preloaded_hik_scripts_[slot] =
-      std::make_pair("", std::shared_ptr<HIKScript>());
+  SetPreloadedSlot(preloaded_hik_scripts_,
+                   preloaded_hik_index_,
+                   slot,
+                   HIKArrayItem("", std::shared_ptr<HIKScript>()));
 }
 
 void GraphicsSystem::ClearAllPreloadedHIKScripts() {
   preloaded_hik_scripts_.Clear();
+  preloaded_hik_index_.clear();
 }
 
 std::shared_ptr<HIKScript> GraphicsSystem::GetHIKScript(
     System& system,
     const std::string& name,
     const boost::filesystem::path& file_path) {
-  for (HIKArrayItem& item : preloaded_hik_scripts_) {
-    if (item.first == name)
-      return item.second;
-  }
+  HIKArrayItem* item =
+      FindPreloaded(preloaded_hik_scripts_, preloaded_hik_index_, name);
+  if (item)
+    return item->second;
 
   return std::shared_ptr<HIKScript>(new HIKScript(system, file_path));
 }
 
 void GraphicsSystem::PreloadG00(int slot, const std::string& name) {
   // We first check our implicit cache just in case so we don't load it twice.
-  std::shared_ptr<const Surface> surface = image_cache_.fetch(name);
+  std::shared_ptr<const Surface> surface = image_cache_.Fetch(name);
   if (!surface)
-    surface = LoadSurfaceFromFile(name);
+    surface = LoadSurface(name);
 
   if (surface)
     surface->EnsureUploaded();
 
-  preloaded_g00_[slot] = std::make_pair(name, surface);
+  SetPreloadedSlot(preloaded_g00_,
+                   preloaded_g00_index_,
+                   slot,
+                   G00ArrayItem(name, surface));
 }
 
 void GraphicsSystem::ClearPreloadedG00(int slot) {
-  preloaded_g00_[slot] = std::make_pair("", std::shared_ptr<const Surface>());
+  SetPreloadedSlot(preloaded_g00_,
+                   preloaded_g00_index_,
+                   slot,
+                   G00ArrayItem("", std::shared_ptr<const Surface>()));
 }
 
-void GraphicsSystem::ClearAllPreloadedG00() { preloaded_g00_.Clear(); }
+void GraphicsSystem::ClearAllPreloadedG00() {
+  preloaded_g00_.Clear();
+  preloaded_g00_index_.clear();
+}
 
 std::shared_ptr<const Surface> GraphicsSystem::GetPreloadedG00(
     const std::string& name) {
-  for (G00ArrayItem& item : preloaded_g00_) {
-    if (item.first == name)
-      return item.second;
-  }
+  G00ArrayItem* item =
+      FindPreloaded(preloaded_g00_, preloaded_g00_index_, name);
+  if (item)
+    return item->second;
 
   return std::shared_ptr<const Surface>();
 }
@@ -651,7 +729,13 @@ std::shared_ptr<const Surface> GraphicsSystem::GetSurfaceNamedAndMarkViewed(
   // Record that we viewed this CG.
   cg_table().SetViewed(machine, short_filename);
 
-  return GetSurfaceNamed(short_filename);
+  std::shared_ptr<const Surface> surface = GetSurfaceNamed(short_filename);
+
+  // Scene changes tend to come in runs, so get started on the next ones.
+  if (image_prefetcher_)
+    image_prefetcher_->Prefetch(machine);
+
+  return surface;
 }
 
 // -----------------------------------------------------------------------
@@ -665,16 +749,97 @@ std::shared_ptr<const Surface> GraphicsSystem::GetSurfaceNamed(
     return cached_surface;
 
   // First check to see if this surface is already in our internal cache
-  cached_surface = image_cache_.fetch(short_filename);
-  if (cached_surface)
+  cached_surface = image_cache_.Fetch(short_filename);
+  if (cached_surface) {
+    // Other images may have been drawn, and so uploaded, since the last
+    // insertion.
+    image_cache_.Trim();
+    if (image_prefetcher_)
+      image_prefetcher_->RecordLoad(short_filename,
+                                    ImagePrefetcher::LOAD_READY);
     return cached_surface;
+  }
 
-  std::shared_ptr<const Surface> surface_to_ret =
-      LoadSurfaceFromFile(short_filename);
-  image_cache_.insert(short_filename, surface_to_ret);
+  std::shared_ptr<const Surface> surface_to_ret = LoadSurface(short_filename);
+  image_cache_.Insert(short_filename, surface_to_ret);
   return surface_to_ret;
 }
 
+bool GraphicsSystem::RequestSurface(const std::string& short_filename) {
+  if (!image_decoder_) {
+    GetSurfaceNamed(short_filename);
+    return true;
+  }
+
+  PromoteFinishedDecodes();
+  if (GetPreloadedG00(short_filename) ||
+      image_cache_.Exists(short_filename))
+    return true;
+
+  if (pending_images_.find(short_filename) == pending_images_.end()) {
+    pending_images_[short_filename] =
+        image_decoder_->Decode(GetDecodeTask(short_filename));
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------
+
+std::shared_ptr<const Surface> GraphicsSystem::LoadSurface(
+    const std::string& short_filename) {
+  auto it = pending_images_.find(short_filename);
+  if (it == pending_images_.end()) {
+    if (image_prefetcher_)
+      image_prefetcher_->RecordLoad(short_filename,
+                                    ImagePrefetcher::LOAD_DECODED);
+    return LoadSurfaceFromFile(short_filename);
+  }
+
+  // Waiting on a decode that's already under way beats starting over.
+  ImageDecoder::Result result = it->second;
+  pending_images_.erase(it);
+  if (image_prefetcher_) {
+    bool ready = result.wait_for(std::chrono::seconds(0)) ==
+                 std::future_status::ready;
+    image_prefetcher_->RecordLoad(
+        short_filename,
+        ready ? ImagePrefetcher::LOAD_READY : ImagePrefetcher::LOAD_WAITED);
+  }
+  return BuildSurfaceFromImage(short_filename, *result.get());
+}
+
+void GraphicsSystem::PromoteFinishedDecodes() {
+  for (auto it = pending_images_.begin(); it != pending_images_.end();) {
+    if (it->second.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      ++it;
+      continue;
+    }
+
+    try {
+      image_cache_.Insert(it->first,
+                          BuildSurfaceFromImage(it->first, *it->second.get()));
+    }
+    catch (std::exception& e) {
+      // Leave it for GetSurfaceNamed() to load again and report.
+    }
+    it = pending_images_.erase(it);
+  }
+}
+
+ImageDecoder::Task GraphicsSystem::GetDecodeTask(
+    const std::string& short_filename) {
+  throw rlvm::Exception("This graphics system can't decode images in the "
+                        "background.");
+}
+
+std::shared_ptr<const Surface> GraphicsSystem::BuildSurfaceFromImage(
+    const std::string& short_filename,
+    DecodedImage& image) {
+  throw rlvm::Exception("This graphics system can't decode images in the "
+                        "background.");
+}
+
 // -----------------------------------------------------------------------
 
 void GraphicsSystem::ClearAndPromoteObjects() {
@@ -696,6 +861,8 @@ void GraphicsSystem::ClearAndPromoteObjects() {
       bg->FreeObjectData();
     }
   }
+
+  render_order_valid_ = false;
 }
 
 // -----------------------------------------------------------------------
@@ -809,6 +976,28 @@ void GraphicsSystem::ClearAllDCs() {
 // -----------------------------------------------------------------------
 
 void GraphicsSystem::RenderObjects(std::ostream* tree) {
+  int visibility = (should_show_object1() ? 1 : 0) |
+                   (should_show_object2() ? 2 : 0) |
+                   (should_show_weather() ? 4 : 0) |
+                   (is_interface_hidden() ? 8 : 0);
+  if (!render_order_valid_ ||
+      render_order_generation_ != GraphicsObject::render_order_generation() ||
+      render_order_visibility_ != visibility) {
+    RebuildRenderOrder();
+    render_order_valid_ = true;
+    render_order_generation_ = GraphicsObject::render_order_generation();
+    render_order_visibility_ = visibility;
+  }
+
+  for (ToRenderVec::iterator it = to_render_.begin(); it != to_render_.end();
+       ++it) {
+    get<4>(*it)->Render(get<3>(*it), NULL, tree);
+  }
+}
+
+// -----------------------------------------------------------------------
+
+void GraphicsSystem::RebuildRenderOrder() {
   to_render_.clear();
 
   // Collate all objects that we might want to render.
@@ -833,11 +1022,6 @@ void GraphicsSystem::RenderObjects(std::ostream* tree) {
 
   // Sort by all the ordering values.
   std::sort(to_render_.begin(), to_render_.end());
-
-  for (ToRenderVec::iterator it = to_render_.begin(); it != to_render_.end();
-       ++it) {
-    get<4>(*it)->Render(get<3>(*it), NULL, tree);
-  }
 }
 
 // -----------------------------------------------------------------------
@@ -968,11 +1152,23 @@ void GraphicsSystem::save(Archive& ar, unsigned int version) const {
 template <class Archive>
 void GraphicsSystem::load(Archive& ar, unsigned int version) {
   ar& subtitle_;
-  if (version > 0) {
+  if (version > 1) {
     ar& default_grp_name_;
     ar& default_bgr_name_;
     graphics_object_impl_->use_old_graphics_stack = false;
     ar& graphics_object_impl_->graphics_stack;
+  } else if (version > 0) {
+    // Version 1 saved only the bytecode, so replay can't skip anything.
+    ar& default_grp_name_;
+    ar& default_bgr_name_;
+    graphics_object_impl_->use_old_graphics_stack = false;
+    std::deque<std::string> stack;
+    ar& stack;
+    graphics_object_impl_->graphics_stack.clear();
+    for (const std::string& command : stack) {
+      graphics_object_impl_->graphics_stack.push_back(
+          GraphicsStackCommand(command));
+    }
   } else {
     graphics_object_impl_->use_old_graphics_stack = true;
     ar& graphics_object_impl_->old_graphics_stack;
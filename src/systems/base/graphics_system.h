@@ -33,22 +33,26 @@
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/version.hpp>
 
+#include <deque>
 #include <iosfwd>
 #include <map>
 #include <memory>
 #include <queue>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "systems/base/cgm_table.h"
 #include "systems/base/event_listener.h"
+#include "systems/base/image_decoder.h"
+#include "systems/base/image_prefetcher.h"
 #include "systems/base/rect.h"
+#include "systems/base/surface_cache.h"
 #include "systems/base/tone_curve.h"
 
 #include "utilities/lazy_array.h"
-#include "lru_cache.hpp"
 
 class ColourFilter;
 class Gameexe;
@@ -127,6 +131,39 @@ enum BeginFrameType {
 // Which type of mutually exclusive background should we display?
 enum GraphicsBackgroundType { BACKGROUND_DC0, BACKGROUND_HIK };
 
+// One command on the graphics stack, along with what it does to the DCs as far
+// as replaying the stack needs to know.
+struct GraphicsStackCommand {
+  enum Effect {
+    // Anything at all. Replay has to run the command, and everything before it
+    // that it might depend on.
+    EFFECT_OTHER,
+
+    // Draws over all of |dc| without reading any DC, but keeps its size.
+    EFFECT_FILLS_DC,
+
+    // Reallocates |dc| and draws into it without reading any DC.
+    EFFECT_REPLACES_DC
+  };
+
+  GraphicsStackCommand() : effect(EFFECT_OTHER), dc(-1) {}
+  explicit GraphicsStackCommand(const std::string& in_bytecode)
+      : bytecode(in_bytecode), effect(EFFECT_OTHER), dc(-1) {}
+
+  // The command in RealLive bytecode with its parameters evaluated to
+  // constants. Empty for stackNop().
+  std::string bytecode;
+
+  Effect effect;
+  int dc;
+
+  // boost::serialization support
+  template <class Archive>
+  void serialize(Archive& ar, const unsigned int version) {
+    ar& bytecode& effect& dc;
+  }
+};
+
 // Abstract interface to a graphics system. Specialize this class for
 // each system you plan on running RLVM on. For now, there's only one
 // derived class; SDLGraphicsSystem.
@@ -232,9 +269,12 @@ class GraphicsSystem : public EventListener {
   // that when the game is restored, these graphics commands can be replayed to
   // recreate the screen state.
 
-  // Adds |command|, the serialized form of a bytecode used by calling the
-  // BytecodeElement::data().
-  void AddGraphicsStackCommand(const std::string& command);
+  // Adds |command|, whose bytecode is the serialized form of a bytecode
+  // command given by CommandElement::GetSerializedCommand().
+  void AddGraphicsStackCommand(const GraphicsStackCommand& command);
+
+  // The commands on the stack, oldest first.
+  const std::deque<GraphicsStackCommand>& graphics_stack() const;
 
   // Returns the number of entries in the stack.
   int StackSize() const;
@@ -389,6 +429,19 @@ class GraphicsSystem : public EventListener {
   std::shared_ptr<const Surface> GetSurfaceNamed(
       const std::string& short_filename);
 
+  // Starts decoding |short_filename| in the background unless it's already
+  // loaded or on its way. Never waits on a decode; returns true once
+  // GetSurfaceNamed() will return the image without decoding it, so long
+  // operations can poll this while they wait for their images.
+  bool RequestSurface(const std::string& short_filename);
+
+  // Set when images can be decoded in the background.
+  ImagePrefetcher* image_prefetcher() { return image_prefetcher_.get(); }
+
+  // Recently loaded images. Budgeted by the internal __SURFACE_CACHE_MB and
+  // __TEXTURE_CACHE_MB Gameexe keys.
+  SurfaceCache& surface_cache() { return image_cache_; }
+
   virtual std::shared_ptr<Surface> GetHaikei() = 0;
 
   virtual std::shared_ptr<Surface> GetDC(int dc) = 0;
@@ -404,6 +457,9 @@ class GraphicsSystem : public EventListener {
   // rendered.
   void RenderObjects(std::ostream* tree);
 
+  // Recomputes |to_render_| from the foreground objects.
+  void RebuildRenderOrder();
+
   // Creates rendering data for a graphics object from a G00, PDT or ANM file.
   // Does not deal with GAN files. Those are built with a separate function.
   GraphicsObjectData* BuildObjOfFile(const std::string& filename);
@@ -492,11 +548,34 @@ class GraphicsSystem : public EventListener {
 
   void DrawFrame(std::ostream* tree);
 
+  // Set by subclasses that can decode images off the main thread.
+  std::unique_ptr<ImageDecoder> image_decoder_;
+  std::unique_ptr<ImagePrefetcher> image_prefetcher_;
+
  private:
   // Gets a platform appropriate surface loaded.
   virtual std::shared_ptr<const Surface> LoadSurfaceFromFile(
       const std::string& short_filename) = 0;
 
+  // Returns a task that decodes |short_filename| on |image_decoder_|. Called
+  // on the main thread, so this may look the file up, but the task itself
+  // must not touch the graphics system. Only used when |image_decoder_| is
+  // set.
+  virtual ImageDecoder::Task GetDecodeTask(const std::string& short_filename);
+
+  // Builds a platform surface out of the result of a GetDecodeTask() task.
+  // Each result is only built once, so this may take |image|'s pixels.
+  virtual std::shared_ptr<const Surface> BuildSurfaceFromImage(
+      const std::string& short_filename,
+      DecodedImage& image);
+
+  // Returns the surface for |short_filename| from an in flight decode if
+  // there is one (waiting for it if needed), or LoadSurfaceFromFile().
+  std::shared_ptr<const Surface> LoadSurface(const std::string& short_filename);
+
+  // Moves every finished decode into |image_cache_|.
+  void PromoteFinishedDecodes();
+
   // Default grp name (used in grp* and rec* functions where filename
   // is '???')
   std::string default_grp_name_;
@@ -593,20 +672,28 @@ class GraphicsSystem : public EventListener {
   // Our parent system object.
   System& system_;
 
+  // Maps a preloaded name to the slots holding it. Lookups use the lowest
+  // slot, which is what a front to back scan of the array would find.
+  typedef std::unordered_map<std::string, std::set<int>> PreloadIndex;
+
   // Preloaded HIKScripts.
   typedef std::pair<std::string, std::shared_ptr<HIKScript>> HIKArrayItem;
   typedef LazyArray<HIKArrayItem> HIKScriptList;
   HIKScriptList preloaded_hik_scripts_;
+  PreloadIndex preloaded_hik_index_;
 
   // Preloaded G00 images.
   typedef std::pair<std::string, std::shared_ptr<const Surface>> G00ArrayItem;
   typedef LazyArray<G00ArrayItem> G00ScriptList;
   G00ScriptList preloaded_g00_;
+  PreloadIndex preloaded_g00_index_;
 
-  // LRU cache filled with the last fifteen accessed images.
-  //
-  // This cache's contents are assumed to be immutable.
-  LRUCache<std::string, std::shared_ptr<const Surface>> image_cache_;
+  // Recently accessed images, kept within a memory budget.
+  SurfaceCache image_cache_;
+
+  // Decodes handed to |image_decoder_| that haven't made it into
+  // |image_cache_| yet, so that no file is ever decoded twice at once.
+  std::map<std::string, ImageDecoder::Result> pending_images_;
 
   // Possible background script which drives graphics to the screen.
   std::unique_ptr<HIKRenderer> hik_renderer_;
@@ -620,6 +707,14 @@ class GraphicsSystem : public EventListener {
       ToRenderVec;
   ToRenderVec to_render_;
 
+  // |to_render_| is kept between frames and only rebuilt when an object is
+  // created, destroyed or reordered (as counted by
+  // GraphicsObject::render_order_generation()), when objects are promoted,
+  // or when which object groups are shown changes.
+  bool render_order_valid_;
+  unsigned int render_order_generation_;
+  int render_order_visibility_;
+
   // boost::serialization support
   friend class boost::serialization::access;
 
@@ -634,6 +729,6 @@ class GraphicsSystem : public EventListener {
   BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
-BOOST_CLASS_VERSION(GraphicsSystem, 1)
+BOOST_CLASS_VERSION(GraphicsSystem, 2)
 
 #endif  // SRC_SYSTEMS_BASE_GRAPHICS_SYSTEM_H_
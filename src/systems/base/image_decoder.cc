@@ -0,0 +1,88 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/image_decoder.h"
+
+#include <algorithm>
+#include <utility>
+
+ImageDecoder::ImageDecoder(int thread_count) : shutting_down_(false) {
+  for (int i = 0; i < thread_count; ++i)
+    workers_.emplace_back(&ImageDecoder::Run, this);
+}
+
+ImageDecoder::~ImageDecoder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+    // Anyone still holding a Result for these gets a broken_promise.
+    queue_.clear();
+  }
+  work_available_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+}
+
+// static
+int ImageDecoder::DefaultThreadCount() {
+  int cores = std::thread::hardware_concurrency();
+  return std::min(4, std::max(1, cores - 1));
+}
+
+ImageDecoder::Result ImageDecoder::Decode(Task task) {
+  std::packaged_task<std::shared_ptr<DecodedImage>()> packaged(std::move(task));
+  Result result = packaged.get_future().share();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(packaged));
+  }
+  work_available_.notify_one();
+  return result;
+}
+
+int ImageDecoder::queued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+void ImageDecoder::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_available_.wait(lock,
+                         [&] { return shutting_down_ || !queue_.empty(); });
+    if (shutting_down_)
+      return;
+
+    std::packaged_task<std::shared_ptr<DecodedImage>()> task =
+        std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    task();
+
+    lock.lock();
+  }
+}
@@ -0,0 +1,107 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_IMAGE_DECODER_H_
+#define SRC_SYSTEMS_BASE_IMAGE_DECODER_H_
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "systems/base/surface.h"
+
+// Releases buffers that came from malloc().
+struct MallocDeleter {
+  void operator()(char* data) const { free(data); }
+};
+
+// An image file decoded into 32-bit pixels, waiting to be turned into a
+// platform Surface on the main thread.
+struct DecodedImage {
+  int width;
+  int height;
+
+  // width * height pixels in the order GRPCONV::Read() writes them. Allocated
+  // with malloc() so that a platform surface can adopt the buffer instead of
+  // copying it.
+  std::unique_ptr<char[], MallocDeleter> pixels;
+
+  // Whether any pixel isn't fully opaque.
+  bool has_alpha;
+
+  // The type-2 region table, or a single region covering the image.
+  std::vector<Surface::GrpRect> region_table;
+};
+
+// A small pool of threads that decode image files so that opening a bg or an
+// object doesn't have to read and LZ decode a G00 on the interpreter thread.
+//
+// Decode tasks are handed in by GraphicsSystem, which keeps track of which
+// files are in flight so a file is never decoded twice at once. Tasks must
+// only touch the file they're decoding; everything that touches the graphics
+// system (building the Surface, uploading textures) stays on the main thread.
+class ImageDecoder {
+ public:
+  typedef std::function<std::shared_ptr<DecodedImage>()> Task;
+  typedef std::shared_future<std::shared_ptr<DecodedImage>> Result;
+
+  explicit ImageDecoder(int thread_count);
+  ~ImageDecoder();
+
+  // A thread count that leaves a core for the interpreter.
+  static int DefaultThreadCount();
+
+  // Queues |task|. Exceptions thrown by |task| are rethrown from the
+  // Result's get().
+  Result Decode(Task task);
+
+  // Number of tasks that haven't been started yet.
+  int queued() const;
+
+ private:
+  // Body of each of |workers_|.
+  void Run();
+
+  // Guards everything below.
+  mutable std::mutex mutex_;
+
+  // Signalled when there's more work or when we're shutting down.
+  std::condition_variable work_available_;
+
+  std::deque<std::packaged_task<std::shared_ptr<DecodedImage>()>> queue_;
+
+  bool shutting_down_;
+
+  std::vector<std::thread> workers_;
+};  // class ImageDecoder
+
+#endif  // SRC_SYSTEMS_BASE_IMAGE_DECODER_H_
@@ -0,0 +1,244 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/image_prefetcher.h"
+
+#include <algorithm>
+#include <exception>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "libreallive/bytecode.h"
+#include "libreallive/expression.h"
+#include "machine/rlmachine.h"
+#include "machine/stack_frame.h"
+#include "systems/base/graphics_system.h"
+
+namespace {
+
+// How many bytecode elements past the instruction pointer we're willing to
+// look at, across all the branches we follow.
+const int kMaxScanElements = 1024;
+
+// A range of type 1 opcodes in |module| whose parameter number |param| is
+// the name of an image file.
+struct ImageCommand {
+  int module;
+  int first_opcode;
+  int last_opcode;
+  int param;
+};
+
+const ImageCommand kImageCommands[] = {
+    {33, 50, 51, 0},      // grpLoad, grpMaskLoad
+    {33, 70, 76, 0},      // grpBuffer through grpOpen
+    {33, 1050, 1057, 0},  // recLoad through recMulti
+    {40, 10, 10, 0},      // bgrLoadHaikei
+    {40, 100, 100, 0},    // bgrMulti
+    {71, 1000, 1003, 1},  // objOfFile, objOfFile2, objOfFileGan
+    {71, 1300, 1300, 1},  // objDriftOfFile
+    {71, 1400, 1400, 1},  // objOfDigits
+    {72, 1000, 1003, 1},  // The same for background objects
+    {72, 1300, 1300, 1},
+    {72, 1400, 1400, 1},
+};
+
+// Returns which parameter of |command| names an image, or -1.
+int GetImageParameterIndex(const libreallive::CommandElement& command) {
+  if (command.modtype() != 1)
+    return -1;
+
+  for (const ImageCommand& image_command : kImageCommands) {
+    if (command.module() == image_command.module &&
+        command.opcode() >= image_command.first_opcode &&
+        command.opcode() <= image_command.last_opcode)
+      return image_command.param;
+  }
+  return -1;
+}
+
+// Whether execution never falls through to the element after |command|.
+bool EndsStraightLineCode(const libreallive::CommandElement& command) {
+  if (command.modtype() != 0 || command.module() != 1)
+    return false;
+
+  switch (command.opcode()) {
+    case 0:   // goto
+    case 10:  // ret
+    case 11:  // jump
+    case 13:  // rtl
+    case 17:  // ret_with
+    case 19:  // rtl_with
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Reads parameter |index| of |command| if it's a string constant.
+bool GetConstantStringParameter(RLMachine& machine,
+                                const libreallive::CommandElement& command,
+                                int index,
+                                std::string* value) {
+  if (index >= static_cast<int>(command.GetParamCount()))
+    return false;
+
+  try {
+    std::string param = command.GetParam(index);
+    const char* src = param.c_str();
+    libreallive::ExpressionPiece piece(libreallive::GetData(src));
+    if (piece.IsMemoryReference() ||
+        piece.GetExpressionValueType() != libreallive::ValueTypeString)
+      return false;
+
+    *value = piece.GetStringValue(machine);
+    return true;
+  }
+  catch (std::exception& e) {
+    // Whatever this is, the command will complain about it when it runs.
+    return false;
+  }
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// ImagePrefetcher
+// -----------------------------------------------------------------------
+
+ImagePrefetcher::ImagePrefetcher(GraphicsSystem& graphics)
+    : graphics_(graphics),
+      lookahead_(kDefaultLookahead),
+      hits_(0),
+      late_(0),
+      misses_(0),
+      wasted_(0) {}
+
+ImagePrefetcher::~ImagePrefetcher() {}
+
+// static
+std::vector<std::string> ImagePrefetcher::ScanForImages(
+    RLMachine& machine,
+    const libreallive::BytecodeList& bytecode,
+    libreallive::pointer_t ip,
+    int max_names) {
+  std::vector<std::string> names;
+  const libreallive::pointer_t end = bytecode.size();
+  if (ip >= end)
+    return names;
+
+  // Places to scan from, in the order we found them; the straight line code
+  // after |ip| comes first, then jump targets.
+  std::vector<libreallive::pointer_t> starts;
+  starts.push_back(ip + 1);
+  std::set<libreallive::pointer_t> visited;
+
+  int scanned = 0;
+  for (size_t i = 0; i < starts.size(); ++i) {
+    for (libreallive::pointer_t pos = starts[i];
+         pos < end && scanned < kMaxScanElements &&
+             static_cast<int>(names.size()) < max_names;
+         ++pos, ++scanned) {
+      if (!visited.insert(pos).second)
+        break;
+
+      if (!bytecode[pos].is_command())
+        continue;
+      libreallive::CommandElement command = bytecode.command(pos);
+
+      std::string name;
+      int index = GetImageParameterIndex(command);
+      if (index != -1 &&
+          GetConstantStringParameter(machine, command, index, &name) &&
+          !name.empty() && name != "???" &&
+          std::find(names.begin(), names.end(), name) == names.end()) {
+        names.push_back(name);
+      }
+
+      for (size_t j = 0; j < command.GetPointersCount(); ++j)
+        starts.push_back(command.GetPointer(j));
+
+      if (EndsStraightLineCode(command))
+        break;
+    }
+  }
+
+  return names;
+}
+
+void ImagePrefetcher::Prefetch(RLMachine& machine) {
+  const StackFrame& frame = machine.CurrentBytecodeFrame();
+  std::vector<std::string> names = ScanForImages(
+      machine, frame.scenario->bytecode(), frame.ip, lookahead_);
+
+  std::vector<std::string> wanted;
+  for (const std::string& name : wanted_) {
+    if (std::find(names.begin(), names.end(), name) != names.end())
+      wanted.push_back(name);
+    else
+      wasted_++;
+  }
+
+  for (const std::string& name : names) {
+    if (std::find(wanted.begin(), wanted.end(), name) != wanted.end())
+      continue;
+
+    try {
+      // Only keep track of what we actually had to start decoding.
+      if (!graphics_.RequestSurface(name))
+        wanted.push_back(name);
+    }
+    catch (std::exception& e) {
+      // Not an image we can find (an ANM object, say). Leave it for the
+      // command to report.
+    }
+  }
+
+  wanted_.swap(wanted);
+}
+
+void ImagePrefetcher::RecordLoad(const std::string& short_filename,
+                                 LoadKind kind) {
+  std::vector<std::string>::iterator it =
+      std::find(wanted_.begin(), wanted_.end(), short_filename);
+  if (it != wanted_.end())
+    wanted_.erase(it);
+  else if (kind != LOAD_DECODED)
+    return;
+
+  switch (kind) {
+    case LOAD_READY:
+      hits_++;
+      break;
+    case LOAD_WAITED:
+      late_++;
+      break;
+    case LOAD_DECODED:
+      misses_++;
+      break;
+  }
+}
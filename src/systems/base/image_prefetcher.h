@@ -0,0 +1,108 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_IMAGE_PREFETCHER_H_
+#define SRC_SYSTEMS_BASE_IMAGE_PREFETCHER_H_
+
+#include <string>
+#include <vector>
+
+#include "libreallive/bytecode_fwd.h"
+
+class GraphicsSystem;
+class RLMachine;
+
+// Starts decoding the images that upcoming grp, rec, bgr and obj commands
+// will load, so that scene transitions don't wait on the disk or the G00
+// decoder.
+//
+// Most of those commands take their file name as a string constant, which we
+// can read straight out of the bytecode ahead of the instruction pointer. The
+// names found are handed to GraphicsSystem::RequestSurface(), which decodes
+// them on its ImageDecoder. Lives on the main thread.
+class ImagePrefetcher {
+ public:
+  // How GraphicsSystem came up with a surface it was asked for.
+  enum LoadKind {
+    // It was already decoded.
+    LOAD_READY,
+    // It was being decoded and we had to wait for it.
+    LOAD_WAITED,
+    // Nobody had started decoding it.
+    LOAD_DECODED
+  };
+
+  // The default number of upcoming images to keep decoded.
+  static const int kDefaultLookahead = 4;
+
+  explicit ImagePrefetcher(GraphicsSystem& graphics);
+  ~ImagePrefetcher();
+
+  // Walks |bytecode| after |ip| and returns the first |max_names| distinct
+  // image names taken as string constants by file loading commands. Static
+  // jump targets are followed as well as the straight line code, and only a
+  // bounded number of elements are looked at.
+  static std::vector<std::string> ScanForImages(
+      RLMachine& machine,
+      const libreallive::BytecodeList& bytecode,
+      libreallive::pointer_t ip,
+      int max_names);
+
+  // Scans ahead of |machine|'s instruction pointer and starts decoding what
+  // we find. Decodes we started earlier that are no longer ahead of us and
+  // were never loaded count as wasted.
+  void Prefetch(RLMachine& machine);
+
+  // Called by GraphicsSystem for every image it hands out.
+  void RecordLoad(const std::string& short_filename, LoadKind kind);
+
+  int lookahead() const { return lookahead_; }
+  void set_lookahead(int lookahead) { lookahead_ = lookahead; }
+
+  // Prefetched images that were ready when they were asked for.
+  int hits() const { return hits_; }
+  // Prefetched images that were still being decoded when asked for.
+  int late() const { return late_; }
+  // Images that had to be decoded when asked for.
+  int misses() const { return misses_; }
+  // Prefetched images that were never asked for.
+  int wasted() const { return wasted_; }
+
+ private:
+  GraphicsSystem& graphics_;
+
+  int lookahead_;
+
+  // Names we started decoding that haven't been asked for yet.
+  std::vector<std::string> wanted_;
+
+  int hits_;
+  int late_;
+  int misses_;
+  int wasted_;
+};  // class ImagePrefetcher
+
+#endif  // SRC_SYSTEMS_BASE_IMAGE_PREFETCHER_H_
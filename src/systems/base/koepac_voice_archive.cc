@@ -63,6 +63,7 @@
 #include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <vector>
 
@@ -141,6 +142,61 @@ uint8_t koe_ad_trans_tbl[256] = {
     0x78, 0x87, 0x79, 0x86, 0x7a, 0x85, 0x7b, 0x84, 0x7c, 0x83, 0x7d, 0x82,
     0x7e, 0x81, 0x7f, 0x80};
 
+// Number of stereo frames in each KOEPAC block.
+const int kFramesPerBlock = 0x400;
+
+// Decodes the KOEPAC block of |slen| bytes at |src| into kFramesPerBlock
+// stereo frames at |dest|.
+//
+// This has been mildly adapted from decode_koe in xclannad.
+void DecodeKoeBlock(const uint8_t* src, int slen, uint16_t* dest) {
+  if (slen == 0) {  // do nothing
+    memset(dest, 0, kFramesPerBlock * 4);
+  } else if (slen == 0x400) {  // table 変換
+    for (int j = 0; j < 0x400; j++) {
+      dest[0] = koe_8bit_trans_tbl[*src];
+      dest[1] = koe_8bit_trans_tbl[*src];
+      dest += 2;
+      src++;
+    }
+  } else {  // DPCM
+    uint8_t d = 0;
+    uint16_t o2;
+    int k = 0;
+    for (int j = 0; j < slen && k < 0x800; j++) {
+      uint8_t s = src[j];
+      if ((s + 1) & 0x0f) {
+        d -= koe_ad_trans_tbl[s & 0x0f];
+      } else {
+        uint8_t s2;
+        s >>= 4;
+        s &= 0x0f;
+        s2 = s;
+        s = src[++j];
+        s2 |= (s << 4) & 0xf0;
+        d -= koe_ad_trans_tbl[s2];
+      }
+      o2 = koe_8bit_trans_tbl[d];
+      dest[k] = o2;
+      dest[k + 1] = o2;
+      k += 2;
+      s >>= 4;
+      if ((s + 1) & 0x0f) {
+        d -= koe_ad_trans_tbl[s & 0x0f];
+      } else {
+        d -= koe_ad_trans_tbl[src[++j]];
+      }
+      o2 = koe_8bit_trans_tbl[d];
+      dest[k] = o2;
+      dest[k + 1] = o2;
+      k += 2;
+    }
+    // Short blocks are padded out with silence.
+    if (k < 0x800)
+      memset(dest + k, 0, (0x800 - k) * 2);
+  }
+}
+
 }  // namespace
 
 // -----------------------------------------------------------------------
@@ -152,7 +208,10 @@ class KOEPACVoiceSample : public VoiceSample {
       : stream_(std::fopen(file.native().c_str(), "rb")),
         offset_(offset),
         length_(length),
-        rate_(rate) {}
+        rate_(rate),
+        block_index_(0),
+        block_pos_(kFramesPerBlock),
+        data_pos_(0) {}
 
   virtual ~KOEPACVoiceSample() {
     if (stream_)
@@ -160,93 +219,117 @@ class KOEPACVoiceSample : public VoiceSample {
   }
 
   virtual char* Decode(int* size) override;
+  virtual bool BeginDecode(int* rate, int* channels) override;
+  virtual int DecodeSome(int16_t* buffer, int frames) override;
 
  private:
+  // Reads the per block length table at the start of the sample.
+  void ReadBlockTable();
+
   FILE* stream_;
   int offset_;
   int length_;
   int rate_;
+
+  // Compressed length of each of the |length_| blocks.
+  std::vector<int> block_lengths_;
+
+  // Incremental decoding state: the next block to decode, how many frames
+  // of the current |block_| have been handed out, and where the next block's
+  // data is in |stream_|.
+  int block_index_;
+  int block_pos_;
+  long data_pos_;  // NOLINT
+  std::vector<uint8_t> compressed_;
+  uint16_t block_[kFramesPerBlock * 2];
 };
 
+void KOEPACVoiceSample::ReadBlockTable() {
+  std::unique_ptr<char[]> table(new char[length_ * 2]);
+  fseek(stream_, offset_, 0);
+  fread(table.get(), 2, length_, stream_);
+
+  block_lengths_.resize(length_);
+  for (int i = 0; i < length_; i++)
+    block_lengths_[i] = read_little_endian_short(table.get() + i * 2);
+}
+
 char* KOEPACVoiceSample::Decode(int* dest_len) {
   // This function has been mildly adapted from decode_koe in xclannad. I have
   // modified types so that it works on 64-bit systems and changed malloc()s to
   // new[]s, as the consumer of decode() will delete [] the returned pointer.
 
   // avg32 の声データ展開
-  std::unique_ptr<char[]> table(new char[length_ * 2]);
-  fseek(stream_, offset_, 0);
-  fread(table.get(), 2, length_, stream_);
-
+  ReadBlockTable();
   int all_len = 0;
   for (int i = 0; i < length_; i++)
-    all_len += read_little_endian_short(table.get() + i * 2);
+    all_len += block_lengths_[i];
 
   // データ読み込み
-  uint8_t* src_orig = new uint8_t[all_len];
-  uint16_t* dest_orig = new uint16_t[length_ * 0x1000 + 0x2c];
-
-  if (src_orig == NULL || dest_orig == NULL)
-    return NULL;
-  uint8_t* src = src_orig;
-  fread(src, 1, all_len, stream_);
-  *dest_len = length_ * 0x400 * 4;
+  std::unique_ptr<uint8_t[]> src_orig(new uint8_t[all_len]);
+  fread(src_orig.get(), 1, all_len, stream_);
+
+  *dest_len = length_ * kFramesPerBlock * 4;
+  char* dest_orig = new char[*dest_len + WAV_HEADER_SIZE];
   const char* header = MakeWavHeader(rate_, 2, 2, *dest_len);
-  memcpy(dest_orig, header, 0x2c);
-  uint16_t* dest = dest_orig + 0x2c;
+  memcpy(dest_orig, header, WAV_HEADER_SIZE);
+  char* dest = dest_orig + WAV_HEADER_SIZE;
 
   // 展開
+  const uint8_t* src = src_orig.get();
   for (int i = 0; i < length_; i++) {
-    int slen = read_little_endian_short(table.get() + i * 2);
-    if (slen == 0) {  // do nothing
-      memset(dest, 0, 0x1000);
-      dest += 0x800;
-      src += 0;
-    } else if (slen == 0x400) {  // table 変換
-      for (int j = 0; j < 0x400; j++) {
-        write_little_endian_short((char*)(dest + 0), koe_8bit_trans_tbl[*src]);
-        write_little_endian_short((char*)(dest + 1), koe_8bit_trans_tbl[*src]);
-        dest += 2;
-        src++;
-      }
-    } else {  // DPCM
-      uint8_t d = 0;
-      uint16_t o2;
-      for (int j = 0, k = 0; j < slen && k < 0x800; j++) {
-        uint8_t s = src[j];
-        if ((s + 1) & 0x0f) {
-          d -= koe_ad_trans_tbl[s & 0x0f];
-        } else {
-          uint8_t s2;
-          s >>= 4;
-          s &= 0x0f;
-          s2 = s;
-          s = src[++j];
-          s2 |= (s << 4) & 0xf0;
-          d -= koe_ad_trans_tbl[s2];
-        }
-        o2 = koe_8bit_trans_tbl[d];
-        write_little_endian_short((char*)(dest + k), o2);
-        write_little_endian_short((char*)(dest + k + 1), o2);
-        k += 2;
-        s >>= 4;
-        if ((s + 1) & 0x0f) {
-          d -= koe_ad_trans_tbl[s & 0x0f];
-        } else {
-          d -= koe_ad_trans_tbl[src[++j]];
-        }
-        o2 = koe_8bit_trans_tbl[d];
-        write_little_endian_short((char*)(dest + k), o2);
-        write_little_endian_short((char*)(dest + k + 1), o2);
-        k += 2;
-      }
-      dest += 0x800;
-      src += slen;
+    DecodeKoeBlock(src, block_lengths_[i], block_);
+    for (int j = 0; j < kFramesPerBlock * 2; ++j)
+      write_little_endian_short(dest + j * 2, block_[j]);
+    dest += kFramesPerBlock * 4;
+    src += block_lengths_[i];
+  }
+
+  return dest_orig;
+}
+
+bool KOEPACVoiceSample::BeginDecode(int* rate, int* channels) {
+  if (!stream_)
+    return false;
+
+  ReadBlockTable();
+  data_pos_ = ftell(stream_);
+  block_index_ = 0;
+  block_pos_ = kFramesPerBlock;
+
+  *rate = rate_;
+  *channels = 2;
+  return true;
+}
+
+int KOEPACVoiceSample::DecodeSome(int16_t* buffer, int frames) {
+  int written = 0;
+  while (written < frames) {
+    if (block_pos_ == kFramesPerBlock) {
+      if (block_index_ >= length_)
+        break;
+
+      // Each block is tiny, so read them one at a time instead of holding
+      // the whole compressed sample. The DPCM decoder can look one byte past
+      // the end of a block.
+      int slen = block_lengths_[block_index_];
+      compressed_.assign(slen + 1, 0);
+      fseek(stream_, data_pos_, 0);
+      fread(compressed_.data(), 1, slen, stream_);
+      data_pos_ += slen;
+      DecodeKoeBlock(compressed_.data(), slen, block_);
+
+      block_index_++;
+      block_pos_ = 0;
     }
+
+    int count = std::min(frames - written, kFramesPerBlock - block_pos_);
+    memcpy(buffer + written * 2, block_ + block_pos_ * 2, count * 4);
+    block_pos_ += count;
+    written += count;
   }
-  delete[] src_orig;
 
-  return (char*)dest_orig;
+  return written;
 }
 
 // -----------------------------------------------------------------------
@@ -26,7 +26,9 @@
 
 #include "systems/base/nwk_voice_archive.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <memory>
 
 #include "utilities/exception.h"
 #include "xclannad/endian.hpp"
@@ -45,11 +47,20 @@ class NWKVoiceSample : public VoiceSample {
 
   // Overridden from VoiceSample:
   virtual char* Decode(int* size) override;
+  virtual bool BeginDecode(int* rate, int* channels) override;
+  virtual int DecodeSome(int16_t* buffer, int frames) override;
 
  private:
   FILE* stream_;
   int offset_;
   int length_;
+
+  // Incremental decoding state. |block_| holds the last decoded NWA block, of
+  // which |block_pos_| bytes have been handed out.
+  std::unique_ptr<NWAKoeStream> nwa_;
+  std::unique_ptr<char[]> block_;
+  int block_pos_;
+  int block_len_;
 };
 
 NWKVoiceSample::NWKVoiceSample(boost::filesystem::path file,
@@ -57,7 +68,9 @@ NWKVoiceSample::NWKVoiceSample(boost::filesystem::path file,
                                int length)
     : stream_(std::fopen(file.native().c_str(), "rb")),
       offset_(offset),
-      length_(length) {}
+      length_(length),
+      block_pos_(0),
+      block_len_(0) {}
 
 NWKVoiceSample::~NWKVoiceSample() {
   if (stream_)
@@ -65,10 +78,57 @@ NWKVoiceSample::~NWKVoiceSample() {
 }
 
 char* NWKVoiceSample::Decode(int* size) {
+  nwa_.reset();
+
   // Defined in nwatowav.cc
   return decode_koe_nwa(stream_, offset_, length_, size);
 }
 
+bool NWKVoiceSample::BeginDecode(int* rate, int* channels) {
+  nwa_.reset(new NWAKoeStream(stream_, offset_, length_));
+
+  // Voice is always 16-bit in practice; let the generic path deal with
+  // anything else.
+  if (!nwa_->valid || nwa_->bps != 16) {
+    nwa_.reset();
+    return VoiceSample::BeginDecode(rate, channels);
+  }
+
+  block_.reset(new char[nwa_->BlockLength()]);
+  block_pos_ = block_len_ = 0;
+  *rate = nwa_->freq;
+  *channels = nwa_->channels;
+  return true;
+}
+
+int NWKVoiceSample::DecodeSome(int16_t* buffer, int frames) {
+  if (!nwa_)
+    return VoiceSample::DecodeSome(buffer, frames);
+
+  int frame_size = nwa_->channels * 2;
+  int written = 0;
+  while (written < frames) {
+    if (block_pos_ + frame_size > block_len_) {
+      block_len_ = nwa_->DecodeBlock(block_.get());
+      block_pos_ = 0;
+      if (block_len_ == 0)
+        break;
+    }
+
+    int count =
+        std::min(frames - written, (block_len_ - block_pos_) / frame_size);
+    int16_t* out = buffer + written * nwa_->channels;
+    for (int i = 0; i < count * nwa_->channels; ++i) {
+      out[i] = static_cast<int16_t>(
+          read_little_endian_short(block_.get() + block_pos_ + i * 2));
+    }
+    block_pos_ += count * frame_size;
+    written += count;
+  }
+
+  return written;
+}
+
 }  // namespace
 
 NWKVoiceArchive::NWKVoiceArchive(fs::path file, int file_no)
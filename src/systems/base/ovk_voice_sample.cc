@@ -61,6 +61,7 @@
 
 #include <cstdio>
 #include <cstring>
+#include <iostream>
 #include <string>
 #include <sstream>
 
@@ -114,7 +115,11 @@ std::string oggErrorCodeToString(int code) {
 }  // namespace
 
 OVKVoiceSample::OVKVoiceSample(fs::path file)
-    : stream_(std::fopen(file.native().c_str(), "rb")), offset_(0), length_(0) {
+    : stream_(std::fopen(file.native().c_str(), "rb")),
+      offset_(0),
+      length_(0),
+      vf_open_(false),
+      channels_(0) {
   std::fseek(stream_, 0, SEEK_END);
   length_ = ftell(stream_);
   std::fseek(stream_, 0, SEEK_SET);
@@ -123,25 +128,23 @@ OVKVoiceSample::OVKVoiceSample(fs::path file)
 OVKVoiceSample::OVKVoiceSample(fs::path file, int offset, int length)
     : stream_(std::fopen(file.native().c_str(), "rb")),
       offset_(offset),
-      length_(length) {}
+      length_(length),
+      vf_open_(false),
+      channels_(0) {}
 
 OVKVoiceSample::~OVKVoiceSample() {
+  EndDecode();
   if (stream_)
     fclose(stream_);
 }
 
 char* OVKVoiceSample::Decode(int* size) {
   // This function has been mildly adapted from decode_koe_ogg in xclannad.
+  EndDecode();
   fseek(stream_, offset_, 0);
 
-  ov_callbacks callback;
-  callback.read_func = (size_t (*)(void*, size_t, size_t, void*))ogg_readfunc;
-  callback.seek_func = (int (*)(void*, ogg_int64_t, int))ogg_seekfunc;
-  callback.close_func = NULL;
-  callback.tell_func = (long int (*)(void*))ogg_tellfunc;  // NOLINT
-
   OggVorbis_File vf;
-  int r = ov_open_callbacks(this, &vf, NULL, 0, callback);
+  int r = ov_open_callbacks(this, &vf, NULL, 0, MakeCallbacks());
   if (r != 0) {
     ostringstream oss;
     oss << "Ogg stream error in OVKVoiceSample::decode: "
@@ -192,6 +195,65 @@ char* OVKVoiceSample::Decode(int* size) {
   return buffer;
 }
 
+bool OVKVoiceSample::BeginDecode(int* rate, int* channels) {
+  EndDecode();
+  fseek(stream_, offset_, 0);
+
+  int r = ov_open_callbacks(this, &vf_, NULL, 0, MakeCallbacks());
+  if (r != 0) {
+    std::cerr << "Ogg stream error in OVKVoiceSample::BeginDecode: "
+              << oggErrorCodeToString(r) << std::endl;
+    return false;
+  }
+  vf_open_ = true;
+
+  vorbis_info* vinfo = ov_info(&vf_, 0);
+  *rate = vinfo->rate;
+  *channels = channels_ = vinfo->channels;
+  return true;
+}
+
+int OVKVoiceSample::DecodeSome(int16_t* buffer, int frames) {
+  if (!vf_open_)
+    return 0;
+
+  static const uint16_t endian_probe = 1;
+  const int big_endian = *reinterpret_cast<const char*>(&endian_probe) == 0;
+
+  // ov_read() stops at packet boundaries, so keep asking until either the
+  // caller's buffer is full or the stream ends.
+  char* out = reinterpret_cast<char*>(buffer);
+  int wanted = frames * channels_ * 2;
+  int have = 0;
+  while (have < wanted) {
+    long r = ov_read(&vf_, out + have, wanted - have, big_endian, 2, 1, 0);
+    if (r <= 0)
+      break;
+    have += r;
+  }
+
+  if (have == 0)
+    EndDecode();
+  return have / (channels_ * 2);
+}
+
+// static
+ov_callbacks OVKVoiceSample::MakeCallbacks() {
+  ov_callbacks callback;
+  callback.read_func = (size_t (*)(void*, size_t, size_t, void*))ogg_readfunc;
+  callback.seek_func = (int (*)(void*, ogg_int64_t, int))ogg_seekfunc;
+  callback.close_func = NULL;
+  callback.tell_func = (long int (*)(void*))ogg_tellfunc;  // NOLINT
+  return callback;
+}
+
+void OVKVoiceSample::EndDecode() {
+  if (vf_open_) {
+    ov_clear(&vf_);
+    vf_open_ = false;
+  }
+}
+
 size_t OVKVoiceSample::ogg_readfunc(void* ptr,
                                     size_t size,
                                     size_t nmemb,
@@ -43,8 +43,16 @@ class OVKVoiceSample : public VoiceSample {
 
   // Overridden from VoiceSample:
   virtual char* Decode(int* size) override;
+  virtual bool BeginDecode(int* rate, int* channels) override;
+  virtual int DecodeSome(int16_t* buffer, int frames) override;
 
  private:
+  // Fills in the callbacks that route libvorbisfile through |stream_|.
+  static ov_callbacks MakeCallbacks();
+
+  // Closes |vf_| if BeginDecode() opened it.
+  void EndDecode();
+
   static size_t ogg_readfunc(void* ptr,
                              size_t size,
                              size_t nmemb,
@@ -57,6 +65,11 @@ class OVKVoiceSample : public VoiceSample {
   FILE* stream_;
   int offset_;
   int length_;
+
+  // The vorbis stream used by the incremental decoding interface.
+  OggVorbis_File vf_;
+  bool vf_open_;
+  int channels_;
 };
 
 #endif  // SRC_SYSTEMS_BASE_OVK_VOICE_SAMPLE_H_
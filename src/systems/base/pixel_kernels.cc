@@ -0,0 +1,217 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/pixel_kernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "systems/base/colour.h"
+#include "utilities/graphics.h"
+
+namespace {
+
+const uint32_t kAlphaMask = 0xff000000;
+
+// The portable versions handle two pixels at a time in a 64-bit word. Nothing
+// below carries from one pixel's half of the word into the other's.
+const uint64_t kColourMask64 = 0x00ffffff00ffffffull;
+const uint64_t kLowByte64 = 0x000000ff000000ffull;
+
+inline uint64_t Load64(const uint32_t* pixels) {
+  uint64_t word;
+  memcpy(&word, pixels, sizeof(word));
+  return word;
+}
+
+inline void Store64(uint32_t* pixels, uint64_t word) {
+  memcpy(pixels, &word, sizeof(word));
+}
+
+// MonoChannel() works out 0.3r + 0.59g + 0.11b in floating point and
+// truncates, which is exactly (30r + 59g + 11b) / 100. For sums up to
+// 255 * 100, multiplying by 41944 and shifting right by 22 divides by 100,
+// and the product still fits in 32 bits.
+const uint32_t kDivideBy100 = 41944;
+const int kDivideBy100Shift = 22;
+
+inline uint32_t Grey(uint32_t pixel) {
+  uint32_t sum = ((pixel >> 16) & 0xff) * 30 + ((pixel >> 8) & 0xff) * 59 +
+                 (pixel & 0xff) * 11;
+  return (pixel & kAlphaMask) | (sum / 100) * 0x010101;
+}
+
+inline uint64_t Grey64(uint64_t pixels) {
+  uint64_t sum = ((pixels >> 16) & kLowByte64) * 30 +
+                 ((pixels >> 8) & kLowByte64) * 59 + (pixels & kLowByte64) * 11;
+  uint64_t grey = ((sum * kDivideBy100) >> kDivideBy100Shift) & kLowByte64;
+  return (pixels & ~kColourMask64) | grey * 0x010101;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+
+int MonoChannel(int r, int g, int b) {
+  float grayscale = 0.3 * r + 0.59 * g + 0.11 * b;
+  Clamp(grayscale, 0, 255);
+  return static_cast<int>(grayscale);
+}
+
+// -----------------------------------------------------------------------
+
+int ApplyColourChannel(int in_colour, int surface_colour) {
+  if (in_colour > 0) {
+    return 255 -
+           ((static_cast<float>((255 - in_colour) * (255 - surface_colour)) /
+             (255 * 255)) *
+            255);
+  } else if (in_colour < 0) {
+    return (static_cast<float>(abs(in_colour) * surface_colour) /
+            (255 * 255)) *
+           255;
+  } else {
+    return surface_colour;
+  }
+}
+
+// -----------------------------------------------------------------------
+
+void InvertPixels(uint32_t* pixels, int count) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i colour_mask = _mm_set1_epi32(~kAlphaMask);
+  for (; i + 4 <= count; i += 4) {
+    __m128i* block = reinterpret_cast<__m128i*>(pixels + i);
+    _mm_storeu_si128(block,
+                     _mm_xor_si128(_mm_loadu_si128(block), colour_mask));
+  }
+#endif
+  for (; i + 2 <= count; i += 2)
+    Store64(pixels + i, Load64(pixels + i) ^ kColourMask64);
+  for (; i < count; ++i)
+    pixels[i] ^= ~kAlphaMask;
+}
+
+// -----------------------------------------------------------------------
+
+void MonoPixels(uint32_t* pixels, int count) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i low_byte = _mm_set1_epi32(0xff);
+  const __m128i alpha_mask = _mm_set1_epi32(kAlphaMask);
+  const __m128i red_weight = _mm_set1_epi32(30);
+  const __m128i green_weight = _mm_set1_epi32(59);
+  const __m128i blue_weight = _mm_set1_epi32(11);
+  const __m128i divide = _mm_set1_epi32(kDivideBy100);
+  for (; i + 4 <= count; i += 4) {
+    __m128i* block = reinterpret_cast<__m128i*>(pixels + i);
+    __m128i pixel = _mm_loadu_si128(block);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(pixel, 16), low_byte);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixel, 8), low_byte);
+    __m128i b = _mm_and_si128(pixel, low_byte);
+
+    // The top half of every 32-bit lane is zero, so 16-bit multiplies give
+    // the same answer as 32-bit ones would.
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, red_weight),
+                                              _mm_mullo_epi16(g, green_weight)),
+                                _mm_mullo_epi16(b, blue_weight));
+    __m128i grey = _mm_srli_epi32(_mm_mulhi_epu16(sum, divide),
+                                  kDivideBy100Shift - 16);
+
+    __m128i out = _mm_or_si128(
+        _mm_or_si128(grey, _mm_slli_epi32(grey, 8)),
+        _mm_or_si128(_mm_slli_epi32(grey, 16),
+                     _mm_and_si128(pixel, alpha_mask)));
+    _mm_storeu_si128(block, out);
+  }
+#endif
+  for (; i + 2 <= count; i += 2)
+    Store64(pixels + i, Grey64(Load64(pixels + i)));
+  for (; i < count; ++i)
+    pixels[i] = Grey(pixels[i]);
+}
+
+// -----------------------------------------------------------------------
+
+void MapPixels(uint32_t* pixels, int count, const ToneCurveRGBMap& map) {
+  const unsigned char* red = map[0].data();
+  const unsigned char* green = map[1].data();
+  const unsigned char* blue = map[2].data();
+  for (int i = 0; i < count; ++i) {
+    uint32_t pixel = pixels[i];
+    pixels[i] = (pixel & kAlphaMask) | (red[(pixel >> 16) & 0xff] << 16) |
+                (green[(pixel >> 8) & 0xff] << 8) | blue[pixel & 0xff];
+  }
+}
+
+// -----------------------------------------------------------------------
+
+ToneCurveRGBMap BuildApplyColourMap(const RGBColour& colour) {
+  ToneCurveRGBMap map;
+  for (int i = 0; i < 256; ++i) {
+    map[0][i] = ApplyColourChannel(colour.r(), i);
+    map[1][i] = ApplyColourChannel(colour.g(), i);
+    map[2][i] = ApplyColourChannel(colour.b(), i);
+  }
+  return map;
+}
+
+// -----------------------------------------------------------------------
+
+void BlendCoverage(uint32_t* pixels,
+                   const uint8_t* coverage,
+                   int count,
+                   uint32_t colour) {
+  const int red = (colour >> 16) & 0xff;
+  const int green = (colour >> 8) & 0xff;
+  const int blue = colour & 0xff;
+  const uint32_t opaque = (colour & 0xffffff) | kAlphaMask;
+  for (int i = 0; i < count; ++i) {
+    int alpha = coverage[i];
+    if (alpha == 0)
+      continue;
+
+    uint32_t pixel = pixels[i];
+    int dest_alpha = pixel >> 24;
+    if (alpha == 255 || dest_alpha == 0) {
+      // pygame's blend reduces to a plain copy in both cases.
+      pixels[i] = alpha == 255 ? opaque : (opaque & 0xffffff) | (alpha << 24);
+      continue;
+    }
+
+    int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+    r = ((r << 8) + (red - r) * alpha + red) >> 8;
+    g = ((g << 8) + (green - g) * alpha + green) >> 8;
+    b = ((b << 8) + (blue - b) * alpha + blue) >> 8;
+    dest_alpha = alpha + dest_alpha - (alpha * dest_alpha) / 255;
+    pixels[i] = (dest_alpha << 24) | (r << 16) | (g << 8) | b;
+  }
+}
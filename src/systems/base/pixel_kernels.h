@@ -0,0 +1,70 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_PIXEL_KERNELS_H_
+#define SRC_SYSTEMS_BASE_PIXEL_KERNELS_H_
+
+#include <cstdint>
+
+#include "systems/base/tone_curve.h"
+
+class RGBColour;
+
+// Colour transforms used by grpMono, grpInvert, grpColour and friends.
+//
+// The *Pixels() functions work on a row of |count| 32-bit pixels laid out as
+// 0xAARRGGBB, which is the format of every surface rlvm builds. They leave
+// alpha alone and give bit for bit the same results as the per channel
+// functions, which are what surfaces in any other format go through.
+
+// The grey level that grpMono turns a pixel into.
+int MonoChannel(int r, int g, int b);
+
+// Tints one channel of a surface towards white (|in_colour| > 0) or black
+// (|in_colour| < 0), as grpColour does.
+int ApplyColourChannel(int in_colour, int surface_colour);
+
+void InvertPixels(uint32_t* pixels, int count);
+void MonoPixels(uint32_t* pixels, int count);
+
+// Looks each channel up in |map|, as a tone curve does.
+void MapPixels(uint32_t* pixels, int count, const ToneCurveRGBMap& map);
+
+// Builds the table that makes MapPixels() equivalent to applying
+// ApplyColourChannel() with |colour| to each channel.
+ToneCurveRGBMap BuildApplyColourMap(const RGBColour& colour);
+
+// Blends |colour| (0xRRGGBB) onto each pixel with that pixel's entry in
+// |coverage| as its alpha. This is what pygame_AlphaBlit() does when it blits
+// a glyph that SDL_ttf rendered in |colour|, except that pixels with no
+// coverage are left completely alone instead of having their colour replaced
+// while they're fully transparent.
+void BlendCoverage(uint32_t* pixels,
+                   const uint8_t* coverage,
+                   int count,
+                   uint32_t colour);
+
+#endif  // SRC_SYSTEMS_BASE_PIXEL_KERNELS_H_
@@ -41,6 +41,7 @@
 #include "machine/serialization.h"
 #include "systems/base/event_system.h"
 #include "systems/base/system.h"
+#include "systems/base/voice_prefetcher.h"
 #include "libreallive/gameexe.h"
 
 // -----------------------------------------------------------------------
@@ -376,7 +377,8 @@ void SoundSystem::KoePlay(int id, int charid) {
 }
 
 void SoundSystem::Reset() {
-  // empty
+  if (voice_prefetcher_)
+    voice_prefetcher_->Clear();
 }
 
 // static
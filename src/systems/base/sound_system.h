@@ -33,6 +33,7 @@
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/version.hpp>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -40,6 +41,7 @@
 
 class Gameexe;
 class System;
+class VoicePrefetcher;
 
 const int NUM_BASE_CHANNELS = 16;
 const int NUM_EXTRA_WAVPLAY_CHANNELS = 8;
@@ -352,6 +354,10 @@ class SoundSystem {
   virtual bool KoePlaying() const = 0;
   virtual void KoeStop() = 0;
 
+  // Returns the background voice preparer, or NULL if this sound system
+  // doesn't prefetch voices.
+  VoicePrefetcher* voice_prefetcher() { return voice_prefetcher_.get(); }
+
   virtual void Reset();
 
   System& system() { return system_; }
@@ -376,6 +382,10 @@ class SoundSystem {
 
   VoiceCache voice_cache_;
 
+  // Set by subclasses that can make use of prefetched voices. Declared after
+  // |voice_cache_| so its worker thread is stopped first.
+  std::unique_ptr<VoicePrefetcher> voice_prefetcher_;
+
  private:
   System& system_;
 
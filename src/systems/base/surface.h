@@ -58,6 +58,17 @@ class Surface : public std::enable_shared_from_this<Surface> {
   // uploading.
   virtual void EnsureUploaded() const {}
 
+  // Approximate number of bytes this surface's pixels take in main memory.
+  virtual size_t GetPixelMemory() const;
+
+  // Approximate number of bytes of texture memory uploaded from this
+  // surface. Zero on platforms that don't upload surfaces.
+  virtual size_t GetTextureMemory() const { return 0; }
+
+  // Frees any uploaded textures. They are uploaded again the next time the
+  // surface is drawn.
+  virtual void ReleaseTextures() const {}
+
   // ------------------------------------------------- [ Drawing functions ]
 
   // Fills the surface with |colour|.
@@ -0,0 +1,95 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/surface_cache.h"
+
+#include <string>
+#include <utility>
+
+#include "systems/base/surface.h"
+
+SurfaceCache::SurfaceCache(size_t pixel_budget, size_t texture_budget)
+    : surfaces_(pixel_budget),
+      texture_budget_(texture_budget),
+      texture_releases_(0) {}
+
+SurfaceCache::~SurfaceCache() {}
+
+std::shared_ptr<const Surface> SurfaceCache::Fetch(const std::string& name) {
+  return surfaces_.Fetch(name);
+}
+
+bool SurfaceCache::Exists(const std::string& name) const {
+  return surfaces_.Exists(name);
+}
+
+void SurfaceCache::Insert(const std::string& name,
+                          std::shared_ptr<const Surface> surface) {
+  surfaces_.Insert(name, std::move(surface));
+  Trim();
+}
+
+void SurfaceCache::Trim() {
+  surfaces_.Trim();
+
+  if (!texture_budget_)
+    return;
+
+  size_t texture_memory = GetTextureMemory();
+  for (auto it = surfaces_.rbegin();
+       it != surfaces_.rend() && texture_memory > texture_budget_;
+       ++it) {
+    // A surface that's held elsewhere is probably on screen and would only
+    // be uploaded again on the next frame.
+    if (!it->data || it->data.use_count() > 1)
+      continue;
+
+    size_t released = it->data->GetTextureMemory();
+    if (released) {
+      it->data->ReleaseTextures();
+      texture_memory -= released;
+      texture_releases_++;
+    }
+  }
+}
+
+void SurfaceCache::Clear() {
+  surfaces_.Clear();
+}
+
+size_t SurfaceCache::GetTextureMemory() const {
+  size_t total = 0;
+  for (const auto& entry : surfaces_) {
+    if (entry.data)
+      total += entry.data->GetTextureMemory();
+  }
+  return total;
+}
+
+size_t SurfaceCache::PixelMemory::operator()(
+    const std::shared_ptr<const Surface>& surface) const {
+  return surface ? surface->GetPixelMemory() : 0;
+}
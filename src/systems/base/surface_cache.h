@@ -0,0 +1,110 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_SURFACE_CACHE_H_
+#define SRC_SYSTEMS_BASE_SURFACE_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "weighted_lru_cache.hpp"
+
+class Surface;
+
+// Keeps recently loaded images around so that scripts which flip between the
+// same handful of CGs don't decode them over and over again.
+//
+// Entries are weighed by how much memory they take instead of counted, so a
+// run of full screen backgrounds can't push out every small sprite, and a
+// screen full of sprites can't pin a dozen backgrounds. Pixel data in main
+// memory and the textures uploaded from it have separate budgets: once the
+// pixel budget is exceeded, the least recently used surfaces are dropped; once
+// the texture budget is exceeded, the least recently used surfaces that
+// nothing else is holding on to lose their textures but stay cached. A
+// budget of zero means unlimited.
+//
+// The cached surfaces are assumed to be immutable.
+class SurfaceCache {
+ public:
+  SurfaceCache(size_t pixel_budget, size_t texture_budget);
+  ~SurfaceCache();
+
+  // Returns the cached surface named |name| and marks it as the most recently
+  // used, or NULL if it isn't cached.
+  std::shared_ptr<const Surface> Fetch(const std::string& name);
+
+  // Whether |name| is cached. Doesn't count as a use.
+  bool Exists(const std::string& name) const;
+
+  // Caches |surface| as the most recently used entry, replacing any surface
+  // already cached under |name|, and then trims the cache. The surface just
+  // inserted is never evicted, even if it alone is over budget.
+  void Insert(const std::string& name, std::shared_ptr<const Surface> surface);
+
+  // Evicts surfaces and releases textures until we're within budget.
+  // Surfaces upload their textures lazily when first drawn, so the texture
+  // total grows between calls to Insert(); call this periodically.
+  void Trim();
+
+  void Clear();
+
+  size_t pixel_budget() const { return surfaces_.budget(); }
+  void set_pixel_budget(size_t budget) { surfaces_.set_budget(budget); }
+  size_t texture_budget() const { return texture_budget_; }
+  void set_texture_budget(size_t budget) { texture_budget_ = budget; }
+
+  size_t size() const { return surfaces_.size(); }
+
+  // Bytes of pixel data held by the cached surfaces.
+  size_t pixel_memory() const { return surfaces_.weight(); }
+
+  // Bytes of texture memory currently uploaded from the cached surfaces.
+  size_t GetTextureMemory() const;
+
+  // Calls to Fetch() which found a surface.
+  int hits() const { return surfaces_.hits(); }
+  // Calls to Fetch() which didn't.
+  int misses() const { return surfaces_.misses(); }
+  // Surfaces dropped to stay within the pixel budget.
+  int evictions() const { return surfaces_.evictions(); }
+  // Surfaces whose textures were released to stay within the texture budget.
+  int texture_releases() const { return texture_releases_; }
+
+ private:
+  // Weighs surfaces by GetPixelMemory().
+  struct PixelMemory {
+    size_t operator()(const std::shared_ptr<const Surface>& surface) const;
+  };
+
+  WeightedLRUCache<std::string, std::shared_ptr<const Surface>, PixelMemory>
+      surfaces_;
+
+  size_t texture_budget_;
+
+  int texture_releases_;
+};  // class SurfaceCache
+
+#endif  // SRC_SYSTEMS_BASE_SURFACE_CACHE_H_
@@ -44,6 +44,7 @@
 #include "long_operations/load_game_long_operation.h"
 #include "machine/long_operation.h"
 #include "machine/rlmachine.h"
+#include "machine/save_game_index.h"
 #include "machine/serialization.h"
 #include "modules/module_sys.h"
 #include "systems/base/event_system.h"
@@ -386,6 +387,12 @@ boost::filesystem::path System::GameSaveDirectory() {
   return base_dir;
 }
 
+SaveGameIndex& System::save_game_index() {
+  if (!save_game_index_)
+    save_game_index_.reset(new SaveGameIndex(GameSaveDirectory()));
+  return *save_game_index_;
+}
+
 bool System::ShouldFastForward() {
   return (event().CtrlPressed() && text().ctrl_key_skip()) ||
          text().CurrentlySkipping() || force_fast_forward_;
@@ -33,6 +33,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -46,6 +47,7 @@ class RLMachine;
 class Gameexe;
 class GameexeInterpretObject;
 class Platform;
+class SaveGameIndex;
 
 // Syscom Constants
 //
@@ -253,6 +255,9 @@ class System {
   // Support/rlvm/#{REGNAME}/"
   boost::filesystem::path GameSaveDirectory();
 
+  // The headers of the save games in GameSaveDirectory().
+  SaveGameIndex& save_game_index();
+
   // Testing and Debugging Tools
 
   // Whether we are zooming through text and events quickly. Currently can be
@@ -325,6 +330,9 @@ class System {
 
   SystemGlobals globals_;
 
+  // Created on first use, since the save directory depends on the Gameexe.
+  std::unique_ptr<SaveGameIndex> save_game_index_;
+
   // A stream with the save game data at the time of the last selection. Used
   // for the Return to Previous Selection feature.
   std::shared_ptr<std::stringstream> previous_selection_;
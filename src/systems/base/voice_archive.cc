@@ -61,8 +61,62 @@ unsigned char orig_header[0x2c] = {
 // -----------------------------------------------------------------------
 // VoiceSample
 // -----------------------------------------------------------------------
+VoiceSample::VoiceSample()
+    : decoded_pos_(0),
+      decoded_end_(0),
+      decoded_channels_(0),
+      decoded_bytes_per_sample_(0) {}
+
 VoiceSample::~VoiceSample() {}
 
+bool VoiceSample::BeginDecode(int* rate, int* channels) {
+  int size = 0;
+  decoded_.reset(Decode(&size));
+  if (!decoded_ || size < WAV_HEADER_SIZE)
+    return false;
+
+  // Every Decode() implementation starts its buffer with a header in the
+  // MakeWavHeader() layout, so we don't need a general RIFF parser.
+  const char* header = decoded_.get();
+  decoded_channels_ = read_little_endian_short(header + 0x16);
+  decoded_bytes_per_sample_ = read_little_endian_short(header + 0x22) / 8;
+  if (decoded_channels_ <= 0 ||
+      (decoded_bytes_per_sample_ != 1 && decoded_bytes_per_sample_ != 2))
+    return false;
+
+  decoded_pos_ = WAV_HEADER_SIZE;
+  decoded_end_ = WAV_HEADER_SIZE +
+                 std::min(read_little_endian_int(header + 0x28),
+                          size - WAV_HEADER_SIZE);
+
+  *rate = read_little_endian_int(header + 0x18);
+  *channels = decoded_channels_;
+  return true;
+}
+
+int VoiceSample::DecodeSome(int16_t* buffer, int frames) {
+  if (!decoded_)
+    return 0;
+
+  int frame_size = decoded_channels_ * decoded_bytes_per_sample_;
+  int count = std::min(frames, (decoded_end_ - decoded_pos_) / frame_size);
+  int samples = count * decoded_channels_;
+  const char* src = decoded_.get() + decoded_pos_;
+  if (decoded_bytes_per_sample_ == 2) {
+    for (int i = 0; i < samples; ++i)
+      buffer[i] = static_cast<int16_t>(read_little_endian_short(src + i * 2));
+  } else {
+    // 8-bit WAV data is unsigned.
+    for (int i = 0; i < samples; ++i)
+      buffer[i] = (static_cast<unsigned char>(src[i]) - 128) << 8;
+  }
+  decoded_pos_ += count * frame_size;
+
+  if (count == 0)
+    decoded_.reset();
+  return count;
+}
+
 // static
 const char* VoiceSample::MakeWavHeader(int rate, int ch, int bps, int size) {
   static char header[0x2c];
@@ -29,6 +29,8 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -40,12 +42,39 @@ const int WAV_HEADER_SIZE = 0x2c;
 // the voice archive type).
 class VoiceSample {
  public:
+  VoiceSample();
   virtual ~VoiceSample();
 
   // Returns waveform data, putting the size of the buffer in |size|.
   virtual char* Decode(int* size) = 0;
 
+  // Incremental decoding. BeginDecode() (re)starts decoding from the
+  // beginning of the sample and reports its format, returning false if the
+  // sample can't be read. Each following call to DecodeSome() writes up to
+  // |frames| frames of interleaved, signed 16-bit, host endian samples into
+  // |buffer| and returns the number of frames written, which is 0 only at the
+  // end of the sample.
+  //
+  // The default implementation runs Decode() once and then hands out pieces
+  // of the result; subclasses override these to bound memory use and to get
+  // the first block out sooner.
+  virtual bool BeginDecode(int* rate, int* channels);
+  virtual int DecodeSome(int16_t* buffer, int frames);
+
+  // Bytes of decoded audio held by the default BeginDecode()/DecodeSome()
+  // implementation. Subclasses that decode incrementally only keep their
+  // codec state, which isn't counted.
+  size_t buffered_size() const { return decoded_ ? decoded_end_ : 0; }
+
   static const char* MakeWavHeader(int rate, int ch, int bps, int size);
+
+ private:
+  // State for the default BeginDecode()/DecodeSome() implementation.
+  std::unique_ptr<char[]> decoded_;
+  int decoded_pos_;
+  int decoded_end_;
+  int decoded_channels_;
+  int decoded_bytes_per_sample_;
 };
 
 // Abstract representation of an archive on disk with a bunch of voice samples
@@ -57,6 +57,8 @@ std::shared_ptr<VoiceSample> VoiceCache::Find(int id) {
   int file_no = id / ID_RADIX;
   int index = id % ID_RADIX;
 
+  std::lock_guard<std::mutex> lock(mutex_);
+
   std::shared_ptr<VoiceArchive> archive = file_cache_.fetch(file_no);
   if (archive) {
     return archive->FindSample(index);
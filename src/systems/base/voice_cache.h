@@ -28,6 +28,7 @@
 #define SRC_SYSTEMS_BASE_VOICE_CACHE_H_
 
 #include <memory>
+#include <mutex>
 
 #include "lru_cache.hpp"
 
@@ -38,9 +39,11 @@ class VoiceSample;
 class VoiceCache {
  public:
   explicit VoiceCache(SoundSystem& sound_system);
-  ~VoiceCache();
+  virtual ~VoiceCache();
 
-  std::shared_ptr<VoiceSample> Find(int id);
+  // Safe to call from the VoicePrefetcher's worker thread. Virtual so tests
+  // can hand out samples without any archives on disk.
+  virtual std::shared_ptr<VoiceSample> Find(int id);
 
  private:
   // Searches for a file archive of voices.
@@ -52,6 +55,9 @@ class VoiceCache {
 
   SoundSystem& sound_system_;
 
+  // Guards |file_cache_|, which Find() mutates on every lookup.
+  std::mutex mutex_;
+
   // A mapping between a file id number and the underlying file object.
   LRUCache<int, std::shared_ptr<VoiceArchive>> file_cache_;
 };  // class VoiceCache
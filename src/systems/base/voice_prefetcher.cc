@@ -0,0 +1,278 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "systems/base/voice_prefetcher.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "libreallive/alldefs.h"
+#include "libreallive/bytecode.h"
+#include "systems/base/voice_archive.h"
+#include "systems/base/voice_cache.h"
+
+namespace {
+
+// How many bytecode elements past the instruction pointer we're willing to
+// look at. A line of voiced text is usually under a dozen elements, so this is
+// generous for any sane lookahead.
+const int kMaxScanElements = 1024;
+
+// The koePlay family in module_koe (1:23). All of them take the voice id as
+// their first parameter.
+bool IsKoePlayOpcode(int opcode) {
+  switch (opcode) {
+    case 0:   // koePlay
+    case 1:   // koePlayEx
+    case 7:   // koePlayExC
+    case 8:   // koeDoPlay
+    case 9:   // koeDoPlayEx
+    case 10:  // koeDoPlayExC
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Constant integers are encoded as '$' 0xff followed by a 32 bit little
+// endian value; anything else would need the machine to evaluate.
+bool GetConstantParameter(const std::string& param, int* value) {
+  if (param.size() != 6 || param[0] != '$' ||
+      static_cast<unsigned char>(param[1]) != 0xff)
+    return false;
+
+  *value = libreallive::read_i32(param.data() + 2);
+  return true;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// PreparedVoice
+// -----------------------------------------------------------------------
+
+size_t PreparedVoice::size() const {
+  return first_block.size() * sizeof(int16_t) + sample->buffered_size();
+}
+
+// -----------------------------------------------------------------------
+// VoicePrefetcher
+// -----------------------------------------------------------------------
+
+VoicePrefetcher::VoicePrefetcher(VoiceCache& voice_cache)
+    : voice_cache_(voice_cache),
+      lookahead_(kDefaultLookahead),
+      in_flight_(-1),
+      ready_bytes_(0),
+      max_ready_bytes_(kDefaultMaxReadyBytes),
+      hits_(0),
+      misses_(0),
+      shutting_down_(false),
+      worker_(&VoicePrefetcher::Run, this) {}
+
+VoicePrefetcher::~VoicePrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  work_available_.notify_all();
+  worker_.join();
+}
+
+// static
+std::vector<int> VoicePrefetcher::ScanForVoices(
+    const libreallive::BytecodeList& bytecode,
+    libreallive::pointer_t ip,
+    int max_ids) {
+  std::vector<int> ids;
+  const libreallive::pointer_t end = bytecode.size();
+  if (ip >= end)
+    return ids;
+
+  int scanned = 0;
+  for (++ip; ip < end && scanned < kMaxScanElements &&
+                 static_cast<int>(ids.size()) < max_ids;
+       ++ip, ++scanned) {
+    if (!bytecode[ip].is_command())
+      continue;
+    libreallive::CommandElement command = bytecode.command(ip);
+    if (command.modtype() != 1 || command.module() != 23 ||
+        !IsKoePlayOpcode(command.opcode()) || command.GetParamCount() == 0)
+      continue;
+
+    int id;
+    if (GetConstantParameter(command.GetParam(0), &id) &&
+        std::find(ids.begin(), ids.end(), id) == ids.end()) {
+      ids.push_back(id);
+    }
+  }
+
+  return ids;
+}
+
+void VoicePrefetcher::Prefetch(const std::vector<int>& ids) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wanted_ = ids;
+
+    for (auto it = ready_.begin(); it != ready_.end();) {
+      if (IsWanted(it->first))
+        ++it;
+      else
+        EraseReady(it++);
+    }
+
+    pending_.clear();
+    for (int id : ids) {
+      if (id != in_flight_ && ready_.find(id) == ready_.end())
+        pending_.push_back(id);
+    }
+  }
+
+  work_available_.notify_one();
+}
+
+std::unique_ptr<PreparedVoice> VoicePrefetcher::Take(int id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_.erase(std::remove(pending_.begin(), pending_.end(), id),
+                 pending_.end());
+
+  // Waiting on a sample that's already being opened still beats starting
+  // over.
+  sample_finished_.wait(lock, [&] { return in_flight_ != id; });
+
+  auto it = ready_.find(id);
+  if (it == ready_.end()) {
+    misses_++;
+    return std::unique_ptr<PreparedVoice>();
+  }
+
+  hits_++;
+  std::unique_ptr<PreparedVoice> voice = std::move(it->second);
+  ready_bytes_ -= voice->size();
+  ready_.erase(it);
+  lock.unlock();
+
+  work_available_.notify_one();
+  return voice;
+}
+
+void VoicePrefetcher::Clear() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wanted_.clear();
+    pending_.clear();
+    ready_.clear();
+    ready_bytes_ = 0;
+  }
+
+  work_available_.notify_one();
+}
+
+void VoicePrefetcher::set_max_ready_bytes(size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_ready_bytes_ = bytes;
+  }
+
+  work_available_.notify_one();
+}
+
+size_t VoicePrefetcher::ready_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ready_bytes_;
+}
+
+int VoicePrefetcher::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+int VoicePrefetcher::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+void VoicePrefetcher::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_available_.wait(lock, [&] {
+      return shutting_down_ ||
+             (!pending_.empty() && ready_bytes_ < max_ready_bytes_);
+    });
+    if (shutting_down_)
+      return;
+
+    int id = pending_.front();
+    pending_.erase(pending_.begin());
+    in_flight_ = id;
+    lock.unlock();
+
+    std::unique_ptr<PreparedVoice> voice;
+    try {
+      voice = Prepare(id);
+    } catch (std::exception& e) {
+      // Leave it for KoePlayImpl() to miss on and report.
+    }
+
+    lock.lock();
+    if (voice && IsWanted(id)) {
+      ready_bytes_ += voice->size();
+      ready_[id] = std::move(voice);
+    }
+    in_flight_ = -1;
+    sample_finished_.notify_all();
+  }
+}
+
+std::unique_ptr<PreparedVoice> VoicePrefetcher::Prepare(int id) {
+  std::unique_ptr<PreparedVoice> voice(new PreparedVoice);
+  voice->sample = voice_cache_.Find(id);
+  if (!voice->sample ||
+      !voice->sample->BeginDecode(&voice->rate, &voice->channels) ||
+      voice->channels < 1)
+    return std::unique_ptr<PreparedVoice>();
+
+  voice->first_block.resize(kFirstBlockFrames * voice->channels);
+  int frames =
+      voice->sample->DecodeSome(voice->first_block.data(), kFirstBlockFrames);
+  voice->first_block.resize(frames * voice->channels);
+  voice->first_block.shrink_to_fit();
+  return voice;
+}
+
+bool VoicePrefetcher::IsWanted(int id) const {
+  return std::find(wanted_.begin(), wanted_.end(), id) != wanted_.end();
+}
+
+void VoicePrefetcher::EraseReady(
+    std::map<int, std::unique_ptr<PreparedVoice>>::iterator it) {
+  ready_bytes_ -= it->second->size();
+  ready_.erase(it);
+}
@@ -0,0 +1,168 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_BASE_VOICE_PREFETCHER_H_
+#define SRC_SYSTEMS_BASE_VOICE_PREFETCHER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libreallive/bytecode_fwd.h"
+
+class VoiceCache;
+class VoiceSample;
+
+// A voice sample that's been located, opened and started on the prefetch
+// worker, ready to be streamed.
+struct PreparedVoice {
+  // BeginDecode() has already been called on |sample|.
+  std::shared_ptr<VoiceSample> sample;
+  int rate;
+  int channels;
+
+  // The first frames of the sample, already pulled out with DecodeSome().
+  std::vector<int16_t> first_block;
+
+  // Approximately how much memory this holds on to.
+  size_t size() const;
+};
+
+// Prepares upcoming voice samples on a worker thread so that koePlay doesn't
+// have to search the voice archives, open the sample and decode its first
+// block on the interpreter thread.
+//
+// The interpreter hands us the ids of the next few voices found ahead of the
+// instruction pointer; the worker prepares each of them into a ready-queue
+// that's bounded by bytes, which KoePlayImpl() then drains with Take() and
+// streams from as usual. Only the first block of each line is decoded ahead
+// of time, so memory doesn't grow with the length of the lines.
+class VoicePrefetcher {
+ public:
+  // The default number of upcoming voices to keep prepared.
+  static const int kDefaultLookahead = 4;
+
+  // How many frames of each voice to decode ahead of time.
+  static const int kFirstBlockFrames = 2048;
+
+  // The default limit on memory held by prepared voices.
+  static const size_t kDefaultMaxReadyBytes = 4 * 1024 * 1024;
+
+  explicit VoicePrefetcher(VoiceCache& voice_cache);
+  ~VoicePrefetcher();
+
+  // Walks |bytecode| after |ip| and returns the ids of the first |max_ids|
+  // koePlay family commands that take a constant voice id. Only a bounded
+  // number of elements are looked at, and jumps aren't followed.
+  static std::vector<int> ScanForVoices(
+      const libreallive::BytecodeList& bytecode,
+      libreallive::pointer_t ip,
+      int max_ids);
+
+  // Replaces the set of voices we expect to be played with |ids|, in the
+  // order they're expected. Prepared voices that aren't in |ids| are
+  // dropped.
+  void Prefetch(const std::vector<int>& ids);
+
+  // Returns the prepared voice for |id| if it was prefetched, or NULL if the
+  // caller has to find it itself. If |id| is being prepared right now, waits
+  // for the worker to finish it.
+  std::unique_ptr<PreparedVoice> Take(int id);
+
+  // Forgets everything that's been queued or prepared.
+  void Clear();
+
+  int lookahead() const { return lookahead_; }
+  void set_lookahead(int lookahead) { lookahead_ = lookahead; }
+
+  // The worker doesn't start on another voice while the prepared ones hold
+  // this many bytes or more, so the limit is overshot by at most one voice.
+  size_t max_ready_bytes() const { return max_ready_bytes_; }
+  void set_max_ready_bytes(size_t bytes);
+
+  // How many bytes the prepared voices currently hold.
+  size_t ready_bytes() const;
+
+  // Counters for how often Take() was able to serve a sample.
+  int hits() const;
+  int misses() const;
+
+ private:
+  // Body of |worker_|.
+  void Run();
+
+  // Finds |id| and decodes its first block. Returns NULL if there's no such
+  // voice or it can't be decoded. Called on |worker_| without |mutex_|.
+  std::unique_ptr<PreparedVoice> Prepare(int id);
+
+  // Whether |id| is still in |wanted_|. Expects |mutex_| to be held.
+  bool IsWanted(int id) const;
+
+  // Removes |it| from |ready_|. Expects |mutex_| to be held.
+  void EraseReady(std::map<int, std::unique_ptr<PreparedVoice>>::iterator it);
+
+  VoiceCache& voice_cache_;
+
+  int lookahead_;
+
+  // Guards everything below.
+  mutable std::mutex mutex_;
+
+  // Signalled when there's more work or room for it, or when we're shutting
+  // down.
+  std::condition_variable work_available_;
+
+  // Signalled whenever the worker finishes a sample.
+  std::condition_variable sample_finished_;
+
+  // The ids passed to the last Prefetch() call.
+  std::vector<int> wanted_;
+
+  // Ids waiting to be prepared, in order.
+  std::vector<int> pending_;
+
+  // The id the worker is preparing, or -1.
+  int in_flight_;
+
+  // Prepared voices waiting to be played, and the sum of their sizes.
+  std::map<int, std::unique_ptr<PreparedVoice>> ready_;
+  size_t ready_bytes_;
+  size_t max_ready_bytes_;
+
+  int hits_;
+  int misses_;
+
+  bool shutting_down_;
+
+  std::thread worker_;
+};  // class VoicePrefetcher
+
+#endif  // SRC_SYSTEMS_BASE_VOICE_PREFETCHER_H_
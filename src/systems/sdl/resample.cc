@@ -25,70 +25,224 @@
 //
 // -----------------------------------------------------------------------
 //
-// Every library that I've seen that isn't tied to some sort of mixer library
-// in itself seems to either require you to do conversions, bring in its own
-// preferred file reading code, and/or pass in raw file descriptors for
-// input/output.
-//
-// If I had any idea about audio programming (and wasn't facing a hard one
-// week deadline), I could do a better job of this, but since I don't, write
-// and read from tempfiles. This file is glue code to zresample.
-//
-// Patches welcome.
+// SDL_mixer's own rate conversion only handles power of two ratios, so voice
+// samples which don't match the output device (48k -> 44.1k is common) have
+// to be resampled by hand. This is glue code between the WAV images produced
+// by the VoiceSample subclasses and the zita resampler, which used to go
+// through tempfiles and a trimmed copy of the zresample tool. Everything here
+// now happens in memory.
 
 #include "systems/sdl/resample.h"
 
-#include <stdlib.h>
-#include <unistd.h>
+#include <zita-resampler/resampler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
-#include "systems/sdl/zresample.h"
-#include "vendor/xclannad/wavfile.h"
+#include "systems/base/voice_archive.h"
+#include "xclannad/endian.hpp"
+#include "xclannad/wavfile.h"
+
+namespace {
+
+// The constants the file based zresample conversion used.
+const int kBufferSize = 0x4000;
+const int kFilterSize = 96;
+
+const int kMinRate = 8000;
+const int kMaxRate = 192000;
+
+// libsndfile's normalization factors for 16-bit data, which we keep so the
+// output is the same as the old file based conversion.
+const float kReadScale = 1.0f / 0x8000;
+const float kWriteScale = 0x7FFF;
+
+int16_t FloatToSample(float v) {
+  if (v > 1.0f)
+    v = 1.0f;
+  else if (v < -1.0f)
+    v = -1.0f;
+  return static_cast<int16_t>(lrintf(v * kWriteScale));
+}
+
+}  // namespace
+
+bool ParseWavHeader(const char* data, int length, WavHeaderInfo* info) {
+  if (length < 12 || memcmp(data, "RIFF", 4) != 0 ||
+      memcmp(data + 8, "WAVE", 4) != 0)
+    return false;
+
+  bool found_fmt = false;
+  int pos = 12;
+  while (pos + 8 <= length) {
+    const char* chunk = data + pos;
+    int chunk_length = read_little_endian_int(chunk + 4);
+    if (chunk_length < 0)
+      return false;
+
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunk_length < 16 || pos + 8 + 16 > length)
+        return false;
+      // Only plain PCM is understood.
+      if (read_little_endian_short(chunk + 8) != 1)
+        return false;
+      info->channels = read_little_endian_short(chunk + 10);
+      info->rate = read_little_endian_int(chunk + 12);
+      info->bits_per_sample = read_little_endian_short(chunk + 22);
+      found_fmt = true;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!found_fmt)
+        return false;
+      info->data_offset = pos + 8;
+      // Several of our decoders hand us buffers which are larger than their
+      // payload, but never ones which are smaller.
+      info->data_length = std::min(chunk_length, length - info->data_offset);
+      return true;
+    }
+
+    // Chunks are padded to an even length.
+    pos += 8 + chunk_length + (chunk_length & 1);
+  }
+
+  return false;
+}
+
+// -----------------------------------------------------------------------
+// PCM16Resampler
+// -----------------------------------------------------------------------
+PCM16Resampler::PCM16Resampler() : channels_(0), primed_(false) {}
+
+PCM16Resampler::~PCM16Resampler() {}
+
+bool PCM16Resampler::Setup(int input_rate, int output_rate, int channels) {
+  if (input_rate < kMinRate || input_rate > kMaxRate ||
+      output_rate < kMinRate || output_rate > kMaxRate || channels <= 0)
+    return false;
+
+  resampler_.reset(new Resampler);
+  if (resampler_->setup(input_rate, output_rate, channels, kFilterSize)) {
+    resampler_.reset();
+    return false;
+  }
+
+  channels_ = channels;
+  primed_ = false;
+  inbuf_.resize(channels * kBufferSize);
+  outbuf_.resize(channels * kBufferSize);
+  return true;
+}
+
+void PCM16Resampler::Process(const int16_t* input,
+                             int frames,
+                             std::vector<int16_t>* output) {
+  if (!primed_) {
+    // Like zresample, lead with half a filter's worth of silence so the
+    // output is aligned with the input.
+    resampler_->inp_count = resampler_->inpsize() / 2 - 1;
+    resampler_->inp_data = nullptr;
+    Run(output);
+    primed_ = true;
+  }
+
+  while (frames > 0) {
+    int count = std::min(kBufferSize, frames);
+    for (int i = 0; i < count * channels_; ++i)
+      inbuf_[i] = input[i] * kReadScale;
+
+    resampler_->inp_count = count;
+    resampler_->inp_data = &inbuf_[0];
+    Run(output);
+
+    input += count * channels_;
+    frames -= count;
+  }
+}
+
+void PCM16Resampler::Flush(std::vector<int16_t>* output) {
+  if (!primed_)
+    Process(nullptr, 0, output);
+
+  resampler_->inp_count = resampler_->inpsize() / 2;
+  resampler_->inp_data = nullptr;
+  Run(output);
+}
+
+void PCM16Resampler::Run(std::vector<int16_t>* output) {
+  while (resampler_->inp_count > 0) {
+    resampler_->out_count = kBufferSize;
+    resampler_->out_data = &outbuf_[0];
+    resampler_->process();
+
+    int produced = (kBufferSize - resampler_->out_count) * channels_;
+    for (int i = 0; i < produced; ++i)
+      output->push_back(FloatToSample(outbuf_[i]));
+  }
+}
+
+// -----------------------------------------------------------------------
+
+bool ResamplePCM16(const int16_t* input,
+                   int frames,
+                   int channels,
+                   int input_rate,
+                   int output_rate,
+                   std::vector<int16_t>* output) {
+  PCM16Resampler resampler;
+  if (!resampler.Setup(input_rate, output_rate, channels))
+    return false;
+
+  output->clear();
+  output->reserve(
+      (static_cast<int64_t>(frames) * output_rate / input_rate + 1) *
+      channels);
+  resampler.Process(input, frames, output);
+  resampler.Flush(output);
+  return true;
+}
 
 char* EnsureDataIsCorrectBitrate(char* incoming_data, int* length) {
-  // TODO(erg): Fast path by just returning incoming_data if the bitrate is the
-  // same as the desired rate.
-
-  // Write |incoming_data| to a file.
-  char dir_template[] = "/tmp/rlvm-temp-XXXXXX";
-  char* tmp_dirname = mkdtemp(dir_template);
-  if (tmp_dirname == nullptr) {
-    std::cerr << "Warning! Failed to make temp dir for audio conversion."
+  WavHeaderInfo info;
+  if (!ParseWavHeader(incoming_data, *length, &info)) {
+    std::cerr << "Warning! Couldn't parse WAV header for audio conversion."
               << std::endl;
     return incoming_data;
   }
 
-  std::string infile_name = tmp_dirname;
-  infile_name += "/input.wav";
-  std::string outfile_name = tmp_dirname;
-  outfile_name += "/output.wav";
-
-  FILE* infile = fopen(infile_name.c_str(), "wb");
-  fwrite(incoming_data, *length, 1, infile);
-  fclose(infile);
+  // Fast path: nearly every game ships voice at the mixer's rate.
+  if (info.rate == WAVFILE::freq)
+    return incoming_data;
 
-  if (zresample_main(infile_name.c_str(), outfile_name.c_str(), WAVFILE::freq)) {
-    std::cerr << "Warning! Failed to perform audio conversion."
-              << std::endl;
-    unlink(infile_name.c_str());
-    unlink(outfile_name.c_str());
-    rmdir(tmp_dirname);
+  if (info.bits_per_sample != 16) {
+    std::cerr << "Warning! Can't resample " << info.bits_per_sample
+              << "-bit audio." << std::endl;
     return incoming_data;
   }
 
-  FILE* f = fopen(outfile_name.c_str(), "rb");
-  fseek(f, 0, SEEK_END);
-  long fsize = ftell(f);
-  *length = fsize;
-  fseek(f, 0, SEEK_SET);
+  int frames = info.data_length / (2 * info.channels);
+  std::vector<int16_t> samples(frames * info.channels);
+  const char* pcm = incoming_data + info.data_offset;
+  for (size_t i = 0; i < samples.size(); ++i)
+    samples[i] = static_cast<int16_t>(read_little_endian_short(pcm + i * 2));
 
-  char* outdata = new char[fsize];
-  fread(outdata, fsize, 1, f);
-  fclose(f);
+  std::vector<int16_t> resampled;
+  if (!ResamplePCM16(samples.data(), frames, info.channels, info.rate,
+                     WAVFILE::freq, &resampled)) {
+    std::cerr << "Warning! Failed to perform audio conversion from "
+              << info.rate << " to " << WAVFILE::freq << "." << std::endl;
+    return incoming_data;
+  }
 
-  unlink(infile_name.c_str());
-  unlink(outfile_name.c_str());
-  rmdir(tmp_dirname);
+  int data_size = resampled.size() * 2;
+  *length = WAV_HEADER_SIZE + data_size;
+  char* outdata = new char[*length];
+  memcpy(outdata,
+         VoiceSample::MakeWavHeader(WAVFILE::freq, info.channels, 2, *length),
+         WAV_HEADER_SIZE);
+  for (size_t i = 0; i < resampled.size(); ++i)
+    write_little_endian_short(outdata + WAV_HEADER_SIZE + i * 2, resampled[i]);
 
+  delete[] incoming_data;
   return outdata;
 }
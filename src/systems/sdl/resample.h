@@ -29,16 +29,80 @@
 #define SRC_SYSTEMS_SDL_RESAMPLE_H_
 
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Resampler;
+
+// The parts of a RIFF/WAVE header that we care about, parsed in place from a
+// buffer in memory.
+struct WavHeaderInfo {
+  int channels;
+  int rate;
+  int bits_per_sample;
+
+  // Offset and length of the PCM payload of the "data" chunk.
+  int data_offset;
+  int data_length;
+};
+
+// Parses the WAV image in |data|, walking the RIFF chunks until both the
+// "fmt " and "data" chunks have been found. Returns false if |data| doesn't
+// look like uncompressed PCM.
+bool ParseWavHeader(const char* data, int length, WavHeaderInfo* info);
+
+// Incremental wrapper around the zita resampler for interleaved, signed 16-bit
+// audio, so a stream can be resampled a block at a time as it's decoded.
+class PCM16Resampler {
+ public:
+  PCM16Resampler();
+  ~PCM16Resampler();
+
+  // Returns false if the rate ratio isn't supported.
+  bool Setup(int input_rate, int output_rate, int channels);
+
+  // Resamples |frames| frames of |input|, appending whatever output the
+  // filter produces to |output|.
+  void Process(const int16_t* input, int frames, std::vector<int16_t>* output);
+
+  // Pushes trailing silence through the filter so the tail of the signal is
+  // appended to |output|. Call once, after the last Process().
+  void Flush(std::vector<int16_t>* output);
+
+ private:
+  // Drains the resampler's current input into |output|.
+  void Run(std::vector<int16_t>* output);
+
+  std::unique_ptr<Resampler> resampler_;
+  int channels_;
+
+  // Whether the leading silence has been fed in yet.
+  bool primed_;
+
+  std::vector<float> inbuf_;
+  std::vector<float> outbuf_;
+};
+
+// Resamples interleaved signed 16-bit |frames| of |channels| channel audio
+// from |input_rate| to |output_rate| with the zita resampler, replacing the
+// contents of |output|. Returns false if the rate ratio isn't supported.
+bool ResamplePCM16(const int16_t* input,
+                   int frames,
+                   int channels,
+                   int input_rate,
+                   int output_rate,
+                   std::vector<int16_t>* output);
 
 // Ensures that the wav file with PCM data |incoming_data| is of the same
 // bitrate as our output device. This function takes ownership of
 // |incoming_data|. |length| is modified to refer to the size of the return
 // value.
 //
-// Caller takes ownership of return value.
+// When the sample is already at the output rate, |incoming_data| is returned
+// untouched; otherwise the conversion happens entirely in memory.
 //
-// TODO(erg): Hopefully, this is a temporary hack. See comments in
-// sdl_sound_system.cc.
+// Caller takes ownership of return value.
 char* EnsureDataIsCorrectBitrate(char* incoming_data, int* length);
 
 #endif  // SRC_SYSTEMS_SDL_RESAMPLE_H_
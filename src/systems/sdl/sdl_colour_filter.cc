@@ -32,6 +32,7 @@
 #include "systems/base/graphics_object.h"
 #include "systems/sdl/sdl_utils.h"
 #include "systems/sdl/shaders.h"
+#include "systems/sdl/sprite_batch.h"
 #include "systems/sdl/texture.h"
 
 SDLColourFilter::SDLColourFilter()
@@ -69,6 +70,7 @@ void SDLColourFilter::Fill(const GraphicsObject& go,
 
     // Copy the current value of the region where we're going to render
     // to a texture for input to the shader
+    SpriteBatch::Flush();
     glBindTexture(GL_TEXTURE_2D, back_texture_id_);
     int ystart =
         int(Texture::ScreenHeight() - screen_rect.y() - screen_rect.height());
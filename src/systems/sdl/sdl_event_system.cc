@@ -29,6 +29,7 @@
 
 #include <SDL/SDL.h>
 
+#include <algorithm>
 #include <functional>
 
 #include "machine/rlmachine.h"
@@ -39,6 +40,13 @@
 using std::bind;
 using std::placeholders::_1;
 
+namespace {
+
+// How often Wait() checks for input while it sleeps.
+const unsigned int kWaitPollInterval = 5;
+
+}  // namespace
+
 SDLEventSystem::SDLEventSystem(SDLSystem& sys, Gameexe& gexe)
     : EventSystem(gexe),
       shift_pressed_(false),
@@ -128,7 +136,20 @@ unsigned int SDLEventSystem::TimeOfLastMouseMove() {
 unsigned int SDLEventSystem::GetTicks() const { return SDL_GetTicks(); }
 
 void SDLEventSystem::Wait(unsigned int milliseconds) const {
-  SDL_Delay(milliseconds);
+  // Sleep in short steps so that input arriving in the middle of an idle
+  // sleep is handled on the next pass instead of a few frames later.
+  unsigned int start = SDL_GetTicks();
+  while (true) {
+    SDL_PumpEvents();
+    SDL_Event event;
+    if (SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) > 0)
+      return;
+
+    unsigned int elapsed = SDL_GetTicks() - start;
+    if (elapsed >= milliseconds)
+      return;
+    SDL_Delay(std::min(milliseconds - elapsed, kWaitPollInterval));
+  }
 }
 
 bool SDLEventSystem::ShiftPressed() const { return shift_pressed_; }
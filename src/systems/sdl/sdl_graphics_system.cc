@@ -40,10 +40,15 @@
 #include <boost/algorithm/string.hpp>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
 #include <set>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/notification_source.h"
@@ -52,6 +57,7 @@
 #include "systems/base/cgm_table.h"
 #include "systems/base/colour.h"
 #include "systems/base/event_system.h"
+#include "systems/base/g00_decoder.h"
 #include "systems/base/graphics_object.h"
 #include "systems/base/mouse_cursor.h"
 #include "systems/base/renderable.h"
@@ -65,6 +71,7 @@
 #include "systems/sdl/sdl_surface.h"
 #include "systems/sdl/sdl_utils.h"
 #include "systems/sdl/shaders.h"
+#include "systems/sdl/sprite_batch.h"
 #include "systems/sdl/texture.h"
 #include "utilities/exception.h"
 #include "utilities/graphics.h"
@@ -83,6 +90,7 @@ void SDLGraphicsSystem::SetCursor(int cursor) {
 }
 
 void SDLGraphicsSystem::BeginFrame(BeginFrameType mode) {
+  SpriteBatch::Flush();
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   DebugShowGLErrors();
@@ -133,6 +141,7 @@ void SDLGraphicsSystem::EndFrame() {
   for (; it != end; ++it) {
     (*it)->Render(NULL);
   }
+  SpriteBatch::Flush();
 
   if (screen_update_mode() == SCREENUPDATEMODE_MANUAL) {
     // Copy the area behind the cursor to the temporary buffer (drivers differ:
@@ -155,6 +164,7 @@ void SDLGraphicsSystem::EndFrame() {
   }
 
   DrawCursor();
+  SpriteBatch::Flush();
 
   // Swap the buffers
   glFlush();
@@ -169,6 +179,7 @@ void SDLGraphicsSystem::RedrawLastFrame() {
   // DrawManual() mode.
   if (screen_contents_texture_valid_) {
     // Redraw the screen
+    SpriteBatch::Flush();
     glBindTexture(GL_TEXTURE_2D, screen_contents_texture_);
     glBegin(GL_QUADS);
     {
@@ -193,6 +204,7 @@ void SDLGraphicsSystem::RedrawLastFrame() {
     glEnd();
 
     DrawCursor();
+    SpriteBatch::Flush();
 
     glFlush();
 
@@ -277,6 +289,9 @@ SDLGraphicsSystem::SDLGraphicsSystem(System& system, Gameexe& gameexe)
   registrar_.Add(this,
                  NotificationType::FULLSCREEN_STATE_CHANGED,
                  Source<GraphicsSystem>(static_cast<GraphicsSystem*>(this)));
+
+  image_decoder_.reset(new ImageDecoder(ImageDecoder::DefaultThreadCount()));
+  image_prefetcher_.reset(new ImagePrefetcher(*this));
 }
 
 void SDLGraphicsSystem::SetupVideo() {
@@ -540,37 +555,34 @@ typedef enum { NO_MASK, ALPHA_MASK, COLOR_MASK } MaskType;
 #define DefaultAmask 0xff000000
 #define DefaultBpp 32
 
-static SDL_Surface* newSurfaceFromRGBAData(int w,
-                                           int h,
-                                           char* data,
-                                           MaskType with_mask) {
+// Wraps the decoded pixels in |data| in a surface, which takes ownership of
+// them.
+//
+// We can't (regretfully) rely on SDL_DisplayFormat[Alpha] to decide on a
+// format that we can send to OpenGL (see some Intel macs), so the surfaces we
+// build always use the above format, which is the order the decoders wrote
+// the pixels in. Converting to that format would only be a copy, so hand the
+// buffer to SDL instead: without SDL_PREALLOC, SDL_FreeSurface() frees the
+// pixels with SDL_free(), which is free().
+static SDL_Surface* newSurfaceFromRGBAData(
+    int w,
+    int h,
+    std::unique_ptr<char[], MallocDeleter> data,
+    MaskType with_mask) {
   int amask = (with_mask == ALPHA_MASK) ? DefaultAmask : 0;
-  SDL_Surface* tmp = SDL_CreateRGBSurfaceFrom(data,
-                                              w,
-                                              h,
-                                              DefaultBpp,
-                                              w * 4,
-                                              DefaultRmask,
-                                              DefaultGmask,
-                                              DefaultBmask,
-                                              amask);
-
-  // We now need to convert this surface to a format suitable for use across
-  // the rest of the program. We can't (regretfully) rely on
-  // SDL_DisplayFormat[Alpha] to decide on a format that we can send to OpenGL
-  // (see some Intel macs) so use convert surface to a pixel order our data
-  // correctly while still using the appropriate alpha flags. So use the above
-  // format with only the flags that would have been set by
-  // SDL_DisplayFormat[Alpha].
-  Uint32 flags;
-  if (with_mask == ALPHA_MASK) {
-    flags = tmp->flags & (SDL_SRCALPHA | SDL_RLEACCELOK);
-  } else {
-    flags = tmp->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA | SDL_RLEACCELOK);
+  SDL_Surface* surf = SDL_CreateRGBSurfaceFrom(data.get(),
+                                               w,
+                                               h,
+                                               DefaultBpp,
+                                               w * 4,
+                                               DefaultRmask,
+                                               DefaultGmask,
+                                               DefaultBmask,
+                                               amask);
+  if (surf) {
+    surf->flags &= ~SDL_PREALLOC;
+    data.release();
   }
-
-  SDL_Surface* surf = SDL_ConvertSurface(tmp, tmp->format, flags);
-  SDL_FreeSurface(tmp);
   return surf;
 }
 
@@ -585,16 +597,10 @@ static SDLSurface::GrpRect xclannadRegionToGrpRect(
   return rect;
 }
 
-std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
-    const std::string& short_filename) {
-  boost::filesystem::path filename =
-      system().FindFile(short_filename, IMAGE_FILETYPES);
-  if (filename.empty()) {
-    std::ostringstream oss;
-    oss << "Could not find image file \"" << short_filename << "\".";
-    throw rlvm::Exception(oss.str());
-  }
-
+// Reads and decodes |filename|. Doesn't touch anything but the file, so that
+// it can run on an ImageDecoder thread.
+static std::shared_ptr<DecodedImage> DecodeImageFile(
+    const boost::filesystem::path& filename) {
   // Glue code to allow my stuff to work with Jagarl's loader
   FILE* file = fopen(filename.string().c_str(), "rb");
   if (!file) {
@@ -615,47 +621,92 @@ std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
   if (conv == 0) {
     throw SystemError("Failure in GRPCONV.");
   }
-  // do not free until SDL_FreeSurface() is called on the surface using it
-  char* mem = (char*)malloc(conv->Width() * conv->Height() * 4 + 1024);
-  SDL_Surface* s = 0;
-  if (conv->Read(mem)) {
-    MaskType is_mask = conv->IsMask() ? ALPHA_MASK : NO_MASK;
-    if (is_mask == ALPHA_MASK) {
+
+  std::shared_ptr<DecodedImage> image(new DecodedImage);
+  image->width = conv->Width();
+  image->height = conv->Height();
+  image->has_alpha = false;
+  image->pixels.reset(static_cast<char*>(
+      malloc(conv->Width() * conv->Height() * 4 + 1024)));
+  if (!image->pixels)
+    throw std::bad_alloc();
+  if (IsG00(*conv)) {
+    if (!DecodeG00(*conv,
+                   reinterpret_cast<uint32_t*>(image->pixels.get()),
+                   &image->has_alpha)) {
+      image->pixels.reset();
+    }
+  } else if (conv->Read(image->pixels.get())) {
+    if (conv->IsMask()) {
       int len = conv->Width() * conv->Height();
-      unsigned int* d = (unsigned int*)mem;
+      unsigned int* d = reinterpret_cast<unsigned int*>(image->pixels.get());
       int i;
       for (i = 0; i < len; i++) {
         if ((*d & 0xff000000) != 0xff000000)
           break;
         d++;
       }
-      if (i == len) {
-        is_mask = NO_MASK;
-      }
+      image->has_alpha = i != len;
     }
-
-    s = newSurfaceFromRGBAData(conv->Width(), conv->Height(), mem, is_mask);
+  } else {
+    image->pixels.reset();
   }
-  free(mem);
 
   // Grab the Type-2 information out of the converter or create one
   // default region if none exist
-  std::vector<SDLSurface::GrpRect> region_table;
   if (conv->region_table.size()) {
     std::transform(conv->region_table.begin(),
                    conv->region_table.end(),
-                   std::back_inserter(region_table),
+                   std::back_inserter(image->region_table),
                    xclannadRegionToGrpRect);
   } else {
     SDLSurface::GrpRect rect;
     rect.rect = Rect(Point(0, 0), Size(conv->Width(), conv->Height()));
     rect.originX = 0;
     rect.originY = 0;
-    region_table.push_back(rect);
+    image->region_table.push_back(rect);
+  }
+
+  return image;
+}
+
+boost::filesystem::path SDLGraphicsSystem::FindImageFile(
+    const std::string& short_filename) {
+  boost::filesystem::path filename =
+      system().FindFile(short_filename, IMAGE_FILETYPES);
+  if (filename.empty()) {
+    std::ostringstream oss;
+    oss << "Could not find image file \"" << short_filename << "\".";
+    throw rlvm::Exception(oss.str());
+  }
+  return filename;
+}
+
+std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
+    const std::string& short_filename) {
+  return BuildSurfaceFromImage(
+      short_filename, *DecodeImageFile(FindImageFile(short_filename)));
+}
+
+ImageDecoder::Task SDLGraphicsSystem::GetDecodeTask(
+    const std::string& short_filename) {
+  boost::filesystem::path filename = FindImageFile(short_filename);
+  return [filename]() { return DecodeImageFile(filename); };
+}
+
+std::shared_ptr<const Surface> SDLGraphicsSystem::BuildSurfaceFromImage(
+    const std::string& short_filename,
+    DecodedImage& image) {
+  SDL_Surface* s = 0;
+  if (image.pixels) {
+    s = newSurfaceFromRGBAData(image.width,
+                               image.height,
+                               std::move(image.pixels),
+                               image.has_alpha ? ALPHA_MASK : NO_MASK);
   }
 
   std::shared_ptr<Surface> surface_to_ret(
-      new SDLSurface(this, s, region_table));
+      new SDLSurface(this, s, image.region_table));
   // handle tone curve effect loading
   if (short_filename.find("?") != short_filename.npos) {
     std::string effect_no_str =
@@ -671,7 +722,7 @@ std::shared_ptr<const Surface> SDLGraphicsSystem::LoadSurfaceFromFile(
     }
     surface_to_ret.get()->ToneCurve(
         globals().tone_curves.GetEffect(effect_no / 10 - 1),
-        Rect(Point(0, 0), Size(conv->Width(), conv->Height())));
+        Rect(Point(0, 0), Size(image.width, image.height)));
   }
 
   return surface_to_ret;
@@ -81,6 +81,11 @@ class SDLGraphicsSystem : public GraphicsSystem, public NotificationObserver {
 
   virtual std::shared_ptr<const Surface> LoadSurfaceFromFile(
       const std::string& short_filename) override;
+  virtual ImageDecoder::Task GetDecodeTask(
+      const std::string& short_filename) override;
+  virtual std::shared_ptr<const Surface> BuildSurfaceFromImage(
+      const std::string& short_filename,
+      DecodedImage& image) override;
 
   virtual std::shared_ptr<Surface> GetHaikei() override;
   virtual std::shared_ptr<Surface> GetDC(int dc) override;
@@ -102,6 +107,9 @@ class SDLGraphicsSystem : public GraphicsSystem, public NotificationObserver {
  private:
   void SetupVideo();
 
+  // Finds the file for |short_filename| or throws.
+  boost::filesystem::path FindImageFile(const std::string& short_filename);
+
   // Makes sure that a passed in dc number is valid.
   //
   // @exception Error Throws when dc is greater then the maximum.
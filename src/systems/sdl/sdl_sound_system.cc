@@ -37,9 +37,11 @@
 #include "systems/base/system.h"
 #include "systems/base/system_error.h"
 #include "systems/base/voice_archive.h"
+#include "systems/base/voice_prefetcher.h"
 #include "systems/sdl/resample.h"
 #include "systems/sdl/sdl_music.h"
 #include "systems/sdl/sdl_sound_chunk.h"
+#include "systems/sdl/sdl_voice_stream.h"
 #include "utilities/exception.h"
 
 namespace fs = boost::filesystem;
@@ -165,9 +167,14 @@ SDLSoundSystem::SDLSoundSystem(System& system)
   Mix_ChannelFinished(&SDLSoundChunk::SoundChunkFinishedPlayback);
 
   SetMusicHook(NULL);
+
+  // Prefetched voices are only ever streamed.
+  if (SDLVoiceStream::CanStream())
+    voice_prefetcher_.reset(new VoicePrefetcher(voice_cache_));
 }
 
 SDLSoundSystem::~SDLSoundSystem() {
+  voice_prefetcher_.reset();
   Mix_HookMusic(NULL, NULL);
 
   Mix_CloseAudio();
@@ -181,6 +188,11 @@ void SDLSoundSystem::ExecuteSoundSystem() {
     queued_music_->FadeIn(queued_music_loop_, queued_music_fadein_);
     queued_music_.reset();
   }
+
+  // The voice channel loops silence after a streamed voice runs out; stop it
+  // so it doesn't cost anything while idle.
+  if (koe_stream_ && koe_stream_->IsFinished())
+    KoeStop();
 }
 
 void SDLSoundSystem::SetBgmEnabled(const int in) {
@@ -378,23 +390,52 @@ bool SDLSoundSystem::BgmLooping() const {
     return false;
 }
 
-bool SDLSoundSystem::KoePlaying() const { return Mix_Playing(KOE_CHANNEL); }
+bool SDLSoundSystem::KoePlaying() const {
+  if (koe_stream_ && koe_stream_->IsFinished())
+    return false;
+  return Mix_Playing(KOE_CHANNEL);
+}
 
-void SDLSoundSystem::KoeStop() { SDLSoundChunk::StopChannel(KOE_CHANNEL); }
+void SDLSoundSystem::KoeStop() {
+  // Halting the channel unregisters the stream's effect, so this has to
+  // happen before |koe_stream_| is released.
+  SDLSoundChunk::StopChannel(KOE_CHANNEL);
+  koe_stream_.reset();
+}
 
 void SDLSoundSystem::KoePlayImpl(int id) {
   if (!is_koe_enabled()) {
     return;
   }
 
+  // The prefetcher may have already found this voice and decoded its start.
+  std::unique_ptr<PreparedVoice> prepared;
+  if (voice_prefetcher_)
+    prepared = voice_prefetcher_->Take(id);
+
   // Get the VoiceSample.
-  std::shared_ptr<VoiceSample> sample = voice_cache_.Find(id);
+  std::shared_ptr<VoiceSample> sample =
+      prepared ? prepared->sample : voice_cache_.Find(id);
   if (!sample) {
     std::ostringstream oss;
     oss << "No sample for " << id;
     throw std::runtime_error(oss.str());
   }
 
+  KoeStop();
+
+  if (SDLVoiceStream::CanStream()) {
+    koe_stream_ = prepared ? SDLVoiceStream::Create(*prepared)
+                           : SDLVoiceStream::Create(sample);
+    if (koe_stream_) {
+      SetChannelVolumeImpl(KOE_CHANNEL);
+      koe_stream_->PlayOn(KOE_CHANNEL);
+      return;
+    }
+
+    // Otherwise decode the whole line below, which reports its own errors.
+  }
+
   int length;
   char* data = sample->Decode(&length);
 
@@ -39,6 +39,7 @@
 
 class SDLSoundChunk;
 class SDLMusic;
+class SDLVoiceStream;
 
 class SDLSoundSystem : public SoundSystem {
  public:
@@ -105,8 +106,9 @@ class SDLSoundSystem : public SoundSystem {
                                  SoundChunkCache& cache);
 
   // Builds a SoundChunk from a piece of memory. This is used for playing
-  // voice. These chunks are not put in a SoundChunkCache since there's no
-  // string to cache on.
+  // voice when the mixer's format doesn't allow streaming it through
+  // SDLVoiceStream. These chunks are not put in a SoundChunkCache since
+  // there's no string to cache on.
   static SDLSoundChunkPtr BuildKoeChunk(char* data, int length);
 
   // Implementation to play a wave file. Two wavPlay() versions use this
@@ -127,6 +129,9 @@ class SDLSoundSystem : public SoundSystem {
   SoundChunkCache se_cache_;
   SoundChunkCache wav_cache_;
 
+  // The voice currently being streamed on KOE_CHANNEL, if any.
+  std::shared_ptr<SDLVoiceStream> koe_stream_;
+
   // The music to play next as soon as the current track finishes.
   SDLMusicPtr queued_music_;
 
@@ -28,6 +28,8 @@
 #include "systems/sdl/sdl_surface.h"
 
 #include <SDL/SDL.h>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -35,13 +37,22 @@
 #include "base/notification_source.h"
 #include "pygame/alphablit.h"
 #include "systems/base/colour.h"
+#include "systems/base/glyph_cache.h"
 #include "systems/base/graphics_object.h"
 #include "systems/base/graphics_object_data.h"
+#include "systems/base/pixel_kernels.h"
 #include "systems/base/system_error.h"
 #include "systems/sdl/sdl_graphics_system.h"
 #include "systems/sdl/sdl_utils.h"
 #include "systems/sdl/texture.h"
-#include "utilities/graphics.h"
+
+// Note to self: These describe the byte order IN THE RAW G00 DATA!
+// These should NOT be switched to native byte order.
+#define DefaultRmask 0xff0000
+#define DefaultGmask 0xff00
+#define DefaultBmask 0xff
+#define DefaultAmask 0xff000000
+#define DefaultBpp 32
 
 namespace {
 
@@ -76,8 +87,7 @@ class InvertColourTransformer : public ColourTransformer {
 class MonoColourTransformer : public ColourTransformer {
  public:
   virtual SDL_Color operator()(const SDL_Color& colour) const {
-    float grayscale = 0.3 * colour.r + 0.59 * colour.g + 0.11 * colour.b;
-    Clamp(grayscale, 0, 255);
+    Uint8 grayscale = MonoChannel(colour.r, colour.g, colour.b);
     SDL_Color out = {grayscale, grayscale, grayscale, 0};
     return out;
   }
@@ -87,25 +97,10 @@ class ApplyColourTransformer : public ColourTransformer {
  public:
   explicit ApplyColourTransformer(const RGBColour& colour) : colour_(colour) {}
 
-  int compose(int in_colour, int surface_colour) const {
-    if (in_colour > 0) {
-      return 255 -
-             ((static_cast<float>((255 - in_colour) * (255 - surface_colour)) /
-               (255 * 255)) *
-              255);
-    } else if (in_colour < 0) {
-      return (static_cast<float>(abs(in_colour) * surface_colour) /
-              (255 * 255)) *
-             255;
-    } else {
-      return surface_colour;
-    }
-  }
-
   virtual SDL_Color operator()(const SDL_Color& colour) const {
-    SDL_Color out = {
-        compose(colour_.r(), colour.r), compose(colour_.g(), colour.g),
-        compose(colour_.b(), colour.b), 0};
+    SDL_Color out = {ApplyColourChannel(colour_.r(), colour.r),
+                     ApplyColourChannel(colour_.g(), colour.g),
+                     ApplyColourChannel(colour_.b(), colour.b), 0};
     return out;
   }
 
@@ -113,11 +108,32 @@ class ApplyColourTransformer : public ColourTransformer {
   RGBColour colour_;
 };
 
-// Applies a |transformer| to every pixel in |area| in the surface |surface|.
+// Whether |format| is the layout of the surfaces we build, which the pixel
+// kernels can work on directly.
+bool IsDefaultFormat(const SDL_PixelFormat* format) {
+  return format->BitsPerPixel == DefaultBpp && format->Rmask == DefaultRmask &&
+         format->Gmask == DefaultGmask && format->Bmask == DefaultBmask &&
+         format->Amask == DefaultAmask;
+}
+
+// Applies |kernel| to each row of |area| in the surface |surface| if it's in
+// the default format, and |transformer| to every pixel in |area| otherwise.
 void TransformSurface(SDLSurface* our_surface,
                       const Rect& area,
-                      const ColourTransformer& transformer) {
+                      const ColourTransformer& transformer,
+                      const std::function<void(uint32_t*, int)>& kernel) {
   SDL_Surface* surface = our_surface->rawSurface();
+  if (IsDefaultFormat(surface->format)) {
+    SDL_LockSurface(surface);
+    char* row = static_cast<char*>(surface->pixels) + surface->pitch * area.y();
+    for (int y = 0; y < area.height(); ++y, row += surface->pitch)
+      kernel(reinterpret_cast<uint32_t*>(row) + area.x(), area.width());
+    SDL_UnlockSurface(surface);
+
+    our_surface->markWrittenTo(our_surface->GetRect());
+    return;
+  }
+
   SDL_Color colour;
   Uint32 col = 0;
 
@@ -166,14 +182,6 @@ void TransformSurface(SDLSurface* our_surface,
 
 // -----------------------------------------------------------------------
 
-// Note to self: These describe the byte order IN THE RAW G00 DATA!
-// These should NOT be switched to native byte order.
-#define DefaultRmask 0xff0000
-#define DefaultGmask 0xff00
-#define DefaultBmask 0xff
-#define DefaultAmask 0xff000000
-#define DefaultBpp 32
-
 SDL_Surface* buildNewSurface(const Size& size) {
   // Create an empty surface
   SDL_Surface* tmp = SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA,
@@ -312,6 +320,34 @@ void SDLSurface::EnsureUploaded() const {
 
 // -----------------------------------------------------------------------
 
+size_t SDLSurface::GetPixelMemory() const {
+  return surface_ ? surface_->pitch * surface_->h : 0;
+}
+
+// -----------------------------------------------------------------------
+
+size_t SDLSurface::GetTextureMemory() const {
+  size_t total = 0;
+  for (const TextureRecord& record : textures_) {
+    if (record.texture) {
+      // Masks are uploaded as a single GL_ALPHA channel.
+      size_t bytes = record.bytes_per_pixel_ == GL_ALPHA ? 1 : 4;
+      total += record.w_ * record.h_ * bytes;
+    }
+  }
+  return total;
+}
+
+// -----------------------------------------------------------------------
+
+void SDLSurface::ReleaseTextures() const {
+  textures_.clear();
+  dirty_rectangle_ = Rect();
+  texture_is_valid_ = false;
+}
+
+// -----------------------------------------------------------------------
+
 void SDLSurface::registerForNotification(GraphicsSystem* system) {
   registrar_.Add(this,
                  NotificationType::FULLSCREEN_STATE_CHANGED,
@@ -459,6 +495,39 @@ void SDLSurface::blitFROMSurface(SDL_Surface* src_surface,
 
 // -----------------------------------------------------------------------
 
+void SDLSurface::BlendGlyph(const GlyphMask& mask,
+                            const RGBColour& colour,
+                            const Point& at) {
+  Rect dst(at, Size(mask.width, mask.height));
+  uint32_t rgb = (colour.r() << 16) | (colour.g() << 8) | colour.b();
+  if (IsDefaultFormat(surface_->format)) {
+    SDL_LockSurface(surface_);
+    CompositeGlyph(mask, rgb, at, static_cast<uint8_t*>(surface_->pixels),
+                   surface_->pitch, GetSize());
+    SDL_UnlockSurface(surface_);
+    markWrittenTo(dst);
+    return;
+  }
+
+  // Rebuild what SDL_ttf would have handed us and let pygame blend it.
+  std::shared_ptr<SDL_Surface> glyph(
+      SDL_CreateRGBSurface(SDL_SWSURFACE, mask.width, mask.height, DefaultBpp,
+                           DefaultRmask, DefaultGmask, DefaultBmask,
+                           DefaultAmask),
+      SDL_FreeSurface);
+  SDL_LockSurface(glyph.get());
+  for (int y = 0; y < mask.height; ++y) {
+    uint32_t* row = reinterpret_cast<uint32_t*>(
+        static_cast<uint8_t*>(glyph->pixels) + y * glyph->pitch);
+    for (int x = 0; x < mask.width; ++x)
+      row[x] = rgb | (mask.coverage[y * mask.width + x] << 24);
+  }
+  SDL_UnlockSurface(glyph.get());
+  blitFROMSurface(glyph.get(), Rect(Point(0, 0), dst.size()), dst, 255);
+}
+
+// -----------------------------------------------------------------------
+
 static void determineProperties(SDL_Surface* surface,
                                 bool is_mask,
                                 GLenum& bytes_per_pixel,
@@ -659,28 +728,33 @@ void SDLSurface::Fill(const RGBAColour& colour, const Rect& area) {
 
 void SDLSurface::Invert(const Rect& rect) {
   InvertColourTransformer inverter;
-  TransformSurface(this, rect, inverter);
+  TransformSurface(this, rect, inverter, InvertPixels);
 }
 
 // -----------------------------------------------------------------------
 
 void SDLSurface::Mono(const Rect& rect) {
   MonoColourTransformer mono;
-  TransformSurface(this, rect, mono);
+  TransformSurface(this, rect, mono, MonoPixels);
 }
 
 // -----------------------------------------------------------------------
 
 void SDLSurface::ToneCurve(const ToneCurveRGBMap effect, const Rect& area) {
   ToneCurveColourTransformer tc(effect);
-  TransformSurface(this, area, tc);
+  TransformSurface(this, area, tc, [&](uint32_t* row, int count) {
+    MapPixels(row, count, effect);
+  });
 }
 
 // -----------------------------------------------------------------------
 
 void SDLSurface::ApplyColour(const RGBColour& colour, const Rect& area) {
   ApplyColourTransformer apply(colour);
-  TransformSurface(this, area, apply);
+  ToneCurveRGBMap map = BuildApplyColourMap(colour);
+  TransformSurface(this, area, apply, [&](uint32_t* row, int count) {
+    MapPixels(row, count, map);
+  });
 }
 
 // -----------------------------------------------------------------------
@@ -35,6 +35,7 @@
 #include "systems/base/surface.h"
 #include "systems/base/tone_curve.h"
 
+struct GlyphMask;
 struct SDL_Surface;
 class Texture;
 class GraphicsSystem;
@@ -68,6 +69,9 @@ class SDLSurface : public Surface, public NotificationObserver {
   ~SDLSurface();
 
   virtual void EnsureUploaded() const override;
+  virtual size_t GetPixelMemory() const override;
+  virtual size_t GetTextureMemory() const override;
+  virtual void ReleaseTextures() const override;
 
   void registerForNotification(GraphicsSystem* system);
 
@@ -100,6 +104,12 @@ class SDLSurface : public Surface, public NotificationObserver {
                        int alpha = 255,
                        bool use_src_alpha = true);
 
+  // Draws |mask| in |colour| with its top left corner at |at|, blending it
+  // the way blitFROMSurface() blends text rendered by SDL_ttf.
+  void BlendGlyph(const GlyphMask& mask,
+                  const RGBColour& colour,
+                  const Point& at);
+
   virtual void RenderToScreen(const Rect& src,
                               const Rect& dst,
                               int alpha = 255) const override;
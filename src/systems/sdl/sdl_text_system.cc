@@ -47,8 +47,18 @@
 #include "utilities/find_font_file.h"
 #include "libreallive/gameexe.h"
 
+namespace {
+
+// A glyph at a typical text size is well under a kilobyte, so this holds
+// several thousand of them: more than a game's worth of kanji at one size.
+const size_t kGlyphCacheBudget = 4 * 1024 * 1024;
+
+}  // namespace
+
 SDLTextSystem::SDLTextSystem(SDLSystem& system, Gameexe& gameexe)
-    : TextSystem(system, gameexe), sdl_system_(system) {
+    : TextSystem(system, gameexe),
+      glyph_cache_(kGlyphCacheBudget),
+      sdl_system_(system) {
   if (TTF_Init() == -1) {
     std::ostringstream oss;
     oss << "Error initializing SDL_ttf: " << TTF_GetError();
@@ -83,19 +93,9 @@ Size SDLTextSystem::RenderGlyphOnto(
     const std::shared_ptr<Surface>& destination) {
   SDLSurface* sdl_surface = static_cast<SDLSurface*>(destination.get());
 
-  std::shared_ptr<TTF_Font> font = GetFontOfSize(font_size);
-
-  if (italic) {
-    TTF_SetFontStyle(font.get(), TTF_STYLE_ITALIC);
-  }
-
-  SDL_Color sdl_colour;
-  RGBColourToSDLColor(font_colour, &sdl_colour);
-  std::shared_ptr<SDL_Surface> character(
-      TTF_RenderUTF8_Blended(font.get(), current.c_str(), sdl_colour),
-      SDL_FreeSurface);
-
-  if (character == NULL) {
+  std::shared_ptr<const GlyphMask> glyph =
+      GetGlyphMask(current, font_size, italic);
+  if (!glyph) {
     // Bug during Kyou's path. The string is printed "". Regression in parser?
     std::cerr << "WARNING. TTF_RenderUTF8_Blended didn't render the "
               << "character \"" << current << "\". Hopefully continuing..."
@@ -103,34 +103,60 @@ Size SDLTextSystem::RenderGlyphOnto(
     return Size(0, 0);
   }
 
-  std::shared_ptr<SDL_Surface> shadow;
-  if (shadow_colour && sdl_system_.text().font_shadow()) {
-    SDL_Color sdl_shadow_colour;
-    RGBColourToSDLColor(*shadow_colour, &sdl_shadow_colour);
+  // The shadow is the same glyph in another colour, so it costs nothing to
+  // rasterize.
+  Point insertion(insertion_point_x, insertion_point_y);
+  if (shadow_colour && sdl_system_.text().font_shadow())
+    sdl_surface->BlendGlyph(*glyph, *shadow_colour, insertion + Point(2, 2));
 
-    shadow.reset(
-        TTF_RenderUTF8_Blended(font.get(), current.c_str(), sdl_shadow_colour),
-        SDL_FreeSurface);
-  }
+  sdl_surface->BlendGlyph(*glyph, font_colour, insertion);
+  return Size(glyph->width, glyph->height);
+}
 
-  if (italic) {
-    TTF_SetFontStyle(font.get(), TTF_STYLE_NORMAL);
-  }
+std::shared_ptr<const GlyphMask> SDLTextSystem::GetGlyphMask(
+    const std::string& glyph,
+    int font_size,
+    bool italic) {
+  std::shared_ptr<const GlyphMask> mask =
+      glyph_cache_.Fetch(glyph, font_size, italic);
+  if (mask)
+    return mask;
 
-  Point insertion(insertion_point_x, insertion_point_y);
+  std::shared_ptr<TTF_Font> font = GetFontOfSize(font_size);
+  if (italic)
+    TTF_SetFontStyle(font.get(), TTF_STYLE_ITALIC);
+
+  // SDL_ttf puts the coverage in the alpha channel of its output, whatever
+  // colour it's asked for.
+  SDL_Color white = {255, 255, 255, 0};
+  std::shared_ptr<SDL_Surface> rendered(
+      TTF_RenderUTF8_Blended(font.get(), glyph.c_str(), white),
+      SDL_FreeSurface);
+
+  if (italic)
+    TTF_SetFontStyle(font.get(), TTF_STYLE_NORMAL);
 
-  if (shadow) {
-    Size offset(shadow->w, shadow->h);
-    sdl_surface->blitFROMSurface(shadow.get(),
-                                 Rect(Point(0, 0), offset),
-                                 Rect(insertion + Point(2, 2), offset),
-                                 255);
+  if (rendered == NULL)
+    return mask;
+
+  std::shared_ptr<GlyphMask> new_mask(new GlyphMask);
+  new_mask->width = rendered->w;
+  new_mask->height = rendered->h;
+  new_mask->coverage.resize(rendered->w * rendered->h);
+
+  SDL_PixelFormat* format = rendered->format;
+  SDL_LockSurface(rendered.get());
+  for (int y = 0; y < rendered->h; ++y) {
+    const Uint32* row = reinterpret_cast<const Uint32*>(
+        static_cast<const Uint8*>(rendered->pixels) + y * rendered->pitch);
+    uint8_t* out = new_mask->coverage.data() + y * rendered->w;
+    for (int x = 0; x < rendered->w; ++x)
+      out[x] = (row[x] & format->Amask) >> format->Ashift;
   }
+  SDL_UnlockSurface(rendered.get());
 
-  Size size(character->w, character->h);
-  sdl_surface->blitFROMSurface(
-      character.get(), Rect(Point(0, 0), size), Rect(insertion, size), 255);
-  return size;
+  glyph_cache_.Insert(glyph, font_size, italic, new_mask);
+  return new_mask;
 }
 
 int SDLTextSystem::GetCharWidth(int size, uint16_t codepoint) {
@@ -31,8 +31,10 @@
 #include <SDL/SDL_ttf.h>
 
 #include <map>
+#include <memory>
 #include <string>
 
+#include "systems/base/glyph_cache.h"
 #include "systems/base/text_system.h"
 
 class Point;
@@ -62,11 +64,22 @@ class SDLTextSystem : public TextSystem {
   // Returns (and caches) a SDL_ttf font object for a font of |size|.
   std::shared_ptr<TTF_Font> GetFontOfSize(int size);
 
+  // Returns the coverage mask of |glyph| (which may be a whole string),
+  // rasterizing it and caching the result if we haven't seen it recently.
+  // Returns NULL if SDL_ttf can't render it.
+  std::shared_ptr<const GlyphMask> GetGlyphMask(const std::string& glyph,
+                                                int font_size,
+                                                bool italic);
+
+  GlyphCache& glyph_cache() { return glyph_cache_; }
+
  private:
   // Font storage.
   typedef std::map<int, std::shared_ptr<TTF_Font>> FontSizeMap;
   FontSizeMap map_;
 
+  GlyphCache glyph_cache_;
+
   SDLSystem& sdl_system_;
 
   std::unique_ptr<bool> is_monospace_;
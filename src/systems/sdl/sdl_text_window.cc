@@ -35,6 +35,7 @@
 
 #include "libreallive/gameexe.h"
 #include "systems/base/colour.h"
+#include "systems/base/glyph_cache.h"
 #include "systems/base/graphics_system.h"
 #include "systems/base/selection_element.h"
 #include "systems/base/system_error.h"
@@ -112,8 +113,6 @@ void SDLTextWindow::AddSelectionItem(const std::string& utf8str,
 
 void SDLTextWindow::DisplayRubyText(const std::string& utf8str) {
   if (ruby_begin_point_ != -1) {
-    std::shared_ptr<TTF_Font> font =
-        sdl_system_.text().GetFontOfSize(ruby_text_size());
     int end_point = text_insertion_point_x_ - x_spacing_;
 
     if (ruby_begin_point_ > end_point) {
@@ -121,24 +120,18 @@ void SDLTextWindow::DisplayRubyText(const std::string& utf8str) {
       throw rlvm::Exception("We don't handle ruby across line breaks yet!");
     }
 
-    SDL_Color colour;
-    RGBColourToSDLColor(font_colour_, &colour);
-    SDL_Surface* tmp =
-        TTF_RenderUTF8_Blended(font.get(), utf8str.c_str(), colour);
-
-    // Render glyph to surface
-    int w = tmp->w;
-    int h = tmp->h;
-    int height_location = text_insertion_point_y_ - ruby_text_size();
-    int width_start =
-        int(ruby_begin_point_ + ((end_point - ruby_begin_point_) * 0.5f) -
-            (w * 0.5f));
-    surface_->blitFROMSurface(
-        tmp,
-        Rect(Point(0, 0), Size(w, h)),
-        Rect(Point(width_start, height_location), Size(w, h)),
-        255);
-    SDL_FreeSurface(tmp);
+    std::shared_ptr<const GlyphMask> ruby =
+        sdl_system_.text().GetGlyphMask(utf8str, ruby_text_size(), false);
+    if (ruby) {
+      // Render glyph to surface
+      int w = ruby->width;
+      int height_location = text_insertion_point_y_ - ruby_text_size();
+      int width_start =
+          int(ruby_begin_point_ + ((end_point - ruby_begin_point_) * 0.5f) -
+              (w * 0.5f));
+      surface_->BlendGlyph(
+          *ruby, font_colour_, Point(width_start, height_location));
+    }
 
     system_.graphics().MarkScreenAsDirty(GUT_TEXTSYS);
 
@@ -0,0 +1,219 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "systems/sdl/sdl_voice_stream.h"
+
+#include <SDL/SDL_mixer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include "systems/base/voice_archive.h"
+#include "systems/base/voice_prefetcher.h"
+#include "systems/sdl/sdl_audio_locker.h"
+#include "xclannad/wavfile.h"
+
+namespace {
+
+// Number of frames pulled out of the VoiceSample at a time.
+const int kDecodeFrames = 2048;
+
+// Length in bytes of the silent chunk that the voice is mixed over.
+const int kSilenceLength = 4096;
+
+// Returns the chunk of silence that's looped on the voice channel. It's never
+// freed since SDL_mixer may reference it right up until shutdown.
+Mix_Chunk* GetSilentChunk() {
+  static Uint8 silence[kSilenceLength];
+  static Mix_Chunk* chunk = Mix_QuickLoad_RAW(silence, kSilenceLength);
+  return chunk;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// SDLVoiceStream
+// -----------------------------------------------------------------------
+SDLVoiceStream::SDLVoiceStream(std::shared_ptr<VoiceSample> sample,
+                               int channels,
+                               std::unique_ptr<PCM16Resampler> resampler,
+                               std::vector<int16_t> first_block)
+    : sample_(sample),
+      channels_(channels),
+      resampler_(std::move(resampler)),
+      decoded_(std::move(first_block)),
+      first_block_frames_(decoded_.size() / channels),
+      pending_pos_(0),
+      decoder_done_(false),
+      finished_(false) {
+  if (decoded_.size() < static_cast<size_t>(kDecodeFrames * channels))
+    decoded_.resize(kDecodeFrames * channels);
+
+  // Reserve enough that the mixer thread never has to allocate.
+  resampled_.reserve(kDecodeFrames * channels * 8);
+  pending_.reserve(kDecodeFrames * std::max(channels, WAVFILE::channels) * 8);
+}
+
+SDLVoiceStream::~SDLVoiceStream() {}
+
+// static
+bool SDLVoiceStream::CanStream() {
+  return WAVFILE::format == AUDIO_S16SYS &&
+         (WAVFILE::channels == 1 || WAVFILE::channels == 2);
+}
+
+// static
+std::shared_ptr<SDLVoiceStream> SDLVoiceStream::Create(
+    std::shared_ptr<VoiceSample> sample) {
+  int rate, channels;
+  if (!sample->BeginDecode(&rate, &channels))
+    return std::shared_ptr<SDLVoiceStream>();
+
+  return Open(sample, rate, channels, std::vector<int16_t>());
+}
+
+// static
+std::shared_ptr<SDLVoiceStream> SDLVoiceStream::Create(PreparedVoice& voice) {
+  return Open(voice.sample, voice.rate, voice.channels,
+              std::move(voice.first_block));
+}
+
+// static
+std::shared_ptr<SDLVoiceStream> SDLVoiceStream::Open(
+    std::shared_ptr<VoiceSample> sample,
+    int rate,
+    int channels,
+    std::vector<int16_t> first_block) {
+  if (channels < 1 || channels > 2)
+    return std::shared_ptr<SDLVoiceStream>();
+
+  // Streaming at the wrong rate would play the line at the wrong pitch and
+  // speed, so refuse instead.
+  std::unique_ptr<PCM16Resampler> resampler;
+  if (rate != WAVFILE::freq) {
+    resampler.reset(new PCM16Resampler);
+    if (!resampler->Setup(rate, WAVFILE::freq, channels)) {
+      std::cerr << "Warning! Can't stream a voice from " << rate << " to "
+                << WAVFILE::freq << " Hz." << std::endl;
+      return std::shared_ptr<SDLVoiceStream>();
+    }
+  }
+
+  return std::shared_ptr<SDLVoiceStream>(
+      new SDLVoiceStream(sample, channels, std::move(resampler),
+                         std::move(first_block)));
+}
+
+void SDLVoiceStream::PlayOn(int channel) {
+  // Mix_PlayChannel() drops the effects of whatever was playing on the
+  // channel, so the effect has to be registered afterwards.
+  Mix_PlayChannel(channel, GetSilentChunk(), -1);
+  Mix_RegisterEffect(channel, &SDLVoiceStream::MixVoice, NULL, this);
+}
+
+bool SDLVoiceStream::IsFinished() const {
+  SDLAudioLocker locker;
+  return finished_;
+}
+
+bool SDLVoiceStream::DecodeNextBlock() {
+  pending_.clear();
+  pending_pos_ = 0;
+
+  if (decoder_done_)
+    return false;
+
+  int frames;
+  if (first_block_frames_) {
+    // The prefetcher already decoded the start of the line.
+    frames = first_block_frames_;
+    first_block_frames_ = 0;
+  } else {
+    frames = sample_->DecodeSome(&decoded_[0], kDecodeFrames);
+  }
+  if (frames == 0)
+    decoder_done_ = true;
+
+  if (resampler_) {
+    resampled_.clear();
+    if (frames)
+      resampler_->Process(&decoded_[0], frames, &resampled_);
+    else
+      resampler_->Flush(&resampled_);
+    AppendToPending(resampled_.data(), resampled_.size() / channels_);
+  } else {
+    AppendToPending(&decoded_[0], frames);
+  }
+
+  // The resampler may not have produced anything yet; that's not the end.
+  return !pending_.empty() || !decoder_done_;
+}
+
+void SDLVoiceStream::AppendToPending(const int16_t* samples, int count) {
+  if (channels_ == WAVFILE::channels) {
+    pending_.insert(pending_.end(), samples, samples + count * channels_);
+  } else if (channels_ == 1) {
+    for (int i = 0; i < count; ++i) {
+      pending_.push_back(samples[i]);
+      pending_.push_back(samples[i]);
+    }
+  } else {
+    for (int i = 0; i < count; ++i)
+      pending_.push_back((samples[i * 2] + samples[i * 2 + 1]) / 2);
+  }
+}
+
+// static
+void SDLVoiceStream::MixVoice(int channel, void* stream, int len, void* udata) {
+  // Don't need an SDLAudioLocker because we're in the audio callback right
+  // now.
+  SDLVoiceStream* voice = static_cast<SDLVoiceStream*>(udata);
+  int16_t* out = static_cast<int16_t*>(stream);
+  size_t wanted = len / sizeof(int16_t);
+  size_t written = 0;
+
+  while (written < wanted && !voice->finished_) {
+    if (voice->pending_pos_ == voice->pending_.size() &&
+        !voice->DecodeNextBlock()) {
+      voice->finished_ = true;
+      break;
+    }
+
+    size_t count = std::min(wanted - written,
+                            voice->pending_.size() - voice->pending_pos_);
+    memcpy(out + written,
+           voice->pending_.data() + voice->pending_pos_,
+           count * sizeof(int16_t));
+    voice->pending_pos_ += count;
+    written += count;
+  }
+
+  if (written < wanted)
+    memset(out + written, 0, (wanted - written) * sizeof(int16_t));
+}
@@ -0,0 +1,126 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_SDL_SDL_VOICE_STREAM_H_
+#define SRC_SYSTEMS_SDL_SDL_VOICE_STREAM_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "systems/sdl/resample.h"
+
+class VoiceSample;
+struct PreparedVoice;
+
+// Plays a VoiceSample on a mixer channel without decoding it up front.
+//
+// SDL_mixer can only play Mix_Chunks, which must be completely decoded in
+// memory before playback starts. Instead, we loop a short silent chunk on the
+// channel and register an effect on it which overwrites the silence with
+// samples as they're decoded. Like SDLMusic::MixMusic(), the decoding happens
+// inside the mixer callback, so the voice starts after the first block and
+// only a block's worth of PCM is ever resident, no matter how long the line
+// is.
+class SDLVoiceStream {
+ public:
+  ~SDLVoiceStream();
+
+  // Whether the mixer was opened with an output format we can produce. When
+  // this returns false, voices have to go through Mix_LoadWAV_RW() instead.
+  static bool CanStream();
+
+  // Prepares |sample| for playback. Returns NULL if it can't be decoded or
+  // resampled to the mixer's rate, in which case the caller should fall back
+  // to decoding the whole sample.
+  static std::shared_ptr<SDLVoiceStream> Create(
+      std::shared_ptr<VoiceSample> sample);
+
+  // Like the above, but picks up where the VoicePrefetcher left |voice|.
+  // Takes its first block.
+  static std::shared_ptr<SDLVoiceStream> Create(PreparedVoice& voice);
+
+  // Starts playing on |channel|. The caller must keep this object alive until
+  // the channel has been halted.
+  void PlayOn(int channel);
+
+  // Whether every sample has been handed to the mixer. The channel keeps
+  // playing silence until it's halted.
+  bool IsFinished() const;
+
+ private:
+  SDLVoiceStream(std::shared_ptr<VoiceSample> sample,
+                 int channels,
+                 std::unique_ptr<PCM16Resampler> resampler,
+                 std::vector<int16_t> first_block);
+
+  // Sets up a stream for a |sample| that BeginDecode() has already been
+  // called on. |first_block| holds frames already decoded from it, if any.
+  static std::shared_ptr<SDLVoiceStream> Open(
+      std::shared_ptr<VoiceSample> sample,
+      int rate,
+      int channels,
+      std::vector<int16_t> first_block);
+
+  // Decodes the next block of the sample into |pending_|, resampling and
+  // remixing it to the output format. Returns false at the end of the sample.
+  bool DecodeNextBlock();
+
+  // Converts |count| frames of |samples| from |channels_| to the mixer's
+  // channel count, appending them to |pending_|.
+  void AppendToPending(const int16_t* samples, int count);
+
+  // SDL_mixer effect callback which replaces the silent chunk's data.
+  static void MixVoice(int channel, void* stream, int len, void* udata);
+
+  std::shared_ptr<VoiceSample> sample_;
+
+  // Number of channels in |sample_|.
+  int channels_;
+
+  // Set when |sample_| isn't at the mixer's rate.
+  std::unique_ptr<PCM16Resampler> resampler_;
+
+  // Scratch space for DecodeNextBlock().
+  std::vector<int16_t> decoded_;
+
+  // Number of frames at the start of |decoded_| that were decoded before
+  // playback started and haven't been played yet.
+  int first_block_frames_;
+  std::vector<int16_t> resampled_;
+
+  // Converted samples waiting to be handed to the mixer.
+  std::vector<int16_t> pending_;
+  size_t pending_pos_;
+
+  // Whether the decoder has run dry, and whether everything it produced has
+  // been played.
+  bool decoder_done_;
+  bool finished_;
+};
+
+#endif  // SRC_SYSTEMS_SDL_SDL_VOICE_STREAM_H_
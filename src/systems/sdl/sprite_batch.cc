@@ -0,0 +1,108 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#include "GL/glew.h"
+
+#include "systems/sdl/sprite_batch.h"
+
+#include "systems/sdl/sdl_utils.h"
+
+SpriteBatch::State SpriteBatch::s_state(0, GL_ONE, GL_ZERO);
+std::vector<SpriteBatch::Vertex> SpriteBatch::s_vertices;
+bool SpriteBatch::s_immediate_mode = false;
+
+// -----------------------------------------------------------------------
+
+void SpriteBatch::Add(const State& state, const Vertex quad[4]) {
+  if (!s_vertices.empty() && state != s_state)
+    Flush();
+
+  s_state = state;
+  s_vertices.insert(s_vertices.end(), quad, quad + 4);
+  if (s_immediate_mode)
+    Flush();
+}
+
+// -----------------------------------------------------------------------
+
+void SpriteBatch::Flush() {
+  if (s_vertices.empty())
+    return;
+
+  glBindTexture(GL_TEXTURE_2D, s_state.texture);
+  glBlendFunc(s_state.src_blend, s_state.dst_blend);
+  if (s_state.blend_equation != GL_FUNC_ADD)
+    glBlendEquation(s_state.blend_equation);
+
+  if (s_immediate_mode) {
+    glBegin(GL_QUADS);
+    for (const Vertex& vertex : s_vertices) {
+      glColor4ubv(vertex.colour);
+      glTexCoord2f(vertex.u, vertex.v);
+      glVertex2f(vertex.x, vertex.y);
+    }
+    glEnd();
+  } else {
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &s_vertices[0].x);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &s_vertices[0].u);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), s_vertices[0].colour);
+
+    // GL_QUADS rather than two triangles per sprite so that the rasterizer
+    // splits each quad exactly the way it did under glBegin(GL_QUADS).
+    glDrawArrays(GL_QUADS, 0, s_vertices.size());
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+  }
+
+  // The current colour is undefined after drawing with a colour array.
+  glColor4ubv(s_vertices.back().colour);
+
+  if (s_state.blend_equation != GL_FUNC_ADD)
+    glBlendEquation(GL_FUNC_ADD);
+  glBlendFunc(GL_ONE, GL_ZERO);
+
+  s_vertices.clear();
+  DebugShowGLErrors();
+}
+
+// -----------------------------------------------------------------------
+
+void SpriteBatch::FlushIfUsing(GLuint texture) {
+  if (!s_vertices.empty() && s_state.texture == texture)
+    Flush();
+}
+
+// -----------------------------------------------------------------------
+
+void SpriteBatch::set_immediate_mode(bool immediate) {
+  Flush();
+  s_immediate_mode = immediate;
+}
@@ -0,0 +1,121 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+#ifndef SRC_SYSTEMS_SDL_SPRITE_BATCH_H_
+#define SRC_SYSTEMS_SDL_SPRITE_BATCH_H_
+
+#include <SDL/SDL_opengl.h>
+
+#include <vector>
+
+// Static state that collects textured quads into a client side vertex array
+// so that runs of quads which share a texture and blend mode go to the driver
+// as a single glDrawArrays() call instead of one glBegin()/glEnd() pair each.
+//
+// Quads are drawn in the order they were added; a quad with different state
+// than the pending run flushes that run first. Anything that touches GL
+// directly (reading the framebuffer, changing the matrix or the shader,
+// deleting or reuploading a texture, swapping buffers) must call Flush()
+// before it does so.
+class SpriteBatch {
+ public:
+  struct State {
+    State(GLuint texture, GLenum src_blend, GLenum dst_blend)
+        : texture(texture),
+          src_blend(src_blend),
+          dst_blend(dst_blend),
+          blend_equation(GL_FUNC_ADD) {}
+    State(GLuint texture,
+          GLenum src_blend,
+          GLenum dst_blend,
+          GLenum blend_equation)
+        : texture(texture),
+          src_blend(src_blend),
+          dst_blend(dst_blend),
+          blend_equation(blend_equation) {}
+
+    bool operator==(const State& rhs) const {
+      return texture == rhs.texture && src_blend == rhs.src_blend &&
+             dst_blend == rhs.dst_blend && blend_equation == rhs.blend_equation;
+    }
+    bool operator!=(const State& rhs) const { return !(*this == rhs); }
+
+    GLuint texture;
+    GLenum src_blend;
+    GLenum dst_blend;
+    GLenum blend_equation;
+  };
+
+  struct Vertex {
+    Vertex() {}
+    Vertex(GLfloat x,
+           GLfloat y,
+           GLfloat u,
+           GLfloat v,
+           int r,
+           int g,
+           int b,
+           int a)
+        : x(x), y(y), u(u), v(v) {
+      colour[0] = static_cast<GLubyte>(r);
+      colour[1] = static_cast<GLubyte>(g);
+      colour[2] = static_cast<GLubyte>(b);
+      colour[3] = static_cast<GLubyte>(a);
+    }
+
+    GLfloat x, y;
+    GLfloat u, v;
+    GLubyte colour[4];
+  };
+
+  // Queues |quad|, given in glBegin(GL_QUADS) vertex order.
+  static void Add(const State& state, const Vertex quad[4]);
+
+  // Draws everything queued. Afterwards the GL state is what the immediate
+  // mode code left behind: the blend func is (GL_ONE, GL_ZERO), the blend
+  // equation is GL_FUNC_ADD, the batch's texture is bound and the current
+  // colour is that of the last vertex drawn.
+  static void Flush();
+
+  // Flushes only if the pending run samples |texture|, which is about to be
+  // deleted or overwritten.
+  static void FlushIfUsing(GLuint texture);
+
+  // In immediate mode, each quad is drawn as soon as it's added, between
+  // glBegin(GL_QUADS) and glEnd() the way Texture drew before batching. This
+  // is the reference the batched output is checked against (see
+  // test/texture_snapshot_test.cc), and a way around drivers with broken
+  // vertex arrays.
+  static bool immediate_mode() { return s_immediate_mode; }
+  static void set_immediate_mode(bool immediate);
+
+ private:
+  static State s_state;
+  static std::vector<Vertex> s_vertices;
+  static bool s_immediate_mode;
+};
+
+#endif  // SRC_SYSTEMS_SDL_SPRITE_BATCH_H_
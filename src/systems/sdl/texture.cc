@@ -48,6 +48,7 @@
 #include "systems/sdl/sdl_surface.h"
 #include "systems/sdl/sdl_utils.h"
 #include "systems/sdl/shaders.h"
+#include "systems/sdl/sprite_batch.h"
 #include "systems/sdl/texture.h"
 
 unsigned int Texture::s_screen_width = 0;
@@ -170,6 +171,9 @@ Texture::Texture(render_to_texture, int width, int height)
       texture_id_(0),
       back_texture_id_(0),
       is_upside_down_(true) {
+  // We snapshot the framebuffer, so anything still queued belongs in it.
+  SpriteBatch::Flush();
+
   glGenTextures(1, &texture_id_);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
   DebugShowGLErrors();
@@ -201,6 +205,7 @@ Texture::Texture(render_to_texture, int width, int height)
 // -----------------------------------------------------------------------
 
 Texture::~Texture() {
+  SpriteBatch::FlushIfUsing(texture_id_);
   glDeleteTextures(1, &texture_id_);
 
   if (back_texture_id_)
@@ -232,6 +237,7 @@ void Texture::reupload(SDL_Surface* surface,
                        unsigned int bytes_per_pixel,
                        int byte_order,
                        int byte_type) {
+  SpriteBatch::FlushIfUsing(texture_id_);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
 
   if (w == total_width_ && h == total_height_) {
@@ -322,23 +328,14 @@ void Texture::RenderToScreen(const Rect& src, const Rect& dst, int opacity) {
     thisy2 = float(logical_height_ - y2) / texture_height_;
   }
 
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
-
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glBegin(GL_QUADS);
-  {
-    glColor4ub(255, 255, 255, opacity);
-    glTexCoord2f(thisx1, thisy1);
-    glVertex2i(fdx1, fdy1);
-    glTexCoord2f(thisx2, thisy1);
-    glVertex2i(fdx2, fdy1);
-    glTexCoord2f(thisx2, thisy2);
-    glVertex2i(fdx2, fdy2);
-    glTexCoord2f(thisx1, thisy2);
-    glVertex2i(fdx1, fdy2);
-  }
-  glEnd();
-  glBlendFunc(GL_ONE, GL_ZERO);
+  const SpriteBatch::Vertex quad[4] = {
+      SpriteBatch::Vertex(fdx1, fdy1, thisx1, thisy1, 255, 255, 255, opacity),
+      SpriteBatch::Vertex(fdx2, fdy1, thisx2, thisy1, 255, 255, 255, opacity),
+      SpriteBatch::Vertex(fdx2, fdy2, thisx2, thisy2, 255, 255, 255, opacity),
+      SpriteBatch::Vertex(fdx1, fdy2, thisx1, thisy2, 255, 255, 255, opacity)};
+  SpriteBatch::Add(
+      SpriteBatch::State(texture_id_, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA),
+      quad);
 }
 
 // -----------------------------------------------------------------------
@@ -406,7 +403,9 @@ void Texture::render_to_screen_as_colour_mask_subtractive_glsl(
   }
 
   // Copy the current value of the region where we're going to render
-  // to a texture for input to the shader
+  // to a texture for input to the shader. Everything queued has to be on
+  // the screen first.
+  SpriteBatch::Flush();
   glBindTexture(GL_TEXTURE_2D, back_texture_id_);
   int ystart = int(s_screen_height - fdy1 - (fdy2 - fdy1));
   int idx1 = int(fdx1);
@@ -486,30 +485,21 @@ void Texture::render_to_screen_as_colour_mask_subtractive_fallback(
     thisy2 = float(logical_height_ - y2) / texture_height_;
   }
 
-  // First draw the mask
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  int r = rgba.r(), g = rgba.g(), b = rgba.b(), a = rgba.a();
+  const SpriteBatch::Vertex quad[4] = {
+      SpriteBatch::Vertex(fdx1, fdy1, thisx1, thisy1, r, g, b, a),
+      SpriteBatch::Vertex(fdx2, fdy1, thisx2, thisy1, r, g, b, a),
+      SpriteBatch::Vertex(fdx2, fdy2, thisx2, thisy2, r, g, b, a),
+      SpriteBatch::Vertex(fdx1, fdy2, thisx1, thisy2, r, g, b, a)};
 
   /// SERIOUS WTF: gl_blend_func_separate causes a segmentation fault
   /// under the current i810 driver for linux.
   //  glBlendFuncSeparate(GL_SRC_ALPHA_SATURATE, GL_ONE_MINUS_SRC_ALPHA,
   //                      GL_SRC_COLOR, GL_ONE_MINUS_SRC_ALPHA);
-  glBlendFunc(GL_SRC_ALPHA_SATURATE, GL_ONE_MINUS_SRC_ALPHA);
-
-  glBegin(GL_QUADS);
-  {
-    glColorRGBA(rgba);
-    glTexCoord2f(thisx1, thisy1);
-    glVertex2i(fdx1, fdy1);
-    glTexCoord2f(thisx2, thisy1);
-    glVertex2i(fdx2, fdy1);
-    glTexCoord2f(thisx2, thisy2);
-    glVertex2i(fdx2, fdy2);
-    glTexCoord2f(thisx1, thisy2);
-    glVertex2i(fdx1, fdy2);
-  }
-  glEnd();
-
-  glBlendFunc(GL_ONE, GL_ZERO);
+  SpriteBatch::Add(
+      SpriteBatch::State(
+          texture_id_, GL_SRC_ALPHA_SATURATE, GL_ONE_MINUS_SRC_ALPHA),
+      quad);
 }
 
 // -----------------------------------------------------------------------
@@ -532,25 +522,18 @@ void Texture::render_to_screen_as_colour_mask_additive(const Rect& src,
     thisy2 = float(logical_height_ - y2) / texture_height_;
   }
 
-  // First draw the mask
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  glBegin(GL_QUADS);
-  {
-    glColorRGBA(rgba);
-    glTexCoord2i(thisx1, thisy1);
-    glVertex2f(fdx1, fdy1);
-    glTexCoord2i(thisx2, thisy1);
-    glVertex2f(fdx2, fdy1);
-    glTexCoord2i(thisx2, thisy2);
-    glVertex2f(fdx2, fdy2);
-    glTexCoord2i(thisx1, thisy2);
-    glVertex2f(fdx1, fdy2);
-  }
-  glEnd();
-
-  glBlendFunc(GL_ONE, GL_ZERO);
+  // This has always passed the coordinates through glTexCoord2i(), which
+  // truncates them; keep doing so.
+  int tx1 = thisx1, ty1 = thisy1, tx2 = thisx2, ty2 = thisy2;
+  int r = rgba.r(), g = rgba.g(), b = rgba.b(), a = rgba.a();
+  const SpriteBatch::Vertex quad[4] = {
+      SpriteBatch::Vertex(fdx1, fdy1, tx1, ty1, r, g, b, a),
+      SpriteBatch::Vertex(fdx2, fdy1, tx2, ty1, r, g, b, a),
+      SpriteBatch::Vertex(fdx2, fdy2, tx2, ty2, r, g, b, a),
+      SpriteBatch::Vertex(fdx1, fdy2, tx1, ty2, r, g, b, a)};
+  SpriteBatch::Add(
+      SpriteBatch::State(texture_id_, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA),
+      quad);
 }
 
 // -----------------------------------------------------------------------
@@ -569,31 +552,24 @@ void Texture::RenderToScreen(const Rect& src,
   float thisx2 = float(x2) / texture_width_;
   float thisy2 = float(y2) / texture_height_;
 
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
-
-  // Blend when we have less opacity
+  // Blend when we have less opacity; otherwise replace.
+  SpriteBatch::State state(texture_id_, GL_ONE, GL_ZERO);
   if (std::find_if(opacity, opacity + 4, [](int o) { return o < 255; }) !=
       opacity + 4) {
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state = SpriteBatch::State(
+        texture_id_, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   }
 
-  glBegin(GL_QUADS);
-  {
-    glColor4ub(255, 255, 255, opacity[0]);
-    glTexCoord2f(thisx1, thisy1);
-    glVertex2i(fdx1, fdy1);
-    glColor4ub(255, 255, 255, opacity[1]);
-    glTexCoord2f(thisx2, thisy1);
-    glVertex2i(fdx2, fdy1);
-    glColor4ub(255, 255, 255, opacity[2]);
-    glTexCoord2f(thisx2, thisy2);
-    glVertex2i(fdx2, fdy2);
-    glColor4ub(255, 255, 255, opacity[3]);
-    glTexCoord2f(thisx1, thisy2);
-    glVertex2i(fdx1, fdy2);
-  }
-  glEnd();
-  glBlendFunc(GL_ONE, GL_ZERO);
+  const SpriteBatch::Vertex quad[4] = {
+      SpriteBatch::Vertex(
+          fdx1, fdy1, thisx1, thisy1, 255, 255, 255, opacity[0]),
+      SpriteBatch::Vertex(
+          fdx2, fdy1, thisx2, thisy1, 255, 255, 255, opacity[1]),
+      SpriteBatch::Vertex(
+          fdx2, fdy2, thisx2, thisy2, 255, 255, 255, opacity[2]),
+      SpriteBatch::Vertex(
+          fdx1, fdy2, thisx1, thisy2, 255, 255, 255, opacity[3])};
+  SpriteBatch::Add(state, quad);
 }
 
 // -----------------------------------------------------------------------
@@ -625,16 +601,62 @@ void Texture::RenderToScreenAsObject(const GraphicsObject& go,
   float thisx2 = float(xSrc2) / texture_width_;
   float thisy2 = float(ySrc2) / texture_height_;
 
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  // Make this so that when we have composite 1, we're doing a pure
+  // additive blend, (ignoring the alpha channel?)
+  GLenum src_blend = GL_SRC_ALPHA, dst_blend, blend_equation = GL_FUNC_ADD;
+  switch (go.composite_mode()) {
+    case 0:
+      dst_blend = GL_ONE_MINUS_SRC_ALPHA;
+      break;
+    case 1:
+      dst_blend = GL_ONE;
+      break;
+    case 2: {
+      dst_blend = GL_ONE;
+      blend_equation = GL_FUNC_REVERSE_SUBTRACT;
+      break;
+    }
+    default: {
+      std::ostringstream oss;
+      oss << "Invalid composite_mode in render: " << go.composite_mode();
+      throw SystemError(oss.str());
+    }
+  }
+  SpriteBatch::State state(texture_id_, src_blend, dst_blend, blend_equation);
+
+  // RealLive has its own complex shading/tinting system which we implement
+  // in a shader if available. It's costly enough that we make sure we need
+  // to use it.
+  bool using_shader =
+      (go.light() || go.tint() != RGBColour::Black() ||
+       go.colour() != RGBAColour::Clear() || go.mono() || go.invert()) &&
+      GLEW_ARB_fragment_shader && GLEW_ARB_multitexture;
+
+  int width = fdx2 - fdx1;
+  int height = fdy2 - fdy1;
+
+  // The common case of an unrotated, unshaded object joins the batch in
+  // screen coordinates. (The shader takes care of the alpha for us, so the
+  // vertex colour only matters when we aren't using it.)
+  if (go.rotation() == 0 && !using_shader) {
+    const SpriteBatch::Vertex quad[4] = {
+        SpriteBatch::Vertex(fdx1, fdy1, thisx1, thisy1, 255, 255, 255, alpha),
+        SpriteBatch::Vertex(fdx2, fdy1, thisx2, thisy1, 255, 255, 255, alpha),
+        SpriteBatch::Vertex(fdx2, fdy2, thisx2, thisy2, 255, 255, 255, alpha),
+        SpriteBatch::Vertex(fdx1, fdy2, thisx1, thisy2, 255, 255, 255, alpha)};
+    SpriteBatch::Add(state, quad);
+    return;
+  }
+
+  // Everything else changes the matrix or the program, so it is drawn on its
+  // own.
+  SpriteBatch::Flush();
 
   glPushMatrix();
   {
     // Translate to where the object starts.
     glTranslatef(fdx1, fdy1, 0);
 
-    int width = fdx2 - fdx1;
-    int height = fdy2 - fdy1;
-
     // Rotate the texture around the point (origin + position + reporigin)
     float x_rep = (width / 2.0f) + go.rep_origin_x();
     float y_rep = (height / 2.0f) + go.rep_origin_y();
@@ -643,13 +665,7 @@ void Texture::RenderToScreenAsObject(const GraphicsObject& go,
     glRotatef(float(go.rotation()) / 10, 0, 0, 1);
     glTranslatef(-x_rep, -y_rep, 0);
 
-    // RealLive has its own complex shading/tinting system which we implement
-    // in a shader if available. It's costly enough that we make sure we need
-    // to use it.
-    bool using_shader = false;
-    if ((go.light() || go.tint() != RGBColour::Black() ||
-         go.colour() != RGBAColour::Clear() || go.mono() || go.invert()) &&
-        GLEW_ARB_fragment_shader && GLEW_ARB_multitexture) {
+    if (using_shader) {
       // Image
       glActiveTexture(GL_TEXTURE0_ARB);
       glEnable(GL_TEXTURE_2D);
@@ -662,55 +678,20 @@ void Texture::RenderToScreenAsObject(const GraphicsObject& go,
 
       // Alpha.
       glUniform1fARB(Shaders::GetObjectUniformAlpha(), alpha / 255.0f);
-
-      // Our final blending color has to be all white here.
-      using_shader = true;
-    } else {
-      // The shader takes care of the alpha for us, so we need to specify when
-      // not using it.
-      glColor4ub(255, 255, 255, alpha);
     }
 
-    // Make this so that when we have composite 1, we're doing a pure
-    // additive blend, (ignoring the alpha channel?)
-    switch (go.composite_mode()) {
-      case 0:
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        break;
-      case 1:
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        break;
-      case 2: {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-        break;
-      }
-      default: {
-        std::ostringstream oss;
-        oss << "Invalid composite_mode in render: " << go.composite_mode();
-        throw SystemError(oss.str());
-      }
-    }
-
-    glBegin(GL_QUADS);
-    {
-      glTexCoord2f(thisx1, thisy1);
-      glVertex2i(0, 0);
-      glTexCoord2f(thisx2, thisy1);
-      glVertex2i(width, 0);
-      glTexCoord2f(thisx2, thisy2);
-      glVertex2i(width, height);
-      glTexCoord2f(thisx1, thisy2);
-      glVertex2i(0, height);
-    }
-    glEnd();
+    const SpriteBatch::Vertex quad[4] = {
+        SpriteBatch::Vertex(0, 0, thisx1, thisy1, 255, 255, 255, alpha),
+        SpriteBatch::Vertex(width, 0, thisx2, thisy1, 255, 255, 255, alpha),
+        SpriteBatch::Vertex(
+            width, height, thisx2, thisy2, 255, 255, 255, alpha),
+        SpriteBatch::Vertex(0, height, thisx1, thisy2, 255, 255, 255, alpha)};
+    SpriteBatch::Add(state, quad);
+    SpriteBatch::Flush();
 
     if (using_shader) {
       glUseProgramObjectARB(0);
     }
-
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_ONE, GL_ZERO);
   }
   glPopMatrix();
 
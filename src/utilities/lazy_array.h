@@ -28,9 +28,11 @@
 #include <boost/serialization/split_member.hpp>
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <ostream>
 #include <stdexcept>
+#include <vector>
 
 // Forward declaration
 template <typename T>
@@ -50,7 +52,9 @@ class FullLazyArrayIterator;
 // foreground layer at exit. Planetarian leaves 3 objects
 // allocated. Kanon leaves 10.
 //
-// TODO(erg): Think about caching firstEntry for the iterators...
+// Which slots are allocated is also kept as a bitmap, so that iterating
+// over the allocated items skips empty stretches a word at a time instead
+// of testing every slot.
 template <typename T>
 class LazyArray {
  public:
@@ -110,6 +114,23 @@ class LazyArray {
 
   T* rawDeref(int pos);
 
+  // Bit (i % 64) of live_[i / 64] is set when array_[i] is allocated.
+  void MarkLive(int pos) const {
+    live_[pos / 64] |= uint64_t(1) << (pos % 64);
+  }
+  void MarkDead(int pos) { live_[pos / 64] &= ~(uint64_t(1) << (pos % 64)); }
+
+  // Returns the first allocated position at or after |pos|, or size_ if
+  // there isn't one.
+  int NextLive(int pos) const;
+
+  // Recomputes |live_| from |array_|.
+  void RebuildLiveBits();
+
+  static int CountTrailingZeros(uint64_t word);
+
+  mutable std::vector<uint64_t> live_;
+
   friend class boost::serialization::access;
 
   // boost::serialization loading
@@ -122,6 +143,8 @@ class LazyArray {
     for (int i = 0; i < size_; ++i) {
       ar& array_[i];
     }
+
+    RebuildLiveBits();
   }
 
   // boost::serialization saving
@@ -216,10 +239,7 @@ class AllocatedLazyArrayIterator
   }
 
   void increment() {
-    current_position_++;
-    while (current_position_ < array_->size() &&
-           array_->rawDeref(current_position_) == NULL)
-      current_position_++;
+    current_position_ = array_->NextLive(current_position_ + 1);
   }
 
   Value& dereference() const { return *(array_->rawDeref(current_position_)); }
@@ -234,7 +254,7 @@ class AllocatedLazyArrayIterator
 
 template <typename T>
 LazyArray<T>::LazyArray(int size)
-    : size_(size), array_(new T* [size]) {
+    : size_(size), array_(new T* [size]), live_((size + 63) / 64, 0) {
   for (int i = 0; i < size_; ++i)
     array_[i] = NULL;
 }
@@ -257,6 +277,7 @@ T& LazyArray<T>::operator[](int pos) {
 
   if (array_[pos] == NULL) {
     array_[pos] = new T();
+    MarkLive(pos);
   }
 
   return *(array_[pos]);
@@ -269,6 +290,7 @@ const T& LazyArray<T>::operator[](int pos) const {
 
   if (array_[pos] == NULL) {
     array_[pos] = new T();
+    MarkLive(pos);
   }
 
   return *(array_[pos]);
@@ -278,14 +300,16 @@ template <typename T>
 void LazyArray<T>::DeleteAt(int i) {
   boost::checked_delete<T>(array_[i]);
   array_[i] = NULL;
+  MarkDead(i);
 }
 
 template <typename T>
 void LazyArray<T>::Clear() {
-  for (int i = 0; i < size_; ++i) {
+  for (int i = NextLive(0); i < size_; i = NextLive(i + 1)) {
     boost::checked_delete<T>(array_[i]);
     array_[i] = NULL;
   }
+  std::fill(live_.begin(), live_.end(), 0);
 }
 
 template <typename T>
@@ -295,15 +319,19 @@ void LazyArray<T>::CopyTo(LazyArray<T>& otherArray) {
         "Not enough space in target array in LazyArray::copyTo");
 
   otherArray.size_ = size_;
-  for (int i = 0; i < size_; ++i) {
+  // Only positions allocated in either array need any work.
+  for (int i = std::min(NextLive(0), otherArray.NextLive(0)); i < size_;
+       i = std::min(NextLive(i + 1), otherArray.NextLive(i + 1))) {
     T* srcEntry = rawDeref(i);
     T* dstEntry = otherArray.rawDeref(i);
 
     if (srcEntry && !dstEntry) {
       otherArray.array_[i] = new T(*srcEntry);
+      otherArray.MarkLive(i);
     } else if (!srcEntry && dstEntry) {
       boost::checked_delete<T>(otherArray.array_[i]);
       otherArray.array_[i] = NULL;
+      otherArray.MarkDead(i);
     } else if (srcEntry && dstEntry) {
       *dstEntry = *srcEntry;
     }
@@ -312,12 +340,44 @@ void LazyArray<T>::CopyTo(LazyArray<T>& otherArray) {
 
 template <typename T>
 AllocatedLazyArrayIterator<T> LazyArray<T>::begin() {
-  // Find the first
-  int firstEntry = 0;
-  while (firstEntry < size_ && array_[firstEntry] == NULL)
-    firstEntry++;
+  return AllocatedLazyArrayIterator<T>(NextLive(0), this);
+}
 
-  return AllocatedLazyArrayIterator<T>(firstEntry, this);
+template <typename T>
+int LazyArray<T>::NextLive(int pos) const {
+  if (pos >= size_)
+    return size_;
+
+  size_t word = pos / 64;
+  uint64_t bits = live_[word] & (~uint64_t(0) << (pos % 64));
+  while (!bits) {
+    if (++word == live_.size())
+      return size_;
+    bits = live_[word];
+  }
+
+  return std::min(int(word * 64) + CountTrailingZeros(bits), size_);
+}
+
+template <typename T>
+void LazyArray<T>::RebuildLiveBits() {
+  live_.assign((size_ + 63) / 64, 0);
+  for (int i = 0; i < size_; ++i) {
+    if (array_[i])
+      MarkLive(i);
+  }
+}
+
+template <typename T>
+int LazyArray<T>::CountTrailingZeros(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int count = 0;
+  for (; !(word & 1); word >>= 1)
+    count++;
+  return count;
+#endif
 }
 
 #endif  // SRC_UTILITIES_LAZY_ARRAY_H_
@@ -0,0 +1,143 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+// Measures how quickly RLMachine steps through bytecode by running every
+// SEEN file in test/Module_*_SEEN repeatedly and reporting instructions per
+// second. Run from the root of the source tree:
+//
+//   ./build/rlvm_bytecode_benchmark [iterations]
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "machine/rlmachine.h"
+#include "modules/modules.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const char* kSeenDirectories[] = {"Module_Jmp_SEEN", "Module_Mem_SEEN",
+                                  "Module_Str_SEEN", "Module_Sys_SEEN"};
+
+// These load image files that only exist in a real game tree.
+const char* kSkippedFiles[] = {"graphics.TXT", "graphics2.TXT"};
+
+// Guards against SEEN files that wait on input or loop forever.
+const long kMaxInstructionsPerRun = 100000;
+
+std::vector<std::string> FindSeenFiles() {
+  std::vector<std::string> files;
+  for (const char* directory : kSeenDirectories) {
+    fs::path dir(locateTestCase(directory));
+    for (fs::directory_iterator it(dir), end; it != end; ++it) {
+      std::string name = it->path().filename().string();
+      if (it->path().extension() == ".TXT" &&
+          std::find(std::begin(kSkippedFiles), std::end(kSkippedFiles),
+                    name) == std::end(kSkippedFiles)) {
+        files.push_back(it->path().string());
+      }
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = argc > 1 ? std::stoi(argv[1]) : 200;
+
+  std::string gameexe = locateTestCase("Gameexe_data/Gameexe.ini");
+
+  // Errors in the test SEENs are expected (they're run without the inputs
+  // the unit tests give them); keep them off the console.
+  std::streambuf* old_cout = std::cout.rdbuf(nullptr);
+  std::ostream out(old_cout);
+
+  long total_instructions = 0;
+  double total_seconds = 0;
+
+  // Most of the SEENs are tiny, so also report the typical per-file rate so
+  // that one long running file doesn't dominate the result.
+  std::vector<double> rates;
+  for (const std::string& file : FindSeenFiles()) {
+    libreallive::Archive arc(file);
+    long instructions = 0;
+    double seconds = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+      // Text the SEENs print piles up in a system's text pages, so give each
+      // run a fresh one.
+      TestSystem system(gameexe);
+      RLMachine machine(system, arc);
+      AddAllModules(machine);
+
+      long run_instructions = 0;
+      auto start = std::chrono::steady_clock::now();
+      while (!machine.halted() && run_instructions < kMaxInstructionsPerRun) {
+        machine.ExecuteNextInstruction();
+        run_instructions++;
+      }
+      seconds += std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start).count();
+      instructions += run_instructions;
+    }
+
+    out << std::left << std::setw(48) << fs::path(file).filename().string()
+        << std::right << std::setw(10) << instructions << " insns "
+        << std::setw(14) << std::fixed << std::setprecision(0)
+        << instructions / seconds << " insns/s" << std::endl;
+    total_instructions += instructions;
+    total_seconds += seconds;
+    rates.push_back(instructions / seconds);
+  }
+
+  std::sort(rates.begin(), rates.end());
+
+  out << "Total: " << total_instructions << " instructions in "
+      << std::setprecision(3) << total_seconds << "s ("
+      << std::setprecision(0) << total_instructions / total_seconds
+      << " insns/s)" << std::endl;
+  if (!rates.empty()) {
+    out << "Median per-file rate: " << rates[rates.size() / 2] << " insns/s"
+        << std::endl;
+  }
+
+  std::cout.rdbuf(old_cout);
+  return 0;
+}
@@ -0,0 +1,121 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+// Measures the per-command cost of RLMachine::ExecuteCommand() on the same
+// SEEN file and Gameexe.ini as the rloperation_test fixtures. Commands resolve
+// to no-op operations, so what's left is the dispatch overhead. This is
+// compared against looking the operation up through the module tables on
+// every command, which is what ExecuteCommand() did before it cached the
+// result on the command's BytecodeRecord. Run from the root of the source
+// tree:
+//
+//   ./build/rlvm_dispatch_benchmark [iterations]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "libreallive/archive.h"
+#include "libreallive/bytecode.h"
+#include "machine/rlmachine.h"
+#include "machine/rlmodule.h"
+#include "machine/rloperation.h"
+#include "modules/modules.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+namespace {
+
+// A module number that none of the real modules use.
+const int kModuleType = 1;
+const int kModuleNumber = 100;
+
+const int kOpcodeCount = 64;
+
+struct Noop : public RLOpcode<> {
+  virtual void operator()(RLMachine& machine) {}
+  virtual bool AdvanceInstructionPointer() { return false; }
+};
+
+class NoopModule : public RLModule {
+ public:
+  NoopModule() : RLModule("Noop", kModuleType, kModuleNumber) {
+    for (int i = 0; i < kOpcodeCount; ++i)
+      AddOpcode(i, 0, "noop", new Noop);
+  }
+};
+
+// Appends a parameterless command for |opcode| in NoopModule to |commands|.
+void AddCommand(libreallive::BytecodeList& commands, int opcode) {
+  const char bytecode[] = {'#', kModuleType, kModuleNumber,
+                           static_cast<char>(opcode & 0xff),
+                           static_cast<char>(opcode >> 8), 0, 0, 0, '\0'};
+  commands.AppendFunction(bytecode);
+}
+
+template <typename Dispatch>
+double NanosecondsPerCommand(const libreallive::BytecodeList& commands,
+                             int iterations,
+                             Dispatch dispatch) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (size_t j = 0; j < commands.size(); ++j)
+      dispatch(commands.command(j));
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (static_cast<double>(iterations) * commands.size());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = argc > 1 ? std::stoi(argv[1]) : 100000;
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  RLMachine machine(system, arc);
+  AddAllModules(machine);
+  machine.AttachModule(new NoopModule);
+
+  libreallive::BytecodeList commands;
+  for (int i = 0; i < kOpcodeCount; ++i)
+    AddCommand(commands, i);
+
+  double lookup = NanosecondsPerCommand(
+      commands, iterations, [&](const libreallive::CommandElement& f) {
+        machine.GetOperation(f)->DispatchFunction(machine, f);
+      });
+  double cached = NanosecondsPerCommand(
+      commands, iterations, [&](const libreallive::CommandElement& f) {
+        machine.ExecuteCommand(f);
+      });
+
+  std::cout << "Module lookup per command: " << lookup << "ns" << std::endl;
+  std::cout << "Cached dispatch:           " << cached << "ns" << std::endl;
+  return 0;
+}
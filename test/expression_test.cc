@@ -27,9 +27,14 @@
 
 #include "gtest/gtest.h"
 
+#include <random>
+#include <sstream>
+#include <string>
+
 #include "libreallive/archive.h"
 #include "libreallive/expression.h"
 #include "libreallive/intmemref.h"
+#include "machine/memory.h"
 #include "machine/rlmachine.h"
 #include "modules/module_jmp.h"
 #include "test_system/test_system.h"
@@ -148,3 +153,173 @@ TEST(ExpressionTest, ParseQuotedEnglishString) {
 
   ASSERT_EQ(16, libreallive::NextString(s.c_str()));
 }
+
+namespace {
+
+// Builds random integer expressions for comparing ExpressionProgram against
+// the tree walker. Assignments only appear at the top level, since the tree
+// walker doesn't define the order operands are evaluated in.
+class RandomExpressionBuilder {
+ public:
+  explicit RandomExpressionBuilder(unsigned int seed) : rng_(seed) {}
+
+  ExpressionPiece Statement() {
+    switch (Random(4)) {
+      case 0:
+        return ExpressionPiece::BinaryExpression(
+            20 + Random(8), LValue(), Value(3));
+      case 1:
+        return ExpressionPiece::BinaryExpression(30, LValue(), Value(3));
+      default:
+        return Value(4);
+    }
+  }
+
+ private:
+  int Random(int n) {
+    return std::uniform_int_distribution<int>(0, n - 1)(rng_);
+  }
+
+  ExpressionPiece Constant() {
+    return ExpressionPiece::IntConstant(Random(41) - 20);
+  }
+
+  ExpressionPiece LValue() {
+    // intA, intB, intG, intZ, intL, intAb, intB2b, intC4b, intD8b, and
+    // strS[], which isn't a valid integer location at all.
+    static const int kTypes[] = {0, 1, 6, 25, 11, 26, 53, 80, 107, 0x12};
+    int type = kTypes[Random(10)];
+    switch (Random(4)) {
+      case 0:
+        return ExpressionPiece::StoreRegister();
+      case 1:
+        // Usually in range, occasionally negative.
+        return ExpressionPiece::MemoryReference(
+            type,
+            ExpressionPiece::BinaryExpression(4, Value(1),
+                                              ExpressionPiece::IntConstant(8)));
+      default:
+        return ExpressionPiece::MemoryReference(
+            type, ExpressionPiece::IntConstant(Random(8)));
+    }
+  }
+
+  ExpressionPiece Value(int depth) {
+    if (depth == 0 || Random(3) == 0) {
+      if (Random(2))
+        return Constant();
+      return LValue();
+    }
+
+    if (Random(6) == 0)
+      return ExpressionPiece::UniaryExpression(Random(2), Value(depth - 1));
+
+    static const char kOperators[] = {0,  1,  2,  3,  4,  5,  6,  7,  8,
+                                      9,  40, 41, 42, 43, 44, 45, 60, 61};
+    char op = kOperators[Random(sizeof(kOperators))];
+    if (op == 8 || op == 9) {
+      return ExpressionPiece::BinaryExpression(
+          op, Value(depth - 1), ExpressionPiece::IntConstant(Random(31)));
+    }
+    return ExpressionPiece::BinaryExpression(op, Value(depth - 1),
+                                             Value(depth - 1));
+  }
+
+  std::mt19937 rng_;
+};
+
+void FillMemory(RLMachine& machine) {
+  for (int i = 0; i < 8; ++i) {
+    machine.SetIntValue(IntMemRef('A', i), i * 3 - 7);
+    machine.SetIntValue(IntMemRef('B', i), 11 - i);
+    machine.SetIntValue(IntMemRef('C', i), 0x12345678 >> i);
+    machine.SetIntValue(IntMemRef('D', i), -1 - i);
+    machine.SetIntValue(IntMemRef('G', i), i);
+    machine.SetIntValue(IntMemRef('Z', i), i * i);
+    machine.SetIntValue(IntMemRef('L', i), 5 - i);
+  }
+  machine.set_store_register(3);
+}
+
+// Evaluates |piece| and returns a description of the result and of the
+// memory it touched.
+std::string Evaluate(RLMachine& machine, const ExpressionPiece& piece,
+                     bool interpret) {
+  std::ostringstream oss;
+  try {
+    oss << (interpret ? piece.InterpretIntegerValue(machine)
+                      : piece.GetIntegerValue(machine));
+  }
+  catch (std::exception& e) {
+    oss << "threw";
+  }
+
+  oss << " store:" << machine.store_register();
+  for (int bank = INTA_LOCATION; bank <= INTZ_LOCATION; ++bank) {
+    for (int i = 0; i < 8; ++i)
+      oss << " " << machine.memory().int_bank(bank)[i];
+  }
+  for (int i = 0; i < 8; ++i)
+    oss << " " << machine.GetIntValue(IntMemRef('L', i));
+  return oss.str();
+}
+
+}  // namespace
+
+// Differential test between the compiled ExpressionProgram and the tree
+// walking reference implementation.
+TEST(ExpressionTest, CompiledExpressionsMatchTreeWalker) {
+  TestSystem system;
+  libreallive::Archive arc(
+      locateTestCase("ExpressionTest_SEEN/basicOperators.TXT"));
+  RLMachine interpreted(system, arc);
+  RLMachine compiled(system, arc);
+
+  RandomExpressionBuilder builder(20160901);
+  int programs = 0;
+  for (int i = 0; i < 2000; ++i) {
+    ExpressionPiece piece = builder.Statement();
+    ExpressionPiece program = piece;
+    program.Compile();
+    if (program.is_compiled())
+      ++programs;
+
+    FillMemory(interpreted);
+    FillMemory(compiled);
+    EXPECT_EQ(Evaluate(interpreted, piece, true),
+              Evaluate(compiled, program, false))
+        << "Mismatch on " << piece.GetDebugString();
+  }
+
+  // Everything but bare constants, the store register and strS[] references
+  // should have been compiled.
+  EXPECT_GT(programs, 1600);
+}
+
+TEST(ExpressionTest, CompiledConstantSubexpressions) {
+  TestSystem system;
+  libreallive::Archive arc(
+      locateTestCase("ExpressionTest_SEEN/basicOperators.TXT"));
+  RLMachine rlmachine(system, arc);
+
+  // -(3 * (4 + 5)) == intA[0]
+  ExpressionPiece piece = ExpressionPiece::BinaryExpression(
+      40,
+      ExpressionPiece::UniaryExpression(
+          1,
+          ExpressionPiece::BinaryExpression(
+              2,
+              ExpressionPiece::IntConstant(3),
+              ExpressionPiece::BinaryExpression(
+                  0,
+                  ExpressionPiece::IntConstant(4),
+                  ExpressionPiece::IntConstant(5)))),
+      ExpressionPiece::MemoryReference(0, ExpressionPiece::IntConstant(0)));
+  piece.Compile();
+  ASSERT_TRUE(piece.is_compiled());
+
+  rlmachine.SetIntValue(IntMemRef('A', 0), -27);
+  EXPECT_EQ(1, piece.GetIntegerValue(rlmachine));
+  rlmachine.SetIntValue(IntMemRef('A', 0), 27);
+  EXPECT_EQ(0, piece.GetIntegerValue(rlmachine));
+}
@@ -0,0 +1,148 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include "machine/frame_scheduler.h"
+
+TEST(HistogramTest, BucketsByLimits) {
+  Histogram histogram({10, 20});
+  histogram.Add(0);
+  histogram.Add(9);
+  histogram.Add(10);
+  histogram.Add(500);
+
+  ASSERT_EQ(3u, histogram.bucket_count());
+  EXPECT_EQ(2, histogram.count(0));
+  EXPECT_EQ(1, histogram.count(1));
+  EXPECT_EQ(1, histogram.count(2));
+  EXPECT_EQ(4, histogram.total());
+  EXPECT_EQ(0u, histogram.lower_bound(0));
+  EXPECT_EQ(20u, histogram.lower_bound(2));
+}
+
+TEST(FrameSchedulerTest, SleepsUntilTheNextFrame) {
+  FrameScheduler scheduler(50);
+  scheduler.BeginPass(1000);
+  EXPECT_EQ(17u, scheduler.EndPass(1003, false, false, false));
+
+  // Passes stay on the 20ms grid however long their work took.
+  scheduler.BeginPass(1020);
+  EXPECT_EQ(12u, scheduler.EndPass(1028, false, false, false));
+  scheduler.BeginPass(1041);
+  EXPECT_EQ(19u, scheduler.EndPass(1041, false, true, false));
+}
+
+TEST(FrameSchedulerTest, DoesntDriftWithUnevenPeriods) {
+  FrameScheduler scheduler(60);
+  unsigned int now = 0;
+  for (int i = 0; i < 60; ++i) {
+    scheduler.BeginPass(now);
+    now += scheduler.EndPass(now, false, false, false);
+  }
+  EXPECT_EQ(1000u, now);
+}
+
+TEST(FrameSchedulerTest, IdlePassesSleepThroughSeveralFrames) {
+  FrameScheduler scheduler(50);
+  scheduler.BeginPass(0);
+  EXPECT_EQ(58u, scheduler.EndPass(2, false, false, true));
+
+  // Busy passes go back to the 20ms grid.
+  scheduler.BeginPass(60);
+  EXPECT_EQ(20u, scheduler.EndPass(60, false, false, false));
+
+  // Idle passes stay on the grid, three frames apart.
+  unsigned int now = 80;
+  int passes = 0;
+  while (now < 1000) {
+    scheduler.BeginPass(now);
+    now += scheduler.EndPass(now, false, false, true);
+    passes++;
+  }
+  EXPECT_EQ(1040u, now);
+  EXPECT_EQ(16, passes);
+}
+
+TEST(FrameSchedulerTest, InputCutsIdleSleepsShort) {
+  FrameScheduler scheduler(50);
+  scheduler.BeginPass(0);
+  EXPECT_EQ(60u, scheduler.EndPass(0, false, false, true));
+
+  // Woken for input 25ms into a 60ms idle sleep, the next pass is back to
+  // being a frame away instead of picking up where the idle sleep ended.
+  scheduler.BeginPass(25);
+  EXPECT_EQ(15u, scheduler.EndPass(25, false, true, false));
+  scheduler.BeginPass(40);
+  EXPECT_EQ(20u, scheduler.EndPass(40, false, false, false));
+}
+
+TEST(FrameSchedulerTest, DropsFramesWhenBehind) {
+  FrameScheduler scheduler(50);
+  scheduler.BeginPass(0);
+  EXPECT_EQ(20u, scheduler.EndPass(0, false, false, false));
+
+  // A dirty screen is drawn right away; an idle one still yields.
+  scheduler.BeginPass(20);
+  EXPECT_EQ(0u, scheduler.EndPass(75, false, true, false));
+  scheduler.BeginPass(75);
+  EXPECT_EQ(20u, scheduler.EndPass(75, false, false, false));
+  scheduler.BeginPass(95);
+  EXPECT_EQ(1u, scheduler.EndPass(150, false, false, false));
+}
+
+TEST(FrameSchedulerTest, FastForwardRunsLongerSlicesWithoutSleeping) {
+  FrameScheduler scheduler(50);
+  EXPECT_EQ(10u, scheduler.GetSliceLength(false));
+  EXPECT_EQ(80u, scheduler.GetSliceLength(true));
+
+  scheduler.BeginPass(0);
+  EXPECT_EQ(0u, scheduler.EndPass(80, true, true, false));
+  scheduler.BeginPass(80);
+  EXPECT_EQ(20u, scheduler.EndPass(80, false, false, false));
+}
+
+TEST(FrameSchedulerTest, RecordsFrameTimesAndCpuUsage) {
+  FrameScheduler scheduler(50);
+  unsigned int now = 0;
+  for (int i = 0; i < 51; ++i) {
+    scheduler.BeginPass(now);
+    // Work for 5ms of each 20ms frame.
+    now += 5;
+    now += scheduler.EndPass(now, false, false, false);
+  }
+
+  const Histogram& frames = scheduler.frame_times();
+  EXPECT_EQ(50, frames.total());
+  EXPECT_EQ(20u, frames.lower_bound(4));
+  EXPECT_EQ(50, frames.count(4));
+
+  const Histogram& cpu = scheduler.cpu_usage();
+  EXPECT_EQ(1, cpu.total());
+  EXPECT_EQ(20u, cpu.lower_bound(2));
+  EXPECT_EQ(1, cpu.count(2));
+}
@@ -0,0 +1,171 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+// Times GRPCONV::Read() against DecodeG00() on every G00 file in a
+// directory, checking along the way that both produce the same pixels. The
+// repository's own test/Gameroot/g00 holds only placeholders, so when no
+// usable file is found a 24-bit and a masked 800x600 image are synthesized.
+// Run with:
+//
+//   ./build/rlvm_g00_decoder_benchmark [directory] [passes]
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "systems/base/g00_decoder.h"
+#include "xclannad/file.h"
+
+#include "g00_writer.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::vector<std::pair<std::string, std::string>> LoadCorpus(
+    const std::string& directory) {
+  std::vector<std::pair<std::string, std::string>> corpus;
+  if (!fs::is_directory(directory))
+    return corpus;
+  for (fs::directory_iterator it(directory), end; it != end; ++it) {
+    if (it->path().extension() != ".g00")
+      continue;
+    std::ifstream in(it->path().string().c_str(), std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    std::unique_ptr<GRPCONV> conv(
+        GRPCONV::AssignConverter(data.data(), data.size(), "bench.g00"));
+    if (conv && IsG00(*conv))
+      corpus.emplace_back(it->path().filename().string(), data);
+  }
+  return corpus;
+}
+
+std::vector<std::pair<std::string, std::string>> SynthesizeCorpus() {
+  const int width = 800, height = 600;
+  std::vector<std::pair<std::string, std::string>> corpus;
+  corpus.emplace_back(
+      "synthetic type 0",
+      BuildG00Type0(width, height, MakeTestPicture(width, height, 1, 0)));
+
+  // A sprite: a few rectangles of opaque and translucent pixels.
+  std::vector<uint32_t> canvas =
+      MakeTestPicture(width, height, 2, 0xff000000);
+  for (int y = 0; y < height; y += 3) {
+    for (int x = 0; x < width; ++x)
+      canvas[y * width + x] &= 0x7fffffff;
+  }
+  std::vector<G00Region> regions;
+  for (int i = 0; i < 4; ++i) {
+    G00Region region = {0, i * 150, width - 1, i * 150 + 149, {}};
+    region.blocks.push_back({100, 0, 600, 150});
+    regions.push_back(region);
+  }
+  corpus.emplace_back("synthetic type 2",
+                      BuildG00Type2(width, height, regions, canvas));
+  return corpus;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string directory = argc > 1 ? argv[1] : "test/Gameroot/g00";
+  int passes = argc > 2 ? std::stoi(argv[2]) : 20;
+
+  std::vector<std::pair<std::string, std::string>> corpus =
+      LoadCorpus(directory);
+  if (corpus.empty()) {
+    std::cout << "No G00 files in " << directory << "; using synthetic images"
+              << std::endl;
+    corpus = SynthesizeCorpus();
+  }
+
+  Clock::duration total_old = Clock::duration::zero();
+  Clock::duration total_new = Clock::duration::zero();
+  for (const auto& file : corpus) {
+    const std::string& data = file.second;
+    std::unique_ptr<GRPCONV> conv(
+        GRPCONV::AssignConverter(data.data(), data.size(), "bench.g00"));
+    int pixel_count = conv->width * conv->height;
+    std::vector<char> old_pixels(pixel_count * 4 + 1024);
+    std::vector<uint32_t> new_pixels(pixel_count);
+
+    // Both as SDLGraphicsSystem uses them, including the scan for
+    // translucent pixels that used to follow GRPCONV::Read().
+    bool old_alpha = false;
+    Clock::time_point start = Clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+      conv->Read(old_pixels.data());
+      if (conv->is_mask) {
+        const uint32_t* p =
+            reinterpret_cast<const uint32_t*>(old_pixels.data());
+        int i = 0;
+        while (i < pixel_count && (p[i] & 0xff000000) == 0xff000000)
+          ++i;
+        old_alpha = i != pixel_count;
+      }
+    }
+    Clock::duration old_time = Clock::now() - start;
+
+    bool new_alpha = false;
+    start = Clock::now();
+    for (int pass = 0; pass < passes; ++pass)
+      DecodeG00(*conv, new_pixels.data(), &new_alpha);
+    Clock::duration new_time = Clock::now() - start;
+
+    bool same = old_alpha == new_alpha &&
+                std::equal(new_pixels.begin(), new_pixels.end(),
+                           reinterpret_cast<const uint32_t*>(
+                               old_pixels.data()));
+    std::cout << file.first << " (" << conv->width << "x" << conv->height
+              << "): " << Milliseconds(old_time) / passes << "ms GRPCONV, "
+              << Milliseconds(new_time) / passes << "ms DecodeG00"
+              << (same ? "" : "  ** OUTPUT DIFFERS **") << std::endl;
+    total_old += old_time;
+    total_new += new_time;
+  }
+
+  std::cout << "Total: " << Milliseconds(total_old) / passes
+            << "ms GRPCONV, " << Milliseconds(total_new) / passes
+            << "ms DecodeG00" << std::endl;
+  return 0;
+}
@@ -0,0 +1,168 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "systems/base/g00_decoder.h"
+#include "xclannad/file.h"
+
+#include "g00_writer.h"
+
+namespace {
+
+struct Decoded {
+  std::vector<uint32_t> pixels;
+  bool has_alpha;
+};
+
+// What SDLGraphicsSystem did before DecodeG00(): GRPCONV::Read() and a scan
+// for translucent pixels in masked images.
+Decoded DecodeWithGrpconv(const std::string& file) {
+  std::unique_ptr<GRPCONV> conv(
+      GRPCONV::AssignConverter(file.data(), file.size(), "test.g00"));
+  EXPECT_TRUE(conv.get());
+  Decoded out;
+  std::vector<char> buffer(conv->width * conv->height * 4 + 1024);
+  EXPECT_TRUE(conv->Read(buffer.data()));
+  const uint32_t* pixels = reinterpret_cast<const uint32_t*>(buffer.data());
+  out.pixels.assign(pixels, pixels + conv->width * conv->height);
+  out.has_alpha = false;
+  if (conv->is_mask) {
+    for (uint32_t pixel : out.pixels) {
+      if ((pixel & 0xff000000) != 0xff000000)
+        out.has_alpha = true;
+    }
+  }
+  return out;
+}
+
+Decoded DecodeWithG00Decoder(const std::string& file) {
+  std::unique_ptr<GRPCONV> conv(
+      GRPCONV::AssignConverter(file.data(), file.size(), "test.g00"));
+  EXPECT_TRUE(conv.get());
+  EXPECT_TRUE(IsG00(*conv));
+  Decoded out;
+  out.pixels.assign(conv->width * conv->height, 0xdeadbeef);
+  out.has_alpha = false;
+  EXPECT_TRUE(DecodeG00(*conv, out.pixels.data(), &out.has_alpha));
+  return out;
+}
+
+void ExpectSameAsGrpconv(const std::string& file, bool has_alpha) {
+  Decoded expected = DecodeWithGrpconv(file);
+  Decoded actual = DecodeWithG00Decoder(file);
+  ASSERT_EQ(expected.pixels.size(), actual.pixels.size());
+  for (size_t i = 0; i < expected.pixels.size(); ++i)
+    ASSERT_EQ(expected.pixels[i], actual.pixels[i]) << "at pixel " << i;
+  EXPECT_EQ(has_alpha, expected.has_alpha);
+  EXPECT_EQ(expected.has_alpha, actual.has_alpha);
+}
+
+// Translucent in the middle, so that partial coverage and alpha both show.
+std::vector<uint32_t> MakeMaskedPicture(int width, int height) {
+  std::vector<uint32_t> canvas = MakeTestPicture(width, height, 3, 0xff000000);
+  for (int y = height / 4; y < height / 2; ++y) {
+    for (int x = width / 4; x < width / 2; ++x)
+      canvas[y * width + x] = (canvas[y * width + x] & 0xffffff) | 0x80000000;
+  }
+  return canvas;
+}
+
+}  // namespace
+
+TEST(G00DecoderTest, Type0MatchesGrpconv) {
+  // Odd sizes, so rows don't line up with anything.
+  std::vector<uint32_t> pixels = MakeTestPicture(67, 45, 1, 0);
+  ExpectSameAsGrpconv(BuildG00Type0(67, 45, pixels), false);
+}
+
+TEST(G00DecoderTest, Type1MatchesGrpconv) {
+  std::vector<uint32_t> palette;
+  for (int i = 0; i < 256; ++i)
+    palette.push_back(0xff000000 | (i * 0x010305));
+  std::vector<uint32_t> picture = MakeTestPicture(53, 31, 2, 0);
+  std::vector<unsigned char> indexes;
+  for (uint32_t pixel : picture)
+    indexes.push_back(pixel & 0xff);
+  ExpectSameAsGrpconv(BuildG00Type1(53, 31, palette, indexes), false);
+}
+
+TEST(G00DecoderTest, Type2PartiallyCoveredMatchesGrpconv) {
+  const int width = 80, height = 60;
+  std::vector<uint32_t> canvas = MakeMaskedPicture(width, height);
+  std::vector<G00Region> regions = {
+      {0, 0, 39, 29, {{0, 0, 40, 10}, {5, 12, 30, 18}}},
+      {40, 0, 79, 59, {{0, 0, 40, 60}}},
+      {0, 30, 39, 59, {{10, 10, 20, 20}}}};
+  ExpectSameAsGrpconv(BuildG00Type2(width, height, regions, canvas), true);
+}
+
+TEST(G00DecoderTest, Type2FullyCoveredOpaqueMatchesGrpconv) {
+  const int width = 64, height = 48;
+  std::vector<uint32_t> canvas = MakeTestPicture(width, height, 4, 0xff000000);
+  std::vector<G00Region> regions = {{0, 0, 63, 23, {{0, 0, 64, 24}}},
+                                    {0, 24, 63, 47, {{0, 0, 64, 24}}}};
+  ExpectSameAsGrpconv(BuildG00Type2(width, height, regions, canvas), false);
+}
+
+TEST(G00DecoderTest, Type2StackedRegionsMatchGrpconv) {
+  // Several patterns sharing one rectangle are stacked vertically by
+  // GRPCONV, so the image is taller than the header says.
+  const int width = 32, height = 24;
+  std::vector<uint32_t> canvas = MakeMaskedPicture(width, height);
+  std::vector<G00Region> regions = {{0, 0, 31, 23, {{0, 0, 32, 24}}},
+                                    {0, 0, 31, 23, {{4, 4, 16, 8}}},
+                                    {0, 0, 31, 23, {{0, 0, 32, 24}}}};
+  std::string file = BuildG00Type2(width, height, regions, canvas);
+  std::unique_ptr<GRPCONV> conv(
+      GRPCONV::AssignConverter(file.data(), file.size(), "test.g00"));
+  ASSERT_TRUE(conv.get());
+  EXPECT_EQ(height * 3, conv->height);
+  ExpectSameAsGrpconv(file, true);
+}
+
+TEST(G00DecoderTest, RejectsBackReferenceBeforeStart) {
+  // A 2x2 type 0 image whose first item is a back reference.
+  std::string file("\0\2\0\2\0", 5);
+  const char stream[] = {'\0', '\x10', '\0'};
+  const int data_size = 8 + sizeof(stream);
+  file += std::string(reinterpret_cast<const char*>(&data_size), 4);
+  file += std::string("\x0c\0\0\0", 4);
+  file += std::string(stream, sizeof(stream));
+
+  std::unique_ptr<GRPCONV> conv(
+      GRPCONV::AssignConverter(file.data(), file.size(), "test.g00"));
+  ASSERT_TRUE(conv.get());
+  std::vector<uint32_t> pixels(4);
+  bool has_alpha = false;
+  EXPECT_FALSE(DecodeG00(*conv, pixels.data(), &has_alpha));
+}
@@ -0,0 +1,236 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "g00_writer.h"
+
+#include <map>
+
+namespace {
+
+void AppendShort(std::string& out, int value) {
+  out += static_cast<char>(value & 0xff);
+  out += static_cast<char>((value >> 8) & 0xff);
+}
+
+void AppendInt(std::string& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    out += static_cast<char>((value >> (i * 8)) & 0xff);
+}
+
+void WriteInt(std::string& out, size_t position, uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    out[position + i] = static_cast<char>((value >> (i * 8)) & 0xff);
+}
+
+// Compresses |symbols| the way G00 files are: groups of eight items behind a
+// flag byte whose bits, least significant first, mark literals. A back
+// reference is (distance << 4 | (length - min_length)), counted in symbols.
+// Greedy, trying a handful of likely distances at each position.
+template <typename Symbol, typename LiteralWriter>
+std::string Compress(const std::vector<Symbol>& symbols,
+                     size_t min_length,
+                     LiteralWriter write_literal) {
+  const size_t kMaxDistance = 4095;
+  const size_t max_length = min_length + 15;
+
+  std::string out;
+  std::string items;
+  int flags = 0;
+  int item_count = 0;
+  std::map<Symbol, size_t> last_seen;
+
+  size_t i = 0;
+  while (i < symbols.size()) {
+    const size_t kFixed[] = {1, 2, 3, 4, 8, 16, 64};
+    std::vector<size_t> candidates(kFixed, kFixed + 7);
+    auto seen = last_seen.find(symbols[i]);
+    if (seen != last_seen.end())
+      candidates.push_back(i - seen->second);
+
+    size_t best_distance = 0, best_length = 0;
+    for (size_t distance : candidates) {
+      if (distance == 0 || distance > i || distance > kMaxDistance)
+        continue;
+      size_t length = 0;
+      while (length < max_length && i + length < symbols.size() &&
+             symbols[i + length] == symbols[i + length - distance])
+        ++length;
+      if (length > best_length) {
+        best_length = length;
+        best_distance = distance;
+      }
+    }
+
+    if (best_length >= min_length) {
+      AppendShort(items, (best_distance << 4) | (best_length - min_length));
+    } else {
+      flags |= 1 << item_count;
+      write_literal(items, symbols[i]);
+      best_length = 1;
+    }
+    for (size_t j = i; j < i + best_length; ++j)
+      last_seen[symbols[j]] = j;
+    i += best_length;
+
+    if (++item_count == 8) {
+      out += static_cast<char>(flags);
+      out += items;
+      items.clear();
+      flags = 0;
+      item_count = 0;
+    }
+  }
+  if (item_count) {
+    out += static_cast<char>(flags);
+    out += items;
+  }
+  return out;
+}
+
+std::string CompressBytes(const std::string& data) {
+  std::vector<unsigned char> bytes(data.begin(), data.end());
+  return Compress(bytes, 2, [](std::string& out, unsigned char byte) {
+    out += static_cast<char>(byte);
+  });
+}
+
+}  // namespace
+
+std::string BuildG00Type0(int width,
+                          int height,
+                          const std::vector<uint32_t>& pixels) {
+  std::vector<uint32_t> rgb;
+  for (uint32_t pixel : pixels)
+    rgb.push_back(pixel & 0xffffff);
+  std::string stream = Compress(rgb, 1, [](std::string& out, uint32_t pixel) {
+    out += static_cast<char>(pixel & 0xff);
+    out += static_cast<char>((pixel >> 8) & 0xff);
+    out += static_cast<char>((pixel >> 16) & 0xff);
+  });
+
+  std::string file(1, '\0');
+  AppendShort(file, width);
+  AppendShort(file, height);
+  AppendInt(file, 8 + stream.size());
+  AppendInt(file, width * height * 3);
+  return file + stream;
+}
+
+std::string BuildG00Type1(int width,
+                          int height,
+                          const std::vector<uint32_t>& palette,
+                          const std::vector<unsigned char>& indexes) {
+  std::string raw;
+  AppendShort(raw, palette.size());
+  for (uint32_t colour : palette)
+    AppendInt(raw, colour);
+  raw.append(indexes.begin(), indexes.end());
+  std::string stream = CompressBytes(raw);
+
+  std::string file(1, '\1');
+  AppendShort(file, width);
+  AppendShort(file, height);
+  AppendInt(file, 8 + stream.size());
+  // Readers add one to this.
+  AppendInt(file, raw.size() - 1);
+  return file + stream;
+}
+
+std::string BuildG00Type2(int width,
+                          int height,
+                          const std::vector<G00Region>& regions,
+                          const std::vector<uint32_t>& canvas) {
+  // The uncompressed data: a table of (offset, length) for each region, then
+  // each region's 0x74 byte header and its blocks, each with a 0x5c byte
+  // header.
+  std::string raw;
+  AppendInt(raw, regions.size());
+  raw.append(regions.size() * 8, '\0');
+  for (size_t i = 0; i < regions.size(); ++i) {
+    const G00Region& region = regions[i];
+    size_t offset = raw.size();
+    raw.append(0x74, '\0');
+    for (const G00Block& block : region.blocks) {
+      std::string header(0x5c, '\0');
+      header[0] = block.x & 0xff;
+      header[1] = block.x >> 8;
+      header[2] = block.y & 0xff;
+      header[3] = block.y >> 8;
+      header[6] = block.width & 0xff;
+      header[7] = block.width >> 8;
+      header[8] = block.height & 0xff;
+      header[9] = block.height >> 8;
+      raw += header;
+      for (int y = 0; y < block.height; ++y) {
+        for (int x = 0; x < block.width; ++x) {
+          AppendInt(raw, canvas[(region.y1 + block.y + y) * width +
+                                region.x1 + block.x + x]);
+        }
+      }
+    }
+    WriteInt(raw, 4 + i * 8, offset);
+    WriteInt(raw, 8 + i * 8, raw.size() - offset);
+  }
+  std::string stream = CompressBytes(raw);
+
+  std::string file(1, '\2');
+  AppendShort(file, width);
+  AppendShort(file, height);
+  AppendInt(file, regions.size());
+  for (const G00Region& region : regions) {
+    AppendInt(file, region.x1);
+    AppendInt(file, region.y1);
+    AppendInt(file, region.x2);
+    AppendInt(file, region.y2);
+    AppendInt(file, 0);
+    AppendInt(file, 0);
+  }
+  AppendInt(file, 8 + stream.size());
+  AppendInt(file, raw.size());
+  return file + stream;
+}
+
+std::vector<uint32_t> MakeTestPicture(int width, int height, uint32_t seed,
+                                      uint32_t alpha) {
+  std::vector<uint32_t> pixels(width * height);
+  uint32_t state = seed * 2654435761u + 1;
+  uint32_t colour = 0;
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    state = state * 1103515245 + 12345;
+    // Mostly runs, some noise, and now and then a copy of the row above.
+    int roll = (state >> 16) % 16;
+    if (roll == 0)
+      colour = state & 0xffffff;
+    if (roll == 1 && i >= static_cast<size_t>(width))
+      pixels[i] = pixels[i - width];
+    else if (roll == 2)
+      pixels[i] = ((state >> 8) & 0xffffff) | alpha;
+    else
+      pixels[i] = colour | alpha;
+  }
+  return pixels;
+}
@@ -0,0 +1,76 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#ifndef TEST_G00_WRITER_H_
+#define TEST_G00_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Builds G00 files in memory, so that the decoder can be tested without
+// shipping copyrighted images. Pixels are 0xAARRGGBB, as the decoders return
+// them. The LZ streams really are compressed, with both short and
+// overlapping back references, so they exercise every path of a decoder.
+
+// A 24-bit image. The alpha in |pixels| is dropped.
+std::string BuildG00Type0(int width,
+                          int height,
+                          const std::vector<uint32_t>& pixels);
+
+// A paletted image.
+std::string BuildG00Type1(int width,
+                          int height,
+                          const std::vector<uint32_t>& palette,
+                          const std::vector<unsigned char>& indexes);
+
+// A rectangle of pixels stored in a type 2 region. |x| and |y| are relative
+// to the region.
+struct G00Block {
+  int x, y, width, height;
+};
+
+// A type 2 region. |x2| and |y2| are inclusive, as in the file.
+struct G00Region {
+  int x1, y1, x2, y2;
+  std::vector<G00Block> blocks;
+};
+
+// A masked image made of |regions|, whose blocks take their pixels from
+// the |width| x |height| |canvas|.
+std::string BuildG00Type2(int width,
+                          int height,
+                          const std::vector<G00Region>& regions,
+                          const std::vector<uint32_t>& canvas);
+
+// Deterministic test pictures: runs of flat colour broken up by noise, so
+// they compress about as well as real artwork. |alpha| is ORed into every
+// pixel.
+std::vector<uint32_t> MakeTestPicture(int width, int height, uint32_t seed,
+                                      uint32_t alpha);
+
+#endif  // TEST_G00_WRITER_H_
@@ -0,0 +1,151 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+
+// Measures what it costs to persist a few seconds of play to disk, with the
+// global memory of a game that has been played for a while: appending the
+// changes to a journal versus rewriting the whole snapshot, which is all
+// saveGlobalMemory() could do before. Run from the root of the source tree:
+//
+//   ./build/rlvm_global_memory_journal_benchmark [flushes]
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "libreallive/archive.h"
+#include "libreallive/intmemref.h"
+#include "machine/memory.h"
+#include "machine/rlmachine.h"
+#include "machine/serialization.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+// Kidoku markers read in every one of this many scenarios.
+const int kScenarios = 200;
+const int kKidokuPerScenario = 1000;
+
+typedef std::chrono::steady_clock Clock;
+
+double Microseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+// A few seconds of play: some lines read, a couple of flags set.
+void Play(RLMachine& machine, int i) {
+  for (int line = 0; line < 10; ++line)
+    machine.memory().RecordKidoku(kScenarios, i * 10 + line);
+  machine.SetIntValue(libreallive::IntMemRef('G', i % 2000), i);
+  machine.SetIntValue(libreallive::IntMemRef('G', (i + 1) % 2000), i);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int flushes = argc > 1 ? std::stoi(argv[1]) : 200;
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  RLMachine machine(system, arc);
+  for (int scenario = 0; scenario < kScenarios; ++scenario) {
+    for (int kidoku = 0; kidoku < kKidokuPerScenario; ++kidoku)
+      machine.memory().RecordKidoku(scenario, kidoku);
+  }
+  for (int i = 0; i < SIZE_OF_MEM_BANK; ++i) {
+    machine.SetIntValue(libreallive::IntMemRef('G', i), i);
+    machine.SetStringValue(libreallive::STRM_LOCATION, i, std::to_string(i));
+  }
+
+  fs::path dir =
+      fs::temp_directory_path() / fs::unique_path("rlvm-global-%%%%-%%%%");
+  fs::create_directories(dir);
+  fs::path snapshot = dir / "global.sav.gz";
+  fs::path journal = dir / "global.journal";
+
+  // Compaction: start with everything in the snapshot.
+  {
+    fs::ofstream file(snapshot, std::ios::binary);
+    Serialization::saveGlobalMemoryTo(file, machine);
+  }
+  machine.memory().global().changes.Clear();
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < flushes; ++i) {
+    Play(machine, i);
+    fs::ofstream file(snapshot, std::ios::binary);
+    Serialization::saveGlobalMemoryTo(file, machine);
+  }
+  std::cout << "Rewriting the snapshot: "
+            << Microseconds(Clock::now() - start) / flushes << "us per flush, "
+            << fs::file_size(snapshot) << " bytes" << std::endl;
+  machine.memory().global().changes.Clear();
+
+  start = Clock::now();
+  for (int i = 0; i < flushes; ++i) {
+    Play(machine, i);
+    fs::ofstream file(journal, std::ios::binary | std::ios::app);
+    Serialization::flushGlobalMemoryJournalTo(file, machine);
+  }
+  std::cout << "Appending to a journal: "
+            << Microseconds(Clock::now() - start) / flushes << "us per flush, "
+            << fs::file_size(journal) / flushes << " bytes" << std::endl;
+
+  // flushGlobalMemoryJournal() doesn't even open the file in this case.
+  {
+    fs::ofstream file(journal, std::ios::binary | std::ios::app);
+    start = Clock::now();
+    for (int i = 0; i < flushes; ++i)
+      Serialization::flushGlobalMemoryJournalTo(file, machine);
+    std::cout << "Nothing to append:      "
+              << Microseconds(Clock::now() - start) / flushes << "us per flush"
+              << std::endl;
+  }
+
+  int replayed = 0;
+  {
+    RLMachine replay_machine(system, arc);
+    fs::ifstream snapshot_file(snapshot, std::ios::binary);
+    Serialization::loadGlobalMemoryFrom(snapshot_file, replay_machine);
+    start = Clock::now();
+    fs::ifstream journal_file(journal, std::ios::binary);
+    replayed = Serialization::replayGlobalMemoryJournalFrom(journal_file,
+                                                            replay_machine);
+    std::cout << "Replaying the journal:  "
+              << Microseconds(Clock::now() - start) << "us for " << replayed
+              << " records" << std::endl;
+  }
+
+  fs::remove_all(dir);
+  return replayed != flushes;
+}
@@ -0,0 +1,266 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+// Renders a page of text a glyph at a time, the way SDLTextSystem does, to
+// compare rasterizing every glyph with SDL_ttf against compositing coverage
+// masks from a GlyphCache. The cache is timed both cold (emptied before each
+// page) and warm (kept from the previous page). Run with:
+//
+//   ./build/rlvm_glyph_cache_benchmark <font.ttf> [font size] [passes]
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pygame/alphablit.h"
+#include "systems/base/glyph_cache.h"
+#include "systems/base/rect.h"
+#include "utf8cpp/utf8.h"
+
+namespace {
+
+const int kPageWidth = 640;
+const int kPageHeight = 480;
+
+// About as much as fits in a full screen text window: narration and dialogue
+// in kana and the common kanji, with the usual punctuation.
+const char kPage[] =
+    "\xe5\x9d\x82\xe3\x81\xae\xe4\xb8\x8b\xe3\x81\xa7\xe7\xab\x8b\xe3\x81\xa1"
+    "\xe6\xad\xa2\xe3\x81\xbe\xe3\x82\x8b\xe3\x80\x82\xe8\xa6\x8b\xe4\xb8\x8a"
+    "\xe3\x81\x92\xe3\x82\x8b\xe3\x81\xa8\xe3\x80\x81\xe6\xa1\x9c\xe3\x81\xae"
+    "\xe8\x8a\xb1\xe3\x81\xb3\xe3\x82\x89\xe3\x81\x8c\xe9\xa2\xa8\xe3\x81\xab"
+    "\xe8\x88\x9e\xe3\x81\xa3\xe3\x81\xa6\xe3\x81\x84\xe3\x81\x9f\xe3\x80\x82"
+    "\xe3\x80\x8c\xe3\x81\x93\xe3\x81\xae\xe7\x94\xba\xe3\x81\xaf\xe5\xa5\xbd"
+    "\xe3\x81\x8d\xe3\x81\xa7\xe3\x81\x99\xe3\x81\x8b\xef\xbc\x9f\xe3\x80\x8d"
+    "\xe3\x81\xb5\xe3\x81\xa8\xe3\x80\x81\xe9\x9a\xa3\xe3\x81\xab\xe7\xab\x8b"
+    "\xe3\x81\xa3\xe3\x81\x9f\xe5\xa5\xb3\xe3\x81\xae\xe5\xad\x90\xe3\x81\x8c"
+    "\xe8\x81\x9e\xe3\x81\x84\xe3\x81\x9f\xe3\x80\x82\xe3\x80\x8c\xe3\x82\x8f"
+    "\xe3\x81\x9f\xe3\x81\x97\xe3\x81\xaf\xe3\x80\x81\xe3\x81\xa8\xe3\x81\xa6"
+    "\xe3\x82\x82\xe5\xa5\xbd\xe3\x81\x8d\xe3\x81\xa7\xe3\x81\x99\xe3\x80\x82"
+    "\xe3\x81\xa7\xe3\x82\x82\xe3\x80\x81\xe3\x81\x84\xe3\x81\xa4\xe3\x81\x8b"
+    "\xe3\x81\xaf\xe5\xa4\x89\xe3\x82\x8f\xe3\x81\xa3\xe3\x81\xa6\xe3\x81\x97"
+    "\xe3\x81\xbe\xe3\x81\x86\xe3\x81\xae\xe3\x81\xa7\xe3\x81\x97\xe3\x82\x87"
+    "\xe3\x81\x86\xe3\x81\xad\xe3\x80\x8d\xe5\x83\x95\xe3\x81\xaf\xe4\xbd\x95"
+    "\xe3\x82\x82\xe7\xad\x94\xe3\x81\x88\xe3\x82\x89\xe3\x82\x8c\xe3\x81\xaa"
+    "\xe3\x81\x8b\xe3\x81\xa3\xe3\x81\x9f\xe3\x80\x82\xe3\x81\x9f\xe3\x81\xa0"
+    "\xe3\x80\x81\xe5\xa5\xb3\xe3\x81\xae\xe5\xad\x90\xe3\x81\xae\xe6\xa8\xaa"
+    "\xe9\xa1\x94\xe3\x82\x92\xe8\xa6\x8b\xe3\x81\xa6\xe3\x81\x84\xe3\x81\x9f"
+    "\xe3\x80\x82\xe3\x80\x8c\xe3\x81\x9d\xe3\x82\x8c\xe3\x81\xa7\xe3\x82\x82"
+    "\xe3\x80\x81\xe3\x81\x93\xe3\x81\xae\xe5\x9d\x82\xe9\x81\x93\xe3\x82\x92"
+    "\xe4\xb8\x8a\xe3\x81\xa3\xe3\x81\xa6\xe3\x81\x84\xe3\x81\x8f\xe3\x82\x93"
+    "\xe3\x81\xa7\xe3\x81\x99\xe3\x80\x82\xe6\xaf\x8e\xe6\x97\xa5\xe3\x80\x81"
+    "\xe6\xaf\x8e\xe6\x97\xa5\xe3\x80\x82\xe3\x80\x8d";
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::vector<std::string> SplitCharacters(const std::string& text) {
+  std::vector<std::string> characters;
+  std::string::const_iterator it = text.begin();
+  while (it != text.end()) {
+    std::string::const_iterator start = it;
+    utf8::next(it, text.end());
+    characters.emplace_back(start, it);
+  }
+  return characters;
+}
+
+// Lays characters out left to right, wrapping at the edge of the page.
+class Cursor {
+ public:
+  explicit Cursor(int line_height) : line_height_(line_height), x_(0), y_(0) {}
+
+  Point Advance(int width) {
+    if (x_ + width > kPageWidth) {
+      x_ = 0;
+      y_ = (y_ + line_height_) % (kPageHeight - line_height_);
+    }
+    Point at(x_, y_);
+    x_ += width;
+    return at;
+  }
+
+ private:
+  int line_height_;
+  int x_, y_;
+};
+
+// What SDLTextSystem::RenderGlyphOnto() did before the glyph cache: render
+// each character twice, once for the shadow, and blit both.
+void RenderWithTTF(TTF_Font* font,
+                   const std::vector<std::string>& characters,
+                   int font_size,
+                   SDL_Surface* page) {
+  SDL_Color colour = {255, 255, 255, 0};
+  SDL_Color shadow_colour = {0, 0, 0, 0};
+  Cursor cursor(font_size + 4);
+  for (const std::string& character : characters) {
+    SDL_Surface* glyph =
+        TTF_RenderUTF8_Blended(font, character.c_str(), colour);
+    SDL_Surface* shadow =
+        TTF_RenderUTF8_Blended(font, character.c_str(), shadow_colour);
+    Point at = cursor.Advance(glyph->w);
+
+    SDL_Rect src = {0, 0, static_cast<Uint16>(glyph->w),
+                    static_cast<Uint16>(glyph->h)};
+    SDL_Rect shadow_dst = {static_cast<Sint16>(at.x() + 2),
+                           static_cast<Sint16>(at.y() + 2), 0, 0};
+    SDL_Rect dst = {static_cast<Sint16>(at.x()), static_cast<Sint16>(at.y()),
+                    0, 0};
+    pygame_AlphaBlit(shadow, &src, page, &shadow_dst);
+    pygame_AlphaBlit(glyph, &src, page, &dst);
+    SDL_FreeSurface(shadow);
+    SDL_FreeSurface(glyph);
+  }
+}
+
+// The same steps as SDLTextSystem::GetGlyphMask().
+std::shared_ptr<const GlyphMask> GetGlyphMask(GlyphCache& cache,
+                                              TTF_Font* font,
+                                              const std::string& character,
+                                              int font_size) {
+  std::shared_ptr<const GlyphMask> mask =
+      cache.Fetch(character, font_size, false);
+  if (mask)
+    return mask;
+
+  SDL_Color white = {255, 255, 255, 0};
+  SDL_Surface* rendered =
+      TTF_RenderUTF8_Blended(font, character.c_str(), white);
+  std::shared_ptr<GlyphMask> new_mask(new GlyphMask);
+  new_mask->width = rendered->w;
+  new_mask->height = rendered->h;
+  new_mask->coverage.resize(rendered->w * rendered->h);
+  SDL_LockSurface(rendered);
+  for (int y = 0; y < rendered->h; ++y) {
+    const Uint32* row = reinterpret_cast<const Uint32*>(
+        static_cast<const Uint8*>(rendered->pixels) + y * rendered->pitch);
+    for (int x = 0; x < rendered->w; ++x) {
+      new_mask->coverage[y * rendered->w + x] =
+          (row[x] & rendered->format->Amask) >> rendered->format->Ashift;
+    }
+  }
+  SDL_UnlockSurface(rendered);
+  SDL_FreeSurface(rendered);
+
+  cache.Insert(character, font_size, false, new_mask);
+  return new_mask;
+}
+
+void RenderWithCache(GlyphCache& cache,
+                     TTF_Font* font,
+                     const std::vector<std::string>& characters,
+                     int font_size,
+                     SDL_Surface* page) {
+  Cursor cursor(font_size + 4);
+  Size page_size(page->w, page->h);
+  SDL_LockSurface(page);
+  for (const std::string& character : characters) {
+    std::shared_ptr<const GlyphMask> mask =
+        GetGlyphMask(cache, font, character, font_size);
+    Point at = cursor.Advance(mask->width);
+    Uint8* pixels = static_cast<Uint8*>(page->pixels);
+    CompositeGlyph(*mask, 0x000000, at + Point(2, 2), pixels, page->pitch,
+                   page_size);
+    CompositeGlyph(*mask, 0xffffff, at, pixels, page->pitch, page_size);
+  }
+  SDL_UnlockSurface(page);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <font.ttf> [font size] [passes]"
+              << std::endl;
+    return 1;
+  }
+  int font_size = argc > 2 ? std::stoi(argv[2]) : 25;
+  int passes = argc > 3 ? std::stoi(argv[3]) : 20;
+
+  if (TTF_Init() == -1) {
+    std::cerr << "TTF_Init: " << TTF_GetError() << std::endl;
+    return 1;
+  }
+  TTF_Font* font = TTF_OpenFont(argv[1], font_size);
+  if (!font) {
+    std::cerr << "TTF_OpenFont: " << TTF_GetError() << std::endl;
+    return 1;
+  }
+
+  SDL_Surface* page = SDL_CreateRGBSurface(SDL_SWSURFACE, kPageWidth,
+                                           kPageHeight, 32, 0xff0000, 0xff00,
+                                           0xff, 0xff000000);
+  std::vector<std::string> characters = SplitCharacters(kPage);
+
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < passes; ++pass)
+    RenderWithTTF(font, characters, font_size, page);
+  Clock::duration ttf = Clock::now() - start;
+
+  GlyphCache cold_cache(0);
+  start = Clock::now();
+  for (int pass = 0; pass < passes; ++pass) {
+    cold_cache.Clear();
+    RenderWithCache(cold_cache, font, characters, font_size, page);
+  }
+  Clock::duration cold = Clock::now() - start;
+
+  GlyphCache warm_cache(0);
+  RenderWithCache(warm_cache, font, characters, font_size, page);
+  int first_page_misses = warm_cache.misses();
+  start = Clock::now();
+  for (int pass = 0; pass < passes; ++pass)
+    RenderWithCache(warm_cache, font, characters, font_size, page);
+  Clock::duration warm = Clock::now() - start;
+
+  int fetches = warm_cache.hits() + warm_cache.misses();
+  std::cout << characters.size() << " characters, "
+            << first_page_misses << " distinct; "
+            << warm_cache.memory() / 1024 << " KiB of masks" << std::endl;
+  std::cout << "SDL_ttf per glyph: " << Milliseconds(ttf) / passes
+            << "ms per page" << std::endl;
+  std::cout << "Glyph cache, cold: " << Milliseconds(cold) / passes
+            << "ms per page" << std::endl;
+  std::cout << "Glyph cache, warm: " << Milliseconds(warm) / passes
+            << "ms per page (" << warm_cache.hits() * 100 / fetches
+            << "% hit rate overall)" << std::endl;
+
+  SDL_FreeSurface(page);
+  TTF_CloseFont(font);
+  TTF_Quit();
+  return 0;
+}
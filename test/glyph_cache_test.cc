@@ -0,0 +1,148 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "systems/base/glyph_cache.h"
+#include "systems/base/rect.h"
+
+namespace {
+
+std::shared_ptr<const GlyphMask> MakeMask(int width, int height) {
+  std::shared_ptr<GlyphMask> mask(new GlyphMask);
+  mask->width = width;
+  mask->height = height;
+  mask->coverage.assign(width * height, 255);
+  return mask;
+}
+
+}  // namespace
+
+TEST(GlyphCacheTest, KeysOnSizeAndStyle) {
+  GlyphCache cache(0);
+  std::shared_ptr<const GlyphMask> plain = MakeMask(10, 12);
+  std::shared_ptr<const GlyphMask> italic = MakeMask(11, 12);
+  std::shared_ptr<const GlyphMask> large = MakeMask(20, 24);
+  cache.Insert("\xe3\x81\x82", 12, false, plain);
+  cache.Insert("\xe3\x81\x82", 12, true, italic);
+  cache.Insert("\xe3\x81\x82", 24, false, large);
+
+  EXPECT_EQ(plain, cache.Fetch("\xe3\x81\x82", 12, false));
+  EXPECT_EQ(italic, cache.Fetch("\xe3\x81\x82", 12, true));
+  EXPECT_EQ(large, cache.Fetch("\xe3\x81\x82", 24, false));
+  EXPECT_FALSE(cache.Fetch("\xe3\x81\x84", 12, false).get());
+  EXPECT_EQ(3, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(10u * 12 + 11 * 12 + 20 * 24, cache.memory());
+}
+
+TEST(GlyphCacheTest, EvictsLeastRecentlyUsed) {
+  // Room for three 10x10 masks.
+  GlyphCache cache(300);
+  cache.Insert("a", 10, false, MakeMask(10, 10));
+  cache.Insert("b", 10, false, MakeMask(10, 10));
+  cache.Insert("c", 10, false, MakeMask(10, 10));
+
+  // Using "a" makes "b" the oldest.
+  EXPECT_TRUE(cache.Fetch("a", 10, false).get());
+  cache.Insert("d", 10, false, MakeMask(10, 10));
+
+  EXPECT_TRUE(cache.Fetch("a", 10, false).get());
+  EXPECT_FALSE(cache.Fetch("b", 10, false).get());
+  EXPECT_TRUE(cache.Fetch("c", 10, false).get());
+  EXPECT_TRUE(cache.Fetch("d", 10, false).get());
+  EXPECT_EQ(1, cache.evictions());
+  EXPECT_EQ(300u, cache.memory());
+
+  // A mask bigger than the whole budget is still kept until the next insert.
+  cache.Insert("huge", 10, false, MakeMask(40, 40));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_TRUE(cache.Fetch("huge", 10, false).get());
+}
+
+TEST(GlyphCacheTest, ReplacingAnEntryUpdatesMemory) {
+  GlyphCache cache(0);
+  cache.Insert("a", 10, false, MakeMask(10, 10));
+  cache.Insert("a", 10, false, MakeMask(5, 5));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(25u, cache.memory());
+
+  cache.Clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0u, cache.memory());
+}
+
+TEST(GlyphCacheTest, CompositeClipsToTheImage) {
+  const int kWidth = 8, kHeight = 6;
+  std::vector<uint32_t> pixels(kWidth * kHeight, 0);
+  std::shared_ptr<const GlyphMask> mask = MakeMask(4, 4);
+
+  // Hangs off the top left and bottom right corners.
+  CompositeGlyph(*mask, 0x123456, Point(-2, -1),
+                 reinterpret_cast<uint8_t*>(pixels.data()),
+                 kWidth * sizeof(uint32_t), Size(kWidth, kHeight));
+  CompositeGlyph(*mask, 0xabcdef, Point(6, 4),
+                 reinterpret_cast<uint8_t*>(pixels.data()),
+                 kWidth * sizeof(uint32_t), Size(kWidth, kHeight));
+  // Entirely outside.
+  CompositeGlyph(*mask, 0xffffff, Point(20, 0),
+                 reinterpret_cast<uint8_t*>(pixels.data()),
+                 kWidth * sizeof(uint32_t), Size(kWidth, kHeight));
+
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      uint32_t expected = 0;
+      if (x < 2 && y < 3)
+        expected = 0xff123456;
+      else if (x >= 6 && y >= 4)
+        expected = 0xffabcdef;
+      EXPECT_EQ(expected, pixels[y * kWidth + x]) << x << ", " << y;
+    }
+  }
+}
+
+TEST(GlyphCacheTest, CompositeHonoursPitch) {
+  // Rows padded to 5 pixels, of which the image uses 3.
+  std::vector<uint32_t> pixels(5 * 2, 0);
+  std::shared_ptr<GlyphMask> mask(new GlyphMask);
+  mask->width = 3;
+  mask->height = 2;
+  mask->coverage = {255, 0, 255, 0, 255, 0};
+  CompositeGlyph(*mask, 0x0000ff, Point(0, 0),
+                 reinterpret_cast<uint8_t*>(pixels.data()),
+                 5 * sizeof(uint32_t), Size(3, 2));
+
+  std::vector<uint32_t> expected = {0xff0000ff, 0, 0xff0000ff, 0, 0,
+                                    0, 0xff0000ff, 0, 0, 0};
+  EXPECT_EQ(expected, pixels);
+}
@@ -33,8 +33,10 @@
 #include <boost/serialization/scoped_ptr.hpp>
 
 #include <boost/scoped_ptr.hpp>
+#include <cstdio>
 #include <functional>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -369,3 +371,54 @@ TEST_F(GraphicsObjectTest, RunMutatorsOnChildObjects) {
   parent.Execute(rlmachine);
   EXPECT_TRUE(mutator_test->called());
 }
+
+// Returns the object numbers in the order RenderObjects() draws them.
+static std::vector<int> RenderOrder(TestGraphicsSystem& graphics) {
+  std::ostringstream tree;
+  graphics.Refresh(&tree);
+
+  std::vector<int> order;
+  std::istringstream lines(tree.str());
+  std::string line;
+  while (std::getline(lines, line)) {
+    int num;
+    if (sscanf(line.c_str(), "Object #%d:", &num) == 1)
+      order.push_back(num);
+  }
+  return order;
+}
+
+TEST_F(GraphicsObjectTest, RenderOrderFollowsChanges) {
+  TestGraphicsSystem& graphics = system.graphics();
+  for (int i = 0; i < 3; ++i) {
+    GraphicsObject& obj = graphics.GetObject(0, i);
+    obj.SetObjectData(
+        new ColourFilterObjectData(graphics, Rect(0, 0, Size(10, 10))));
+    obj.SetVisible(1);
+  }
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), RenderOrder(graphics));
+
+  // Reordering an object is picked up by the next frame.
+  graphics.GetObject(0, 0).SetZOrder(5);
+  EXPECT_EQ(std::vector<int>({1, 2, 0}), RenderOrder(graphics));
+  graphics.GetObject(0, 2).SetZLayer(-1);
+  EXPECT_EQ(std::vector<int>({2, 1, 0}), RenderOrder(graphics));
+
+  // So are new objects, and objects that are cleared.
+  GraphicsObject& added = graphics.GetObject(0, 3);
+  added.SetObjectData(
+      new ColourFilterObjectData(graphics, Rect(0, 0, Size(10, 10))));
+  added.SetVisible(1);
+  added.SetZOrder(1);
+  EXPECT_EQ(std::vector<int>({2, 1, 3, 0}), RenderOrder(graphics));
+  graphics.GetObject(0, 0).FreeDataAndInitializeParams();
+  EXPECT_EQ(std::vector<int>({2, 1, 3}), RenderOrder(graphics));
+
+  // Promotion replaces the foreground with the background.
+  GraphicsObject& bg = graphics.GetObject(1, 4);
+  bg.SetObjectData(
+      new ColourFilterObjectData(graphics, Rect(0, 0, Size(10, 10))));
+  bg.SetVisible(1);
+  graphics.ClearAndPromoteObjects();
+  EXPECT_EQ(std::vector<int>({4}), RenderOrder(graphics));
+}
@@ -0,0 +1,114 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+
+// Measures replaying a full graphics stack, the part of loading a save game
+// that redraws the DCs: 127 buffer loads cycling through DCs 2 to 5, as a
+// script that preloads its sprites leaves behind. Replay only needs the last
+// load into each DC. Compares that against replaying every command, which is
+// what happens when the stack has no record of what its commands do, as in
+// saves from older versions. (A full load resets the mock surfaces of the test
+// system, which needs a running test, and the test system doesn't decode
+// images; in a real game each skipped command is also an image decode.) Run
+// from the root of the source tree:
+//
+//   ./build/rlvm_graphics_stack_benchmark [loads]
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "libreallive/archive.h"
+#include "modules/module_grp.h"
+#include "systems/base/graphics_system.h"
+#include "test_system/test_machine.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Puts |stack| back on the graphics stack and replays it |loads| times.
+// Returns the size of the stack afterwards.
+size_t TimeReplays(TestMachine& machine,
+                   const std::deque<GraphicsStackCommand>& stack,
+                   int loads,
+                   const char* label) {
+  GraphicsSystem& graphics = machine.system().graphics();
+  Clock::duration elapsed = Clock::duration::zero();
+  for (int i = 0; i < loads; ++i) {
+    graphics.ClearStack();
+    for (const GraphicsStackCommand& command : stack)
+      graphics.AddGraphicsStackCommand(command);
+
+    Clock::time_point start = Clock::now();
+    graphics.ReplayGraphicsStack(machine);
+    elapsed += Clock::now() - start;
+  }
+
+  int commands_run = 0;
+  for (bool skip : FindOverwrittenGraphicsStackCommands(stack))
+    commands_run += !skip;
+  std::cout << label << Milliseconds(elapsed) / loads << "ms per load, "
+            << commands_run << " of " << stack.size() << " commands run"
+            << std::endl;
+  return graphics.StackSize();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int loads = argc > 1 ? std::stoi(argv[1]) : 200;
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  TestMachine machine(system, arc);
+  machine.AttachModule(new GrpModule);
+
+  for (int i = 0; i < 127; ++i)
+    machine.Exe("grpBuffer", 0, TestMachine::Arg("file", 2 + i % 4));
+  std::deque<GraphicsStackCommand> stack =
+      system.graphics().graphics_stack();
+  size_t size =
+      TimeReplays(machine, stack, loads, "Skipping overwritten loads: ");
+
+  // The same stack without effects, as loaded from an older save.
+  std::deque<GraphicsStackCommand> old_stack;
+  for (const GraphicsStackCommand& command : stack)
+    old_stack.push_back(GraphicsStackCommand(command.bytecode));
+  size +=
+      TimeReplays(machine, old_stack, loads, "Replaying every command:    ");
+
+  return size != 2 * stack.size();
+}
@@ -0,0 +1,161 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "systems/base/image_decoder.h"
+#include "test_system/mock_surface.h"
+#include "test_system/test_graphics_system.h"
+#include "test_system/test_system.h"
+#include "utilities/exception.h"
+
+#include "test_utils.h"
+
+namespace {
+
+std::shared_ptr<DecodedImage> MakeImage(int width, int height) {
+  std::shared_ptr<DecodedImage> image(new DecodedImage);
+  image->width = width;
+  image->height = height;
+  image->pixels.reset(static_cast<char*>(malloc(width * height * 4)));
+  image->has_alpha = false;
+  return image;
+}
+
+// A graphics system that "decodes" on an ImageDecoder thread. Decodes block
+// until Release() is called so tests can see what happens while they're in
+// flight.
+class DecodingGraphicsSystem : public TestGraphicsSystem {
+ public:
+  DecodingGraphicsSystem(System& system, Gameexe& gexe)
+      : TestGraphicsSystem(system, gexe), decodes(0), released_(false) {
+    image_decoder_.reset(new ImageDecoder(2));
+  }
+
+  ~DecodingGraphicsSystem() {
+    // Our tasks refer to us, so stop them before we go away.
+    Release();
+    image_decoder_.reset();
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = true;
+    release_.notify_all();
+  }
+
+  std::atomic<int> decodes;
+
+ private:
+  virtual ImageDecoder::Task GetDecodeTask(
+      const std::string& short_filename) override {
+    return [this]() {
+      decodes++;
+      std::unique_lock<std::mutex> lock(mutex_);
+      release_.wait(lock, [&] { return released_; });
+      return MakeImage(8, 6);
+    };
+  }
+
+  virtual std::shared_ptr<const Surface> BuildSurfaceFromImage(
+      const std::string& short_filename,
+      DecodedImage& image) override {
+    return std::shared_ptr<const Surface>(
+        MockSurface::Create(short_filename, Size(image.width, image.height)));
+  }
+
+  std::mutex mutex_;
+  std::condition_variable release_;
+  bool released_;
+};
+
+class ImageDecoderTest : public ::testing::Test {
+ protected:
+  ImageDecoderTest()
+      : system(locateTestCase("Gameexe_data/Gameexe.ini")),
+        graphics(system, system.gameexe()) {}
+
+  TestSystem system;
+  DecodingGraphicsSystem graphics;
+};
+
+}  // namespace
+
+TEST(ImageDecoder, ReturnsDecodedImages) {
+  ImageDecoder decoder(2);
+  ImageDecoder::Result first = decoder.Decode([] { return MakeImage(4, 3); });
+  ImageDecoder::Result second = decoder.Decode([] { return MakeImage(2, 1); });
+  EXPECT_EQ(4, first.get()->width);
+  EXPECT_EQ(3, first.get()->height);
+  EXPECT_EQ(2, second.get()->width);
+}
+
+TEST(ImageDecoder, RethrowsDecodeErrors) {
+  ImageDecoder decoder(1);
+  ImageDecoder::Result result =
+      decoder.Decode([]() -> std::shared_ptr<DecodedImage> {
+        throw rlvm::Exception("Could not find image file");
+      });
+  EXPECT_THROW(result.get(), rlvm::Exception);
+}
+
+TEST_F(ImageDecoderTest, RequestDoesNotBlockOrDecodeTwice) {
+  EXPECT_FALSE(graphics.RequestSurface("BG01"));
+  EXPECT_FALSE(graphics.RequestSurface("BG01"));
+
+  // Asking for it while it's in flight waits on the decode already running.
+  graphics.Release();
+  std::shared_ptr<const Surface> surface = graphics.GetSurfaceNamed("BG01");
+  EXPECT_EQ(Size(8, 6), surface->GetSize());
+  EXPECT_EQ(1, graphics.decodes);
+
+  EXPECT_TRUE(graphics.RequestSurface("BG01"));
+  EXPECT_EQ(surface, graphics.GetSurfaceNamed("BG01"));
+  EXPECT_EQ(1, graphics.decodes);
+}
+
+TEST_F(ImageDecoderTest, PollingMovesFinishedDecodesIntoTheCache) {
+  graphics.Release();
+  while (!graphics.RequestSurface("BG02"))
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  EXPECT_EQ(Size(8, 6), graphics.GetSurfaceNamed("BG02")->GetSize());
+  EXPECT_EQ(1, graphics.decodes);
+}
+
+TEST_F(ImageDecoderTest, RequestWithoutDecoderLoadsImmediately) {
+  EXPECT_TRUE(system.graphics().RequestSurface("BG03"));
+}
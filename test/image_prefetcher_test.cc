@@ -0,0 +1,127 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libreallive/bytecode.h"
+#include "systems/base/image_prefetcher.h"
+
+#include "test_utils.h"
+
+using libreallive::BytecodeList;
+
+namespace {
+
+std::string IntParam(int value) {
+  std::string param("$\xff");
+  for (int i = 0; i < 4; ++i)
+    param.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  return param;
+}
+
+// The bytecode of a call to op<1:module:opcode, 0>(params...).
+std::string Function(int module,
+                     int opcode,
+                     const std::vector<std::string>& params) {
+  const char command[8] = {'#', 1, static_cast<char>(module),
+                           static_cast<char>(opcode & 0xff),
+                           static_cast<char>(opcode >> 8),
+                           static_cast<char>(params.size()), 0, 0};
+  std::string bytecode(command, 8);
+  if (!params.empty()) {
+    bytecode.push_back('(');
+    for (const std::string& param : params)
+      bytecode.append(param);
+    bytecode.push_back(')');
+  }
+  return bytecode;
+}
+
+}  // namespace
+
+class ImagePrefetcherTest : public FullSystemTest {
+ protected:
+  // Builds:
+  //
+  //   <instruction pointer>
+  //   grpOpenBg('BG001', 0)
+  //   objOfText(0, 'TEXT')
+  //   objOfFile(0, 'CHR01')
+  //   grpLoad('???', 1)
+  //   goto @7
+  //   grpLoad('DEAD', 1)
+  //   @7 recOpenBg('BG002', 0)
+  //   grpOpenBg('BG001', 0)
+  ImagePrefetcherTest() {
+    libreallive::ConstructionData cdata(0);
+    elements.Read(",", NULL, cdata);
+    elements.AppendFunction(Function(33, 73, {"BG001", IntParam(0)}).c_str());
+    elements.AppendFunction(Function(71, 1200, {IntParam(0), "TEXT"}).c_str());
+    elements.AppendFunction(Function(71, 1000, {IntParam(0), "CHR01"}).c_str());
+    elements.AppendFunction(Function(33, 50, {"???", IntParam(1)}).c_str());
+
+    const char goto_command[12] = {'#', 0, 1, 0, 0, 0, 0, 0, 7, 0, 0, 0};
+    elements.Read(goto_command, goto_command + 12, cdata);
+
+    elements.AppendFunction(Function(33, 50, {"DEAD", IntParam(1)}).c_str());
+    elements.AppendFunction(Function(33, 1053, {"BG002", IntParam(0)}).c_str());
+    elements.AppendFunction(Function(33, 73, {"BG001", IntParam(0)}).c_str());
+
+    // Pretend every element is one byte long, so the goto's target of 7 is
+    // the element at index 7.
+    for (size_t i = 0; i < elements.size(); ++i)
+      cdata.offsets.push_back(i);
+    elements.SetPointers(cdata);
+  }
+
+  BytecodeList elements;
+};
+
+TEST_F(ImagePrefetcherTest, FindsConstantFileNames) {
+  std::vector<std::string> names =
+      ImagePrefetcher::ScanForImages(rlmachine, elements, 0, 10);
+  std::vector<std::string> expected = {"BG001", "CHR01", "BG002"};
+  EXPECT_EQ(expected, names);
+}
+
+TEST_F(ImagePrefetcherTest, StopsAfterMaxNames) {
+  std::vector<std::string> names =
+      ImagePrefetcher::ScanForImages(rlmachine, elements, 0, 2);
+  std::vector<std::string> expected = {"BG001", "CHR01"};
+  EXPECT_EQ(expected, names);
+}
+
+TEST_F(ImagePrefetcherTest, StartsAfterInstructionPointer) {
+  std::vector<std::string> names =
+      ImagePrefetcher::ScanForImages(rlmachine, elements, 1, 10);
+  std::vector<std::string> expected = {"CHR01", "BG002", "BG001"};
+  EXPECT_EQ(expected, names);
+}
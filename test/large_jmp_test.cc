@@ -28,6 +28,7 @@
 #include "gtest/gtest.h"
 
 #include "libreallive/archive.h"
+#include "libreallive/bytecode.h"
 #include "libreallive/intmemref.h"
 #include "machine/rlmachine.h"
 #include "modules/module_jmp.h"
@@ -577,6 +578,128 @@ TEST(LargeJmpTest, farcall) {
   }
 }
 
+// Tests that a scenario cache budget never evicts scenarios that are still on
+// the call stack, using the same SEEN files as the farcall test.
+TEST(LargeJmpTest, farcallWithScenarioBudget) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  arc.set_scenario_budget(1);
+  TestSystem system;
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new JmpModule);
+  rlmachine.SetIntValue(IntMemRef('B', 0), 2);
+  rlmachine.ExecuteUntilHalted();
+
+  EXPECT_EQ(2, rlmachine.GetIntValue(IntMemRef('A', 1)));
+  EXPECT_EQ(1, rlmachine.GetIntValue(IntMemRef('A', 2)))
+      << "We didn't return correctly from the farcall!";
+
+  // SEEN0001 was running when SEEN0002 was loaded, so both are still
+  // resident even though they're over budget.
+  std::map<int, size_t> sizes = arc.GetResidentScenarioSizes();
+  ASSERT_EQ(2u, sizes.size());
+  EXPECT_LT(0u, sizes[1]);
+  EXPECT_LT(0u, sizes[2]);
+  EXPECT_EQ(sizes[1] + sizes[2], arc.resident_size());
+
+  // Now that we've returned, only SEEN0001 is referenced by the stack.
+  arc.TrimScenarioCache();
+  sizes = arc.GetResidentScenarioSizes();
+  ASSERT_EQ(1u, sizes.size());
+  EXPECT_EQ(1u, sizes.count(1));
+  EXPECT_EQ(sizes[1], arc.resident_size());
+}
+
+// Tests that scenarios parsed by the preload thread behave the same as ones
+// parsed on demand.
+TEST(LargeJmpTest, farcallWithPreload) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  arc.StartPreload();
+  TestSystem system;
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new JmpModule);
+  rlmachine.SetIntValue(IntMemRef('B', 0), 2);
+  rlmachine.ExecuteUntilHalted();
+
+  EXPECT_EQ(2, rlmachine.GetIntValue(IntMemRef('A', 1)));
+  EXPECT_EQ(1, rlmachine.GetIntValue(IntMemRef('A', 2)))
+      << "We didn't return correctly from the farcall!";
+  EXPECT_EQ(2u, arc.GetResidentScenarioSizes().size());
+}
+
+// Tests that preloaded scenarios are charged to the same budget as ones parsed
+// on demand, so the preload thread can't hold memory the cache doesn't know
+// about.
+TEST(LargeJmpTest, farcallWithPreloadAndScenarioBudget) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  arc.set_scenario_budget(1);
+  arc.StartPreload();
+  TestSystem system;
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new JmpModule);
+  rlmachine.SetIntValue(IntMemRef('B', 0), 2);
+  rlmachine.ExecuteUntilHalted();
+
+  EXPECT_EQ(2, rlmachine.GetIntValue(IntMemRef('A', 1)));
+  EXPECT_EQ(1, rlmachine.GetIntValue(IntMemRef('A', 2)))
+      << "We didn't return correctly from the farcall!";
+
+  // The budget was full after the first scenario, so the preload thread
+  // parsed at most one of them, and whichever it was has been taken.
+  arc.TrimScenarioCache();
+  std::map<int, size_t> sizes = arc.GetResidentScenarioSizes();
+  ASSERT_EQ(1u, sizes.size());
+  EXPECT_EQ(1u, sizes.count(1));
+  EXPECT_EQ(sizes[1], arc.resident_size());
+}
+
+TEST(LargeJmpTest, validateFarcallArchive) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  std::vector<libreallive::Archive::ScenarioReport> reports =
+      arc.ValidateScenarios();
+  ASSERT_EQ(2u, reports.size());
+  for (const auto& report : reports) {
+    libreallive::Scenario* scenario = arc.GetScenario(report.index);
+    ASSERT_TRUE(scenario);
+    EXPECT_EQ("", report.error);
+    EXPECT_EQ(static_cast<size_t>(scenario->size()), report.elements);
+    EXPECT_EQ(scenario->bytecode_length(), report.bytecode_length);
+  }
+}
+
+TEST(LargeJmpTest, farcallWithEagerParameterParsing) {
+  libreallive::Archive arc(
+      locateTestCase("Module_Jmp_SEEN/farcallTest_0.TXT"));
+  TestSystem system;
+  RLMachine rlmachine(system, arc);
+  rlmachine.AttachModule(new JmpModule);
+  rlmachine.SetEagerParameterParsing(true);
+
+  // SEEN0001 was preparsed when we turned eager parsing on.
+  const libreallive::BytecodeList& bytecode = rlmachine.Scenario().bytecode();
+  for (libreallive::pointer_t i = 0; i < rlmachine.Scenario().size(); ++i) {
+    if (!bytecode[i].is_command())
+      continue;
+    CommandElement command = bytecode.command(i);
+    if (rlmachine.GetOperation(command)) {
+      EXPECT_TRUE(command.AreParametersParsed());
+    }
+  }
+
+  // SEEN0002 is preparsed when the farcall loads it; there's nothing left to
+  // do afterwards.
+  rlmachine.SetIntValue(IntMemRef('B', 0), 2);
+  rlmachine.ExecuteUntilHalted();
+  EXPECT_EQ(0, rlmachine.PreparseParameters(*arc.GetScenario(2)));
+
+  EXPECT_EQ(2, rlmachine.GetIntValue(IntMemRef('A', 1)));
+  EXPECT_EQ(1, rlmachine.GetIntValue(IntMemRef('A', 2)))
+      << "We didn't return correctly from the farcall!";
+}
+
 // -----------------------------------------------------------------------
 
 // Tests gosub_with
@@ -0,0 +1,94 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+// Measures walking the allocated entries of a mostly empty LazyArray, the
+// shape of an object layer with a handful of live objects, and looking up
+// preloaded g00 images by name. Run from the root of the source tree:
+//
+//   ./build/rlvm_lazy_array_benchmark [iterations]
+
+#include "gmock/gmock.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "systems/base/graphics_system.h"
+#include "test_system/test_graphics_system.h"
+#include "test_system/test_system.h"
+#include "utilities/lazy_array.h"
+
+#include "test_utils.h"
+
+namespace {
+
+const int kSlots = 256;
+const int kLive = 8;
+
+typedef std::chrono::steady_clock Clock;
+
+double Nanoseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::nano>(d).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+  LazyArray<int> layer(kSlots);
+  for (int i = 0; i < kLive; ++i)
+    layer[(i * 97) % kSlots] = i;
+
+  int sum = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (int value : layer)
+      sum += value;
+  }
+  std::cout << "Iterate " << kLive << " of " << kSlots << " slots: "
+            << Nanoseconds(Clock::now() - start) / iterations << "ns"
+            << std::endl;
+
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  GraphicsSystem& graphics = system.graphics();
+  for (int i = 0; i < kLive; ++i)
+    graphics.PreloadG00(i * 31, "BG0" + std::to_string(i));
+
+  int found = 0;
+  start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    if (graphics.GetPreloadedG00(i % 2 ? "BG07" : "MISSING"))
+      found++;
+  }
+  std::cout << "Preloaded g00 lookup: "
+            << Nanoseconds(Clock::now() - start) / iterations << "ns"
+            << std::endl;
+
+  // Keep the loops from being optimized away.
+  return sum == -1 || found == -1;
+}
@@ -92,6 +92,15 @@ class LazyArrayTest : public ::testing::Test {
       }
     }
   }
+
+  // Returns the positions that AllocatedLazyArrayIterator stops on.
+  template <typename T>
+  vector<int> allocatedPositions(LazyArray<T>& in) {
+    vector<int> positions;
+    for (AllocatedLazyArrayIterator<T> it = in.begin(); it != in.end(); ++it)
+      positions.push_back(it.pos());
+    return positions;
+  }
 };
 
 // -----------------------------------------------------------------------
@@ -181,3 +190,73 @@ TEST_F(LazyArrayTest, Serialization) {
     checkArray(newArray);
   }
 }
+
+TEST_F(LazyArrayTest, IterationSkipsDeletedItems) {
+  LazyArray<int> lazyArray(SIZE);
+  populateIntArray(lazyArray);
+
+  lazyArray.DeleteAt(0);
+  lazyArray.DeleteAt(4);
+  EXPECT_EQ(vector<int>({2, 6, 8}), allocatedPositions(lazyArray));
+
+  lazyArray.Clear();
+  EXPECT_TRUE(lazyArray.begin() == lazyArray.end())
+      << "Allocated Lazy iterator is valid on a cleared array";
+
+  lazyArray[5] = 5;
+  EXPECT_EQ(vector<int>({5}), allocatedPositions(lazyArray));
+}
+
+// Iteration has to find items on either side of each 64 slot word.
+TEST_F(LazyArrayTest, SparseIterationAcrossWords) {
+  const vector<int> positions = {0, 63, 64, 127, 130, 299};
+  LazyArray<int> lazyArray(300);
+  for (int pos : positions)
+    lazyArray[pos] = pos;
+  EXPECT_EQ(positions, allocatedPositions(lazyArray));
+
+  for (AllocatedLazyArrayIterator<int> it = lazyArray.begin();
+       it != lazyArray.end();
+       ++it) {
+    EXPECT_EQ(it.pos(), *it);
+  }
+
+  lazyArray.DeleteAt(63);
+  lazyArray.DeleteAt(299);
+  EXPECT_EQ(vector<int>({0, 64, 127, 130}), allocatedPositions(lazyArray));
+}
+
+TEST_F(LazyArrayTest, CopyToTracksAllocatedItems) {
+  LazyArray<int> source(100);
+  source[3] = 3;
+  source[70] = 70;
+
+  LazyArray<int> destination(100);
+  destination[3] = 10;
+  destination[4] = 4;
+  destination[99] = 99;
+
+  source.CopyTo(destination);
+  EXPECT_EQ(vector<int>({3, 70}), allocatedPositions(destination));
+  EXPECT_EQ(3, destination[3]);
+  EXPECT_EQ(70, destination[70]);
+}
+
+TEST_F(LazyArrayTest, SerializationRestoresIteration) {
+  stringstream ss;
+
+  LazyArray<IntWrapper> lazyArray(200);
+  lazyArray[1] = 1;
+  lazyArray[150] = 150;
+  {
+    boost::archive::text_oarchive oa(ss);
+    oa << const_cast<const LazyArray<IntWrapper>&>(lazyArray);
+  }
+  {
+    LazyArray<IntWrapper> newArray(SIZE);
+    boost::archive::text_iarchive ia(ss);
+    ia >> newArray;
+    EXPECT_EQ(200, newArray.size());
+    EXPECT_EQ(vector<int>({1, 150}), allocatedPositions(newArray));
+  }
+}
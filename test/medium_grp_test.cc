@@ -26,9 +26,13 @@
 
 #include "gtest/gtest.h"
 
+#include <memory>
+#include <vector>
+
 #include "machine/rlmachine.h"
 #include "modules/module_grp.h"
 #include "systems/base/colour.h"
+#include "systems/base/graphics_system.h"
 #include "test_system/mock_surface.h"
 
 #include "test_utils.h"
@@ -133,3 +137,56 @@ TEST_F(MediumGrpTest, TestFade_7) {
   rlmachine.Exe(
       "recFade", 7, TestMachine::Arg(10, 10, 20, 20, 128, 128, 128, 0));
 }
+
+// Everything that only draws into DC 2 before the last load into it is
+// skipped when replaying the stack, but stays on the stack.
+TEST_F(MediumGrpTest, StackReplaySkipsOverwrittenCommands) {
+  rlmachine.Exe("allocDC", 0, TestMachine::Arg(2, 640, 480));
+  rlmachine.Exe("wipe", 0, TestMachine::Arg(2, 10, 10, 10));
+  rlmachine.Exe("grpLoad", 0, TestMachine::Arg("file", 3));
+  rlmachine.Exe("grpLoad", 0, TestMachine::Arg("file", 2));
+  rlmachine.Exe("wipe", 0, TestMachine::Arg(0, 20, 20, 20));
+
+  GraphicsSystem& graphics = system.graphics();
+  std::vector<bool> expected = {true, true, false, false, false};
+  EXPECT_EQ(expected,
+            FindOverwrittenGraphicsStackCommands(graphics.graphics_stack()));
+
+  EXPECT_CALL(system.graphics().GetMockDC(2), Fill(RGBAColour(10, 10, 10)))
+      .Times(0);
+  EXPECT_CALL(system.graphics().GetMockDC(0), Fill(RGBAColour(20, 20, 20)))
+      .Times(1);
+  graphics.ReplayGraphicsStack(rlmachine);
+  EXPECT_EQ(5, graphics.StackSize());
+}
+
+// A command that reads DC 2 keeps the load before it.
+TEST_F(MediumGrpTest, StackReplayKeepsCommandsThatAreRead) {
+  rlmachine.Exe("grpLoad", 0, TestMachine::Arg("file", 2));
+  rlmachine.Exe("grpCopy", 0, TestMachine::Arg(2, 0));
+  rlmachine.Exe("grpLoad", 0, TestMachine::Arg("file", 2));
+
+  std::vector<bool> expected = {false, false, false};
+  EXPECT_EQ(expected,
+            FindOverwrittenGraphicsStackCommands(
+                system.graphics().graphics_stack()));
+}
+
+TEST_F(MediumGrpTest, PreloadedG00IsFoundByName) {
+  GraphicsSystem& graphics = system.graphics();
+  EXPECT_FALSE(graphics.GetPreloadedG00("BG01").get());
+
+  graphics.PreloadG00(5, "BG01");
+  graphics.PreloadG00(2, "BG01");
+  std::shared_ptr<const Surface> surface = graphics.GetPreloadedG00("BG01");
+  ASSERT_TRUE(surface.get());
+
+  // Moving a slot to another name forgets the old one.
+  graphics.PreloadG00(2, "BG02");
+  graphics.ClearPreloadedG00(5);
+  EXPECT_FALSE(graphics.GetPreloadedG00("BG01").get());
+  EXPECT_TRUE(graphics.GetPreloadedG00("BG02").get());
+
+  graphics.ClearAllPreloadedG00();
+  EXPECT_FALSE(graphics.GetPreloadedG00("BG02").get());
+}
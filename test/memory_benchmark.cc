@@ -0,0 +1,116 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+// Measures the cost of writing to local memory between savepoints. This is
+// what the Module_Mem_SEEN scripts do (setrng, cpyrng and strS assignment),
+// scaled up from a handful of elements to whole banks, with a savepoint after
+// every pass like a message savepoint would take. A sparse pass with only a
+// few writes per savepoint is timed too, since that's the common case between
+// lines of text. Run from the root of the source tree:
+//
+//   ./build/rlvm_memory_benchmark [passes]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "libreallive/archive.h"
+#include "libreallive/intmemref.h"
+#include "machine/memory.h"
+#include "machine/rlmachine.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+using libreallive::IntMemRef;
+
+namespace {
+
+const char kLocalBanks[] = {'A', 'B', 'C', 'D', 'E', 'F'};
+
+typedef std::chrono::steady_clock Clock;
+
+double Nanoseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::nano>(d).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int passes = argc > 1 ? std::stoi(argv[1]) : 200;
+
+  libreallive::Archive arc(locateTestCase("Module_Mem_SEEN/setrng_0.TXT"));
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  RLMachine machine(system, arc);
+  Memory& memory = machine.memory();
+
+  std::string strings[2] = {"valid", "another value"};
+
+  // Whole banks: setrng over every local integer bank, cpyrng of intA into
+  // intB, and every strS slot.
+  long writes = 0;
+  Clock::duration write_time = Clock::duration::zero();
+  Clock::duration savepoint_time = Clock::duration::zero();
+  for (int pass = 0; pass < passes; ++pass) {
+    Clock::time_point start = Clock::now();
+    for (char bank : kLocalBanks) {
+      for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
+        memory.SetIntValue(IntMemRef(bank, i), pass);
+    }
+    for (int i = 0; i < SIZE_OF_MEM_BANK; ++i) {
+      memory.SetIntValue(IntMemRef('B', i),
+                         memory.GetIntValue(IntMemRef('A', i)));
+    }
+    for (int i = 0; i < SIZE_OF_MEM_BANK; ++i) {
+      memory.SetStringValue(libreallive::STRS_LOCATION, i,
+                            strings[(pass + i) % 2]);
+    }
+    Clock::time_point written = Clock::now();
+    memory.TakeSavepointSnapshot();
+
+    write_time += written - start;
+    savepoint_time += Clock::now() - written;
+    writes += SIZE_OF_MEM_BANK * 8;
+  }
+
+  std::cout << "Bulk:   " << Nanoseconds(write_time) / writes
+            << "ns per write, " << Nanoseconds(savepoint_time) / passes / 1000
+            << "us per savepoint" << std::endl;
+
+  // A few flags and a string between each savepoint.
+  const int sparse_passes = passes * 1000;
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < sparse_passes; ++pass) {
+    memory.SetIntValue(IntMemRef('A', pass % SIZE_OF_MEM_BANK), pass);
+    memory.SetIntValue(IntMemRef('F', 10), pass);
+    memory.SetIntValue(IntMemRef('F', 11), pass);
+    memory.SetStringValue(libreallive::STRS_LOCATION, 0, strings[pass % 2]);
+    memory.TakeSavepointSnapshot();
+  }
+  std::cout << "Sparse: " << Nanoseconds(Clock::now() - start) / sparse_passes
+            << "ns per four writes and a savepoint" << std::endl;
+  return 0;
+}
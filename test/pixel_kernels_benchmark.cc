@@ -0,0 +1,164 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+// Measures the colour transforms behind grpMono, grpInvert, grpColour and
+// tone curves over a 1024x768 surface. Each is timed both through the pixel
+// kernels and a pixel at a time through a virtual call per pixel, which is
+// what SDLSurface does for surfaces not in the default format. Run with:
+//
+//   ./build/rlvm_pixel_kernels_benchmark [passes]
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "systems/base/colour.h"
+#include "systems/base/pixel_kernels.h"
+
+namespace {
+
+const int kWidth = 1024;
+const int kHeight = 768;
+
+typedef std::chrono::steady_clock Clock;
+
+// One pixel at a time, the way TransformSurface() does it without kernels.
+class ChannelTransformer {
+ public:
+  virtual ~ChannelTransformer() {}
+  virtual void operator()(int& r, int& g, int& b) const = 0;
+};
+
+class InvertTransformer : public ChannelTransformer {
+ public:
+  virtual void operator()(int& r, int& g, int& b) const {
+    r = 255 - r;
+    g = 255 - g;
+    b = 255 - b;
+  }
+};
+
+class MonoTransformer : public ChannelTransformer {
+ public:
+  virtual void operator()(int& r, int& g, int& b) const {
+    r = g = b = MonoChannel(r, g, b);
+  }
+};
+
+class MapTransformer : public ChannelTransformer {
+ public:
+  explicit MapTransformer(const ToneCurveRGBMap& map) : map_(map) {}
+  virtual void operator()(int& r, int& g, int& b) const {
+    r = map_[0][r];
+    g = map_[1][g];
+    b = map_[2][b];
+  }
+
+ private:
+  ToneCurveRGBMap map_;
+};
+
+class ApplyColourTransformer : public ChannelTransformer {
+ public:
+  explicit ApplyColourTransformer(const RGBColour& colour) : colour_(colour) {}
+  virtual void operator()(int& r, int& g, int& b) const {
+    r = ApplyColourChannel(colour_.r(), r) & 0xff;
+    g = ApplyColourChannel(colour_.g(), g) & 0xff;
+    b = ApplyColourChannel(colour_.b(), b) & 0xff;
+  }
+
+ private:
+  RGBColour colour_;
+};
+
+void TransformPerPixel(std::vector<uint32_t>& pixels,
+                       const ChannelTransformer& transformer) {
+  for (uint32_t& pixel : pixels) {
+    int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+    transformer(r, g, b);
+    pixel = (pixel & 0xff000000) | (r << 16) | (g << 8) | b;
+  }
+}
+
+void TransformRows(std::vector<uint32_t>& pixels,
+                   const std::function<void(uint32_t*, int)>& kernel) {
+  for (int y = 0; y < kHeight; ++y)
+    kernel(pixels.data() + y * kWidth, kWidth);
+}
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void Time(const std::string& name,
+          int passes,
+          const ChannelTransformer& transformer,
+          const std::function<void(uint32_t*, int)>& kernel) {
+  std::vector<uint32_t> pixels(kWidth * kHeight);
+  for (size_t i = 0; i < pixels.size(); ++i)
+    pixels[i] = static_cast<uint32_t>(i * 2654435761u);
+
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < passes; ++pass)
+    TransformPerPixel(pixels, transformer);
+  Clock::duration per_pixel = Clock::now() - start;
+
+  start = Clock::now();
+  for (int pass = 0; pass < passes; ++pass)
+    TransformRows(pixels, kernel);
+  Clock::duration kernels = Clock::now() - start;
+
+  std::cout << name << Milliseconds(per_pixel) / passes
+            << "ms per pixel, " << Milliseconds(kernels) / passes
+            << "ms with kernels" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int passes = argc > 1 ? std::stoi(argv[1]) : 20;
+
+  Time("Invert:      ", passes, InvertTransformer(), InvertPixels);
+  Time("Mono:        ", passes, MonoTransformer(), MonoPixels);
+
+  ToneCurveRGBMap map;
+  for (int i = 0; i < 256; ++i) {
+    map[0][i] = 255 - i;
+    map[1][i] = i / 2;
+    map[2][i] = (i * 3) & 0xff;
+  }
+  Time("Tone curve:  ", passes, MapTransformer(map),
+       [&](uint32_t* row, int count) { MapPixels(row, count, map); });
+
+  RGBColour colour(64, -128, 0);
+  ToneCurveRGBMap colour_map = BuildApplyColourMap(colour);
+  Time("ApplyColour: ", passes, ApplyColourTransformer(colour),
+       [&](uint32_t* row, int count) { MapPixels(row, count, colour_map); });
+  return 0;
+}
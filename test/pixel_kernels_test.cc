@@ -0,0 +1,197 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "systems/base/colour.h"
+#include "systems/base/pixel_kernels.h"
+
+namespace {
+
+uint32_t Pack(int a, int r, int g, int b) {
+  return (static_cast<uint32_t>(a) << 24) | (r << 16) | (g << 8) | b;
+}
+
+// Every (r, g, b) triple, 256 pixels to a row, with an alpha that varies so
+// we notice it being touched.
+std::vector<uint32_t> EveryColour() {
+  std::vector<uint32_t> pixels;
+  pixels.reserve(256 * 256 * 256);
+  for (int r = 0; r < 256; ++r) {
+    for (int g = 0; g < 256; ++g) {
+      for (int b = 0; b < 256; ++b)
+        pixels.push_back(Pack((r + g + b) & 0xff, r, g, b));
+    }
+  }
+  return pixels;
+}
+
+// Runs |kernel| over |pixels| in uneven rows, so that the vector, word and
+// single pixel parts of the kernels all get used.
+template <typename Kernel>
+void RunInRows(std::vector<uint32_t>& pixels, Kernel kernel) {
+  const int kRowLengths[] = {1, 2, 3, 4, 5, 7, 8, 13, 64, 255};
+  size_t i = 0;
+  for (int row = 0; i < pixels.size(); ++row) {
+    int count = std::min<size_t>(kRowLengths[row % 10], pixels.size() - i);
+    kernel(pixels.data() + i, count);
+    i += count;
+  }
+}
+
+int Alpha(uint32_t pixel) { return pixel >> 24; }
+int Red(uint32_t pixel) { return (pixel >> 16) & 0xff; }
+int Green(uint32_t pixel) { return (pixel >> 8) & 0xff; }
+int Blue(uint32_t pixel) { return pixel & 0xff; }
+
+// pygame_AlphaBlit()'s ALPHA_BLEND, which is what a glyph from SDL_ttf goes
+// through on its way onto a text surface.
+uint32_t PygameBlend(uint32_t src, uint32_t dst) {
+  int sR = Red(src), sG = Green(src), sB = Blue(src), sA = Alpha(src);
+  int dR = Red(dst), dG = Green(dst), dB = Blue(dst), dA = Alpha(dst);
+  if (dA) {
+    dR = ((dR << 8) + (sR - dR) * sA + sR) >> 8;
+    dG = ((dG << 8) + (sG - dG) * sA + sG) >> 8;
+    dB = ((dB << 8) + (sB - dB) * sA + sB) >> 8;
+    dA = sA + dA - ((sA * dA) / 255);
+  } else {
+    dR = sR;
+    dG = sG;
+    dB = sB;
+    dA = sA;
+  }
+  return Pack(dA, dR, dG, dB);
+}
+
+}  // namespace
+
+TEST(PixelKernelsTest, InvertMatchesPerChannel) {
+  std::vector<uint32_t> original = EveryColour();
+  std::vector<uint32_t> pixels = original;
+  RunInRows(pixels, InvertPixels);
+
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    uint32_t in = original[i];
+    ASSERT_EQ(Pack(Alpha(in), 255 - Red(in), 255 - Green(in), 255 - Blue(in)),
+              pixels[i]);
+  }
+}
+
+TEST(PixelKernelsTest, MonoMatchesPerChannel) {
+  std::vector<uint32_t> original = EveryColour();
+  std::vector<uint32_t> pixels = original;
+  RunInRows(pixels, MonoPixels);
+
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    uint32_t in = original[i];
+    int grey = MonoChannel(Red(in), Green(in), Blue(in));
+    ASSERT_EQ(Pack(Alpha(in), grey, grey, grey), pixels[i])
+        << "for " << Red(in) << ", " << Green(in) << ", " << Blue(in);
+  }
+}
+
+TEST(PixelKernelsTest, MapMatchesPerChannel) {
+  ToneCurveRGBMap map;
+  for (int i = 0; i < 256; ++i) {
+    map[0][i] = 255 - i;
+    map[1][i] = (i * 7) & 0xff;
+    map[2][i] = i / 2;
+  }
+
+  std::vector<uint32_t> original = EveryColour();
+  std::vector<uint32_t> pixels = original;
+  RunInRows(pixels, [&](uint32_t* row, int count) {
+    MapPixels(row, count, map);
+  });
+
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    uint32_t in = original[i];
+    ASSERT_EQ(Pack(Alpha(in), map[0][Red(in)], map[1][Green(in)],
+                   map[2][Blue(in)]),
+              pixels[i]);
+  }
+}
+
+TEST(PixelKernelsTest, ApplyColourMapMatchesPerChannel) {
+  const RGBColour colours[] = {RGBColour(0, 0, 0), RGBColour(255, 255, 255),
+                               RGBColour(-255, -128, -1),
+                               RGBColour(1, 128, -64)};
+  for (const RGBColour& colour : colours) {
+    ToneCurveRGBMap map = BuildApplyColourMap(colour);
+    for (int i = 0; i < 256; ++i) {
+      EXPECT_EQ(static_cast<unsigned char>(ApplyColourChannel(colour.r(), i)),
+                map[0][i]);
+      EXPECT_EQ(static_cast<unsigned char>(ApplyColourChannel(colour.g(), i)),
+                map[1][i]);
+      EXPECT_EQ(static_cast<unsigned char>(ApplyColourChannel(colour.b(), i)),
+                map[2][i]);
+    }
+  }
+}
+
+TEST(PixelKernelsTest, LeavesPixelsOutsideTheRowAlone) {
+  std::vector<uint32_t> pixels(9, Pack(0x80, 10, 20, 30));
+  InvertPixels(pixels.data() + 1, 7);
+  MonoPixels(pixels.data() + 1, 7);
+  EXPECT_EQ(Pack(0x80, 10, 20, 30), pixels.front());
+  EXPECT_EQ(Pack(0x80, 10, 20, 30), pixels.back());
+}
+
+TEST(PixelKernelsTest, BlendCoverageMatchesPygame) {
+  const uint32_t colours[] = {0x000000, 0xffffff, 0x10e080, 0xff0001};
+  const uint32_t backgrounds[] = {0x000000, 0xffffff, 0x2040c0, 0x7f8081};
+  for (uint32_t colour : colours) {
+    for (uint32_t background : backgrounds) {
+      // Every combination of coverage and destination alpha.
+      std::vector<uint8_t> coverage;
+      std::vector<uint32_t> pixels;
+      for (int alpha = 0; alpha < 256; ++alpha) {
+        for (int dest_alpha = 0; dest_alpha < 256; ++dest_alpha) {
+          coverage.push_back(alpha);
+          pixels.push_back(background | (dest_alpha << 24));
+        }
+      }
+      std::vector<uint32_t> original = pixels;
+      BlendCoverage(pixels.data(), coverage.data(), pixels.size(), colour);
+
+      for (size_t i = 0; i < pixels.size(); ++i) {
+        // Uncovered pixels are left alone rather than recoloured.
+        uint32_t expected =
+            coverage[i] ? PygameBlend(colour | (coverage[i] << 24),
+                                      original[i])
+                        : original[i];
+        ASSERT_EQ(expected, pixels[i])
+            << "coverage " << int(coverage[i]) << " over " << std::hex
+            << original[i] << " in " << colour;
+      }
+    }
+  }
+}
@@ -0,0 +1,151 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2026 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+// Times the per line cost of getting a voice sample to the mixer's rate with
+// EnsureDataIsCorrectBitrate(), which is what koePlay pays before a line can
+// start, and the time a PCM16Resampler takes to produce the first block of a
+// streamed line. Lines are synthetic 16-bit speech-length tones. Run with:
+//
+//   ./build/rlvm_resample_benchmark [runs]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "systems/base/voice_archive.h"
+#include "systems/sdl/resample.h"
+#include "xclannad/endian.hpp"
+#include "xclannad/wavfile.h"
+
+namespace {
+
+// The mixer's rate, which is what rlvm opens the audio device with.
+const int kOutputRate = 44100;
+
+// Frames handed to the streaming resampler per decoded block.
+const int kBlockFrames = 4096;
+
+struct Line {
+  const char* name;
+  int rate;
+  int channels;
+  int seconds;
+};
+
+const Line kLines[] = {
+    {"44.1k mono, 5s (no conversion)", 44100, 1, 5},
+    {"48k mono, 1s", 48000, 1, 1},
+    {"48k mono, 5s", 48000, 1, 5},
+    {"48k stereo, 5s", 48000, 2, 5},
+    {"22.05k mono, 5s", 22050, 1, 5},
+    {"48k mono, 15s", 48000, 1, 15},
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::vector<int16_t> MakeSamples(const Line& line) {
+  int frames = line.rate * line.seconds;
+  std::vector<int16_t> samples(frames * line.channels);
+  for (int i = 0; i < frames; ++i) {
+    // A wobbling tone, so the filter has something to do.
+    double t = static_cast<double>(i) / line.rate;
+    double v = sin(2 * M_PI * (220 + 40 * sin(2 * M_PI * 3 * t)) * t);
+    for (int c = 0; c < line.channels; ++c)
+      samples[i * line.channels + c] = static_cast<int16_t>(v * 12000);
+  }
+  return samples;
+}
+
+// A WAV image as the VoiceSample subclasses produce them.
+std::vector<char> MakeWav(const Line& line,
+                          const std::vector<int16_t>& samples) {
+  int length = WAV_HEADER_SIZE + samples.size() * 2;
+  std::vector<char> wav(length);
+  memcpy(&wav[0],
+         VoiceSample::MakeWavHeader(line.rate, line.channels, 2, length),
+         WAV_HEADER_SIZE);
+  for (size_t i = 0; i < samples.size(); ++i)
+    write_little_endian_short(&wav[WAV_HEADER_SIZE + i * 2], samples[i]);
+  return wav;
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int runs = argc > 1 ? std::stoi(argv[1]) : 20;
+  WAVFILE::freq = kOutputRate;
+
+  std::cout << "Median of " << runs << " runs, resampling to " << kOutputRate
+            << " Hz" << std::endl;
+  for (const Line& line : kLines) {
+    std::vector<int16_t> samples = MakeSamples(line);
+    std::vector<char> wav = MakeWav(line, samples);
+
+    std::vector<double> whole, first_block;
+    for (int run = 0; run < runs; ++run) {
+      char* data = new char[wav.size()];
+      memcpy(data, &wav[0], wav.size());
+      int length = wav.size();
+      Clock::time_point start = Clock::now();
+      data = EnsureDataIsCorrectBitrate(data, &length);
+      whole.push_back(Milliseconds(Clock::now() - start));
+      delete[] data;
+
+      if (line.rate != kOutputRate) {
+        std::vector<int16_t> output;
+        start = Clock::now();
+        PCM16Resampler resampler;
+        resampler.Setup(line.rate, kOutputRate, line.channels);
+        resampler.Process(&samples[0],
+                          std::min<int>(kBlockFrames, samples.size() /
+                                                          line.channels),
+                          &output);
+        first_block.push_back(Milliseconds(Clock::now() - start));
+      }
+    }
+
+    std::cout << line.name << ": " << Median(whole) << "ms whole line";
+    if (!first_block.empty())
+      std::cout << ", " << Median(first_block) << "ms to first block";
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
@@ -93,6 +93,28 @@ TEST_F(RLMachineTest, RejectsDoubleAttachs) {
   EXPECT_THROW({ rlmachine.AttachModule(new StrModule); }, rlvm::Exception);
 }
 
+// CommandElements cache the operation they resolve to. Machines sharing an
+// Archive must each look up their own.
+TEST_F(RLMachineTest, OperationCacheIsPerMachine) {
+  {
+    RLMachine first(system, arc);
+    first.AttachModule(new StrModule);
+    first.ExecuteUntilHalted();
+    EXPECT_EQ("valid", first.GetStringValue(STRS_LOCATION, 0));
+  }
+
+  // Without a StrModule, strcpy is unimplemented instead of running the
+  // first machine's (deleted) operation.
+  RLMachine second(system, arc);
+  second.ExecuteUntilHalted();
+  EXPECT_EQ("", second.GetStringValue(STRS_LOCATION, 0));
+
+  RLMachine third(system, arc);
+  third.AttachModule(new StrModule);
+  third.ExecuteUntilHalted();
+  EXPECT_EQ("valid", third.GetStringValue(STRS_LOCATION, 0));
+}
+
 TEST_F(RLMachineTest, ReturnFromFarcallMismatch) {
   EXPECT_THROW({ rlmachine.ReturnFromFarcall(); }, rlvm::Exception);
 }
@@ -276,3 +298,134 @@ TEST_F(RLMachineTest, SerializationOfSavepointValues) {
     verifyStrMemoryCountingFrom(loadMachine, STRS_LOCATION, 0);
   }
 }
+
+// Saves written in the old text format are still loaded.
+TEST_F(RLMachineTest, SerializationDetectsSaveFormat) {
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  const Serialization::SaveFormat formats[] = {
+      Serialization::SAVE_FORMAT_TEXT, Serialization::SAVE_FORMAT_BINARY};
+
+  for (Serialization::SaveFormat format : formats) {
+    stringstream ss;
+    {
+      RLMachine saveMachine(system, arc);
+      setIntMemoryCountingFrom(saveMachine, LOCAL_INTEGER_BANKS, 7);
+      setStrMemoryCountingFrom(saveMachine, STRS_LOCATION, 7);
+      saveMachine.MarkSavepoint();
+      Serialization::saveGameTo(ss, saveMachine, format);
+    }
+
+    EXPECT_EQ(system.graphics().window_subtitle(),
+              Serialization::loadHeaderFrom(ss).title);
+
+    ss.clear();
+    ss.seekg(0);
+    RLMachine loadMachine(system, arc);
+    Serialization::loadGameFrom(ss, loadMachine);
+    verifyIntMemoryCountingFrom(loadMachine, LOCAL_INTEGER_BANKS, 7);
+    verifyStrMemoryCountingFrom(loadMachine, STRS_LOCATION, 7);
+  }
+}
+
+// Binary saves carry their own little endian format version, keep negative
+// integers intact, and refuse versions newer than this build understands.
+TEST_F(RLMachineTest, SerializationOfBinaryFormat) {
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  stringstream ss;
+  {
+    RLMachine saveMachine(system, arc);
+    saveMachine.SetIntValue(IntMemRef('A', 0), -2);
+    saveMachine.SetIntValue(IntMemRef('F', 1999), 0x12345678);
+    saveMachine.MarkSavepoint();
+    Serialization::saveGameTo(
+        ss, saveMachine, Serialization::SAVE_FORMAT_BINARY);
+  }
+  string data = ss.str();
+  ASSERT_LT(12u, data.size());
+  EXPECT_EQ(string("RLVMSAVE\x01\0\0\0", 12), data.substr(0, 12));
+
+  RLMachine loadMachine(system, arc);
+  Serialization::loadGameFrom(ss, loadMachine);
+  EXPECT_EQ(-2, loadMachine.GetIntValue(IntMemRef('A', 0)));
+  EXPECT_EQ(0x12345678, loadMachine.GetIntValue(IntMemRef('F', 1999)));
+
+  data[8] = 2;
+  stringstream newer(data);
+  EXPECT_THROW(Serialization::loadHeaderFrom(newer), rlvm::Exception);
+}
+
+// Simulates a crash after two journal flushes, the second torn part way
+// through being appended: the snapshot plus the journal's intact record
+// rebuild global memory.
+TEST_F(RLMachineTest, GlobalMemoryJournalRecoversAfterCrash) {
+  stringstream snapshot;
+  stringstream journal;
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  {
+    RLMachine saveMachine(system, arc);
+    saveMachine.SetIntValue(IntMemRef('G', 0), 1);
+    Serialization::saveGlobalMemoryTo(snapshot, saveMachine);
+
+    saveMachine.SetIntValue(IntMemRef('G', 10), 10);
+    saveMachine.SetIntValue(IntMemRef('G', 11), 11);
+    saveMachine.SetIntValue(IntMemRef('Z', 1999), 42);
+    saveMachine.SetStringValue(STRM_LOCATION, 3, "three");
+    saveMachine.memory().SetName(2, "Carol");
+    saveMachine.memory().RecordKidoku(5, 7);
+    Serialization::flushGlobalMemoryJournalTo(journal, saveMachine);
+
+    // A clean machine appends nothing.
+    std::string::size_type flushed = journal.str().size();
+    saveMachine.memory().RecordKidoku(5, 7);
+    Serialization::flushGlobalMemoryJournalTo(journal, saveMachine);
+    EXPECT_EQ(flushed, journal.str().size());
+
+    saveMachine.SetIntValue(IntMemRef('G', 0), 99);
+    stringstream torn;
+    Serialization::flushGlobalMemoryJournalTo(torn, saveMachine);
+    journal << torn.str().substr(0, torn.str().size() - 1);
+  }
+
+  RLMachine loadMachine(system, arc);
+  Serialization::loadGlobalMemoryFrom(snapshot, loadMachine);
+  EXPECT_EQ(1,
+            Serialization::replayGlobalMemoryJournalFrom(journal, loadMachine));
+
+  EXPECT_EQ(1, loadMachine.GetIntValue(IntMemRef('G', 0)));
+  EXPECT_EQ(10, loadMachine.GetIntValue(IntMemRef('G', 10)));
+  EXPECT_EQ(11, loadMachine.GetIntValue(IntMemRef('G', 11)));
+  EXPECT_EQ(42, loadMachine.GetIntValue(IntMemRef('Z', 1999)));
+  EXPECT_EQ("three", loadMachine.GetStringValue(STRM_LOCATION, 3));
+  EXPECT_EQ("Carol", loadMachine.memory().GetName(2));
+  EXPECT_TRUE(loadMachine.memory().HasBeenRead(5, 7));
+  EXPECT_FALSE(loadMachine.memory().HasBeenRead(5, 6));
+
+  // Replayed values are already on disk and aren't journaled again.
+  EXPECT_TRUE(loadMachine.memory().global().changes.empty());
+}
+
+// The journal's integers are written out byte by byte, so that a journal
+// left by a crash can be replayed on a machine with another byte order.
+TEST_F(RLMachineTest, GlobalMemoryJournalIsLittleEndian) {
+  auto little_endian = [](uint32_t value) {
+    return string{static_cast<char>(value), static_cast<char>(value >> 8),
+                  static_cast<char>(value >> 16),
+                  static_cast<char>(value >> 24)};
+  };
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  RLMachine machine(system, arc);
+  machine.memory().global().changes.Clear();
+  machine.SetIntValue(IntMemRef('G', 10), 0x01020304);
+  stringstream journal;
+  Serialization::flushGlobalMemoryJournalTo(journal, machine);
+
+  // One run of one word in intG[], and no strings, names or kidoku.
+  string payload = "RLJ1" + little_endian(1) + little_endian(INTG_LOCATION) +
+                   little_endian(10) + little_endian(1) +
+                   little_endian(0x01020304) + little_endian(0) +
+                   little_endian(0) + little_endian(0);
+  ASSERT_EQ(8 + payload.size(), journal.str().size());
+  EXPECT_EQ(little_endian(payload.size()), journal.str().substr(0, 4));
+  EXPECT_EQ(payload, journal.str().substr(8));
+}
@@ -0,0 +1,110 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+
+// Measures writing a save game in each of the formats
+// Serialization::saveGameTo() supports, how big the result is, and reading
+// back its local memory. (A full load resets the mock surfaces of the test
+// system, which needs a running test.) Local memory is filled with flag-like
+// values and short strings. Run from the root of the source tree:
+//
+//   ./build/rlvm_save_game_benchmark [saves]
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "libreallive/archive.h"
+#include "libreallive/intmemref.h"
+#include "machine/memory.h"
+#include "machine/rlmachine.h"
+#include "machine/serialization.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+using libreallive::IntMemRef;
+
+namespace {
+
+const char kLocalBanks[] = {'A', 'B', 'C', 'D', 'E', 'F'};
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void Measure(const char* name,
+             Serialization::SaveFormat format,
+             int saves,
+             RLMachine& machine) {
+  std::string data;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < saves; ++i) {
+    std::ostringstream oss;
+    Serialization::saveGameTo(oss, machine, format);
+    data = oss.str();
+  }
+  double save_ms = Milliseconds(Clock::now() - start) / saves;
+
+  start = Clock::now();
+  for (int i = 0; i < saves; ++i) {
+    std::istringstream iss(data);
+    Serialization::loadLocalMemoryFrom(iss, machine.memory());
+  }
+  double load_ms = Milliseconds(Clock::now() - start) / saves;
+
+  std::cout << name << ": " << data.size() << " bytes, " << save_ms
+            << "ms to save, " << load_ms << "ms to load local memory"
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int saves = argc > 1 ? std::stoi(argv[1]) : 50;
+
+  libreallive::Archive arc(locateTestCase("Module_Mem_SEEN/setrng_0.TXT"));
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  RLMachine machine(system, arc);
+  Memory& memory = machine.memory();
+
+  for (char bank : kLocalBanks) {
+    for (int i = 0; i < SIZE_OF_MEM_BANK; ++i)
+      memory.SetIntValue(IntMemRef(bank, i), (i * 7919) % 1000 - 100);
+  }
+  for (int i = 0; i < SIZE_OF_MEM_BANK; i += 4) {
+    memory.SetStringValue(
+        libreallive::STRS_LOCATION, i, "string " + std::to_string(i));
+  }
+  machine.MarkSavepoint();
+
+  Measure("Text  ", Serialization::SAVE_FORMAT_TEXT, saves, machine);
+  Measure("Binary", Serialization::SAVE_FORMAT_BINARY, saves, machine);
+  return 0;
+}
@@ -0,0 +1,126 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+
+// Measures what a load menu costs with 100 populated save slots: reading each
+// slot's header out of its save file, as SaveInfo and friends used to, versus
+// asking a SaveGameIndex that has to read its index file first, and one that
+// already has. Run from the root of the source tree:
+//
+//   ./build/rlvm_save_game_index_benchmark [menu opens]
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "libreallive/archive.h"
+#include "machine/rlmachine.h"
+#include "machine/save_game_header.h"
+#include "machine/save_game_index.h"
+#include "machine/serialization.h"
+#include "test_system/test_system.h"
+
+#include "test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const int kSlots = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int opens = argc > 1 ? std::stoi(argv[1]) : 20;
+
+  libreallive::Archive arc(locateTestCase("Module_Str_SEEN/strcpy_0.TXT"));
+  TestSystem system(locateTestCase("Gameexe_data/Gameexe.ini"));
+  RLMachine machine(system, arc);
+
+  fs::path save_dir =
+      fs::temp_directory_path() / fs::unique_path("rlvm-saves-%%%%-%%%%");
+  fs::create_directories(save_dir);
+  for (int slot = 0; slot < kSlots; ++slot) {
+    fs::ofstream file(save_dir / SaveGameIndex::GetSaveFilename(slot),
+                      std::ios::binary);
+    Serialization::saveGameTo(file, machine);
+  }
+
+  size_t title_bytes = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < opens; ++i) {
+    for (int slot = 0; slot < kSlots; ++slot) {
+      fs::path path = save_dir / SaveGameIndex::GetSaveFilename(slot);
+      if (fs::exists(path)) {
+        fs::ifstream file(path, std::ios::binary);
+        title_bytes += Serialization::loadHeaderFrom(file).title.size();
+      }
+    }
+  }
+  std::cout << "Reading save files: "
+            << Milliseconds(Clock::now() - start) / opens << "ms per menu"
+            << std::endl;
+
+  // Writes the index file.
+  SaveGameIndex(save_dir).Exists(0);
+
+  start = Clock::now();
+  for (int i = 0; i < opens; ++i) {
+    SaveGameIndex index(save_dir);
+    for (int slot = 0; slot < kSlots; ++slot) {
+      if (index.Exists(slot))
+        title_bytes += index.GetHeader(slot)->title.size();
+    }
+  }
+  std::cout << "Reading the index:  "
+            << Milliseconds(Clock::now() - start) / opens << "ms per menu"
+            << std::endl;
+
+  SaveGameIndex index(save_dir);
+  index.Exists(0);
+  start = Clock::now();
+  for (int i = 0; i < opens; ++i) {
+    for (int slot = 0; slot < kSlots; ++slot) {
+      if (index.Exists(slot))
+        title_bytes += index.GetHeader(slot)->title.size();
+    }
+  }
+  std::cout << "Index in memory:    "
+            << Milliseconds(Clock::now() - start) / opens << "ms per menu"
+            << std::endl;
+
+  fs::remove_all(save_dir);
+  return title_bytes == static_cast<size_t>(-1);
+}
@@ -0,0 +1,154 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/date_time/posix_time/time_serialize.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <string>
+
+#include "machine/save_game_header.h"
+#include "machine/save_game_index.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+class SaveGameIndexTest : public ::testing::Test {
+ protected:
+  SaveGameIndexTest()
+      : save_dir_(fs::temp_directory_path() /
+                  fs::unique_path("rlvm-save-index-%%%%-%%%%")) {
+    fs::create_directories(save_dir_);
+  }
+
+  ~SaveGameIndexTest() { fs::remove_all(save_dir_); }
+
+  fs::path SavePath(int slot) {
+    return save_dir_ / SaveGameIndex::GetSaveFilename(slot);
+  }
+
+  // Writes the start of a save game: as much as loading a header reads.
+  void WriteSave(int slot, const std::string& title) {
+    fs::ofstream file(SavePath(slot), std::ios::binary);
+    boost::iostreams::filtering_stream<boost::iostreams::output> output;
+    output.push(boost::iostreams::zlib_compressor());
+    output.push(file);
+
+    boost::archive::text_oarchive oa(output);
+    const int version = 2;
+    const SaveGameHeader header(title);
+    oa << version << header;
+  }
+
+  // Replaces a save with garbage without changing its modification time, so
+  // an index that still opens it would fail.
+  void CorruptSave(int slot) {
+    std::time_t mtime = fs::last_write_time(SavePath(slot));
+    {
+      fs::ofstream file(SavePath(slot), std::ios::binary);
+      file << "not a save game";
+    }
+    fs::last_write_time(SavePath(slot), mtime);
+  }
+
+  void SetSaveTime(int slot, std::time_t mtime) {
+    fs::last_write_time(SavePath(slot), mtime);
+  }
+
+  fs::path save_dir_;
+};
+
+}  // namespace
+
+TEST_F(SaveGameIndexTest, BuildsFromSaveFiles) {
+  WriteSave(3, "Third");
+  WriteSave(12, "Twelfth");
+  SetSaveTime(3, 2000);
+  SetSaveTime(12, 1000);
+
+  SaveGameIndex index(save_dir_);
+  EXPECT_FALSE(index.Exists(0));
+  EXPECT_FALSE(index.GetHeader(0));
+  ASSERT_TRUE(index.Exists(3));
+  EXPECT_EQ("Third", index.GetHeader(3)->title);
+  ASSERT_TRUE(index.Exists(12));
+  EXPECT_EQ("Twelfth", index.GetHeader(12)->title);
+  EXPECT_EQ(3, index.GetLatestSlot());
+}
+
+TEST_F(SaveGameIndexTest, EmptyDirectoryHasNoSaves) {
+  SaveGameIndex index(save_dir_);
+  EXPECT_FALSE(index.Exists(0));
+  EXPECT_EQ(-1, index.GetLatestSlot());
+}
+
+TEST_F(SaveGameIndexTest, LaterIndexesDontOpenSaveFiles) {
+  WriteSave(1, "First");
+  SaveGameIndex(save_dir_).Exists(1);
+
+  CorruptSave(1);
+  SaveGameIndex index(save_dir_);
+  ASSERT_TRUE(index.Exists(1));
+  EXPECT_EQ("First", index.GetHeader(1)->title);
+}
+
+TEST_F(SaveGameIndexTest, RecordedSavesAreIndexed) {
+  SaveGameIndex index(save_dir_);
+  EXPECT_FALSE(index.Exists(7));
+
+  WriteSave(7, "Seventh");
+  index.Record(7, SaveGameHeader("Seventh"));
+  EXPECT_EQ("Seventh", index.GetHeader(7)->title);
+  EXPECT_EQ(7, index.GetLatestSlot());
+
+  CorruptSave(7);
+  EXPECT_EQ("Seventh", SaveGameIndex(save_dir_).GetHeader(7)->title);
+}
+
+TEST_F(SaveGameIndexTest, ChangedAndDeletedSavesAreNoticed) {
+  WriteSave(1, "Old");
+  WriteSave(2, "Deleted");
+  SetSaveTime(1, 1000);
+  SaveGameIndex(save_dir_).Exists(1);
+
+  // Something that doesn't know about the index replaces one save and
+  // removes another.
+  WriteSave(1, "New");
+  SetSaveTime(1, 2000);
+  fs::remove(SavePath(2));
+
+  SaveGameIndex index(save_dir_);
+  ASSERT_TRUE(index.Exists(1));
+  EXPECT_EQ("New", index.GetHeader(1)->title);
+  EXPECT_FALSE(index.Exists(2));
+}
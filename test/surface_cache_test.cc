@@ -0,0 +1,136 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+
+#include "systems/base/surface_cache.h"
+#include "test_system/mock_surface.h"
+
+namespace {
+
+// 100x100 surfaces take 40000 bytes of pixels.
+const size_t kSurfaceBytes = 100 * 100 * 4;
+
+// A surface which pretends to have uploaded a texture the size of its pixels.
+class UploadedSurface : public MockSurface {
+ public:
+  static std::shared_ptr<const Surface> Create(const std::string& name) {
+    return std::shared_ptr<const Surface>(new UploadedSurface(name));
+  }
+
+  virtual size_t GetTextureMemory() const override {
+    return uploaded_ ? GetPixelMemory() : 0;
+  }
+  virtual void ReleaseTextures() const override { uploaded_ = false; }
+
+ private:
+  explicit UploadedSurface(const std::string& name)
+      : MockSurface(name, Size(100, 100)), uploaded_(true) {}
+
+  mutable bool uploaded_;
+};
+
+std::shared_ptr<const Surface> MakeSurface(const std::string& name) {
+  return std::shared_ptr<const Surface>(
+      MockSurface::Create(name, Size(100, 100)));
+}
+
+}  // namespace
+
+TEST(SurfaceCacheTest, EvictsLeastRecentlyUsedOverPixelBudget) {
+  SurfaceCache cache(3 * kSurfaceBytes, 0);
+  cache.Insert("A", MakeSurface("A"));
+  cache.Insert("B", MakeSurface("B"));
+  cache.Insert("C", MakeSurface("C"));
+  EXPECT_EQ(3 * kSurfaceBytes, cache.pixel_memory());
+
+  // Touching A makes B the oldest.
+  EXPECT_TRUE(cache.Fetch("A").get());
+  cache.Insert("D", MakeSurface("D"));
+
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(3 * kSurfaceBytes, cache.pixel_memory());
+  EXPECT_TRUE(cache.Exists("A"));
+  EXPECT_FALSE(cache.Exists("B"));
+  EXPECT_TRUE(cache.Exists("C"));
+  EXPECT_TRUE(cache.Exists("D"));
+  EXPECT_EQ(1, cache.evictions());
+}
+
+TEST(SurfaceCacheTest, KeepsOversizedNewestEntry) {
+  SurfaceCache cache(kSurfaceBytes / 2, 0);
+  cache.Insert("A", MakeSurface("A"));
+  cache.Insert("B", MakeSurface("B"));
+
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_TRUE(cache.Exists("B"));
+}
+
+TEST(SurfaceCacheTest, ReplacingAnEntryDoesNotDoubleCount) {
+  SurfaceCache cache(0, 0);
+  cache.Insert("A", MakeSurface("A"));
+  cache.Insert("A", MakeSurface("A"));
+
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(kSurfaceBytes, cache.pixel_memory());
+  EXPECT_EQ(0, cache.evictions());
+}
+
+TEST(SurfaceCacheTest, CountsHitsAndMisses) {
+  SurfaceCache cache(0, 0);
+  cache.Insert("A", MakeSurface("A"));
+
+  EXPECT_TRUE(cache.Fetch("A").get());
+  EXPECT_FALSE(cache.Fetch("B").get());
+  EXPECT_TRUE(cache.Fetch("A").get());
+  // Exists() is a peek, not a fetch.
+  cache.Exists("B");
+
+  EXPECT_EQ(2, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+}
+
+TEST(SurfaceCacheTest, ReleasesTexturesOfUnusedSurfaces) {
+  SurfaceCache cache(0, 2 * kSurfaceBytes);
+  std::shared_ptr<const Surface> on_screen = UploadedSurface::Create("A");
+  cache.Insert("A", on_screen);
+  cache.Insert("B", UploadedSurface::Create("B"));
+  cache.Insert("C", UploadedSurface::Create("C"));
+
+  // A is the oldest but still held elsewhere, so B loses its texture instead.
+  EXPECT_EQ(1, cache.texture_releases());
+  EXPECT_EQ(2 * kSurfaceBytes, cache.GetTextureMemory());
+  EXPECT_NE(0u, on_screen->GetTextureMemory());
+  EXPECT_EQ(0u, cache.Fetch("B")->GetTextureMemory());
+
+  // Releasing a texture doesn't evict the surface.
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(0, cache.evictions());
+}
@@ -51,6 +51,10 @@ void TestMachine::AttachModule(RLModule* module) {
 
     RLOperation* op = it->second.get();
     registry_.emplace(make_pair(it->second->name(), overload), op);
+    numbers_.emplace(
+        make_pair(it->second->name(), overload),
+        std::vector<int>{module->module_type(), module->module_number(),
+                         opcode});
   }
 
   RLMachine::AttachModule(module);
@@ -86,22 +90,27 @@ void TestMachine::RunOpcode(const std::string& name,
                             unsigned char overload,
                             int argc,
                             const std::string& argument_string) {
+  std::vector<int> numbers = {0, 0, 0};
+  OpcodeNumbers::const_iterator it = numbers_.find(make_pair(name, overload));
+  if (it != numbers_.end())
+    numbers = it->second;
+
   string repr;
   repr.resize(8, 0);
   repr[0] = '#';
-  repr[1] = 0;             // type
-  repr[2] = 0;             // module
-  insert_i16(repr, 3, 0);  // opcode
+  repr[1] = numbers[0];             // type
+  repr[2] = numbers[1];             // module
+  insert_i16(repr, 3, numbers[2]);  // opcode
   insert_i16(repr, 5, argc);
   repr[7] = overload;
 
   string full = repr + '(' + argument_string + ')';
-  std::unique_ptr<libreallive::CommandElement> element(
-      libreallive::BuildFunctionElement(full.c_str()));
+  libreallive::BytecodeList bytecode;
+  libreallive::pointer_t element = bytecode.AppendFunction(full.c_str());
 
   RLOperation* op = registry_[make_pair(name, overload)];
   if (op) {
-    op->DispatchFunction(*this, *element.get());
+    op->DispatchFunction(*this, bytecode.command(element));
   } else {
     throw rlvm::Exception("Illegal opcode TestMachine::runOpcode");
   }
@@ -232,6 +232,12 @@ class TestMachine : public RLMachine {
   typedef std::map<std::pair<std::string, unsigned char>, RLOperation*>
       OpcodeRegistry;
   OpcodeRegistry registry_;
+
+  // The module type, module and opcode numbers of each entry in |registry_|,
+  // so that the commands we build can be replayed from their bytecode.
+  typedef std::map<std::pair<std::string, unsigned char>, std::vector<int>>
+      OpcodeNumbers;
+  OpcodeNumbers numbers_;
 };
 
 #endif  // TEST_TEST_SYSTEM_TEST_MACHINE_H_
@@ -0,0 +1,363 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2026 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+// -----------------------------------------------------------------------
+
+// Checks that batching Texture's quads through SpriteBatch doesn't change
+// what ends up on screen. Each scene is drawn twice, once with SpriteBatch in
+// immediate mode (a glBegin()/glEnd() pair per quad, as Texture used to draw)
+// and once batched, and snapshotted the way
+// SDLGraphicsSystem::EndFrameToSurface() does: into a render_to_texture
+// Texture, which is then read back. The pixels and the GL state left behind
+// for later draws must match exactly.
+//
+// Renders offscreen through a surfaceless EGL display, so it needs Mesa (its
+// llvmpipe software rasterizer is deterministic) but no window system. Exits
+// successfully without testing anything if there's no such display. Run with:
+//
+//   ./build/rlvm_texture_snapshot_test
+
+#include "GL/glew.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <SDL/SDL.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "systems/base/colour.h"
+#include "systems/base/graphics_object.h"
+#include "systems/base/rect.h"
+#include "systems/sdl/sdl_surface.h"
+#include "systems/sdl/sprite_batch.h"
+#include "systems/sdl/texture.h"
+
+namespace {
+
+const int kScreenWidth = 640;
+const int kScreenHeight = 480;
+
+// What a scene leaves behind.
+struct Snapshot {
+  std::vector<unsigned char> pixels;
+
+  // State that later draws inherit.
+  GLint blend_src;
+  GLint blend_dst;
+  GLint blend_equation;
+  GLfloat colour[4];
+};
+
+// A surface filled with a pattern that has every level of alpha in it.
+std::unique_ptr<SDL_Surface, void (*)(SDL_Surface*)> MakePattern(int width,
+                                                                 int height,
+                                                                 int seed) {
+  std::unique_ptr<SDL_Surface, void (*)(SDL_Surface*)> surface(
+      SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32, 0xff, 0xff00,
+                           0xff0000, 0xff000000),
+      SDL_FreeSurface);
+  for (int y = 0; y < height; ++y) {
+    unsigned char* row =
+        static_cast<unsigned char*>(surface->pixels) + y * surface->pitch;
+    for (int x = 0; x < width; ++x) {
+      unsigned char* pixel = row + x * 4;
+      pixel[0] = (x * 7 + seed * 31) & 0xff;
+      pixel[1] = (y * 5 + seed * 17) & 0xff;
+      pixel[2] = ((x ^ y) * 3 + seed) & 0xff;
+      pixel[3] = ((x + y) * (seed + 1)) & 0xff;
+    }
+  }
+  return surface;
+}
+
+Texture* MakeTexture(SDL_Surface* surface, int x, int y, int w, int h) {
+  return new Texture(surface, x, y, w, h, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+}
+
+bool CreateContext() {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (!get_platform_display)
+    return false;
+
+  EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, NULL);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) ||
+      !eglBindAPI(EGL_OPENGL_API))
+    return false;
+
+  const EGLint config_attributes[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE,     8,               EGL_GREEN_SIZE,      8,
+      EGL_BLUE_SIZE,    8,               EGL_ALPHA_SIZE,      8,
+      EGL_NONE};
+  EGLConfig config;
+  EGLint config_count;
+  if (!eglChooseConfig(display, config_attributes, &config, 1,
+                       &config_count) ||
+      config_count < 1)
+    return false;
+
+  const EGLint surface_attributes[] = {EGL_WIDTH, kScreenWidth, EGL_HEIGHT,
+                                       kScreenHeight, EGL_NONE};
+  EGLSurface surface =
+      eglCreatePbufferSurface(display, config, surface_attributes);
+  EGLContext context =
+      eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+  if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(display, surface, surface, context))
+    return false;
+
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK)
+    return false;
+  glGetError();
+
+  // SDLGraphicsSystem's one time setup.
+  glEnable(GL_TEXTURE_2D);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glShadeModel(GL_SMOOTH);
+  glClearDepth(1.0f);
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glDepthFunc(GL_LEQUAL);
+  glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+  glColor4f(1.0f, 1.0f, 1.0f, 0.5f);
+  Texture::SetScreenSize(Size(kScreenWidth, kScreenHeight));
+  return true;
+}
+
+// Like SDLGraphicsSystem::BeginFrame().
+void BeginFrame() {
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_LIGHTING);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0.0, kScreenWidth, kScreenHeight, 0.0, 0.0, 1.0);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+}
+
+Snapshot EndFrame() {
+  Texture texture(render_to_texture(), kScreenWidth, kScreenHeight);
+
+  Snapshot snapshot;
+  glBindTexture(GL_TEXTURE_2D, texture.textureId());
+  GLint width, height;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  snapshot.pixels.resize(width * height * 4);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                &snapshot.pixels[0]);
+
+  glGetIntegerv(GL_BLEND_SRC, &snapshot.blend_src);
+  glGetIntegerv(GL_BLEND_DST, &snapshot.blend_dst);
+  glGetIntegerv(GL_BLEND_EQUATION, &snapshot.blend_equation);
+  glGetFloatv(GL_CURRENT_COLOR, snapshot.colour);
+  return snapshot;
+}
+
+// Returns a description of how |batched| differs from |immediate|, or an
+// empty string if it doesn't.
+std::string Compare(const Snapshot& immediate, const Snapshot& batched) {
+  if (immediate.pixels.size() != batched.pixels.size())
+    return "snapshot sizes differ";
+
+  int different = 0;
+  for (size_t i = 0; i < immediate.pixels.size(); i += 4) {
+    if (!std::equal(&immediate.pixels[i], &immediate.pixels[i] + 4,
+                    &batched.pixels[i]))
+      different++;
+  }
+  if (different)
+    return std::to_string(different) + " pixels differ";
+
+  if (immediate.blend_src != batched.blend_src ||
+      immediate.blend_dst != batched.blend_dst ||
+      immediate.blend_equation != batched.blend_equation)
+    return "blend state differs";
+  if (!std::equal(immediate.colour, immediate.colour + 4, batched.colour))
+    return "current colour differs";
+  return std::string();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (!CreateContext()) {
+    std::cout << "No surfaceless EGL display with desktop GL; skipping."
+              << std::endl;
+    return 0;
+  }
+  std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  auto background_pixels = MakePattern(kScreenWidth, kScreenHeight, 1);
+  auto sprite_pixels = MakePattern(200, 150, 2);
+  auto mask_pixels = MakePattern(300, 100, 3);
+  std::unique_ptr<Texture> background(MakeTexture(
+      background_pixels.get(), 0, 0, kScreenWidth, kScreenHeight));
+  std::unique_ptr<Texture> sprite(
+      MakeTexture(sprite_pixels.get(), 0, 0, 200, 150));
+  std::unique_ptr<Texture> part(
+      MakeTexture(sprite_pixels.get(), 20, 10, 100, 80));
+  std::unique_ptr<Texture> mask(
+      MakeTexture(mask_pixels.get(), 0, 0, 300, 100));
+
+  // RenderToScreenAsObject() doesn't look at its surface argument.
+  SDLSurface unused_surface(NULL);
+
+  const Rect screen = Rect::GRP(0, 0, kScreenWidth, kScreenHeight);
+  auto draw_background = [&]() {
+    background->RenderToScreen(screen, screen, 255);
+  };
+
+  auto draw_masks = [&]() {
+    draw_background();
+    sprite->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                           Rect::GRP(50, 300, 250, 450), 180);
+    mask->RenderToScreenAsColorMask(Rect::GRP(0, 0, 300, 100),
+                                    Rect::GRP(40, 340, 340, 440),
+                                    RGBAColour(40, 60, 200, 160), 0);
+    mask->RenderToScreenAsColorMask(Rect::GRP(0, 0, 300, 100),
+                                    Rect::GRP(300, 20, 600, 120),
+                                    RGBAColour(200, 60, 40, 100), 1);
+    sprite->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                           Rect::GRP(400, 300, 600, 450), 90);
+  };
+
+  std::vector<std::pair<std::string, std::function<void()>>> scenes;
+
+  // Runs of sprites from one texture, interrupted by another.
+  scenes.emplace_back("sprites", [&]() {
+    draw_background();
+    for (int i = 0; i < 40; ++i) {
+      int x = (i * 37) % 560, y = (i * 53) % 400;
+      sprite->RenderToScreen(Rect::GRP(i % 50, i % 40, 120 + i % 50, 100),
+                             Rect::GRP(x, y, x + 80 + i, y + 60),
+                             (i * 29) % 256);
+      if (i % 7 == 3) {
+        part->RenderToScreen(Rect::GRP(0, 0, 100, 80),
+                             Rect::GRP(x + 10, y + 10, x + 110, y + 90), 200);
+      }
+    }
+  });
+
+  // Per corner opacity, both opaque and translucent.
+  scenes.emplace_back("corners", [&]() {
+    draw_background();
+    const int opaque[4] = {255, 255, 255, 255};
+    const int fade[4] = {0, 128, 255, 64};
+    sprite->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                           Rect::GRP(10, 10, 210, 160), opaque);
+    sprite->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                           Rect::GRP(100, 100, 400, 300), fade);
+    sprite->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                           Rect::GRP(300, 200, 500, 350), opaque);
+  });
+
+  // Text window masks: subtractive through the shader and additive.
+  scenes.emplace_back("masks_glsl", draw_masks);
+
+  // The same without shaders, which takes the subtractive fallback.
+  scenes.emplace_back("masks_fallback", [&]() {
+    GLboolean fragment_shader = __GLEW_ARB_fragment_shader;
+    __GLEW_ARB_fragment_shader = GL_FALSE;
+    draw_masks();
+    __GLEW_ARB_fragment_shader = fragment_shader;
+  });
+
+  // Objects in every composite mode, rotated, shaded and clipped.
+  scenes.emplace_back("objects", [&]() {
+    draw_background();
+    for (int i = 0; i < 24; ++i) {
+      GraphicsObject object;
+      object.SetCompositeMode(i % 3);
+      if (i % 5 == 1)
+        object.SetRotation(i * 150);
+      if (i % 6 == 2)
+        object.SetTint(RGBColour(i * 10, 40, 200));
+      if (i % 6 == 4)
+        object.SetColour(RGBAColour(200, 40, i * 10, 128));
+      if (i == 9)
+        object.SetMono(255);
+      if (i == 15)
+        object.SetInvert(255);
+      if (i == 21)
+        object.SetLight(100);
+      object.SetRepOriginX(i % 4 * 5);
+      int x = (i * 91) % 600 - 30, y = (i * 67) % 440 - 20;
+      sprite->RenderToScreenAsObject(object, unused_surface,
+                                     Rect::GRP(i % 30, 0, 200, 150 - i),
+                                     Rect::GRP(x, y, x + 140, y + 100),
+                                     (i * 41) % 256);
+    }
+  });
+
+  // A texture deleted while its quads are queued.
+  scenes.emplace_back("deleted", [&]() {
+    draw_background();
+    {
+      std::unique_ptr<Texture> temporary(
+          MakeTexture(sprite_pixels.get(), 0, 0, 200, 150));
+      temporary->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                                Rect::GRP(100, 100, 300, 250), 200);
+    }
+    sprite->RenderToScreen(Rect::GRP(0, 0, 200, 150),
+                           Rect::GRP(200, 150, 400, 300), 128);
+  });
+
+  int failures = 0;
+  for (const auto& scene : scenes) {
+    Snapshot snapshots[2];
+    for (int batched = 0; batched < 2; ++batched) {
+      SpriteBatch::set_immediate_mode(!batched);
+      BeginFrame();
+      scene.second();
+      snapshots[batched] = EndFrame();
+    }
+
+    GLenum error = glGetError();
+    std::string difference =
+        error != GL_NO_ERROR ? "GL error " + std::to_string(error)
+                             : Compare(snapshots[0], snapshots[1]);
+    if (difference.empty()) {
+      std::cout << scene.first << ": identical" << std::endl;
+    } else {
+      std::cout << scene.first << ": " << difference << std::endl;
+      failures++;
+    }
+  }
+  SpriteBatch::set_immediate_mode(false);
+
+  return failures ? 1 : 0;
+}
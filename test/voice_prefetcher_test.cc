@@ -0,0 +1,342 @@
+// -*- Mode: C++; tab-width:2; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+// vi:tw=80:et:ts=2:sts=2
+//
+// -----------------------------------------------------------------------
+//
+// This file is part of RLVM, a RealLive virtual machine clone.
+//
+// -----------------------------------------------------------------------
+//
+// Copyright (C) 2016 Elliot Glaysher
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+//
+// -----------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libreallive/bytecode.h"
+#include "systems/base/voice_archive.h"
+#include "systems/base/voice_cache.h"
+#include "systems/base/voice_prefetcher.h"
+
+#include "test_utils.h"
+
+using libreallive::BytecodeList;
+
+namespace {
+
+std::string IntParam(int value) {
+  std::string param("$\xff");
+  for (int i = 0; i < 4; ++i)
+    param.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  return param;
+}
+
+// intA[0], which the scan can't evaluate.
+std::string VariableParam() {
+  return std::string("$\x00[", 3) + IntParam(0) + "]";
+}
+
+// The bytecode of a call to op<1:module:opcode, 0>(params...).
+std::string Function(int module,
+                     int opcode,
+                     const std::vector<std::string>& params) {
+  const char command[8] = {'#', 1, static_cast<char>(module),
+                           static_cast<char>(opcode & 0xff),
+                           static_cast<char>(opcode >> 8),
+                           static_cast<char>(params.size()), 0, 0};
+  std::string bytecode(command, 8);
+  if (!params.empty()) {
+    bytecode.push_back('(');
+    for (const std::string& param : params)
+      bytecode.append(param);
+    bytecode.push_back(')');
+  }
+  return bytecode;
+}
+
+const int kSampleRate = 22050;
+const int kSampleFrames = 3000;
+
+// A mono sample of |kSampleFrames| frames, every one of which is its id.
+class FakeVoiceSample : public VoiceSample {
+ public:
+  explicit FakeVoiceSample(int id) : id_(id) {}
+
+  virtual char* Decode(int* size) override {
+    *size = WAV_HEADER_SIZE + kSampleFrames * 2;
+    char* out = new char[*size];
+    memcpy(out, MakeWavHeader(kSampleRate, 1, 2, *size), WAV_HEADER_SIZE);
+    for (int i = 0; i < kSampleFrames; ++i) {
+      out[WAV_HEADER_SIZE + i * 2] = static_cast<char>(id_ & 0xff);
+      out[WAV_HEADER_SIZE + i * 2 + 1] = static_cast<char>(id_ >> 8);
+    }
+    return out;
+  }
+
+ private:
+  int id_;
+};
+
+// Serves FakeVoiceSamples for every id except |missing_id|, records which ids
+// the worker asked for, and can hold the worker inside Find() until the test
+// lets it go.
+class FakeVoiceCache : public VoiceCache {
+ public:
+  FakeVoiceCache(SoundSystem& sound_system, int missing_id)
+      : VoiceCache(sound_system), missing_id_(missing_id), blocked_(false) {}
+
+  virtual std::shared_ptr<VoiceSample> Find(int id) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    found_.push_back(id);
+    changed_.notify_all();
+    changed_.wait(lock, [&] { return !blocked_; });
+
+    if (id == missing_id_)
+      return std::shared_ptr<VoiceSample>();
+    return std::make_shared<FakeVoiceSample>(id);
+  }
+
+  void Block() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocked_ = true;
+  }
+
+  void Unblock() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      blocked_ = false;
+    }
+    changed_.notify_all();
+  }
+
+  // Waits until the worker has started looking up |id|.
+  void WaitForFind(int id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] {
+      return std::find(found_.begin(), found_.end(), id) != found_.end();
+    });
+  }
+
+  std::vector<int> found() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return found_;
+  }
+
+ private:
+  int missing_id_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::vector<int> found_;
+  bool blocked_;
+};
+
+}  // namespace
+
+// -----------------------------------------------------------------------
+// ScanForVoices
+// -----------------------------------------------------------------------
+
+class VoiceScanTest : public ::testing::Test {
+ protected:
+  // Builds:
+  //
+  //   <instruction pointer>
+  //   koePlay(100)
+  //   koeWait()
+  //   koePlay(intA[0])
+  //   koeDoPlayEx(200, 1)
+  //   koePlay(100)
+  //   bgmPlay(300)
+  //   koePlayExC(400)
+  VoiceScanTest() {
+    libreallive::ConstructionData cdata(0);
+    elements.Read(",", NULL, cdata);
+    elements.AppendFunction(Function(23, 0, {IntParam(100)}).c_str());
+    elements.AppendFunction(Function(23, 3, {}).c_str());
+    elements.AppendFunction(Function(23, 0, {VariableParam()}).c_str());
+    elements.AppendFunction(
+        Function(23, 9, {IntParam(200), IntParam(1)}).c_str());
+    elements.AppendFunction(Function(23, 0, {IntParam(100)}).c_str());
+    elements.AppendFunction(Function(20, 0, {IntParam(300)}).c_str());
+    elements.AppendFunction(Function(23, 7, {IntParam(400)}).c_str());
+  }
+
+  BytecodeList elements;
+};
+
+TEST_F(VoiceScanTest, FindsConstantVoiceIds) {
+  std::vector<int> ids = VoicePrefetcher::ScanForVoices(elements, 0, 10);
+  std::vector<int> expected = {100, 200, 400};
+  EXPECT_EQ(expected, ids);
+}
+
+TEST_F(VoiceScanTest, StopsAfterMaxIds) {
+  std::vector<int> ids = VoicePrefetcher::ScanForVoices(elements, 0, 2);
+  std::vector<int> expected = {100, 200};
+  EXPECT_EQ(expected, ids);
+}
+
+TEST_F(VoiceScanTest, StartsAfterInstructionPointer) {
+  std::vector<int> ids = VoicePrefetcher::ScanForVoices(elements, 1, 10);
+  std::vector<int> expected = {200, 100, 400};
+  EXPECT_EQ(expected, ids);
+}
+
+TEST_F(VoiceScanTest, EmptyRange) {
+  EXPECT_TRUE(
+      VoicePrefetcher::ScanForVoices(elements, elements.size(), 10).empty());
+}
+
+// -----------------------------------------------------------------------
+// Prefetch() and Take()
+// -----------------------------------------------------------------------
+
+class VoicePrefetcherTest : public FullSystemTest {
+ protected:
+  VoicePrefetcherTest()
+      : cache(system.sound(), kMissingId), prefetcher(cache) {}
+
+  static const int kMissingId = 3;
+
+  FakeVoiceCache cache;
+  VoicePrefetcher prefetcher;
+};
+
+TEST_F(VoicePrefetcherTest, TakeReturnsOpenedSampleWithFirstBlock) {
+  prefetcher.Prefetch({1});
+  cache.WaitForFind(1);
+
+  std::unique_ptr<PreparedVoice> voice = prefetcher.Take(1);
+  ASSERT_TRUE(voice.get());
+  EXPECT_EQ(kSampleRate, voice->rate);
+  EXPECT_EQ(1, voice->channels);
+  ASSERT_EQ(static_cast<size_t>(VoicePrefetcher::kFirstBlockFrames),
+            voice->first_block.size());
+  EXPECT_EQ(1, voice->first_block[0]);
+  EXPECT_EQ(1, prefetcher.hits());
+  EXPECT_EQ(0, prefetcher.misses());
+
+  // The rest of the sample is left for the stream to decode.
+  std::vector<int16_t> rest(kSampleFrames);
+  EXPECT_EQ(kSampleFrames - VoicePrefetcher::kFirstBlockFrames,
+            voice->sample->DecodeSome(rest.data(), kSampleFrames));
+
+  // A sample can only be claimed once.
+  EXPECT_FALSE(prefetcher.Take(1).get());
+  EXPECT_EQ(1, prefetcher.misses());
+  EXPECT_EQ(0u, prefetcher.ready_bytes());
+}
+
+TEST_F(VoicePrefetcherTest, TakeWaitsForTheSampleBeingPrepared) {
+  cache.Block();
+  prefetcher.Prefetch({1});
+  cache.WaitForFind(1);
+
+  // The worker is stuck inside Find(1); Take() must wait for it rather than
+  // reporting a miss.
+  std::thread release([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    cache.Unblock();
+  });
+  std::unique_ptr<PreparedVoice> voice = prefetcher.Take(1);
+  release.join();
+
+  ASSERT_TRUE(voice.get());
+  EXPECT_EQ(1, voice->first_block[0]);
+  EXPECT_EQ(1, prefetcher.hits());
+}
+
+TEST_F(VoicePrefetcherTest, TakeClaimsPendingIdsFromTheWorker) {
+  cache.Block();
+  prefetcher.Prefetch({1, 2});
+  cache.WaitForFind(1);
+
+  // 2 is still queued behind 1, so the caller opens it itself and the worker
+  // must not bother with it.
+  EXPECT_FALSE(prefetcher.Take(2).get());
+  EXPECT_EQ(1, prefetcher.misses());
+
+  cache.Unblock();
+  EXPECT_TRUE(prefetcher.Take(1).get());
+
+  std::vector<int> expected = {1};
+  EXPECT_EQ(expected, cache.found());
+}
+
+TEST_F(VoicePrefetcherTest, PrefetchDropsSamplesNoLongerWanted) {
+  prefetcher.Prefetch({1});
+  cache.WaitForFind(1);
+  prefetcher.Prefetch({2});
+  cache.WaitForFind(2);
+
+  EXPECT_FALSE(prefetcher.Take(1).get());
+  std::unique_ptr<PreparedVoice> voice = prefetcher.Take(2);
+  ASSERT_TRUE(voice.get());
+  EXPECT_EQ(2, voice->first_block[0]);
+  EXPECT_EQ(1, prefetcher.hits());
+  EXPECT_EQ(1, prefetcher.misses());
+  EXPECT_EQ(0u, prefetcher.ready_bytes());
+}
+
+TEST_F(VoicePrefetcherTest, ReadyQueueIsBoundedByBytes) {
+  prefetcher.set_max_ready_bytes(1);
+  prefetcher.Prefetch({1, 2});
+
+  // Once 1 is ready the queue is over budget, so 2 has to wait.
+  while (prefetcher.ready_bytes() == 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_LE(static_cast<size_t>(VoicePrefetcher::kFirstBlockFrames * 2),
+            prefetcher.ready_bytes());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::vector<int> expected = {1};
+  EXPECT_EQ(expected, cache.found());
+
+  // Taking 1 makes room for it.
+  EXPECT_TRUE(prefetcher.Take(1).get());
+  cache.WaitForFind(2);
+  EXPECT_TRUE(prefetcher.Take(2).get());
+}
+
+TEST_F(VoicePrefetcherTest, MissingVoiceIsAMiss) {
+  prefetcher.Prefetch({kMissingId});
+  cache.WaitForFind(kMissingId);
+
+  EXPECT_FALSE(prefetcher.Take(kMissingId).get());
+  EXPECT_EQ(0, prefetcher.hits());
+  EXPECT_EQ(1, prefetcher.misses());
+}
+
+TEST_F(VoicePrefetcherTest, ClearForgetsPreparedSamples) {
+  prefetcher.Prefetch({1});
+  cache.WaitForFind(1);
+  prefetcher.Clear();
+
+  EXPECT_FALSE(prefetcher.Take(1).get());
+  EXPECT_EQ(0u, prefetcher.ready_bytes());
+}